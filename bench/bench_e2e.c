@@ -0,0 +1,273 @@
+/**
+ * @file    bench_e2e.c
+ * @brief   End-to-end transactions-per-second benchmark. Master and N slaves run in separate threads connected
+ *          by pseudo-terminals through bus simulator (@ref mod_bussim_linux.h), or by one pty pair directly (-x).
+ *          Whole-system cost is measured: syscalls, wake-ups, framing and stacks. No serial hardware needed.
+ *
+ *          Build:
+ *          gcc -O2 -pthread -DMODBUS_PORT_LINUX -I.. -o bench_e2e bench_e2e.c ../mod_master_rtu.c
+ *              ../mod_slave_rtu.c ../mod_regmap.c ../mod_stream_rtu.c ../mod_port_linux.c
+ *              ../mod_bussim_linux.c ../crc.c
+ *
+ *          Usage:
+ *          bench_e2e [-s slaves] [-d seconds] [-b baud] [-w write_percent] [-x] > result.json
+ *          -b  pace the simulated bus to given baud rate (default unlimited)
+ *          -x  master and single slave connected by one pty pair, without bus simulator
+ *
+ *          Reports transactions/s, latency percentiles, errors and CPU time per transaction (all threads) as JSON.
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "mod_port_linux.h"
+#include "mod_bussim_linux.h"
+#include "mod_regmap.h"
+
+#define MAX_SLAVES  32
+#define MAX_SAMPLES (1u << 24)
+
+typedef struct
+{
+    modSlaveStack_t stack;
+    modPortLink_t   link;
+    modRegMap_t     map;
+    modRegRegion_t  region;
+    uint16_t        regs[1024];
+    pthread_t       thread;
+} benchSlave_t;
+
+static benchSlave_t slaves[MAX_SLAVES];
+static volatile int stop;
+
+// userContent of the stack is occupied by transport link, map is in userContent of the link
+static uint8_t GetReg(modSlaveStack_t* mstack, uint16_t regAddr, uint16_t* regValue)
+{
+    return ModRegMapRead((modRegMap_t*)((modPortLink_t*)mstack->userContent)->userContent, regAddr, regValue);
+}
+
+static uint8_t SetReg(modSlaveStack_t* mstack, uint16_t regAddr, uint16_t regValue)
+{
+    return ModRegMapWrite((modRegMap_t*)((modPortLink_t*)mstack->userContent)->userContent, regAddr, regValue);
+}
+
+static void* SlaveThread(void* arg)
+{
+    benchSlave_t* s = (benchSlave_t*)arg;
+
+    while (!stop)
+    {
+        (void)ModSlaveCheck(&s->stack);
+        (void)ModPortPoll(&s->link, 50);
+    }
+
+    return NULL;
+}
+
+static int SlaveStart(benchSlave_t* s, uint8_t address, int fd)
+{
+    s->region.first = 0;
+    s->region.count = sizeof(s->regs) / sizeof(s->regs[0]);
+    s->region.values = s->regs;
+    s->map.regions = &s->region;
+    s->map.numRegions = 1;
+    s->stack.address = address;
+    s->stack.lastReg = (uint16_t)ModRegMapInit(&s->map);
+    s->stack.pfGetReg = &GetReg;
+    s->stack.pfSetReg = &SetReg;
+    if (ModPortSlaveAttach(&s->link, &s->stack, fd) < 0)
+    {
+        return -1;
+    }
+    s->link.userContent = &s->map;
+    if (ModSlaveInit(&s->stack) < 0)
+    {
+        return -1;
+    }
+
+    return pthread_create(&s->thread, NULL, &SlaveThread, s) == 0 ? 0 : -1;
+}
+
+static int CompareU32(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static double CpuSeconds(void)
+{
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+
+    return (double)ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+           (double)ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+int main(int argc, char** argv)
+{
+    static const uint16_t readSizes[] = { 1, 8, 32, 64, 125 };
+    static const uint16_t writeSizes[] = { 1, 8, 32, 64, 123 };
+    unsigned numSlaves = 4;
+    unsigned seconds = 5;
+    uint32_t baud = 0;
+    unsigned writePercent = 20;
+    int direct = 0;
+    int opt;
+    modBusSim_t sim;
+    modMasterStack_t master;
+    modPortLink_t masterLink;
+    int masterFd;
+    uint16_t regs[125];
+    uint32_t* samples;
+    uint64_t done = 0;
+    uint64_t errors[eMOD_M_STATE_HW_ERROR + 1];
+    uint64_t t0, tEnd;
+    double cpu0, cpu;
+
+    while ((opt = getopt(argc, argv, "s:d:b:w:x")) != -1)
+    {
+        switch (opt)
+        {
+            case 's': numSlaves = (unsigned)strtoul(optarg, NULL, 10); break;
+            case 'd': seconds = (unsigned)strtoul(optarg, NULL, 10); break;
+            case 'b': baud = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'w': writePercent = (unsigned)strtoul(optarg, NULL, 10); break;
+            case 'x': direct = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-s slaves] [-d seconds] [-b baud] [-w write_percent] [-x]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (direct)
+    {
+        numSlaves = 1;
+    }
+    if (numSlaves < 1 || numSlaves > MAX_SLAVES || writePercent > 100)
+    {
+        fprintf(stderr, "1 - %d slaves, 0 - 100 %% writes\n", MAX_SLAVES);
+        return 2;
+    }
+
+    memset(&sim, 0, sizeof(sim));
+    if (direct)
+    {
+        // pty master side for master stack, pty slave side for slave stack
+        masterFd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+        if (masterFd < 0 || grantpt(masterFd) < 0 || unlockpt(masterFd) < 0)
+        {
+            perror("pty");
+            return 1;
+        }
+        if (SlaveStart(&slaves[0], 1, ModPortOpenSerial(ptsname(masterFd), 0, 'N')) < 0)
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        if (ModBusSimOpen(&sim, (uint16_t)(numSlaves + 1), baud) < 0 || ModBusSimStart(&sim) < 0)
+        {
+            perror("bus simulator");
+            return 1;
+        }
+        masterFd = sim.deviceFd[0];
+        for (unsigned i = 0; i < numSlaves; i++)
+        {
+            if (SlaveStart(&slaves[i], (uint8_t)(i + 1), sim.deviceFd[i + 1]) < 0)
+            {
+                return 1;
+            }
+        }
+    }
+
+    memset(&master, 0, sizeof(master));
+    if (ModPortMasterAttach(&masterLink, &master, masterFd) < 0 || ModMasterInit(&master) < 0)
+    {
+        return 1;
+    }
+    samples = malloc(MAX_SAMPLES * sizeof(uint32_t));
+    if (samples == NULL)
+    {
+        return 1;
+    }
+    memset(errors, 0, sizeof(errors));
+    memset(regs, 0x5A, sizeof(regs));
+
+    cpu0 = CpuSeconds();
+    t0 = ModPortTimeUs();
+    tEnd = t0 + seconds * 1000000ULL;
+    for (uint64_t n = 0; ModPortTimeUs() < tEnd; n++)
+    {
+        uint8_t address = (uint8_t)(n % numSlaves + 1);
+        uint64_t start = ModPortTimeUs();
+        modMasterState_t status;
+        int16_t r;
+
+        if ((n * 37) % 100 < writePercent)
+        {
+            r = ModMasterWriteRegs(&master, address, 0, writeSizes[n % 5], regs);
+        }
+        else
+        {
+            r = ModMasterReadRegs(&master, address, 0, readSizes[n % 5], regs);
+        }
+        if (r < 0)
+        {
+            fprintf(stderr, "request failed (%d)\n", r);
+            break;
+        }
+        while (!ModMasterCheck(&master, &status, NULL))
+        {
+            (void)ModPortPoll(&masterLink, 5);
+        }
+
+        errors[status]++;
+        if (status == eMOD_M_STATE_PROCESSED && done < MAX_SAMPLES)
+        {
+            samples[done++] = (uint32_t)(ModPortTimeUs() - start);
+        }
+    }
+    t0 = ModPortTimeUs() - t0;
+    cpu = CpuSeconds() - cpu0;
+
+    stop = 1;
+    for (unsigned i = 0; i < numSlaves; i++)
+    {
+        pthread_join(slaves[i].thread, NULL);
+    }
+    if (direct)
+    {
+        close(slaves[0].link.fd);
+        close(masterFd);
+    }
+    else
+    {
+        ModBusSimClose(&sim);
+    }
+
+    qsort(samples, done, sizeof(uint32_t), CompareU32);
+    printf("{\n  \"slaves\": %u, \"baud\": %u, \"direct\": %d, \"seconds\": %.3f,\n",
+           numSlaves, baud, direct, t0 / 1e6);
+    printf("  \"transactions\": %llu, \"transactions_per_s\": %.1f,\n",
+           (unsigned long long)done, done * 1e6 / (double)t0);
+    if (done > 0)
+    {
+        printf("  \"latency_us\": {\"p50\": %u, \"p90\": %u, \"p99\": %u, \"p999\": %u, \"max\": %u},\n",
+               samples[done / 2], samples[done * 9 / 10], samples[done * 99 / 100], samples[done * 999 / 1000],
+               samples[done - 1]);
+        printf("  \"cpu_us_per_transaction\": %.2f,\n", cpu * 1e6 / (double)done);
+    }
+    printf("  \"errors\": {\"timed_out\": %llu, \"corrupted\": %llu, \"err_reported\": %llu, \"hw_error\": %llu}\n}\n",
+           (unsigned long long)errors[eMOD_M_STATE_TIMED_OUT], (unsigned long long)errors[eMOD_M_STATE_CORRUPTED],
+           (unsigned long long)errors[eMOD_M_STATE_ERR_REPORTED], (unsigned long long)errors[eMOD_M_STATE_HW_ERROR]);
+    free(samples);
+
+    return 0;
+}
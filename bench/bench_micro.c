@@ -0,0 +1,408 @@
+/**
+ * @file    bench_micro.c
+ * @brief   Self-contained microbenchmarks of frame building, parsing and CRC. Stacks run with null transport,
+ *          so only CPU cost of the library is measured. Results are printed as JSON (one object per benchmark),
+ *          suitable for regression checks before firmware releases.
+ *
+ *          Build:
+ *          gcc -O2 -DMODBUS_PORT_LINUX [-DMODBUS_USER_COMMANDS] -I.. -o bench_micro bench_micro.c
+ *              ../mod_master_rtu.c ../mod_slave_rtu.c ../mod_stream_rtu.c ../mod_port_linux.c ../crc.c
+ *
+ *          Usage:
+ *          bench_micro [-t min_time_ms] [-r repetitions] [filter] > result.json
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "mod_master_rtu.h"
+#include "mod_slave_rtu.h"
+#include "crc.h"
+
+#define DO_NOT_OPTIMIZE(x)  __asm__ volatile("" : : "g"(x) : "memory")
+
+/***** harness *****/
+
+typedef void (*benchFn_t)(void* arg);
+
+static unsigned minTimeMs = 200;
+static unsigned repetitions = 5;
+static const char* filter;
+static int first = 1;
+
+static uint64_t NowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static double RunBatch(benchFn_t fn, void* arg, uint64_t iterations)
+{
+    uint64_t t0 = NowNs();
+
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        fn(arg);
+    }
+
+    return (double)(NowNs() - t0);
+}
+
+static int CompareDouble(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void Bench(const char* name, benchFn_t fn, void* arg, uint32_t bytes)
+{
+    uint64_t iterations = 1;
+    double samples[32];
+    double ns;
+
+    if (filter != NULL && strstr(name, filter) == NULL)
+    {
+        return;
+    }
+
+    // find number of iterations running at least minTimeMs
+    while ((ns = RunBatch(fn, arg, iterations)) < minTimeMs * 1e6 / 10 && iterations < (1ULL << 40))
+    {
+        iterations *= 2;
+    }
+    iterations = (uint64_t)(iterations * (minTimeMs * 1e6) / (ns > 0 ? ns : 1)) + 1;
+
+    for (unsigned r = 0; r < repetitions; r++)
+    {
+        samples[r] = RunBatch(fn, arg, iterations) / (double)iterations;
+    }
+    qsort(samples, repetitions, sizeof(double), CompareDouble);
+
+    printf("%s\n  {\"name\": \"%s\", \"iterations\": %llu, \"ns_min\": %.2f, \"ns_median\": %.2f, \"ns_max\": %.2f",
+           first ? "[" : ",", name, (unsigned long long)iterations,
+           samples[0], samples[repetitions / 2], samples[repetitions - 1]);
+    if (bytes > 0)
+    {
+        printf(", \"mb_per_s\": %.1f", bytes * 1e3 / samples[repetitions / 2]);
+    }
+    printf("}");
+    first = 0;
+}
+
+/***** null transport *****/
+
+static int16_t NullSend(modMasterStack_t* mstack, const uint8_t* data, uint16_t length)
+{
+    (void)mstack; (void)data; (void)length;
+    return 0;
+}
+
+static int16_t NullReceive(modMasterStack_t* mstack)
+{
+    (void)mstack;
+    return 0;
+}
+
+static int16_t NullStandby(modSlaveStack_t* mstack)
+{
+    (void)mstack;
+    return 0;
+}
+
+static int16_t NullSendAns(modSlaveStack_t* mstack, const uint8_t* data, uint16_t length)
+{
+    (void)data; (void)length;
+    ModSlaveTxDoneCallback(mstack);
+    return 0;
+}
+
+static uint16_t slaveRegs[256];
+
+static uint8_t GetReg(modSlaveStack_t* mstack, uint16_t regAddr, uint16_t* regValue)
+{
+    (void)mstack;
+    *regValue = slaveRegs[regAddr & 0xFF];
+    return 0;
+}
+
+static uint8_t SetReg(modSlaveStack_t* mstack, uint16_t regAddr, uint16_t regValue)
+{
+    (void)mstack;
+    slaveRegs[regAddr & 0xFF] = regValue;
+    return 0;
+}
+
+#ifdef MODBUS_USER_COMMANDS
+static uint8_t GetPacket(modSlaveStack_t* mstack, uint8_t* buffer, uint16_t* length)
+{
+    (void)mstack;
+    memset(buffer, 0xA5, 64);
+    *length = 64;
+    return 0;
+}
+
+static uint8_t SetPacket(modSlaveStack_t* mstack, const uint8_t* buffer, uint16_t length)
+{
+    (void)mstack; (void)buffer; (void)length;
+    return 0;
+}
+#endif
+
+static modMasterStack_t master;
+static modSlaveStack_t slave;
+static uint16_t regs[125];
+
+static uint16_t AppendCrc(uint8_t* frame, uint16_t length)
+{
+    uint16_t crc = CrcModbus(frame, (uint8_t)length, 0xFFFF);
+    frame[length] = (uint8_t)crc;
+    frame[length + 1] = (uint8_t)(crc >> 8);
+    return length + 2;
+}
+
+/***** benchmarks *****/
+
+typedef struct
+{
+    uint8_t  data[256];
+    uint16_t length;
+} benchFrame_t;
+
+static void BenchCrc(void* arg)
+{
+    benchFrame_t* f = (benchFrame_t*)arg;
+    DO_NOT_OPTIMIZE(CrcModbus(f->data, (uint8_t)f->length, 0xFFFF));
+}
+
+static void BenchBuildRead(void* arg)
+{
+    master.status = eMOD_M_STATE_STANDBY;
+    DO_NOT_OPTIMIZE(ModMasterReadRegs(&master, 1, 0x100, (uint16_t)(uintptr_t)arg, regs));
+}
+
+static void BenchBuildWrite(void* arg)
+{
+    master.status = eMOD_M_STATE_STANDBY;
+    DO_NOT_OPTIMIZE(ModMasterWriteRegs(&master, 1, 0x100, (uint16_t)(uintptr_t)arg, regs));
+}
+
+// answer to pending read / write, goes through ModMasterParseAnswer() and ModMasterProcessAnswer()
+typedef struct
+{
+    benchFrame_t frame;
+    uint8_t      opCode;
+    uint16_t     numRegs;
+} benchAnswer_t;
+
+static void BenchMasterAnswer(void* arg)
+{
+    benchAnswer_t* a = (benchAnswer_t*)arg;
+    modMasterState_t s;
+    uint8_t e;
+
+    master.status = eMOD_M_STATE_WAITING_ANSWER;
+    master.slaveAddr = 1;
+    master.opCode = a->opCode;
+    master.firstReg = 0x100;
+    master.numRegs = a->numRegs;
+    master.dataStorage = regs;
+    ModMasterRxDoneCallback(&master, a->frame.data, a->frame.length);
+    (void)ModMasterCheck(&master, &s, &e);
+    DO_NOT_OPTIMIZE(s);
+}
+
+// command for slave, goes through ModSlaveParseMessage() and ModSlaveProcessCommand()
+static void BenchSlaveCommand(void* arg)
+{
+    benchFrame_t* f = (benchFrame_t*)arg;
+
+    slave.status = eMOD_S_STATE_RECEIVING;
+    ModSlaveRxDoneCallback(&slave, f->data, f->length);
+    DO_NOT_OPTIMIZE(ModSlaveCheck(&slave));
+}
+
+static void RunCrc(void)
+{
+    static const uint16_t lengths[] = { 6, 16, 64, 128, 254 };
+    benchFrame_t f;
+    char name[64];
+
+    for (uint16_t i = 0; i < sizeof(f.data); i++)
+    {
+        f.data[i] = (uint8_t)(i * 31 + 7);
+    }
+    for (unsigned i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++)
+    {
+        f.length = lengths[i];
+        snprintf(name, sizeof(name), "crc/%u", lengths[i]);
+        Bench(name, BenchCrc, &f, lengths[i]);
+    }
+}
+
+static void RunBuild(void)
+{
+    Bench("master_build/read/1", BenchBuildRead, (void*)(uintptr_t)1, 0);
+    Bench("master_build/read/125", BenchBuildRead, (void*)(uintptr_t)125, 0);
+    Bench("master_build/write/1", BenchBuildWrite, (void*)(uintptr_t)1, 0);
+    Bench("master_build/write/123", BenchBuildWrite, (void*)(uintptr_t)123, 0);
+}
+
+static void MakeReadAnswer(benchAnswer_t* a, uint16_t num)
+{
+    a->opCode = 0x03;
+    a->numRegs = num;
+    a->frame.data[0] = 1;
+    a->frame.data[1] = 0x03;
+    a->frame.data[2] = (uint8_t)(2 * num);
+    for (uint16_t i = 0; i < 2 * num; i++)
+    {
+        a->frame.data[3 + i] = (uint8_t)i;
+    }
+    a->frame.length = AppendCrc(a->frame.data, 3 + 2 * num);
+}
+
+static void RunMasterAnswer(void)
+{
+    benchAnswer_t a;
+
+    MakeReadAnswer(&a, 1);
+    Bench("master_answer/read/1", BenchMasterAnswer, &a, 0);
+    MakeReadAnswer(&a, 125);
+    Bench("master_answer/read/125", BenchMasterAnswer, &a, 0);
+
+    // corrupted answers
+    MakeReadAnswer(&a, 125);
+    a.frame.data[a.frame.length - 1] ^= 0xFF;
+    Bench("master_answer/read/125/bad_crc", BenchMasterAnswer, &a, 0);
+    MakeReadAnswer(&a, 125);
+    a.frame.data[0] = 2;
+    Bench("master_answer/read/125/wrong_slave", BenchMasterAnswer, &a, 0);
+    MakeReadAnswer(&a, 124);
+    a.numRegs = 125;
+    Bench("master_answer/read/125/wrong_count", BenchMasterAnswer, &a, 0);
+
+    a.opCode = 0x10;
+    a.numRegs = 123;
+    a.frame.data[0] = 1;
+    a.frame.data[1] = 0x10;
+    a.frame.data[2] = 0x01;
+    a.frame.data[3] = 0x00;
+    a.frame.data[4] = 0;
+    a.frame.data[5] = 123;
+    a.frame.length = AppendCrc(a.frame.data, 6);
+    Bench("master_answer/write/123", BenchMasterAnswer, &a, 0);
+
+    a.frame.data[1] = 0x90;
+    a.frame.data[2] = MODBUS_ERR_ILLEGAL_ADDRESS;
+    a.frame.length = AppendCrc(a.frame.data, 3);
+    Bench("master_answer/write/exception", BenchMasterAnswer, &a, 0);
+}
+
+static void MakeCommand(benchFrame_t* f, uint8_t opCode, uint16_t num)
+{
+    uint16_t len = 6;
+
+    f->data[0] = 1;
+    f->data[1] = opCode;
+    f->data[2] = 0;
+    f->data[3] = 0;
+    f->data[4] = (uint8_t)(num >> 8);
+    f->data[5] = (uint8_t)num;
+    if (opCode == 0x10)
+    {
+        f->data[6] = (uint8_t)(2 * num);
+        for (uint16_t i = 0; i < 2 * num; i++)
+        {
+            f->data[7 + i] = (uint8_t)i;
+        }
+        len = 7 + 2 * num;
+    }
+    f->length = AppendCrc(f->data, len);
+}
+
+static void RunSlaveCommand(void)
+{
+    benchFrame_t f;
+
+    MakeCommand(&f, 0x03, 1);
+    Bench("slave_command/read_holding/1", BenchSlaveCommand, &f, 0);
+    MakeCommand(&f, 0x03, 125);
+    Bench("slave_command/read_holding/125", BenchSlaveCommand, &f, 0);
+    MakeCommand(&f, 0x04, 1);
+    Bench("slave_command/read_input/1", BenchSlaveCommand, &f, 0);
+    MakeCommand(&f, 0x04, 125);
+    Bench("slave_command/read_input/125", BenchSlaveCommand, &f, 0);
+    MakeCommand(&f, 0x10, 1);
+    Bench("slave_command/write_multi/1", BenchSlaveCommand, &f, 0);
+    MakeCommand(&f, 0x10, 123); // 123 is protocol maximum for write
+    Bench("slave_command/write_multi/123", BenchSlaveCommand, &f, 0);
+    MakeCommand(&f, 0x08, 0);
+    Bench("slave_command/diagnostic", BenchSlaveCommand, &f, 0);
+    MakeCommand(&f, 0x2B, 0);
+    Bench("slave_command/illegal_opcode", BenchSlaveCommand, &f, 0);
+#ifdef MODBUS_USER_COMMANDS
+    f.data[0] = 1;
+    f.data[1] = 0x64;
+    f.length = AppendCrc(f.data, 2);
+    Bench("slave_command/read_packet/64", BenchSlaveCommand, &f, 0);
+    f.data[1] = 0x65;
+    f.data[2] = 251;
+    memset(f.data + 3, 0x5A, 251);
+    f.length = AppendCrc(f.data, 3 + 251);
+    Bench("slave_command/write_packet/251", BenchSlaveCommand, &f, 0);
+#endif
+}
+
+int main(int argc, char** argv)
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:r:")) != -1)
+    {
+        switch (opt)
+        {
+            case 't': minTimeMs = (unsigned)strtoul(optarg, NULL, 10); break;
+            case 'r': repetitions = (unsigned)strtoul(optarg, NULL, 10); break;
+            default:
+                fprintf(stderr, "usage: %s [-t min_time_ms] [-r repetitions] [filter]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (repetitions < 1 || repetitions > 32)
+    {
+        repetitions = 5;
+    }
+    if (optind < argc)
+    {
+        filter = argv[optind];
+    }
+
+    master.pfSend = &NullSend;
+    master.pfReceive = &NullReceive;
+    slave.address = 1;
+    slave.lastReg = 0xFFFF;
+    slave.pfStandby = &NullStandby;
+    slave.pfSendAns = &NullSendAns;
+    slave.pfGetReg = &GetReg;
+    slave.pfSetReg = &SetReg;
+#ifdef MODBUS_USER_COMMANDS
+    slave.pfGetPacket = &GetPacket;
+    slave.pfSetPacket = &SetPacket;
+#endif
+    if (ModMasterInit(&master) < 0 || ModSlaveInit(&slave) < 0)
+    {
+        return 1;
+    }
+
+    RunCrc();
+    RunBuild();
+    RunMasterAnswer();
+    RunSlaveCommand();
+    printf("%s\n", first ? "[]" : "\n]");
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "mod_busload.h"
+
+// move rolling window to current time, clear slots which were skipped
+static void ModBusLoadRotate(modBusLoad_t* load, MODBUS_TIME_T now)
+{
+    MODBUS_TIME_T elapsed = (MODBUS_TIME_T)(now - load->slotStart);
+
+    if (elapsed >= (MODBUS_TIME_T)(MODBUS_BUSLOAD_SLOTS * MODBUS_BUSLOAD_SLOT_MS))
+    {
+        // idle longer than whole window
+        memset(load->window, 0, sizeof(load->window));
+        load->slot = 0;
+        load->filled = MODBUS_BUSLOAD_SLOTS - 1;
+        load->slotStart = (MODBUS_TIME_T)(now - elapsed % MODBUS_BUSLOAD_SLOT_MS);
+        return;
+    }
+    while (elapsed >= MODBUS_BUSLOAD_SLOT_MS)
+    {
+        load->slot = (uint8_t)((load->slot + 1) % MODBUS_BUSLOAD_SLOTS);
+        load->window[load->slot] = 0;
+        load->slotStart += MODBUS_BUSLOAD_SLOT_MS;
+        elapsed -= MODBUS_BUSLOAD_SLOT_MS;
+        if (load->filled < MODBUS_BUSLOAD_SLOTS - 1)
+        {
+            load->filled++;
+        }
+    }
+}
+
+int16_t ModBusLoadInit(modBusLoad_t* load, uint32_t baud, MODBUS_TIME_T now)
+{
+    if (load == NULL || baud == 0)
+    {
+        return -2; // wrong params
+    }
+
+    memset(load, 0, offsetof(modBusLoad_t, userContent));
+    load->charUs = ModMasterCharTimeUs(baud);
+    load->gapUs = ModMasterFrameGapUs(baud);
+    load->slotStart = now;
+
+    return 0;
+}
+
+void ModBusLoadAdd(modBusLoad_t* load, uint8_t slaveAddr, uint8_t opCode, uint16_t reqBytes, uint16_t respBytes,
+                   uint32_t durationUs, MODBUS_TIME_T now)
+{
+    uint32_t reqUs = reqBytes * load->charUs;
+    uint32_t respUs = respBytes * load->charUs;
+    uint32_t turnUs = 0;
+    uint32_t busyUs;
+
+    if (durationUs > reqUs + respUs)
+    {
+        // silence between frames, the bus can't be used by anybody else meanwhile
+        turnUs = durationUs - reqUs - respUs;
+    }
+    busyUs = reqUs + turnUs + respUs + load->gapUs;
+
+    load->transactions++;
+    load->requestUs += reqUs;
+    load->responseUs += respUs;
+    load->turnaroundUs += turnUs;
+    load->gapTotalUs += load->gapUs;
+    if (slaveAddr < MODBUS_BUSLOAD_SLAVES)
+    {
+        load->bySlave[slaveAddr] += busyUs;
+    }
+    load->byOpCode[opCode & 0x7F] += busyUs;
+
+    ModBusLoadRotate(load, now);
+    load->window[load->slot] += busyUs;
+}
+
+uint32_t ModBusLoadUtilization(modBusLoad_t* load, MODBUS_TIME_T now)
+{
+    uint64_t busyUs = 0;
+    uint32_t spanMs;
+    uint64_t ppm;
+    uint8_t i;
+
+    ModBusLoadRotate(load, now);
+    for (i = 0; i < MODBUS_BUSLOAD_SLOTS; i++)
+    {
+        busyUs += load->window[i];
+    }
+    spanMs = (uint32_t)load->filled * MODBUS_BUSLOAD_SLOT_MS + (uint32_t)(MODBUS_TIME_T)(now - load->slotStart);
+    if (spanMs == 0)
+    {
+        return 0;
+    }
+    // us / ms = thousandths, * 1000 = ppm
+    ppm = busyUs * 1000 / spanMs;
+
+    return ppm > 1000000 ? 1000000 : (uint32_t)ppm;
+}
@@ -0,0 +1,87 @@
+/**
+ * @file    mod_busload.h
+ * @brief   Bus utilization accounting of one serial line. Each transaction occupies the bus for request bytes,
+ *          turnaround (from end of request to start of response, incl. slave processing), response bytes and
+ *          inter-frame gap. Byte times come from baud rate (11 bits per character), turnaround from measured
+ *          duration of transaction. Totals are kept by slave and by opcode, rolling utilization over last
+ *          MODBUS_BUSLOAD_SLOTS * MODBUS_BUSLOAD_SLOT_MS.
+ *
+ *          @ref mod_master_req.h feeds it when queue->load is set, anything else seeing the traffic (e.g. sniffer
+ *          transaction callback) can call @ref ModBusLoadAdd() directly.
+ */
+
+#ifndef SYSTEM_MOD_BUSLOAD_H
+#define SYSTEM_MOD_BUSLOAD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "mod_master_rtu.h"
+
+#ifndef MODBUS_BUSLOAD_SLOTS
+#define MODBUS_BUSLOAD_SLOTS        16      ///< slots of rolling window
+#endif
+#ifndef MODBUS_BUSLOAD_SLOT_MS
+#define MODBUS_BUSLOAD_SLOT_MS      1000    ///< length of one slot [ms]
+#endif
+#define MODBUS_BUSLOAD_SLAVES       248     ///< slave addresses 0 - 247
+#define MODBUS_BUSLOAD_OPCODES      128     ///< opcodes 0 - 127 (exception bit is ignored)
+
+/**
+ * @brief   Bus load structure, one per serial line
+ */
+typedef struct
+{
+    uint32_t                    charUs;         ///< time of one character
+    uint32_t                    gapUs;          ///< inter-frame gap
+    uint32_t                    transactions;
+    uint64_t                    requestUs;      ///< totals by part of transaction [us]
+    uint64_t                    responseUs;
+    uint64_t                    turnaroundUs;
+    uint64_t                    gapTotalUs;
+    uint64_t                    bySlave[MODBUS_BUSLOAD_SLAVES];     ///< total bus time by slave [us]
+    uint64_t                    byOpCode[MODBUS_BUSLOAD_OPCODES];   ///< total bus time by opcode [us]
+    uint32_t                    window[MODBUS_BUSLOAD_SLOTS];       ///< bus time in slots of rolling window [us]
+    MODBUS_TIME_T               slotStart;      ///< start of current slot
+    uint8_t                     slot;           ///< current slot
+    uint8_t                     filled;         ///< number of complete slots in window
+    void*                       userContent;    ///< user defined pointer, can by used to pass anything
+} modBusLoad_t;
+
+/**
+ * @brief           Initializes bus load structure, clears all totals
+ * @param load      Pointer to bus load structure
+ * @param baud      Baud rate of the line
+ * @param now       Current time [ms]
+ * @return int16_t  0 if OK, -2 wrong params
+ */
+int16_t ModBusLoadInit(modBusLoad_t* load, uint32_t baud, MODBUS_TIME_T now);
+
+/**
+ * @brief               Accounts one transaction
+ * @param load          Pointer to bus load structure
+ * @param slaveAddr     Slave address
+ * @param opCode        Operation code of request
+ * @param reqBytes      Length of request frame incl. CRC
+ * @param respBytes     Length of response frame incl. CRC, 0 if slave didn't answer (broadcast, timeout)
+ * @param durationUs    Measured time from start of request to end of response / timeout, 0 if unknown
+ * @param now           Current time [ms]
+ */
+void ModBusLoadAdd(modBusLoad_t* load, uint8_t slaveAddr, uint8_t opCode, uint16_t reqBytes, uint16_t respBytes,
+                   uint32_t durationUs, MODBUS_TIME_T now);
+
+/**
+ * @brief           Rolling utilization of the bus
+ * @param load      Pointer to bus load structure
+ * @param now       Current time [ms]
+ * @return uint32_t Utilization [parts per million], 1000000 = bus is never silent
+ */
+uint32_t ModBusLoadUtilization(modBusLoad_t* load, MODBUS_TIME_T now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_BUSLOAD_H */
@@ -0,0 +1,168 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include "mod_bussim_linux.h"
+#include "mod_port_linux.h"
+
+int16_t ModBusSimOpen(modBusSim_t* sim, uint16_t numPorts, uint32_t baud)
+{
+    if (numPorts < 2 || numPorts > MODBUS_BUSSIM_MAX_PORTS)
+    {
+        return -2; // wrong params
+    }
+
+    memset(sim, 0, sizeof(modBusSim_t));
+    sim->numPorts = numPorts;
+    sim->baud = baud;
+    for (uint16_t p = 0; p < numPorts; p++)
+    {
+        sim->relayFd[p] = -1;
+        sim->deviceFd[p] = -1;
+    }
+
+    for (uint16_t p = 0; p < numPorts; p++)
+    {
+        int fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+        const char* name;
+
+        if (fd < 0 || grantpt(fd) < 0 || unlockpt(fd) < 0 || (name = ptsname(fd)) == NULL)
+        {
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            ModBusSimClose(sim);
+            return -1;
+        }
+        sim->relayFd[p] = fd;
+        snprintf(sim->deviceName[p], sizeof(sim->deviceName[p]), "%s", name);
+
+        // device side stays open all the time, so relay never sees hang-up
+        sim->deviceFd[p] = ModPortOpenSerial(name, 0, 'N');
+        if (sim->deviceFd[p] < 0)
+        {
+            ModBusSimClose(sim);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// block until the simulated line had time to carry 'length' bytes
+static void ModBusSimPace(modBusSim_t* sim, uint64_t* busFreeUs, uint32_t length)
+{
+    uint64_t now = ModPortTimeUs();
+    struct timespec ts;
+
+    if (sim->baud == 0)
+    {
+        return;
+    }
+    if (*busFreeUs < now)
+    {
+        *busFreeUs = now;
+    }
+    *busFreeUs += (uint64_t)length * ModPortCharTimeUs(sim->baud);
+
+    // monotonic clock of ModPortTimeUs()
+    ts.tv_sec = (time_t)(*busFreeUs / 1000000u);
+    ts.tv_nsec = (long)(*busFreeUs % 1000000u) * 1000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    {
+        ;
+    }
+}
+
+static void* ModBusSimThread(void* arg)
+{
+    modBusSim_t* sim = (modBusSim_t*)arg;
+    struct pollfd fds[MODBUS_BUSSIM_MAX_PORTS];
+    uint64_t busFreeUs = 0;
+
+    for (uint16_t p = 0; p < sim->numPorts; p++)
+    {
+        fds[p].fd = sim->relayFd[p];
+        fds[p].events = POLLIN;
+    }
+
+    while (!sim->stop)
+    {
+        if (poll(fds, sim->numPorts, 50) <= 0)
+        {
+            continue;
+        }
+        for (uint16_t p = 0; p < sim->numPorts; p++)
+        {
+            uint8_t buf[512];
+            ssize_t r;
+
+            if (!(fds[p].revents & POLLIN))
+            {
+                continue;
+            }
+            r = read(fds[p].fd, buf, sizeof(buf));
+            if (r <= 0)
+            {
+                continue;
+            }
+            ModBusSimPace(sim, &busFreeUs, (uint32_t)r);
+            sim->bytes += (uint64_t)r;
+            if (p == 0)
+            {
+                // master talks to everybody, unit which doesn't listen loses the bytes (as on real bus)
+                for (uint16_t d = 1; d < sim->numPorts; d++)
+                {
+                    (void)!write(sim->relayFd[d], buf, (size_t)r);
+                }
+            }
+            else
+            {
+                (void)!write(sim->relayFd[0], buf, (size_t)r);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+int16_t ModBusSimStart(modBusSim_t* sim)
+{
+    sim->stop = 0;
+    if (pthread_create(&sim->thread, NULL, &ModBusSimThread, sim) != 0)
+    {
+        return -1;
+    }
+    sim->running = 1;
+
+    return 0;
+}
+
+void ModBusSimClose(modBusSim_t* sim)
+{
+    if (sim->running)
+    {
+        sim->stop = 1;
+        pthread_join(sim->thread, NULL);
+        sim->running = 0;
+    }
+    for (uint16_t p = 0; p < sim->numPorts; p++)
+    {
+        if (sim->deviceFd[p] >= 0)
+        {
+            close(sim->deviceFd[p]);
+            sim->deviceFd[p] = -1;
+        }
+        if (sim->relayFd[p] >= 0)
+        {
+            close(sim->relayFd[p]);
+            sim->relayFd[p] = -1;
+        }
+    }
+}
@@ -0,0 +1,62 @@
+/**
+ * @file    mod_bussim_linux.h
+ * @brief   RS-485 bus simulator for Linux built from pseudo-terminal pairs. Port 0 is the master side, bytes
+ *          written to it are delivered to all other ports, bytes written to any other port are delivered to port 0.
+ *          Stacks (or external programs) open the device side of each port like a serial line.
+ *          Optional baud-rate pacing delays delivery, so the bus can't carry more than real line would.
+ * @note    Build with -pthread.
+ */
+
+#ifndef SYSTEM_MOD_BUSSIM_LINUX_H
+#define SYSTEM_MOD_BUSSIM_LINUX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <pthread.h>
+
+#define MODBUS_BUSSIM_MAX_PORTS     33      ///< master + 32 unit loads, as RS-485 allows
+
+/**
+ * @brief   Bus simulator structure
+ */
+typedef struct
+{
+    uint16_t                    numPorts;       ///< port 0 = master, 1 .. numPorts-1 slaves
+    uint32_t                    baud;           ///< pacing, 0 = deliver as fast as possible
+    int                         relayFd[MODBUS_BUSSIM_MAX_PORTS];       ///< pty master side, used by relay thread
+    int                         deviceFd[MODBUS_BUSSIM_MAX_PORTS];      ///< pty slave side, for stacks
+    char                        deviceName[MODBUS_BUSSIM_MAX_PORTS][32];///< pty slave path, for external programs
+    uint64_t                    bytes;          ///< statistics: number of bytes carried
+    pthread_t                   thread;
+    uint8_t                     running;        ///< relay thread started
+    volatile int                stop;
+} modBusSim_t;
+
+/**
+ * @brief           Creates pty pairs of all ports, device sides are in raw non-blocking mode
+ * @param sim       Pointer to simulator structure
+ * @param numPorts  Number of ports incl. master, 2 - MODBUS_BUSSIM_MAX_PORTS
+ * @param baud      Simulated baud rate, 0 = unlimited
+ * @return int16_t  0 if OK, -1 if pty can't be created, -2 wrong params
+ */
+int16_t ModBusSimOpen(modBusSim_t* sim, uint16_t numPorts, uint32_t baud);
+
+/**
+ * @brief           Starts relay thread
+ * @return int16_t  0 if OK, -1 if thread can't be created
+ */
+int16_t ModBusSimStart(modBusSim_t* sim);
+
+/**
+ * @brief           Stops relay thread (if running) and closes all ports
+ */
+void ModBusSimClose(modBusSim_t* sim);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_BUSSIM_LINUX_H */
@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <string.h>
+#include "mod_caplog.h"
+
+#define MODBUS_CAPLOG_VERSION       1
+
+static const uint8_t capLogMagic[4] = { 'M', 'B', 'C', 'L' };
+
+static void ModCapLogPut32(uint8_t* out, uint32_t v)
+{
+    out[0] = (uint8_t)(v);
+    out[1] = (uint8_t)(v >> 8);
+    out[2] = (uint8_t)(v >> 16);
+    out[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t ModCapLogGet32(const uint8_t* in)
+{
+    return (uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24;
+}
+
+uint16_t ModCapLogHeader(uint8_t* out)
+{
+    memcpy(out, capLogMagic, sizeof(capLogMagic));
+    out[4] = MODBUS_CAPLOG_VERSION;
+    out[5] = 0;
+    out[6] = 0;
+    out[7] = 0;
+
+    return MODBUS_CAPLOG_HEADER_SIZE;
+}
+
+uint16_t ModCapLogEncode(modCapLog_t* log, uint8_t* out, uint64_t timeUs, uint8_t port, uint8_t info,
+                         const uint8_t* frame, uint16_t length)
+{
+    uint16_t idx = 0;
+
+    if (length < 1 || length > 256 || port == MODBUS_CAPLOG_PORT_SYNC || timeUs < log->timeUs)
+    {
+        return 0; // wrong params
+    }
+
+    if (!log->synced || timeUs - log->timeUs > 0xFFFFFFFFu)
+    {
+        // sync record with absolute time
+        ModCapLogPut32(out, 0);
+        out[4] = MODBUS_CAPLOG_PORT_SYNC;
+        out[5] = 0;
+        out[6] = 8 - 1;
+        ModCapLogPut32(out + 7, (uint32_t)timeUs);
+        ModCapLogPut32(out + 11, (uint32_t)(timeUs >> 32));
+        idx = MODBUS_CAPLOG_RECORD_HDR + 8;
+        log->timeUs = timeUs;
+        log->synced = 1;
+    }
+
+    ModCapLogPut32(out + idx, (uint32_t)(timeUs - log->timeUs));
+    out[idx + 4] = port;
+    out[idx + 5] = info;
+    out[idx + 6] = (uint8_t)(length - 1);
+    memcpy(out + idx + MODBUS_CAPLOG_RECORD_HDR, frame, length);
+    log->timeUs = timeUs;
+
+    return idx + MODBUS_CAPLOG_RECORD_HDR + length;
+}
+
+int16_t ModCapLogCheckHeader(const uint8_t* data, uint32_t length)
+{
+    if (length < MODBUS_CAPLOG_HEADER_SIZE || memcmp(data, capLogMagic, sizeof(capLogMagic)) != 0)
+    {
+        return -1;
+    }
+    if (data[4] != MODBUS_CAPLOG_VERSION)
+    {
+        return -2;
+    }
+
+    return 0;
+}
+
+int32_t ModCapLogDecode(modCapLog_t* log, const uint8_t* data, uint32_t length, modCapLogRecord_t* rec)
+{
+    uint32_t idx = 0;
+
+    for (;;)
+    {
+        uint16_t len;
+
+        if (length - idx < MODBUS_CAPLOG_RECORD_HDR)
+        {
+            return 0; // incomplete
+        }
+        len = (uint16_t)data[idx + 6] + 1;
+        if (length - idx < MODBUS_CAPLOG_RECORD_HDR + (uint32_t)len)
+        {
+            return 0; // incomplete
+        }
+
+        if (data[idx + 4] == MODBUS_CAPLOG_PORT_SYNC)
+        {
+            if (len != 8)
+            {
+                return -1;
+            }
+            log->timeUs = (uint64_t)ModCapLogGet32(data + idx + 7) |
+                          (uint64_t)ModCapLogGet32(data + idx + 11) << 32;
+            log->synced = 1;
+            idx += MODBUS_CAPLOG_RECORD_HDR + len;
+            continue;
+        }
+        if (!log->synced)
+        {
+            return -1; // frame record without absolute time
+        }
+
+        log->timeUs += ModCapLogGet32(data + idx);
+        rec->timeUs = log->timeUs;
+        rec->port = data[idx + 4];
+        rec->info = data[idx + 5];
+        rec->length = len;
+        rec->frame = data + idx + MODBUS_CAPLOG_RECORD_HDR;
+
+        return (int32_t)(idx + MODBUS_CAPLOG_RECORD_HDR + len);
+    }
+}
@@ -0,0 +1,99 @@
+/**
+ * @file    mod_caplog.h
+ * @brief   Compact binary capture log of Modbus RTU frames.
+ *
+ *          File layout (all numbers little endian):
+ *          | Offset | Size | Content                                                   |
+ *          | ------ | ---- | --------------------------------------------------------- |
+ *          | 0      | 4    | magic "MBCL"                                              |
+ *          | 4      | 1    | version (1)                                               |
+ *          | 5      | 3    | reserved, 0                                               |
+ *          | 8      | ...  | records                                                   |
+ *
+ *          Record: time delta [us] since previous record (4), port (1), info (1), frame length - 1 (1), frame.
+ *          Port 0xFF is sync record, frame holds absolute time [us] (8) - written before first record
+ *          and whenever time delta doesn't fit 32 bits.
+ */
+
+#ifndef SYSTEM_MOD_CAPLOG_H
+#define SYSTEM_MOD_CAPLOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define MODBUS_CAPLOG_HEADER_SIZE   8
+#define MODBUS_CAPLOG_RECORD_HDR    7
+#define MODBUS_CAPLOG_RECORD_MAX    (2 * MODBUS_CAPLOG_RECORD_HDR + 8 + 256)    ///< sync + longest frame record
+#define MODBUS_CAPLOG_PORT_SYNC     0xFF
+
+/**
+ * @defgroup ModbusCapLogInfo Record info byte
+ * @{
+ */
+#define MODBUS_CAPLOG_INFO_RESPONSE 0x01                        ///< frame is slave answer
+#define MODBUS_CAPLOG_INFO(isResponse, result)  ((uint8_t)(((isResponse) ? MODBUS_CAPLOG_INFO_RESPONSE : 0) | ((result) << 1)))
+#define MODBUS_CAPLOG_INFO_RESULT(info)         ((uint8_t)((info) >> 1))
+/** @} */
+
+/** Writer / reader cursor, zero it before first use */
+typedef struct
+{
+    uint64_t                    timeUs;         ///< time of last record
+    uint8_t                     synced;         ///< absolute time already written / read
+} modCapLog_t;
+
+/** One decoded frame record */
+typedef struct
+{
+    uint64_t                    timeUs;         ///< absolute time of frame
+    uint8_t                     port;           ///< source port (bus) index
+    uint8_t                     info;           ///< see @ref ModbusCapLogInfo
+    uint16_t                    length;         ///< frame length incl. CRC
+    const uint8_t*              frame;          ///< points into decoded data
+} modCapLogRecord_t;
+
+/**
+ * @brief           Writes file header
+ * @param out       Output buffer, at least MODBUS_CAPLOG_HEADER_SIZE bytes
+ * @return uint16_t Number of bytes written
+ */
+uint16_t ModCapLogHeader(uint8_t* out);
+
+/**
+ * @brief           Encodes one frame record (preceded by sync record if needed)
+ * @param log       Writer cursor
+ * @param out       Output buffer, at least MODBUS_CAPLOG_RECORD_MAX bytes
+ * @param timeUs    Absolute time of frame, non-decreasing
+ * @param port      Source port index, 0 - 254
+ * @param info      See @ref ModbusCapLogInfo
+ * @param frame     Frame incl. CRC
+ * @param length    Frame length, 1 - 256
+ * @return uint16_t Number of bytes written, 0 if params are wrong
+ */
+uint16_t ModCapLogEncode(modCapLog_t* log, uint8_t* out, uint64_t timeUs, uint8_t port, uint8_t info,
+                         const uint8_t* frame, uint16_t length);
+
+/**
+ * @brief           Checks file header
+ * @return int16_t  0 if OK, -1 not a capture log, -2 unsupported version
+ */
+int16_t ModCapLogCheckHeader(const uint8_t* data, uint32_t length);
+
+/**
+ * @brief           Decodes next frame record, sync records are consumed transparently
+ * @param log       Reader cursor
+ * @param data      Log data following the header
+ * @param length    Number of valid bytes at @b data
+ * @param rec       Decoded record, frame points into @b data
+ * @return int32_t  Number of consumed bytes, 0 if data are incomplete, -1 if log is corrupted
+ */
+int32_t ModCapLogDecode(modCapLog_t* log, const uint8_t* data, uint32_t length, modCapLogRecord_t* rec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_CAPLOG_H */
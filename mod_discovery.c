@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <string.h>
+#include "mod_discovery.h"
+
+#define MODBUS_DISCOVERY_ANSWER     8       ///< length of echo frame
+
+void ModDiscoveryInit(modDiscovery_t* disc)
+{
+    disc->numBuses = 0;
+    disc->lastAddr = 0;
+}
+
+int16_t ModDiscoveryAddBus(modDiscovery_t* disc, modMasterStack_t* mstack, uint32_t baud)
+{
+    modDiscoveryBus_t* bus;
+    uint32_t charUs;
+    uint32_t gapUs;
+
+    if (mstack == NULL || baud == 0)
+    {
+        return -2; // wrong params
+    }
+    if (disc->numBuses >= MODBUS_DISCOVERY_BUSES)
+    {
+        return -1; // too many buses
+    }
+
+    bus = &disc->bus[disc->numBuses];
+    memset(bus, 0, sizeof(*bus));
+    bus->mstack = mstack;
+    bus->done = 1;
+    charUs = ModMasterCharTimeUs(baud);
+    gapUs = ModMasterFrameGapUs(baud);
+    bus->gapMs = (uint16_t)((gapUs + 999) / 1000);
+    // slave waits for end of request, processes it and sends echo
+    bus->timeoutMs = (uint16_t)((gapUs + MODBUS_DISCOVERY_ANSWER * charUs + 999) / 1000) + MODBUS_DISCOVERY_TURNAROUND;
+
+    return disc->numBuses++;
+}
+
+int16_t ModDiscoveryStart(modDiscovery_t* disc, uint8_t first, uint8_t last)
+{
+    MODBUS_TIME_T now = MODBUS_GET_TIME_MS;
+
+    if (first < 1 || last > 247 || first > last)
+    {
+        return -2; // wrong params
+    }
+
+    disc->lastAddr = last;
+    for (uint8_t i = 0; i < disc->numBuses; i++)
+    {
+        modDiscoveryBus_t* bus = &disc->bus[i];
+
+        bus->nextAddr = first;
+        bus->probing = 0;
+        bus->done = 0;
+        bus->found = 0;
+        bus->corrupted = 0;
+        bus->time = (MODBUS_TIME_T)(now - bus->gapMs - 1); // first probe can go now
+        ModMasterSetTimeout(bus->mstack, bus->timeoutMs);
+    }
+
+    return 0;
+}
+
+// finish probe on the fly, returns 1 if it is done
+static uint8_t ModDiscoveryFinish(modDiscovery_t* disc, uint8_t index, MODBUS_TIME_T now)
+{
+    modDiscoveryBus_t* bus = &disc->bus[index];
+    modMasterState_t status;
+    uint8_t err = 0;
+
+    if (!ModMasterCheck(bus->mstack, &status, &err))
+    {
+        return 0; // still waiting
+    }
+
+    if (status == eMOD_M_STATE_PROCESSED || status == eMOD_M_STATE_ERR_REPORTED)
+    {
+        bus->found++;
+        if (disc->pfFound != NULL)
+        {
+            disc->pfFound(disc, index, bus->nextAddr, err, (uint16_t)(MODBUS_TIME_T)(now - bus->time));
+        }
+    }
+    else if (status == eMOD_M_STATE_CORRUPTED)
+    {
+        bus->corrupted++;
+    }
+    bus->probing = 0;
+    bus->time = now;
+    if (bus->nextAddr++ >= disc->lastAddr)
+    {
+        bus->done = 1;
+        ModMasterSetTimeout(bus->mstack, MODBUS_RX_TIMEOUT);
+    }
+
+    return 1;
+}
+
+uint8_t ModDiscoveryCheck(modDiscovery_t* disc)
+{
+    uint8_t scanning = 0;
+
+    for (uint8_t i = 0; i < disc->numBuses; i++)
+    {
+        modDiscoveryBus_t* bus = &disc->bus[i];
+        MODBUS_TIME_T now = MODBUS_GET_TIME_MS;
+
+        if (bus->done)
+        {
+            continue;
+        }
+        scanning++;
+        if (bus->probing && !ModDiscoveryFinish(disc, i, now))
+        {
+            continue;
+        }
+        if (bus->done)
+        {
+            scanning--;
+            continue;
+        }
+        // keep the bus silent between frames
+        if ((MODBUS_TIME_T)(now - bus->time) <= bus->gapMs)
+        {
+            continue;
+        }
+        if (ModMasterDiagEcho(bus->mstack, bus->nextAddr, 0xA500 | bus->nextAddr) == -1)
+        {
+            continue; // stack is busy, try again later
+        }
+        // HW error is reported by next check
+        bus->probing = 1;
+        bus->time = now;
+    }
+
+    return scanning;
+}
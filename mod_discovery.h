@@ -0,0 +1,108 @@
+/**
+ * @file    mod_discovery.h
+ * @brief   Discovery of slave devices on many buses at once. Each address of given range is probed by diagnostic
+ *          echo (0x08 / 0x0000, see @ref ModMasterDiagEcho()) with timeout derived from baud rate instead of
+ *          MODBUS_RX_TIMEOUT: time of answer frame + MODBUS_DISCOVERY_TURNAROUND. All buses are scanned in
+ *          parallel, full range 1 - 247 takes approx. 10 s at 9600 Bd and 4 s at 115200 Bd
+ *          (25 s with MODBUS_RX_TIMEOUT).
+ *
+ *          Stacks are used exclusively by the scan, their timeout is restored to MODBUS_RX_TIMEOUT when
+ *          scan of the bus is done.
+ */
+
+#ifndef SYSTEM_MOD_DISCOVERY_H
+#define SYSTEM_MOD_DISCOVERY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "mod_master_rtu.h"
+
+#ifndef MODBUS_DISCOVERY_BUSES
+#define MODBUS_DISCOVERY_BUSES      16      ///< max. number of buses scanned at once
+#endif
+#ifndef MODBUS_DISCOVERY_TURNAROUND
+#define MODBUS_DISCOVERY_TURNAROUND 10      ///< time for slave to start answering [ms]
+#endif
+
+typedef struct modDiscovery_s modDiscovery_t;
+
+/**
+ * @brief   Called for each responding device
+ * @param disc          Pointer to discovery structure
+ * @param bus           Bus index, see @ref ModDiscoveryAddBus()
+ * @param slaveAddr     Address of found device
+ * @param errCode       0 if device echoed the request, exception code if it reported error (device is present,
+ *                      but doesn't support diagnostics)
+ * @param responseMs    Time from request to processed answer
+ */
+typedef void (*pfModDiscoveryFound_t)(modDiscovery_t* disc, uint8_t bus, uint8_t slaveAddr, uint8_t errCode,
+                                      uint16_t responseMs);
+
+/**
+ * @brief   Scan state of one bus
+ */
+typedef struct
+{
+    modMasterStack_t*           mstack;
+    uint16_t                    timeoutMs;      ///< answer timeout derived from baud rate
+    uint16_t                    gapMs;          ///< silence between frames
+    uint8_t                     nextAddr;       ///< address of next probe
+    uint8_t                     probing;        ///< probe is on the fly
+    uint8_t                     done;           ///< whole range scanned
+    MODBUS_TIME_T               time;           ///< start of probe / end of last probe
+    uint16_t                    found;          ///< number of found devices
+    uint16_t                    corrupted;      ///< probes answered by corrupted frame (collision of same addresses?)
+} modDiscoveryBus_t;
+
+/**
+ * @brief   Discovery structure
+ */
+struct modDiscovery_s
+{
+    modDiscoveryBus_t           bus[MODBUS_DISCOVERY_BUSES];
+    uint8_t                     numBuses;
+    uint8_t                     lastAddr;       ///< last address of scanned range
+    pfModDiscoveryFound_t       pfFound;        ///< found device consumer, can be NULL
+    void*                       userContent;    ///< user defined pointer, can by used to pass anything
+};
+
+/**
+ * @brief           Initializes discovery without buses
+ * @param disc      Pointer to discovery structure
+ */
+void ModDiscoveryInit(modDiscovery_t* disc);
+
+/**
+ * @brief           Adds bus to be scanned
+ * @param disc      Pointer to discovery structure
+ * @param mstack    Initialized master stack of the bus
+ * @param baud      Baud rate of the bus
+ * @return int16_t  Bus index if OK, -1 too many buses, -2 wrong params
+ */
+int16_t ModDiscoveryAddBus(modDiscovery_t* disc, modMasterStack_t* mstack, uint32_t baud);
+
+/**
+ * @brief           Starts scan of all buses
+ * @param disc      Pointer to discovery structure
+ * @param first     First address to probe, 1 - 247
+ * @param last      Last address to probe, first - 247
+ * @return int16_t  0 if OK, -2 wrong params
+ */
+int16_t ModDiscoveryStart(modDiscovery_t* disc, uint8_t first, uint8_t last);
+
+/**
+ * @brief           Main function of discovery, has to be called periodically (at least once per ms for exact
+ *                  response times) until it returns 0
+ * @param disc      Pointer to discovery structure
+ * @return uint8_t  Number of buses still scanning
+ */
+uint8_t ModDiscoveryCheck(modDiscovery_t* disc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_DISCOVERY_H */
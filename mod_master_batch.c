@@ -0,0 +1,359 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "mod_master_batch.h"
+
+#define MODBUS_BATCH_END    0xFFFF      // end of chain of operations
+
+static void ModMasterBatchReqDone(modMasterQueue_t* queue, modMasterReq_t* req);
+
+static uint8_t ModMasterBatchIsRead(modMasterReqOp_t op)
+{
+    return (op == eMOD_REQ_READ_REGS || op == eMOD_REQ_READ_INPUT_REGS) ? 1 : 0;
+}
+
+static const modProfile_t* ModMasterBatchProfile(const modMasterQueue_t* queue, uint8_t slaveAddr)
+{
+    return (queue->profiles != NULL && slaveAddr < MODBUS_PROFILE_SLAVES) ? &queue->profiles->slaves[slaveAddr] : NULL;
+}
+
+// request serves one operation directly (no scratch)
+static void ModMasterBatchReqOp(modMasterReq_t* req, const modMasterBatchOp_t* op)
+{
+    req->op = op->op;
+    req->slaveAddr = op->slaveAddr;
+    req->firstReg = op->firstReg;
+    req->numRegs = op->numRegs;
+    req->regs = op->regs;
+#ifdef MODBUS_USER_COMMANDS
+    req->data = op->data;
+    req->length = op->length;
+#endif
+}
+
+// operation takes result of its request
+static void ModMasterBatchFinish(modMasterBatch_t* batch, const modMasterReq_t* req, modMasterBatchOp_t* op)
+{
+    op->result = req->result;
+    op->errCode = req->errCode;
+#ifdef MODBUS_USER_COMMANDS
+    if (op->op == eMOD_REQ_READ_PACKET)
+    {
+        op->length = req->length;
+    }
+#endif
+    if (op->result != eMOD_M_STATE_PROCESSED)
+    {
+        batch->failed++;
+    }
+}
+
+// request for chain of operations starting by first, registers of merged request go through scratch
+static void ModMasterBatchEmit(modMasterBatch_t* batch, uint16_t first, uint16_t firstReg, uint16_t numRegs)
+{
+    modMasterReq_t* req = &batch->reqs[batch->numReqs];
+    const modMasterBatchOp_t* op = &batch->ops[first];
+
+    memset(req, 0, sizeof(*req));
+    ModMasterBatchReqOp(req, op);
+    req->maxRetries = batch->maxRetries;
+    req->backoffMs = batch->backoffMs;
+    req->pfDone = &ModMasterBatchReqDone;
+    req->userContent = batch;
+    if (batch->nextOp[first] != MODBUS_BATCH_END)
+    {
+        req->firstReg = firstReg;
+        req->numRegs = numRegs;
+        req->regs = batch->scratch + batch->scratchUsed;
+        batch->scratchUsed += numRegs;
+        if (op->op == eMOD_REQ_WRITE_REGS)
+        {
+            for (uint16_t i = first; i != MODBUS_BATCH_END; i = batch->nextOp[i])
+            {
+                memcpy(req->regs + (batch->ops[i].firstReg - firstReg), batch->ops[i].regs,
+                       batch->ops[i].numRegs * sizeof(uint16_t));
+            }
+        }
+    }
+    batch->reqOp[batch->numReqs] = first;
+    batch->reqSplit[batch->numReqs] = 0;
+    batch->numReqs++;
+}
+
+// order of reads for merging: function, slave, first register
+static uint8_t ModMasterBatchBefore(const modMasterBatchOp_t* a, const modMasterBatchOp_t* b)
+{
+    if (a->op != b->op)
+    {
+        return a->op < b->op;
+    }
+    if (a->slaveAddr != b->slaveAddr)
+    {
+        return a->slaveAddr < b->slaveAddr;
+    }
+    return a->firstReg < b->firstReg;
+}
+
+// writes and packets starting by operation i, returns index of next operation to plan
+static uint16_t ModMasterBatchPlanWrites(modMasterQueue_t* queue, modMasterBatch_t* batch, uint16_t i)
+{
+    const modMasterBatchOp_t* op = &batch->ops[i];
+    uint32_t last = (uint32_t)op->firstReg + op->numRegs - 1;
+    uint32_t limit = ModProfileMaxWrite(ModMasterBatchProfile(queue, op->slaveAddr));
+    uint16_t tail = i;
+    uint16_t end = i + 1;
+
+    // following writes of continuous registers of the same slave
+    while (!batch->inOrder && op->op == eMOD_REQ_WRITE_REGS && end < batch->numOps)
+    {
+        const modMasterBatchOp_t* next = &batch->ops[end];
+        uint32_t num = last + next->numRegs - op->firstReg + 1;
+
+        if (next->op != eMOD_REQ_WRITE_REGS || next->slaveAddr != op->slaveAddr || next->firstReg != last + 1 ||
+            num > limit || num > (uint32_t)(MODBUS_BATCH_SCRATCH - batch->scratchUsed))
+        {
+            break;
+        }
+        batch->nextOp[tail] = end;
+        tail = end;
+        last += next->numRegs;
+        end++;
+    }
+    ModMasterBatchEmit(batch, i, op->firstReg, (uint16_t)(last - op->firstReg + 1));
+
+    return end;
+}
+
+// reads starting by operation i up to next write / packet, returns index of next operation to plan
+static uint16_t ModMasterBatchPlanReads(modMasterQueue_t* queue, modMasterBatch_t* batch, uint16_t i)
+{
+    uint16_t order[MODBUS_BATCH_OPS];
+    uint16_t n = 0;
+    uint16_t end;
+    uint16_t k;
+
+    for (end = i; end < batch->numOps && ModMasterBatchIsRead(batch->ops[end].op); end++)
+    {
+        // insertion sort, equal reads keep order of the array
+        uint16_t j = n++;
+
+        while (j > 0 && ModMasterBatchBefore(&batch->ops[end], &batch->ops[order[j - 1]]))
+        {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = end;
+    }
+
+    for (k = 0; k < n; )
+    {
+        const modMasterBatchOp_t* op = &batch->ops[order[k]];
+        uint32_t last = (uint32_t)op->firstReg + op->numRegs - 1;
+        uint32_t limit = ModProfileMaxRead(ModMasterBatchProfile(queue, op->slaveAddr));
+        uint16_t tail = order[k];
+        uint16_t m;
+
+        // following reads which touch or overlap, no register is read in vain
+        for (m = k + 1; m < n; m++)
+        {
+            const modMasterBatchOp_t* next = &batch->ops[order[m]];
+            uint32_t nextLast = (uint32_t)next->firstReg + next->numRegs - 1;
+            uint32_t newLast = nextLast > last ? nextLast : last;
+            uint32_t num = newLast - op->firstReg + 1;
+
+            if (next->op != op->op || next->slaveAddr != op->slaveAddr || next->firstReg > last + 1 ||
+                num > limit || num > (uint32_t)(MODBUS_BATCH_SCRATCH - batch->scratchUsed))
+            {
+                break;
+            }
+            batch->nextOp[tail] = order[m];
+            tail = order[m];
+            last = newLast;
+        }
+        ModMasterBatchEmit(batch, order[k], op->firstReg, (uint16_t)(last - op->firstReg + 1));
+        k = m;
+    }
+
+    return end;
+}
+
+// resend request for single operation i (of split merged request)
+static void ModMasterBatchResend(modMasterQueue_t* queue, modMasterBatch_t* batch, modMasterReq_t* req, uint16_t i)
+{
+    batch->reqOp[req - batch->reqs] = i;
+    ModMasterBatchReqOp(req, &batch->ops[i]);
+    batch->transactions++;
+    (void)ModMasterReqSubmit(queue, req);
+}
+
+// queues next phase - single write / packet or all reads up to next one, the phase is queued from completion
+// callback of previous phase before the queue sends anything else, so the bus doesn't wait for application
+static void ModMasterBatchNextPhase(modMasterQueue_t* queue, modMasterBatch_t* batch)
+{
+    uint16_t r = batch->nextReq;
+    uint16_t end = r + 1;
+
+    if (!batch->inOrder && ModMasterBatchIsRead(batch->reqs[r].op))
+    {
+        while (end < batch->numReqs && ModMasterBatchIsRead(batch->reqs[end].op))
+        {
+            end++;
+        }
+    }
+    batch->pending = end - r;
+    batch->nextReq = end;
+    for (; r < end; r++)
+    {
+        batch->transactions++;
+        (void)ModMasterReqSubmit(queue, &batch->reqs[r]);
+    }
+}
+
+static void ModMasterBatchReqDone(modMasterQueue_t* queue, modMasterReq_t* req)
+{
+    modMasterBatch_t* batch = (modMasterBatch_t*)req->userContent;
+    uint16_t r = (uint16_t)(req - batch->reqs);
+    uint16_t i = batch->reqOp[r];
+
+    if (batch->reqSplit[r] || batch->nextOp[i] == MODBUS_BATCH_END)
+    {
+        // request of single operation
+        ModMasterBatchFinish(batch, req, &batch->ops[i]);
+        if (batch->reqSplit[r] && batch->nextOp[i] != MODBUS_BATCH_END)
+        {
+            ModMasterBatchResend(queue, batch, req, batch->nextOp[i]);
+            return;
+        }
+    }
+    else if (req->result == eMOD_M_STATE_ERR_REPORTED)
+    {
+        // merged request refused, exception of each operation is known only when asked one by one
+        batch->reqSplit[r] = 1;
+        ModMasterBatchResend(queue, batch, req, i);
+        return;
+    }
+    else
+    {
+        for (; i != MODBUS_BATCH_END; i = batch->nextOp[i])
+        {
+            modMasterBatchOp_t* op = &batch->ops[i];
+
+            if (req->result == eMOD_M_STATE_PROCESSED && ModMasterBatchIsRead(op->op))
+            {
+                memcpy(op->regs, req->regs + (op->firstReg - req->firstReg), op->numRegs * sizeof(uint16_t));
+            }
+            ModMasterBatchFinish(batch, req, op);
+        }
+    }
+
+    if (--batch->pending > 0)
+    {
+        return;
+    }
+    if (batch->nextReq < batch->numReqs)
+    {
+        ModMasterBatchNextPhase(queue, batch);
+    }
+    else
+    {
+        batch->queue = NULL;
+        if (batch->pfDone != NULL)
+        {
+            batch->pfDone(queue, batch);
+        }
+    }
+}
+
+void ModMasterBatchInit(modMasterBatch_t* batch)
+{
+    memset(batch, 0, offsetof(modMasterBatch_t, userContent));
+}
+
+int16_t ModMasterBatchSubmit(modMasterQueue_t* queue, modMasterBatch_t* batch)
+{
+    uint16_t i;
+
+    if (batch->queue != NULL || (batch->onBus != NULL && batch->onBus->queue != NULL))
+    {
+        return -1; // pending already, or cancelled request still on the bus
+    }
+    if (queue == NULL || batch->ops == NULL || batch->numOps == 0 || batch->numOps > MODBUS_BATCH_OPS)
+    {
+        return -2; // wrong params
+    }
+    for (i = 0; i < batch->numOps; i++)
+    {
+        const modMasterBatchOp_t* op = &batch->ops[i];
+        modMasterReq_t check;
+
+        ModMasterBatchReqOp(&check, op);
+        if (ModMasterReqValid(&check) < 0 ||
+            ((ModMasterBatchIsRead(op->op) || op->op == eMOD_REQ_WRITE_REGS) && op->numRegs == 0))
+        {
+            return -2; // wrong operation
+        }
+    }
+
+    for (i = 0; i < batch->numOps; i++)
+    {
+        batch->nextOp[i] = MODBUS_BATCH_END;
+        batch->ops[i].result = eMOD_M_STATE_STANDBY;
+        batch->ops[i].errCode = 0;
+    }
+    batch->numReqs = 0;
+    batch->scratchUsed = 0;
+    batch->failed = 0;
+    batch->transactions = 0;
+
+    for (i = 0; i < batch->numOps; )
+    {
+        if (batch->inOrder || !ModMasterBatchIsRead(batch->ops[i].op))
+        {
+            i = ModMasterBatchPlanWrites(queue, batch, i);
+        }
+        else
+        {
+            i = ModMasterBatchPlanReads(queue, batch, i);
+        }
+    }
+
+    batch->queue = queue;
+    batch->nextReq = 0;
+    batch->onBus = NULL;
+    ModMasterBatchNextPhase(queue, batch);
+
+    return 0;
+}
+
+int16_t ModMasterBatchCancel(modMasterQueue_t* queue, modMasterBatch_t* batch)
+{
+    if (queue == NULL || batch->queue != queue)
+    {
+        return -1; // not pending here
+    }
+
+    // requests of current phase (or resent single operation of split request)
+    for (uint16_t r = 0; r < batch->nextReq; r++)
+    {
+        if (ModMasterReqCancel(queue, &batch->reqs[r]) == 1)
+        {
+            batch->onBus = &batch->reqs[r]; // finishes silently
+        }
+    }
+    for (uint16_t i = 0; i < batch->numOps; i++)
+    {
+        if (batch->ops[i].result == eMOD_M_STATE_STANDBY)
+        {
+            batch->ops[i].result = eMOD_M_STATE_CANCELLED;
+            batch->failed++;
+        }
+    }
+    batch->pending = 0;
+    batch->queue = NULL;
+    if (batch->pfDone != NULL)
+    {
+        batch->pfDone(queue, batch);
+    }
+
+    return (batch->onBus != NULL && batch->onBus->queue != NULL) ? 1 : 0;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file    mod_master_batch.h
+ * @brief   Batch of master operations with single completion. Reads of the same slave which touch or overlap
+ *          are merged into one request, consecutive writes of continuous registers are merged too. Requests are
+ *          sent back to back by @ref mod_master_req.h, separated by inter-frame gap only. Each operation gets
+ *          its own result.
+ *
+ *          Order of execution: writes and packets are barriers - they are sent in order of the array, one at
+ *          a time (also with retries), reads between two barriers are queued together and may be reordered.
+ *          Merged request refused by exception is repeated operation by operation, so each operation gets
+ *          the exception of its own registers.
+ *
+ *          Pending batch is cancelled by @ref ModMasterBatchCancel(), not by @ref ModMasterReqCancel() of its
+ *          requests - it doesn't call their completion, so the batch would never finish.
+ */
+
+#ifndef SYSTEM_MOD_MASTER_BATCH_H
+#define SYSTEM_MOD_MASTER_BATCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "mod_master_req.h"
+
+#ifndef MODBUS_BATCH_OPS
+#define MODBUS_BATCH_OPS            64      ///< max. operations per batch
+#endif
+#ifndef MODBUS_BATCH_SCRATCH
+#define MODBUS_BATCH_SCRATCH        512     ///< registers of merged requests per batch
+#endif
+
+typedef struct modMasterBatch_s modMasterBatch_t;
+
+/**
+ * @brief   Called when all operations of the batch are finished (successfully or not, after all retries).
+ *          Batch can be submitted again from the callback.
+ */
+typedef void (*pfModMasterBatchDone_t)(modMasterQueue_t* queue, modMasterBatch_t* batch);
+
+/**
+ * @brief   One operation of the batch
+ */
+typedef struct
+{
+    // parameters
+    modMasterReqOp_t            op;             ///< operation
+    uint8_t                     slaveAddr;      ///< address of slave device
+    uint16_t                    firstReg;       ///< first register
+    uint16_t                    numRegs;        ///< number of registers
+    uint16_t*                   regs;           ///< storage of read / values to write
+#ifdef MODBUS_USER_COMMANDS
+    uint8_t*                    data;           ///< packet storage / data to write
+    uint8_t                     length;         ///< length of packet to write / received
+#endif
+
+    // results
+    modMasterState_t            result;         ///< eMOD_M_STATE_PROCESSED or reason of failure
+    uint8_t                     errCode;        ///< error code reported by slave, if result is eMOD_M_STATE_ERR_REPORTED
+} modMasterBatchOp_t;
+
+/**
+ * @brief   Batch structure. Initialize by @ref ModMasterBatchInit(), fill parameters and submit by
+ *          @ref ModMasterBatchSubmit().
+ */
+struct modMasterBatch_s
+{
+    // parameters
+    modMasterBatchOp_t*         ops;            ///< operations, have to stay valid until batch is finished
+    uint16_t                    numOps;         ///< number of operations, max. MODBUS_BATCH_OPS
+    uint8_t                     maxRetries;     ///< retries of each request, see @ref modMasterReq_t
+    uint16_t                    backoffMs;      ///< delay of first retry
+    uint8_t                     inOrder;        ///< 1 = one request per operation in order of the array, no merging
+    pfModMasterBatchDone_t      pfDone;         ///< completion callback, can be NULL
+
+    // results
+    uint16_t                    failed;         ///< number of operations not processed
+    uint16_t                    transactions;   ///< number of requests sent (without retries)
+
+    // internal
+    modMasterQueue_t*           queue;          ///< queue of pending batch, NULL when finished
+    uint16_t                    pending;        ///< number of unfinished requests of current phase
+    uint16_t                    numReqs;
+    uint16_t                    nextReq;        ///< first request of next phase
+    uint16_t                    scratchUsed;
+    modMasterReq_t*             onBus;          ///< request cancelled on the bus, batch isn't free until it finishes
+    uint16_t                    nextOp[MODBUS_BATCH_OPS];   ///< operations served by the same request
+    uint16_t                    reqOp[MODBUS_BATCH_OPS];    ///< first (or current, when split) operation of request
+    uint8_t                     reqSplit[MODBUS_BATCH_OPS]; ///< 1 if merged request is repeated operation by operation
+    modMasterReq_t              reqs[MODBUS_BATCH_OPS];
+    uint16_t                    scratch[MODBUS_BATCH_SCRATCH];  ///< registers of merged requests
+
+    void*                       userContent;    ///< user defined pointer, can by used to pass anything
+};
+
+/**
+ * @brief           Initializes batch (no operations, no retries, merging enabled)
+ * @param batch     Pointer to batch structure
+ */
+void ModMasterBatchInit(modMasterBatch_t* batch);
+
+/**
+ * @brief           Plans requests of the batch and appends them to the queue
+ * @param queue     Queue of the bus, slave profiles (queue->profiles) limit size of merged requests
+ * @param batch     Batch, has to stay valid until it is finished
+ * @return int16_t  0 if OK, -1 batch is pending already, -2 wrong params (no / too many operations,
+ *                  operation with wrong params)
+ */
+int16_t ModMasterBatchSubmit(modMasterQueue_t* queue, modMasterBatch_t* batch);
+
+/**
+ * @brief           Cancels pending batch. Its waiting requests are unlinked, request on the bus finishes silently
+ *                  (storage of read may still be written until then). Unfinished operations get
+ *                  eMOD_M_STATE_CANCELLED and completion callback is called once from here.
+ * @param queue     Queue the batch was submitted to
+ * @param batch     Batch
+ * @return int16_t  0 cancelled (batch is free), 1 request is on the bus (batch can't be submitted until it
+ *                  finishes), -1 batch isn't pending in this queue
+ */
+int16_t ModMasterBatchCancel(modMasterQueue_t* queue, modMasterBatch_t* batch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_MASTER_BATCH_H */
@@ -0,0 +1,437 @@
+#include <stdio.h>
+#include <string.h>
+#include "mod_master_req.h"
+
+static void ModMasterQueueStart(modMasterQueue_t* queue);
+
+// a is before b (wrap-around safe), MODBUS_TIME_T can be narrower than int (16-bit tick of FreeRTOS)
+#define MODBUS_TIME_BEFORE(a, b) \
+    ((MODBUS_TIME_T)((b) - (a) - 1u) < (MODBUS_TIME_T)((MODBUS_TIME_T)~(MODBUS_TIME_T)0 / 2u))
+
+// frame transmission time in ms, rounded up
+static uint32_t ModMasterQueueFrameMs(const modMasterQueue_t* queue, uint16_t bytes)
+{
+    return (bytes * queue->charUs + 999) / 1000;
+}
+
+// keep number of waiting requests (and its gauge) up to date
+static void ModMasterQueueDepth(modMasterQueue_t* queue, int8_t delta)
+{
+    queue->depth += delta;
+    if (queue->stats != NULL)
+    {
+        ModStatsGauge(queue->stats, queue->statsBus, eMOD_STATS_QUEUE_DEPTH, queue->depth);
+    }
+}
+
+// account wire time of finished attempt, frame lengths follow from operation and result
+static void ModMasterQueueLoad(modMasterQueue_t* queue, const modMasterReq_t* req, modMasterState_t status,
+                               MODBUS_TIME_T now)
+{
+    uint16_t reqBytes;
+    uint16_t respBytes;
+    uint32_t ppm;
+
+    switch (req->op)
+    {
+    case eMOD_REQ_WRITE_REGS:
+        reqBytes = 9 + 2 * req->numRegs;
+        respBytes = 8;
+        break;
+#ifdef MODBUS_USER_COMMANDS
+    case eMOD_REQ_READ_PACKET:
+        reqBytes = 4;
+        respBytes = 5 + req->length;
+        break;
+    case eMOD_REQ_WRITE_PACKET:
+        reqBytes = 5 + req->length;
+        respBytes = 5;
+        break;
+#endif
+    default:
+        reqBytes = 8;
+        respBytes = 5 + 2 * req->numRegs;
+        break;
+    }
+
+    if (status == eMOD_M_STATE_HW_ERROR)
+    {
+        return; // request may not reach the bus
+    }
+    if (status == eMOD_M_STATE_ERR_REPORTED)
+    {
+        respBytes = 5;
+    }
+    else if (status == eMOD_M_STATE_TIMED_OUT || req->slaveAddr == 0)
+    {
+        respBytes = 0;
+    }
+    ModBusLoadAdd(queue->load, req->slaveAddr, queue->mstack->opCode, reqBytes, respBytes,
+                  (uint32_t)(MODBUS_TIME_T)(now - queue->startTime) * 1000u, now);
+    if (queue->stats != NULL)
+    {
+        ppm = ModBusLoadUtilization(queue->load, now);
+        ModStatsGauge(queue->stats, queue->statsBus, eMOD_STATS_UTILIZATION_PPM, ppm);
+    }
+}
+
+static void ModMasterQueuePushHead(modMasterQueue_t* queue, modMasterReq_t* req)
+{
+    ModMasterQueueDepth(queue, 1);
+    req->next = queue->head;
+    queue->head = req;
+    if (queue->tail == NULL)
+    {
+        queue->tail = req;
+    }
+}
+
+static void ModMasterQueueTimerExpired(modTimerWheel_t* wheel, modTimer_t* timer)
+{
+    modMasterQueue_t* queue = (modMasterQueue_t*)timer->userContent;
+    modMasterReq_t* req = queue->active;
+
+    if (queue->gap)
+    {
+        // bus is silent long enough, next request can go
+        queue->gap = 0;
+        ModMasterQueueStart(queue);
+    }
+    else if (req != NULL)
+    {
+        // response deadline, stack reports timeout itself
+        ModMasterQueueCheck(queue);
+        if (queue->active == req && !queue->timer.running)
+        {
+            // same request still waits (next one started by check arms own deadline),
+            // stack measures timeout from end of transmission, not reached yet
+            ModTimerStart(wheel, &queue->timer, 1);
+        }
+    }
+}
+
+static void ModMasterReqBackoffExpired(modTimerWheel_t* wheel, modTimer_t* timer)
+{
+    modMasterReq_t* req = (modMasterReq_t*)timer->userContent;
+
+    (void)wheel;
+    ModMasterQueuePushHead(req->queue, req);
+    ModMasterQueueStart(req->queue);
+}
+
+// unlink first waiting request
+static modMasterReq_t* ModMasterQueuePop(modMasterQueue_t* queue)
+{
+    modMasterReq_t* req = queue->head;
+
+    queue->head = req->next;
+    if (queue->head == NULL)
+    {
+        queue->tail = NULL;
+    }
+    req->next = NULL;
+    ModMasterQueueDepth(queue, -1);
+
+    return req;
+}
+
+// request leaves the queue, callback may submit it again
+static void ModMasterReqFinish(modMasterQueue_t* queue, modMasterReq_t* req)
+{
+    req->queue = NULL;
+    if (req->pfDone != NULL)
+    {
+        req->pfDone(queue, req);
+    }
+}
+
+// send first waiting request, if bus is free
+static void ModMasterQueueStart(modMasterQueue_t* queue)
+{
+    modMasterReq_t* req;
+    uint16_t turnaround = 0;
+    int16_t r;
+
+    for (;;)
+    {
+        if (queue->head == NULL || queue->active != NULL || queue->gap)
+        {
+            return; // checked again after callback of dropped request, it may submit
+        }
+        req = ModMasterQueuePop(queue);
+        if (!req->useDeadline || MODBUS_TIME_BEFORE((MODBUS_TIME_T)MODBUS_GET_TIME_MS, req->deadline))
+        {
+            break;
+        }
+        // too late, dropped without touching the bus
+        req->result = eMOD_M_STATE_EXPIRED;
+        req->errCode = 0;
+        queue->expired++;
+        ModMasterReqFinish(queue, req);
+    }
+
+    if (queue->profiles != NULL && req->slaveAddr < MODBUS_PROFILE_SLAVES)
+    {
+        // slow slave needs more time to answer
+        turnaround = queue->profiles->slaves[req->slaveAddr].turnaroundMs;
+        ModMasterSetTimeout(queue->mstack, MODBUS_RX_TIMEOUT + turnaround);
+    }
+    switch (req->op)
+    {
+    case eMOD_REQ_WRITE_REGS:
+        r = ModMasterWriteRegs(queue->mstack, req->slaveAddr, req->firstReg, req->numRegs, req->regs);
+        break;
+    case eMOD_REQ_READ_INPUT_REGS:
+        r = ModMasterReadInputRegs(queue->mstack, req->slaveAddr, req->firstReg, req->numRegs, req->regs);
+        break;
+#ifdef MODBUS_USER_COMMANDS
+    case eMOD_REQ_READ_PACKET:
+        req->length = 0;
+        r = ModMasterReadDataPacket(queue->mstack, req->slaveAddr, &req->length, req->data);
+        break;
+    case eMOD_REQ_WRITE_PACKET:
+        r = ModMasterWriteDataPacket(queue->mstack, req->slaveAddr, req->length, req->data);
+        break;
+#endif
+    default:
+        r = ModMasterReadRegs(queue->mstack, req->slaveAddr, req->firstReg, req->numRegs, req->regs);
+        break;
+    }
+    if (r == -1)
+    {
+        // stack is busy (e.g. no free message buffer), try again later
+        ModMasterQueuePushHead(queue, req);
+        queue->gap = 1;
+        ModTimerStart(queue->wheel, &queue->timer, 1);
+        return;
+    }
+
+    req->attempts++;
+    queue->active = req;
+    queue->startTime = MODBUS_GET_TIME_MS;
+    // response deadline, HW error is reported by stack at next check
+    ModTimerStart(queue->wheel, &queue->timer, r < 0 ? 1 :
+                  ModMasterQueueFrameMs(queue, queue->mstack->messageLast + 1) + MODBUS_RX_TIMEOUT + turnaround + 1);
+}
+
+int16_t ModMasterReqValid(const modMasterReq_t* req)
+{
+    switch (req->op)
+    {
+    case eMOD_REQ_READ_REGS:
+    case eMOD_REQ_READ_INPUT_REGS:
+        return (req->regs != NULL && req->numRegs <= MODBUS_MAX_READ_REGS) ? 0 : -2;
+    case eMOD_REQ_WRITE_REGS:
+        return (req->regs != NULL && req->numRegs <= MODBUS_MAX_WRITE_REGS) ? 0 : -2;
+#ifdef MODBUS_USER_COMMANDS
+    case eMOD_REQ_READ_PACKET:
+        return req->data != NULL ? 0 : -2;
+    case eMOD_REQ_WRITE_PACKET:
+        return (req->data != NULL && req->length <= MODBUS_MAX_PACKET) ? 0 : -2;
+#endif
+    default:
+        return -2;
+    }
+}
+
+int16_t ModMasterQueueInit(modMasterQueue_t* queue, modMasterStack_t* mstack, modTimerWheel_t* wheel, uint32_t baud)
+{
+    if (mstack == NULL || wheel == NULL)
+    {
+        return -2; // wrong params
+    }
+
+    queue->mstack = mstack;
+    queue->wheel = wheel;
+    queue->head = NULL;
+    queue->tail = NULL;
+    queue->active = NULL;
+    memset(&queue->timer, 0, sizeof(queue->timer));
+    queue->timer.pfExpired = &ModMasterQueueTimerExpired;
+    queue->timer.userContent = queue;
+    queue->gap = 0;
+    queue->depth = 0;
+    queue->stats = NULL;
+    queue->statsBus = 0;
+    queue->load = NULL;
+    queue->profiles = NULL;
+    if (baud == 0)
+    {
+        queue->charUs = 0;
+        queue->gapMs = 0;
+    }
+    else
+    {
+        queue->charUs = ModMasterCharTimeUs(baud);
+        queue->gapMs = (uint16_t)((ModMasterFrameGapUs(baud) + 999) / 1000);
+    }
+    queue->completed = 0;
+    queue->failed = 0;
+    queue->retried = 0;
+    queue->expired = 0;
+    queue->cancelled = 0;
+
+    return 0;
+}
+
+int16_t ModMasterReqSubmit(modMasterQueue_t* queue, modMasterReq_t* req)
+{
+    if (req->queue != NULL)
+    {
+        return -1; // pending already
+    }
+    if (ModMasterReqValid(req) < 0)
+    {
+        return -2; // wrong params
+    }
+
+    req->queue = queue;
+    req->attempts = 0;
+    req->errCode = 0;
+    req->cancelled = 0;
+    req->next = NULL;
+    memset(&req->timer, 0, sizeof(req->timer));
+    req->timer.pfExpired = &ModMasterReqBackoffExpired;
+    req->timer.userContent = req;
+    if (queue->tail != NULL)
+    {
+        queue->tail->next = req;
+    }
+    else
+    {
+        queue->head = req;
+    }
+    queue->tail = req;
+    ModMasterQueueDepth(queue, 1);
+
+    ModMasterQueueStart(queue);
+
+    return 0;
+}
+
+int16_t ModMasterReqCancel(modMasterQueue_t* queue, modMasterReq_t* req)
+{
+    modMasterReq_t* prev = NULL;
+    modMasterReq_t* it;
+
+    if (queue == NULL || req->queue != queue)
+    {
+        return -1; // not pending here
+    }
+    queue->cancelled++;
+    if (queue->active == req)
+    {
+        req->cancelled = 1;
+        return 1;
+    }
+
+    if (req->timer.running)
+    {
+        ModTimerStop(queue->wheel, &req->timer); // waiting for retry, not linked
+    }
+    else
+    {
+        for (it = queue->head; it != NULL && it != req; it = it->next)
+        {
+            prev = it;
+        }
+        if (it == NULL)
+        {
+            queue->cancelled--;
+            return -1; // not found, shouldn't happen
+        }
+        if (prev != NULL)
+        {
+            prev->next = req->next;
+        }
+        else
+        {
+            queue->head = req->next;
+        }
+        if (queue->tail == req)
+        {
+            queue->tail = prev;
+        }
+        req->next = NULL;
+        ModMasterQueueDepth(queue, -1);
+    }
+    req->result = eMOD_M_STATE_CANCELLED;
+    req->errCode = 0;
+    req->queue = NULL;
+
+    return 0;
+}
+
+void ModMasterQueueCheck(modMasterQueue_t* queue)
+{
+    modMasterReq_t* req = queue->active;
+    modMasterState_t status;
+    uint8_t err = 0;
+    MODBUS_TIME_T now;
+    uint16_t gapMs = queue->gapMs;
+
+    if (req == NULL || !ModMasterCheck(queue->mstack, &status, &err))
+    {
+        return; // nothing on the bus or still waiting
+    }
+
+    ModTimerStop(queue->wheel, &queue->timer);
+    queue->active = NULL;
+    req->result = status;
+    req->errCode = err;
+    now = MODBUS_GET_TIME_MS;
+    if (queue->stats != NULL)
+    {
+        ModStatsMaster(queue->stats, queue->statsBus, req->slaveAddr, status, err,
+                       (uint32_t)(MODBUS_TIME_T)(now - queue->startTime));
+    }
+    if (queue->load != NULL)
+    {
+        ModMasterQueueLoad(queue, req, status, now);
+    }
+
+    if (queue->profiles != NULL)
+    {
+        (void)ModProfileLearn(queue->profiles, req->slaveAddr, queue->mstack->opCode, req->numRegs, status, err);
+        if (req->slaveAddr < MODBUS_PROFILE_SLAVES)
+        {
+            gapMs += queue->profiles->slaves[req->slaveAddr].gapMs;
+        }
+    }
+
+    // keep the bus silent between frames (before callback, it may submit next request)
+    if (gapMs > 0)
+    {
+        queue->gap = 1;
+        ModTimerStart(queue->wheel, &queue->timer, gapMs);
+    }
+
+    if (req->cancelled)
+    {
+        // cancelled on the bus, released silently
+        req->result = eMOD_M_STATE_CANCELLED;
+        req->queue = NULL;
+    }
+    else if ((status == eMOD_M_STATE_TIMED_OUT || status == eMOD_M_STATE_CORRUPTED || status == eMOD_M_STATE_HW_ERROR) &&
+             req->attempts <= req->maxRetries)
+    {
+        // back-off, other requests may use the bus meanwhile
+        uint8_t shift = req->attempts - 1 < 8 ? req->attempts - 1 : 8;
+        queue->retried++;
+        ModTimerStart(queue->wheel, &req->timer, (uint32_t)req->backoffMs << shift);
+    }
+    else
+    {
+        if (status == eMOD_M_STATE_PROCESSED)
+        {
+            queue->completed++;
+        }
+        else
+        {
+            queue->failed++;
+        }
+        ModMasterReqFinish(queue, req);
+    }
+
+    ModMasterQueueStart(queue);
+}
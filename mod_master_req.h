@@ -0,0 +1,170 @@
+/**
+ * @file    mod_master_req.h
+ * @brief   Request queue on top of one master stack (one bus). Requests are allocated by caller and linked into
+ *          the queue, all timing - response deadline, retry back-off and inter-frame gap - runs on shared
+ *          @ref mod_timer_wheel.h, so event loop serving thousands of queues sleeps until next expiry and never
+ *          scans idle stacks.
+ *
+ *          Event loop:
+ * @code
+ *          for (;;) {
+ *              WaitForIo(ModTimerWheelNextExpiry(&wheel));
+ *              // Rx-done callbacks of stacks with received data were called by driver
+ *              ModMasterQueueCheck(&queue);                    // for each queue with Rx event
+ *              ModTimerWheelAdvance(&wheel, NowMs());
+ *          }
+ * @endcode
+ * @warning Stack must be used by the queue only, not ISR-safe (stack callbacks are).
+ */
+
+#ifndef SYSTEM_MOD_MASTER_REQ_H
+#define SYSTEM_MOD_MASTER_REQ_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "mod_master_rtu.h"
+#include "mod_timer_wheel.h"
+#include "mod_stats.h"
+#include "mod_busload.h"
+#include "mod_profile.h"
+
+/** Request operation **/
+typedef enum
+{
+    eMOD_REQ_READ_REGS,
+    eMOD_REQ_WRITE_REGS,
+    eMOD_REQ_READ_INPUT_REGS,
+#ifdef MODBUS_USER_COMMANDS
+    eMOD_REQ_READ_PACKET,
+    eMOD_REQ_WRITE_PACKET,
+#endif
+} modMasterReqOp_t;
+
+typedef struct modMasterReq_s modMasterReq_t;
+typedef struct modMasterQueue_s modMasterQueue_t;
+
+/**
+ * @brief   Called when request is finished (successfully or not, after all retries). Request is not linked
+ *          anymore, it can be submitted again from the callback.
+ */
+typedef void (*pfModMasterReqDone_t)(modMasterQueue_t* queue, modMasterReq_t* req);
+
+/**
+ * @brief   Request structure. Fill parameters, set next to NULL and submit by @ref ModMasterReqSubmit().
+ */
+struct modMasterReq_s
+{
+    // parameters
+    modMasterReqOp_t            op;             ///< operation
+    uint8_t                     slaveAddr;      ///< address of slave device
+    uint8_t                     maxRetries;     ///< repeat failed (timed out, corrupted, HW error) operation
+    uint16_t                    backoffMs;      ///< delay of first retry, doubled by each next retry
+    uint16_t                    firstReg;       ///< first register
+    uint16_t                    numRegs;        ///< number of registers
+    uint16_t*                   regs;           ///< storage of read / values to write
+#ifdef MODBUS_USER_COMMANDS
+    uint8_t*                    data;           ///< packet storage / data to write
+    uint8_t                     length;         ///< length of packet to write / received
+#endif
+    uint8_t                     useDeadline;    ///< 1 = request reaching head of queue at / after deadline is dropped
+    MODBUS_TIME_T               deadline;       ///< absolute time [ms], request isn't sent (nor retried) at / after it,
+                                                ///< expiry (eMOD_M_STATE_EXPIRED) is reported when it would be sent
+    pfModMasterReqDone_t        pfDone;         ///< completion callback, can be NULL
+    void*                       userContent;    ///< user defined pointer, can by used to pass anything
+
+    // results
+    modMasterState_t            result;         ///< eMOD_M_STATE_PROCESSED or reason of failure
+    uint8_t                     errCode;        ///< error code reported by slave, if result is eMOD_M_STATE_ERR_REPORTED
+    uint8_t                     attempts;       ///< number of transmissions
+
+    // internal
+    modMasterQueue_t*           queue;          ///< queue of pending request, NULL when finished
+    modMasterReq_t*             next;           ///< queue link
+    modTimer_t                  timer;          ///< retry back-off
+    uint8_t                     cancelled;      ///< 1 if cancelled on the bus, finished silently by answer / timeout
+};
+
+/**
+ * @brief   Queue structure
+ */
+struct modMasterQueue_s
+{
+    modMasterStack_t*           mstack;         ///< stack of the bus, used by queue only
+    modTimerWheel_t*            wheel;          ///< shared timer wheel
+    modMasterReq_t*             head;           ///< waiting requests
+    modMasterReq_t*             tail;
+    modMasterReq_t*             active;         ///< request on the bus
+    modTimer_t                  timer;          ///< response deadline or inter-frame gap
+    uint8_t                     gap;            ///< 1 if timer runs inter-frame gap
+    uint16_t                    gapMs;          ///< silence between frames, 0 = none
+    uint32_t                    charUs;         ///< time of one character, 0 = unpaced link
+    uint16_t                    depth;          ///< number of waiting requests
+    MODBUS_TIME_T               startTime;      ///< when active request was sent
+
+    modStatsShard_t*            stats;          ///< shard of serving thread to record transactions to, can be NULL
+    uint8_t                     statsBus;       ///< bus number in statistics
+    modBusLoad_t*               load;           ///< utilization accounting of the bus, can be NULL
+    modProfileTable_t*          profiles;       ///< capabilities of slaves to learn and apply (gap, turnaround), can be NULL
+
+    uint32_t                    completed;      ///< statistics: successful requests
+    uint32_t                    failed;         ///< statistics: requests failed after all retries
+    uint32_t                    retried;        ///< statistics: retransmissions
+    uint32_t                    expired;        ///< statistics: requests dropped after deadline
+    uint32_t                    cancelled;      ///< statistics: cancelled requests
+
+    void*                       userContent;    ///< user defined pointer, can by used to pass anything
+};
+
+/**
+ * @brief           Initializes empty queue
+ * @warning         mstack has to be initialized by @ref ModMasterInit() already
+ * @param queue     Pointer to queue structure
+ * @param mstack    Master stack of the bus
+ * @param wheel     Timer wheel, can be shared by many queues
+ * @param baud      Baud rate of the bus for frame timing, 0 = unpaced link (pty, TCP tunnel)
+ * @return int16_t  0 if OK, -2 wrong params
+ */
+int16_t ModMasterQueueInit(modMasterQueue_t* queue, modMasterStack_t* mstack, modTimerWheel_t* wheel, uint32_t baud);
+
+/**
+ * @brief           Appends request to the queue, it is sent as soon as the bus is free
+ * @param queue     Pointer to queue structure
+ * @param req       Request, has to stay valid until it is finished
+ * @return int16_t  0 if OK, -1 request is pending already, -2 wrong params
+ */
+int16_t ModMasterReqSubmit(modMasterQueue_t* queue, modMasterReq_t* req);
+
+/**
+ * @brief           Cancels pending request. Waiting request (or waiting for retry) is unlinked at once, request on
+ *                  the bus finishes silently when answer or timeout arrives - the bus is released as usual and
+ *                  storage of read may still be written until then. Completion callback isn't called in both cases,
+ *                  batch (@ref mod_master_batch.h) is cancelled by @ref ModMasterBatchCancel() instead.
+ * @param queue     Pointer to queue structure
+ * @param req       Request
+ * @return int16_t  0 cancelled (request is free), 1 request is on the bus (free when req->queue is NULL),
+ *                  -1 request isn't pending in this queue
+ */
+int16_t ModMasterReqCancel(modMasterQueue_t* queue, modMasterReq_t* req);
+
+/**
+ * @brief           Checks parameters of request (storage present, number of registers / bytes within limits)
+ * @param req       Request
+ * @return int16_t  0 if OK, -2 wrong params
+ */
+int16_t ModMasterReqValid(const modMasterReq_t* req);
+
+/**
+ * @brief           Finishes active request if answer arrived. Call it when Rx-done or Rx-error callback of
+ *                  the stack was called, timeouts are handled by the timer wheel.
+ * @param queue     Pointer to queue structure
+ */
+void ModMasterQueueCheck(modMasterQueue_t* queue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_MASTER_REQ_H */
@@ -2,6 +2,26 @@
 #include <string.h>
 #include "mod_master_rtu.h"
 #include "crc.h"
+#include "mod_trace.h"
+#ifdef MODBUS_STACK_STATS
+#include "mod_stats.h"
+#endif
+
+// hot state is either in stack or in shared state table
+#ifdef MODBUS_MASTER_TABLE
+    #include "mod_master_table.h"
+    #define MSTACK_STATUS(mstack)       ((mstack)->table->status[(mstack)->slot])
+    #define MSTACK_RX_START(mstack)     ((mstack)->table->rxStartTime[(mstack)->slot])
+    #define MSTACK_RX_TIMEOUT(mstack)   ((mstack)->table->rxTimeout[(mstack)->slot])
+#else
+    #define MSTACK_STATUS(mstack)       ((mstack)->status)
+    #define MSTACK_RX_START(mstack)     ((mstack)->rxStartTime)
+    #define MSTACK_RX_TIMEOUT(mstack)   ((mstack)->rxTimeout)
+#endif
+
+// every state transition goes through here
+#define MSTACK_SET_STATUS(mstack, state) \
+    do { MSTACK_STATUS(mstack) = (state); MODBUS_TRACE_M_STATE(mstack, state); } while (0)
 
 // MODBUS commands
 #define MODBUS_OPCODE_READ_OUT_REGS     0x03
@@ -23,21 +43,75 @@ int16_t ModMasterInit (modMasterStack_t* mstack)
         return -1; // wrong config
     }
 
-    mstack->status = eMOD_M_STATE_STANDBY;
+#ifdef MODBUS_MESSAGE_POOL
+    if (mstack->pool == NULL || mstack->pool->bufferSize < MODBUS_MESSAGE_SIZE)
+    {
+        return -1; // wrong config, Rx callbacks copy up to MODBUS_MESSAGE_SIZE bytes into borrowed buffer
+    }
+    mstack->message = NULL; // borrowed for each operation
+#endif
+#ifdef MODBUS_MASTER_TABLE
+    if (mstack->table == NULL)
+    {
+        return -1; // wrong config, use ModMasterTableAdd()
+    }
+#endif
+    MSTACK_RX_TIMEOUT(mstack) = MODBUS_RX_TIMEOUT;
+    MSTACK_SET_STATUS(mstack, eMOD_M_STATE_STANDBY);
 
     return 0;
 }
 
+void ModMasterSetTimeout(modMasterStack_t* mstack, uint16_t timeout)
+{
+    MSTACK_RX_TIMEOUT(mstack) = timeout;
+}
+
+uint32_t ModMasterCharTimeUs(uint32_t baud)
+{
+    return (11u * 1000000u + baud - 1) / baud;
+}
+
+uint32_t ModMasterFrameGapUs(uint32_t baud)
+{
+    // above 19200 Bd the spec recommends fixed 1.75 ms
+    return (baud > 19200) ? 1750u : (ModMasterCharTimeUs(baud) * 7u + 1u) / 2u;
+}
+
+#ifdef MODBUS_MESSAGE_POOL
+// borrow message buffer for new operation
+static int16_t ModMasterBorrow (modMasterStack_t* mstack)
+{
+    if (mstack->message == NULL)
+    {
+        mstack->message = ModMsgPoolAlloc(mstack->pool);
+    }
+
+    return mstack->message == NULL ? -1 : 0;
+}
+
+// return message buffer, operation is done
+static void ModMasterRelease (modMasterStack_t* mstack)
+{
+    ModMsgPoolFree(mstack->pool, mstack->message);
+    mstack->message = NULL;
+}
+#else
+#define ModMasterBorrow(mstack)     (0)
+#define ModMasterRelease(mstack)
+#endif
+
 //calc CRC and initialize transmit
 static int16_t ModMasterSend (modMasterStack_t* mstack)
 {
     int16_t retval = 0;
     uint16_t crc;
     
-    // check msg length 256Bytes total (254 + space for 2 CRC)
-    if (mstack->messageLast > 253)
+    // check msg length MODBUS_MAX_FRAME total (incl. space for 2 CRC)
+    if (mstack->messageLast > MODBUS_MAX_FRAME - 3)
     {
         retval = -2;
+        ModMasterRelease(mstack);
     }
     else
     {
@@ -45,29 +119,39 @@ static int16_t ModMasterSend (modMasterStack_t* mstack)
         mstack->message[(++mstack->messageLast)] = (uint8_t)crc;
         mstack->message[(++mstack->messageLast)] = (uint8_t)(crc >> 8);
         //reserve the bus for us
-        mstack->status = eMOD_M_STATE_TRANSMITTING;
+#ifdef MODBUS_MASTER_TABLE
+        mstack->table->seq[mstack->slot]++;
+#endif
+        MSTACK_SET_STATUS(mstack, eMOD_M_STATE_TRANSMITTING);
+        MODBUS_TRACE_M_SEND(mstack, mstack->message, mstack->messageLast + 1);
         if (mstack->pfSend(mstack, (uint8_t*)mstack->message, mstack->messageLast + 1) < 0) {
             retval = -3;
-            mstack->status = eMOD_M_STATE_HW_ERROR;
+            MSTACK_SET_STATUS(mstack, eMOD_M_STATE_HW_ERROR);
         }
     }
 
     return retval;
 }
 
-int16_t ModMasterReadRegs(modMasterStack_t* mstack, uint8_t modAddress, uint16_t first, uint16_t num, uint16_t* regs)
+// read holding or input registers
+static int16_t ModMasterRead(modMasterStack_t* mstack, uint8_t opCode, uint8_t modAddress, uint16_t first, uint16_t num,
+                             uint16_t* regs)
 {
-    if( mstack->status != eMOD_M_STATE_STANDBY )
+    if( MSTACK_STATUS(mstack) != eMOD_M_STATE_STANDBY )
     {
         return -1; // stack is busy
     }
-    if( num > 125 || regs == NULL )
+    if( num > MODBUS_MAX_READ_REGS || regs == NULL )
     {
         return -2; // wrong params
     }
+    if( ModMasterBorrow(mstack) < 0 )
+    {
+        return -1; // no free message buffer in pool
+    }
 
     mstack->slaveAddr = modAddress;
-    mstack->opCode = MODBUS_OPCODE_READ_OUT_REGS;
+    mstack->opCode = opCode;
     mstack->firstReg = first;
     mstack->numRegs = num;
     mstack->dataStorage = regs;
@@ -83,16 +167,30 @@ int16_t ModMasterReadRegs(modMasterStack_t* mstack, uint8_t modAddress, uint16_t
     return ModMasterSend(mstack);
 }
 
+int16_t ModMasterReadRegs(modMasterStack_t* mstack, uint8_t modAddress, uint16_t first, uint16_t num, uint16_t* regs)
+{
+    return ModMasterRead(mstack, MODBUS_OPCODE_READ_OUT_REGS, modAddress, first, num, regs);
+}
+
+int16_t ModMasterReadInputRegs(modMasterStack_t* mstack, uint8_t modAddress, uint16_t first, uint16_t num, uint16_t* regs)
+{
+    return ModMasterRead(mstack, MODBUS_OPCODE_READ_INP_REGS, modAddress, first, num, regs);
+}
+
 int16_t ModMasterWriteRegs(modMasterStack_t* mstack, uint8_t modAddress, uint16_t first, uint16_t num, const uint16_t* regs)
 {
-    if( mstack->status != eMOD_M_STATE_STANDBY )
+    if( MSTACK_STATUS(mstack) != eMOD_M_STATE_STANDBY )
     {
         return -1; // stack is busy
     }
-    if( num > 123 || regs == NULL )
+    if( num > MODBUS_MAX_WRITE_REGS || regs == NULL )
     {
         return -2; // wrong params
     }
+    if( ModMasterBorrow(mstack) < 0 )
+    {
+        return -1; // no free message buffer in pool
+    }
 
     mstack->slaveAddr = modAddress;
     mstack->opCode = MODBUS_OPCODE_WRITE_MULTI_REGS;
@@ -115,10 +213,37 @@ int16_t ModMasterWriteRegs(modMasterStack_t* mstack, uint8_t modAddress, uint16_
     return ModMasterSend(mstack);
 }
 
+int16_t ModMasterDiagEcho(modMasterStack_t* mstack, uint8_t modAddress, uint16_t data)
+{
+    if( MSTACK_STATUS(mstack) != eMOD_M_STATE_STANDBY )
+    {
+        return -1; // stack is busy
+    }
+    if( ModMasterBorrow(mstack) < 0 )
+    {
+        return -1; // no free message buffer in pool
+    }
+
+    mstack->slaveAddr = modAddress;
+    mstack->opCode = MODBUS_OPCODE_DIAGNOSTIC;
+    mstack->firstReg = 0x0000; // sub-function: return query data
+    mstack->numRegs = data; // store data for later check
+
+    mstack->message[0] = modAddress;
+    mstack->message[1] = mstack->opCode;
+    mstack->message[2] = 0x00;
+    mstack->message[3] = 0x00;
+    mstack->message[4] = (uint8_t)(data >> 8);
+    mstack->message[5] = (uint8_t)(data);
+    mstack->messageLast = 5;
+
+    return ModMasterSend(mstack);
+}
+
 #ifdef MODBUS_USER_COMMANDS
 int16_t ModMasterReadDataPacket(modMasterStack_t* mstack, uint8_t modAddress, uint8_t* length, uint8_t* data)
 {
-    if( mstack->status != eMOD_M_STATE_STANDBY )
+    if( MSTACK_STATUS(mstack) != eMOD_M_STATE_STANDBY )
     {
         return -1; // stack is busy
     }
@@ -126,6 +251,10 @@ int16_t ModMasterReadDataPacket(modMasterStack_t* mstack, uint8_t modAddress, ui
     {
         return -2; // wrong params
     }
+    if( ModMasterBorrow(mstack) < 0 )
+    {
+        return -1; // no free message buffer in pool
+    }
 
     mstack->slaveAddr = modAddress;
     mstack->opCode = MODBUS_OPCODE_READ_DATA_PACKET;
@@ -141,14 +270,18 @@ int16_t ModMasterReadDataPacket(modMasterStack_t* mstack, uint8_t modAddress, ui
 
 int16_t ModMasterWriteDataPacket(modMasterStack_t* mstack, uint8_t modAddress, uint8_t length, const uint8_t* data)
 {
-    if( mstack->status != eMOD_M_STATE_STANDBY )
+    if( MSTACK_STATUS(mstack) != eMOD_M_STATE_STANDBY )
     {
         return -1; // stack is busy
     }
-    if( length > 251 || data == NULL )
+    if( length > MODBUS_MAX_PACKET || data == NULL )
     {
         return -2; // wrong params
     }
+    if( ModMasterBorrow(mstack) < 0 )
+    {
+        return -1; // no free message buffer in pool
+    }
 
     mstack->slaveAddr = modAddress;
     mstack->opCode = MODBUS_OPCODE_WRITE_DATA_PACKET;
@@ -167,22 +300,23 @@ int16_t ModMasterWriteDataPacket(modMasterStack_t* mstack, uint8_t modAddress, u
 // process answer PDU - check if everything is OK
 static void ModMasterProcessAnswer(modMasterStack_t* mstack)
 {
+    MODBUS_TRACE_M_DISPATCH(mstack, mstack->message[1]);
     if ((mstack->message[1] & 0x7F) != mstack->opCode)
     {
         // answer to wrong command :o
-        mstack->status = eMOD_M_STATE_CORRUPTED;
+        MSTACK_SET_STATUS(mstack, eMOD_M_STATE_CORRUPTED);
     }
     else if (mstack->message[1] & 0x80)
     {
         // error reported
         if (mstack->messageLast < 2)
         {
-            mstack->status = eMOD_M_STATE_CORRUPTED;
+            MSTACK_SET_STATUS(mstack, eMOD_M_STATE_CORRUPTED);
         }
         else
         {
             // error code in message[2]
-            mstack->status = eMOD_M_STATE_ERR_REPORTED;
+            MSTACK_SET_STATUS(mstack, eMOD_M_STATE_ERR_REPORTED);
         }
     }
     else
@@ -194,7 +328,7 @@ static void ModMasterProcessAnswer(modMasterStack_t* mstack)
                 if (mstack->messageLast < (2 + 2 * mstack->numRegs) ||
                     mstack->message[2] != 2 * mstack->numRegs)
                 {
-                    mstack->status = eMOD_M_STATE_CORRUPTED;
+                    MSTACK_SET_STATUS(mstack, eMOD_M_STATE_CORRUPTED);
                 }
                 else
                 {
@@ -203,14 +337,14 @@ static void ModMasterProcessAnswer(modMasterStack_t* mstack)
                     {
                         ((uint16_t*)mstack->dataStorage)[i] = ((uint16_t)(mstack->message[3 + 2 * i]) << 8) | mstack->message[4 + 2 * i];
                     }
-                    mstack->status = eMOD_M_STATE_PROCESSED;
+                    MSTACK_SET_STATUS(mstack, eMOD_M_STATE_PROCESSED);
                 }
                 break;
 
             case MODBUS_OPCODE_WRITE_MULTI_REGS:
                 if (mstack->messageLast < 5)
                 {
-                    mstack->status = eMOD_M_STATE_CORRUPTED;
+                    MSTACK_SET_STATUS(mstack, eMOD_M_STATE_CORRUPTED);
                 }
                 else
                 {
@@ -219,21 +353,37 @@ static void ModMasterProcessAnswer(modMasterStack_t* mstack)
                         mstack->message[4] == (uint8_t)(mstack->numRegs >> 8) &&
                         mstack->message[5] == (uint8_t)(mstack->numRegs))
                     {
-                        mstack->status = eMOD_M_STATE_PROCESSED;
+                        MSTACK_SET_STATUS(mstack, eMOD_M_STATE_PROCESSED);
                     }
                     else
                     {
-                        mstack->status = eMOD_M_STATE_CORRUPTED;
+                        MSTACK_SET_STATUS(mstack, eMOD_M_STATE_CORRUPTED);
                     }
                 }
                 break;
 
+            case MODBUS_OPCODE_DIAGNOSTIC:
+                // echo of the request
+                if (mstack->messageLast == 5 &&
+                    mstack->message[2] == (uint8_t)(mstack->firstReg >> 8) &&
+                    mstack->message[3] == (uint8_t)(mstack->firstReg) &&
+                    mstack->message[4] == (uint8_t)(mstack->numRegs >> 8) &&
+                    mstack->message[5] == (uint8_t)(mstack->numRegs))
+                {
+                    MSTACK_SET_STATUS(mstack, eMOD_M_STATE_PROCESSED);
+                }
+                else
+                {
+                    MSTACK_SET_STATUS(mstack, eMOD_M_STATE_CORRUPTED);
+                }
+                break;
+
 #ifdef MODBUS_USER_COMMANDS
             case MODBUS_OPCODE_READ_DATA_PACKET:
                 if (mstack->messageLast < 2 ||
                     mstack->messageLast != (2 + mstack->message[2]))
                 {
-                    mstack->status = eMOD_M_STATE_CORRUPTED;
+                    MSTACK_SET_STATUS(mstack, eMOD_M_STATE_CORRUPTED);
                 }
                 else
                 {
@@ -242,7 +392,7 @@ static void ModMasterProcessAnswer(modMasterStack_t* mstack)
                     {
                         *((uint8_t*)mstack->dataStorage2) = mstack->message[2];
                     }
-                    mstack->status = eMOD_M_STATE_PROCESSED;
+                    MSTACK_SET_STATUS(mstack, eMOD_M_STATE_PROCESSED);
                 }
                 break;
 
@@ -250,18 +400,18 @@ static void ModMasterProcessAnswer(modMasterStack_t* mstack)
                 if (mstack->messageLast != 2 ||
                     mstack->message[2] != mstack->numRegs)
                 {
-                    mstack->status= eMOD_M_STATE_CORRUPTED;
+                    MSTACK_SET_STATUS(mstack, eMOD_M_STATE_CORRUPTED);
                 }
                 else
                 {
-                    mstack->status = eMOD_M_STATE_PROCESSED;
+                    MSTACK_SET_STATUS(mstack, eMOD_M_STATE_PROCESSED);
                 }
                 break;
 #endif
 
             default:
                 // something very bad happend
-                mstack->status = eMOD_M_STATE_CORRUPTED;
+                MSTACK_SET_STATUS(mstack, eMOD_M_STATE_CORRUPTED);
                 break;
         }
     }
@@ -272,7 +422,7 @@ static void ModMasterParseAnswer (modMasterStack_t* mstack)
 {
     uint16_t crc;
     
-    mstack->status = eMOD_M_STATE_PROCESSING;
+    MSTACK_SET_STATUS(mstack, eMOD_M_STATE_PROCESSING);
     
     //if message is from device we wanted
     if (mstack->message[0] == mstack->slaveAddr)
@@ -281,7 +431,7 @@ static void ModMasterParseAnswer (modMasterStack_t* mstack)
         if (mstack->messageLast < 3)
         {
             // message too short
-            mstack->status = eMOD_M_STATE_CORRUPTED;
+            MSTACK_SET_STATUS(mstack, eMOD_M_STATE_CORRUPTED);
         }
         else
         {
@@ -290,11 +440,19 @@ static void ModMasterParseAnswer (modMasterStack_t* mstack)
                 mstack->message[(mstack->messageLast--)] != (uint8_t)(crc))
             {
                 // invalid CRC
-                mstack->status = eMOD_M_STATE_CORRUPTED;
+                MODBUS_TRACE_M_CRC(mstack, 0);
+#ifdef MODBUS_STACK_STATS
+                if (mstack->stats != NULL)
+                {
+                    ModStatsCrcError(mstack->stats, mstack->statsBus, 1);
+                }
+#endif
+                MSTACK_SET_STATUS(mstack, eMOD_M_STATE_CORRUPTED);
             }
             else
             {
                 // message correct, process it (.messageLast pointing to last byte of data, not CRC)
+                MODBUS_TRACE_M_CRC(mstack, 1);
                 ModMasterProcessAnswer(mstack);
             }
         }
@@ -302,7 +460,7 @@ static void ModMasterParseAnswer (modMasterStack_t* mstack)
     //if message is not from slave we wanted
     else
     {
-        mstack->status = eMOD_M_STATE_CORRUPTED;
+        MSTACK_SET_STATUS(mstack, eMOD_M_STATE_CORRUPTED);
     }
 }
 
@@ -311,7 +469,7 @@ int16_t ModMasterCheck(modMasterStack_t* mstack, modMasterState_t* lastStatus, u
     int16_t retval = 0;
     modMasterState_t status;
     //INTERRUPT_PROTECT(
-        status = mstack->status; // atomic read on ARM (!)
+        status = MSTACK_STATUS(mstack); // atomic read on ARM (!)
     //);
 
     switch (status) {
@@ -325,21 +483,24 @@ int16_t ModMasterCheck(modMasterStack_t* mstack, modMasterState_t* lastStatus, u
         break;
 
     case eMOD_M_STATE_WAITING_ANSWER:
-        if ((MODBUS_GET_TIME_MS - mstack->rxStartTime) > (MODBUS_TIME_T)MODBUS_RX_TIMEOUT) {
+        if ((MODBUS_GET_TIME_MS - MSTACK_RX_START(mstack)) > (MODBUS_TIME_T)MSTACK_RX_TIMEOUT(mstack)) {
             status = eMOD_M_STATE_TIMED_OUT; // report timeout
-            mstack->status = eMOD_M_STATE_STANDBY; // atomic write (!)
+            MODBUS_TRACE_M_STATE(mstack, eMOD_M_STATE_TIMED_OUT);
+            MSTACK_SET_STATUS(mstack, eMOD_M_STATE_STANDBY); // atomic write (!)
+            ModMasterRelease(mstack);
             retval = 1;
         }
         break;
 
     case eMOD_M_STATE_RECEIVED:
         ModMasterParseAnswer(mstack); // parse answer
-        status = mstack->status; // refresh - status will change during parsing
+        status = MSTACK_STATUS(mstack); // refresh - status will change during parsing
         // copy error code reported by slave (if any)
         if( status == eMOD_M_STATE_ERR_REPORTED && errCode != NULL ) {
             *errCode = mstack->message[2];
         }
-        mstack->status = eMOD_M_STATE_STANDBY; // operation done, go standby
+        MSTACK_SET_STATUS(mstack, eMOD_M_STATE_STANDBY); // operation done, go standby
+        ModMasterRelease(mstack);
         retval = 1;
         break;
 
@@ -347,7 +508,8 @@ int16_t ModMasterCheck(modMasterStack_t* mstack, modMasterState_t* lastStatus, u
     // eMOD_M_STATE_TIMED_OUT managed in eMOD_M_STATE_WAITING_ANSWER
 
     case eMOD_M_STATE_CORRUPTED:
-        mstack->status = eMOD_M_STATE_STANDBY; // operation done, go standby
+        MSTACK_SET_STATUS(mstack, eMOD_M_STATE_STANDBY); // operation done, go standby
+        ModMasterRelease(mstack);
         retval = 1;
         break;
 
@@ -355,12 +517,14 @@ int16_t ModMasterCheck(modMasterStack_t* mstack, modMasterState_t* lastStatus, u
     // eMOD_M_STATE_PROCESSED managed in eMOD_M_STATE_WAITING_ANSWER
 
     case eMOD_M_STATE_HW_ERROR:
-        mstack->status = eMOD_M_STATE_STANDBY; // operation done, go standby
+        MSTACK_SET_STATUS(mstack, eMOD_M_STATE_STANDBY); // operation done, go standby
+        ModMasterRelease(mstack);
         retval = 1;
         break;
 
     default:
-        mstack->status = eMOD_M_STATE_STANDBY; // failsafe
+        MSTACK_SET_STATUS(mstack, eMOD_M_STATE_STANDBY); // failsafe
+        ModMasterRelease(mstack);
         break;
     }
 
@@ -375,25 +539,25 @@ int16_t ModMasterCheck(modMasterStack_t* mstack, modMasterState_t* lastStatus, u
 
 void ModMasterTxDoneCallback(modMasterStack_t* mstack)
 {
-    if (mstack->status == eMOD_M_STATE_TRANSMITTING)
+    if (MSTACK_STATUS(mstack) == eMOD_M_STATE_TRANSMITTING)
     {
-        mstack->status = eMOD_M_STATE_WAITING_ANSWER;
+        MSTACK_SET_STATUS(mstack, eMOD_M_STATE_WAITING_ANSWER);
         if (mstack->pfReceive(mstack) < 0) {
-            mstack->status = eMOD_M_STATE_HW_ERROR;
+            MSTACK_SET_STATUS(mstack, eMOD_M_STATE_HW_ERROR);
         }
-        mstack->rxStartTime = MODBUS_GET_TIME_ISR_MS;
+        MSTACK_RX_START(mstack) = MODBUS_GET_TIME_ISR_MS;
     }
 }
 
 void ModMasterRxDoneCallback(modMasterStack_t* mstack, const uint8_t* msg, uint16_t len)
 {
     // full message received
-    if (mstack->status == eMOD_M_STATE_WAITING_ANSWER)
+    if (MSTACK_STATUS(mstack) == eMOD_M_STATE_WAITING_ANSWER)
     {
-        if (len < 1 || len > 257)
+        if (len < 1 || len > MODBUS_MESSAGE_SIZE)
         {
             // too short or too long message
-            mstack->status = eMOD_M_STATE_CORRUPTED;
+            MSTACK_SET_STATUS(mstack, eMOD_M_STATE_CORRUPTED);
         }
         else
         {
@@ -403,7 +567,7 @@ void ModMasterRxDoneCallback(modMasterStack_t* mstack, const uint8_t* msg, uint1
                 // copy data only if original msg is somewhere else than internal buffer
                 memcpy((uint8_t*)mstack->message, msg, len);
             }
-            mstack->status = eMOD_M_STATE_RECEIVED; // parse new message in main code
+            MSTACK_SET_STATUS(mstack, eMOD_M_STATE_RECEIVED); // parse new message in main code
         }
     }
 }
@@ -411,8 +575,8 @@ void ModMasterRxDoneCallback(modMasterStack_t* mstack, const uint8_t* msg, uint1
 void ModMasterRxErrorCallback(modMasterStack_t* mstack)
 {
     // general rx error
-    if (mstack->status == eMOD_M_STATE_WAITING_ANSWER)
+    if (MSTACK_STATUS(mstack) == eMOD_M_STATE_WAITING_ANSWER)
     {
-        mstack->status = eMOD_M_STATE_CORRUPTED;
+        MSTACK_SET_STATUS(mstack, eMOD_M_STATE_CORRUPTED);
     }
 }
@@ -17,15 +17,21 @@ extern "C" {
 /**
  * @defgroup TimeAPI Time API includes & defines
  * It is here only for @ref ModbusMasterInternal. Feel free to change to any other API.
+ * Define MODBUS_PORT_LINUX to use POSIX monotonic clock (host tools, gateways).
  * @{
  */
+#ifdef MODBUS_PORT_LINUX
+#include "mod_time_linux.h"
+#else
 #include "FreeRTOS.h"
 #include "task.h"
 
-#define MODBUS_RX_TIMEOUT           100     ///< in milliseconds
 #define MODBUS_TIME_T               TickType_t
 #define MODBUS_GET_TIME_MS          (xTaskGetTickCount() * (1000/configTICK_RATE_HZ))
 #define MODBUS_GET_TIME_ISR_MS      (xTaskGetTickCountFromISR() * (1000/configTICK_RATE_HZ))
+#endif
+
+#define MODBUS_RX_TIMEOUT           100     ///< in milliseconds
 /** @} */
 
 /**
@@ -38,6 +44,45 @@ extern "C" {
 #define MODBUS_ERR_DEVICE_FAULT     0x04
 /** @} */
 
+/**
+ * @defgroup ModbusBuffer Message buffer size
+ * Define MODBUS_MESSAGE_SIZE (e.g. by compiler flag) to shrink stacks exchanging short frames only.
+ * Limits of all operations are derived from it.
+ * @{
+ */
+#ifndef MODBUS_MESSAGE_SIZE
+#define MODBUS_MESSAGE_SIZE         257     ///< longest RTU frame (256 B) + 1 B, so DMA can detect overflow
+#endif
+#if MODBUS_MESSAGE_SIZE < 12 || MODBUS_MESSAGE_SIZE > 257
+#error "MODBUS_MESSAGE_SIZE has to be 12 - 257"
+#endif
+#define MODBUS_MAX_FRAME            (MODBUS_MESSAGE_SIZE - 1)
+#define MODBUS_MAX_READ_REGS        ((MODBUS_MAX_FRAME - 5) / 2 < 125 ? (MODBUS_MAX_FRAME - 5) / 2 : 125)
+#define MODBUS_MAX_WRITE_REGS       ((MODBUS_MAX_FRAME - 9) / 2 < 123 ? (MODBUS_MAX_FRAME - 9) / 2 : 123)
+#define MODBUS_MAX_PACKET           (MODBUS_MAX_FRAME - 5 < 251 ? MODBUS_MAX_FRAME - 5 : 251)
+/** @} */
+
+/**
+ * Define MODBUS_MESSAGE_POOL to borrow message buffers from shared pool (see @ref mod_msgpool.h)
+ * instead of embedding one in each stack.
+ */
+#ifdef MODBUS_MESSAGE_POOL
+#include "mod_msgpool.h"
+#endif
+
+/**
+ * Define MODBUS_STACK_STATS to count CRC errors of answers into statistics shard (see @ref mod_stats.h),
+ * results of transactions are recorded by request queue.
+ */
+#ifdef MODBUS_STACK_STATS
+struct modStatsShard_s;
+#endif
+
+/**
+ * Define MODBUS_MASTER_TABLE to keep status and rx start time of stacks in shared structure-of-arrays table
+ * (see @ref mod_master_table.h), so many stacks can be swept without touching their cold data.
+ */
+
 /** MODBUS engine status flags **/
 typedef enum
 {
@@ -50,10 +95,13 @@ typedef enum
     eMOD_M_STATE_CORRUPTED,
     eMOD_M_STATE_ERR_REPORTED,
     eMOD_M_STATE_PROCESSED,
-    eMOD_M_STATE_HW_ERROR
+    eMOD_M_STATE_HW_ERROR,
+    eMOD_M_STATE_CANCELLED,         ///< request was cancelled (reported by request queue only)
+    eMOD_M_STATE_EXPIRED            ///< request was dropped after its deadline (reported by request queue only)
 } modMasterState_t;
 
 typedef struct modMasterStack_s modMasterStack_t;
+typedef struct modMasterTable_s modMasterTable_t;
 
 /**
  * @defgroup ModbusMasterCb Modbus master callbacks
@@ -82,21 +130,41 @@ typedef int16_t (*pfModMReceive_t)(modMasterStack_t* mstack);
  */
 struct modMasterStack_s
 {
-    void*                       userContent;    ///< user defined pointer, can by used to pass anything
+    // hot: touched by every callback and check
+#ifdef MODBUS_MASTER_TABLE
+    uint16_t                    slot;           ///< status and rxStartTime are in table (see @ref mod_master_table.h)
+#else
     modMasterState_t volatile   status;         ///< status of MODBUS engine
-
-    pfModMSend_t                pfSend;         ///< send command function
-    pfModMReceive_t             pfReceive;      ///< setup receiver function
-    
-    MODBUS_TIME_T               rxStartTime;    ///< absolute time, when Rx starts - used by timeout calculation
+#endif
+    uint16_t volatile           messageLast;    ///< total length of MODBUS message - 1
     uint8_t                     slaveAddr;      ///< address of slave device for command on the fly
     uint8_t                     opCode;         ///< operation code of command on the fly
     uint16_t                    firstReg;       ///< first register of R/W operation
     uint16_t                    numRegs;        ///< amount of data to read or write
+#ifndef MODBUS_MASTER_TABLE
+    MODBUS_TIME_T               rxStartTime;    ///< absolute time, when Rx starts - used by timeout calculation
+    uint16_t                    rxTimeout;      ///< answer timeout [ms], see @ref ModMasterSetTimeout()
+#endif
+
+    pfModMSend_t                pfSend;         ///< send command function
+    pfModMReceive_t             pfReceive;      ///< setup receiver function
     void*                       dataStorage;    ///< user defined storage for rx or tx data
     void*                       dataStorage2;   ///< extra user defined storage
-    uint16_t volatile           messageLast;    ///< total length of MODBUS message - 1
-    uint8_t                     message[257];   ///< the message
+    void*                       userContent;    ///< user defined pointer, can by used to pass anything
+#ifdef MODBUS_MASTER_TABLE
+    modMasterTable_t*           table;          ///< shared state table, slot of this stack is above
+#endif
+#ifdef MODBUS_STACK_STATS
+    struct modStatsShard_s*     stats;          ///< shard of thread running the stack, can be NULL
+    uint8_t                     statsBus;       ///< bus number in statistics
+#endif
+
+#ifdef MODBUS_MESSAGE_POOL
+    modMsgPool_t*               pool;           ///< pool of message buffers (MODBUS_MESSAGE_SIZE each), shared with other stacks
+    uint8_t*                    message;        ///< the message, borrowed from pool while operation is on the fly
+#else
+    uint8_t                     message[MODBUS_MESSAGE_SIZE];   ///< the message
+#endif
 };
 
 /**
@@ -107,13 +175,35 @@ struct modMasterStack_s
  */
 int16_t ModMasterInit(modMasterStack_t* mstack);
 
+/**
+ * @brief           Sets answer timeout (measured from end of transmission) for next operations,
+ *                  @ref ModMasterInit() sets MODBUS_RX_TIMEOUT
+ * @param mstack    Pointer to modbus stack structure
+ * @param timeout   Timeout in milliseconds
+ */
+void ModMasterSetTimeout(modMasterStack_t* mstack, uint16_t timeout);
+
+/**
+ * @brief           Duration of one character on the line (start + 8 data + parity/2nd stop + stop = 11 bits)
+ * @param baud      Baud rate, > 0
+ * @return uint32_t Character time in microseconds, rounded up
+ */
+uint32_t ModMasterCharTimeUs(uint32_t baud);
+
+/**
+ * @brief           Minimum silent interval between frames (3.5 characters, fixed 1750 us above 19200 Bd)
+ * @param baud      Baud rate, > 0
+ * @return uint32_t Inter-frame gap in microseconds, rounded up
+ */
+uint32_t ModMasterFrameGapUs(uint32_t baud);
+
 /**
  * @brief               Initialize "read holding registers" operation of slave device
  * 
  * @param mstack        Pointer to modbus stack structure
  * @param modAddress    Slave device address
  * @param first         Address of first register
- * @param num           Number of registers to read
+ * @param num           Number of registers to read, max MODBUS_MAX_READ_REGS
  * @param regs          Storage, it's caller responsibility to allocate enough space.
  *                      Data are valid only after success finish of operation
  *                      @ref ModMasterCheck() reports eMOD_M_STATE_PROCESSED.
@@ -122,19 +212,46 @@ int16_t ModMasterInit(modMasterStack_t* mstack);
  */
 int16_t ModMasterReadRegs(modMasterStack_t* mstack, uint8_t modAddress, uint16_t first, uint16_t num, uint16_t* regs);
 
+/**
+ * @brief               Initialize "read input registers" operation of slave device
+ *
+ * @param mstack        Pointer to modbus stack structure
+ * @param modAddress    Slave device address
+ * @param first         Address of first register
+ * @param num           Number of registers to read, max MODBUS_MAX_READ_REGS
+ * @param regs          Storage, it's caller responsibility to allocate enough space.
+ *                      Data are valid only after success finish of operation
+ *                      @ref ModMasterCheck() reports eMOD_M_STATE_PROCESSED.
+ * @return int16_t      0 initialization successful, -1 stack is busy, -2 wrong params,
+ *                      -3 HW error (next call of @ref ModMasterCheck() will report eMOD_M_STATE_HW_ERROR)
+ */
+int16_t ModMasterReadInputRegs(modMasterStack_t* mstack, uint8_t modAddress, uint16_t first, uint16_t num, uint16_t* regs);
+
 /**
  * @brief               Initialize "write holding registers" operation of slave device
  * 
  * @param mstack        Pointer to modbus stack structure
  * @param modAddress    Slave device address
  * @param first         Address of first register
- * @param num           Number of registers to write
+ * @param num           Number of registers to write, max MODBUS_MAX_WRITE_REGS
  * @param regs          Values to write
  * @return int16_t      0 initialization successful, -1 stack is busy, -2 wrong params,
  *                      -3 HW error (next call of @ref ModMasterCheck() will report eMOD_M_STATE_HW_ERROR)
  */
 int16_t ModMasterWriteRegs(modMasterStack_t* mstack, uint8_t modAddress, uint16_t first, uint16_t num, const uint16_t* regs);
 
+/**
+ * @brief               Initialize "diagnostics - return query data" operation (0x08, sub-function 0x0000),
+ *                      slave echoes the request. Cheap presence test of slave device.
+ *
+ * @param mstack        Pointer to modbus stack structure
+ * @param modAddress    Slave device address
+ * @param data          Data to be echoed
+ * @return int16_t      0 initialization successful, -1 stack is busy,
+ *                      -3 HW error (next call of @ref ModMasterCheck() will report eMOD_M_STATE_HW_ERROR)
+ */
+int16_t ModMasterDiagEcho(modMasterStack_t* mstack, uint8_t modAddress, uint16_t data);
+
 #ifdef MODBUS_USER_COMMANDS
 /**
  * @brief               Initialize reading of one data packet (custom user defined Modbus operation) from slave device.
@@ -155,7 +272,7 @@ int16_t ModMasterReadDataPacket(modMasterStack_t* mstack, uint8_t modAddress, ui
  *
  * @param mstack        Pointer to modbus stack structure
  * @param modAddress    Slave device address
- * @param length        Number of bytes to write, max 251
+ * @param length        Number of bytes to write, max MODBUS_MAX_PACKET
  * @param data          Data to be sent
  * @return int16_t      0 initialization successful, -1 stack is busy, -2 wrong params,
  *                      -3 HW error (next call of @ref ModMasterCheck() will report eMOD_M_STATE_HW_ERROR)
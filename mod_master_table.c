@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <string.h>
+#include "mod_master_table.h"
+
+void ModMasterTableInit(modMasterTable_t* table)
+{
+    table->numUsed = 0;
+}
+
+int16_t ModMasterTableAdd(modMasterTable_t* table, modMasterStack_t* mstack)
+{
+    uint16_t slot = table->numUsed;
+
+    if (slot >= MODBUS_MASTER_TABLE_SIZE)
+    {
+        return -1; // table is full
+    }
+
+    table->status[slot] = eMOD_M_STATE_STANDBY;
+    table->rxStartTime[slot] = 0;
+    table->rxTimeout[slot] = MODBUS_RX_TIMEOUT;
+    table->seq[slot] = 0;
+    table->stacks[slot] = mstack;
+    table->numUsed++;
+    mstack->table = table;
+    mstack->slot = slot;
+
+    return (int16_t)slot;
+}
+
+uint16_t ModMasterTableSweep(modMasterTable_t* table, uint16_t* due, uint16_t maxDue)
+{
+    uint16_t found = 0;
+    MODBUS_TIME_T now = MODBUS_GET_TIME_MS;
+
+    for (uint16_t slot = 0; slot < table->numUsed && found < maxDue; slot++)
+    {
+        switch (table->status[slot])
+        {
+        case eMOD_M_STATE_STANDBY:
+        case eMOD_M_STATE_TRANSMITTING:
+            break;
+
+        case eMOD_M_STATE_WAITING_ANSWER:
+            if ((MODBUS_TIME_T)(now - table->rxStartTime[slot]) > (MODBUS_TIME_T)table->rxTimeout[slot])
+            {
+                due[found++] = slot;
+            }
+            break;
+
+        default:
+            // received, corrupted or HW error
+            due[found++] = slot;
+            break;
+        }
+    }
+
+    return found;
+}
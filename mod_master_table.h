@@ -0,0 +1,70 @@
+/**
+ * @file    mod_master_table.h
+ * @brief   Hot state of many master stacks in one structure-of-arrays table. With MODBUS_MASTER_TABLE defined,
+ *          status and rx start time of each @ref modMasterStack_t live in a slot of the table instead of in the
+ *          stack, next to the same fields of other stacks. Manager of many buses can then sweep the table for
+ *          stacks needing @ref ModMasterCheck() touching only few bytes per stack, cold data (callbacks, message
+ *          buffer) are touched only for stacks found by the sweep.
+ */
+
+#ifndef SYSTEM_MOD_MASTER_TABLE_H
+#define SYSTEM_MOD_MASTER_TABLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "mod_master_rtu.h"
+
+#ifndef MODBUS_MASTER_TABLE
+#error "mod_master_table.h requires MODBUS_MASTER_TABLE to be defined"
+#endif
+
+#ifndef MODBUS_MASTER_TABLE_SIZE
+#define MODBUS_MASTER_TABLE_SIZE    1024    ///< max. number of stacks in one table
+#endif
+
+/**
+ * @brief   State table structure. Arrays are indexed by slot of the stack.
+ */
+struct modMasterTable_s
+{
+    uint8_t volatile            status[MODBUS_MASTER_TABLE_SIZE];       ///< modMasterState_t of each stack
+    MODBUS_TIME_T volatile      rxStartTime[MODBUS_MASTER_TABLE_SIZE];  ///< when Rx starts - used by timeout calculation
+    uint16_t                    rxTimeout[MODBUS_MASTER_TABLE_SIZE];    ///< answer timeout of each stack [ms]
+    uint16_t                    seq[MODBUS_MASTER_TABLE_SIZE];          ///< incremented when operation starts
+    modMasterStack_t*           stacks[MODBUS_MASTER_TABLE_SIZE];       ///< cold part of the stack
+    uint16_t                    numUsed;        ///< number of assigned slots
+};
+
+/**
+ * @brief           Initializes empty table
+ * @param table     Pointer to table structure
+ */
+void ModMasterTableInit(modMasterTable_t* table);
+
+/**
+ * @brief           Assigns next free slot to the stack
+ * @warning         Call it BEFORE @ref ModMasterInit()
+ * @param table     Pointer to table structure
+ * @param mstack    Pointer to modbus stack structure
+ * @return int16_t  slot number if OK, -1 if table is full
+ */
+int16_t ModMasterTableAdd(modMasterTable_t* table, modMasterStack_t* mstack);
+
+/**
+ * @brief           Finds stacks, whose next @ref ModMasterCheck() finishes operation - answer received or failed,
+ *                  or waiting for answer longer than its timeout
+ * @param table     Pointer to table structure
+ * @param due       Storage for slot numbers of found stacks
+ * @param maxDue    Size of due storage, sweep stops when it is full
+ * @return uint16_t Number of found stacks
+ */
+uint16_t ModMasterTableSweep(modMasterTable_t* table, uint16_t* due, uint16_t maxDue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_MASTER_TABLE_H */
@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <string.h>
+#include "mod_msgpool.h"
+
+// link to next free buffer is stored in first two bytes of free buffer
+static uint16_t ModMsgPoolNext(const uint8_t* buffer)
+{
+    return (uint16_t)buffer[0] | (uint16_t)buffer[1] << 8;
+}
+
+static void ModMsgPoolSetNext(uint8_t* buffer, uint16_t next)
+{
+    buffer[0] = (uint8_t)next;
+    buffer[1] = (uint8_t)(next >> 8);
+}
+
+int16_t ModMsgPoolInit(modMsgPool_t* pool, uint8_t* storage, uint16_t bufferSize, uint16_t numBuffers)
+{
+    if (storage == NULL || bufferSize < 2 || numBuffers == 0 || numBuffers == 0xFFFF)
+    {
+        return -2; // wrong params
+    }
+
+    pool->storage = storage;
+    pool->bufferSize = bufferSize;
+    pool->numBuffers = numBuffers;
+    for (uint16_t i = 0; i < numBuffers; i++)
+    {
+        ModMsgPoolSetNext(storage + (uint32_t)i * bufferSize, i + 1);
+    }
+    pool->firstFree = 0;
+    pool->numFree = numBuffers;
+    pool->minFree = numBuffers;
+    pool->failures = 0;
+
+    return 0;
+}
+
+uint8_t* ModMsgPoolAlloc(modMsgPool_t* pool)
+{
+    uint8_t* buffer = NULL;
+
+    MODBUS_POOL_LOCK();
+    if (pool->firstFree < pool->numBuffers)
+    {
+        buffer = pool->storage + (uint32_t)pool->firstFree * pool->bufferSize;
+        pool->firstFree = ModMsgPoolNext(buffer);
+        pool->numFree--;
+        if (pool->numFree < pool->minFree)
+        {
+            pool->minFree = pool->numFree;
+        }
+    }
+    else
+    {
+        pool->failures++;
+    }
+    MODBUS_POOL_UNLOCK();
+
+    return buffer;
+}
+
+void ModMsgPoolFree(modMsgPool_t* pool, uint8_t* buffer)
+{
+    if (buffer == NULL)
+    {
+        return;
+    }
+
+    MODBUS_POOL_LOCK();
+    ModMsgPoolSetNext(buffer, pool->firstFree);
+    pool->firstFree = (uint16_t)((uint32_t)(buffer - pool->storage) / pool->bufferSize);
+    pool->numFree++;
+    MODBUS_POOL_UNLOCK();
+}
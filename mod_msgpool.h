@@ -0,0 +1,81 @@
+/**
+ * @file    mod_msgpool.h
+ * @brief   Fixed-size pool of message buffers shared by many stacks. With MODBUS_MESSAGE_POOL defined,
+ *          @ref modMasterStack_t and @ref modSlaveStack_t don't embed message buffer, they borrow one from the pool
+ *          when transaction starts and return it when transaction is done. Resident memory then scales with number
+ *          of concurrent transactions instead of number of stacks. No heap is used.
+ *
+ *          Master borrows buffer in ModMasterReadRegs() & co. and returns it in ModMasterCheck() when operation
+ *          is finished. Slave borrows buffer when receiver is armed in ModSlaveCheck() and returns it when
+ *          transaction is finished, so listening slave holds its buffer. Pool pays off for masters and for
+ *          slaves, whose ModSlaveCheck() is called only when they should listen.
+ * @warning With pool, driver must not DMA into mstack->message after operation finished (e.g. late answer after
+ *          timeout), buffer may belong to other stack already. Abort reception or receive into own driver
+ *          buffer and let Rx-done callback copy it.
+ */
+
+#ifndef SYSTEM_MOD_MSGPOOL_H
+#define SYSTEM_MOD_MSGPOOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/**
+ * @defgroup ModbusPoolLock Pool locking
+ * Pool is used from ModMasterCheck() / ModSlaveCheck() and stack request functions only (never from ISR callbacks).
+ * If stacks sharing one pool run in more threads, define these (e.g. taskENTER_CRITICAL() / taskEXIT_CRITICAL()
+ * or mutex lock / unlock).
+ * @{
+ */
+#ifndef MODBUS_POOL_LOCK
+#define MODBUS_POOL_LOCK()
+#define MODBUS_POOL_UNLOCK()
+#endif
+/** @} */
+
+/**
+ * @brief   Pool structure. Free buffers are linked through their first two bytes.
+ */
+typedef struct
+{
+    uint8_t*                    storage;        ///< numBuffers * bufferSize bytes
+    uint16_t                    bufferSize;     ///< size of one buffer
+    uint16_t                    numBuffers;     ///< number of buffers
+    uint16_t                    firstFree;      ///< index of first free buffer, numBuffers if none
+    uint16_t                    numFree;        ///< statistics: free buffers now
+    uint16_t                    minFree;        ///< statistics: low watermark of free buffers
+    uint32_t                    failures;       ///< statistics: borrow requests refused because pool was empty
+} modMsgPool_t;
+
+/**
+ * @brief               Initializes pool
+ * @param pool          Pointer to pool structure
+ * @param storage       Storage of numBuffers * bufferSize bytes, e.g. uint8_t storage[N][MODBUS_MESSAGE_SIZE]
+ * @param bufferSize    Size of one buffer, MODBUS_MESSAGE_SIZE for stacks
+ * @param numBuffers    Number of buffers, 1 - 65534
+ * @return int16_t      0 if OK, -2 wrong params
+ */
+int16_t ModMsgPoolInit(modMsgPool_t* pool, uint8_t* storage, uint16_t bufferSize, uint16_t numBuffers);
+
+/**
+ * @brief               Borrows one buffer
+ * @param pool          Pointer to pool structure
+ * @return uint8_t*     Buffer of pool->bufferSize bytes, NULL if pool is empty
+ */
+uint8_t* ModMsgPoolAlloc(modMsgPool_t* pool);
+
+/**
+ * @brief               Returns buffer borrowed by @ref ModMsgPoolAlloc()
+ * @param pool          Pointer to pool structure
+ * @param buffer        Returned buffer, NULL is ignored
+ */
+void ModMsgPoolFree(modMsgPool_t* pool, uint8_t* buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_MSGPOOL_H */
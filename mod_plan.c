@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <string.h>
+#include "mod_plan.h"
+
+// store planned read, returns -1 if storage is full
+static int16_t ModPlanEmit(modPlanRange_t* reads, uint16_t maxReads, uint16_t* numReads, uint32_t first, uint32_t last)
+{
+    if (*numReads >= maxReads)
+    {
+        return -1;
+    }
+    reads[*numReads].first = (uint16_t)first;
+    reads[*numReads].num = (uint16_t)(last - first + 1);
+    (*numReads)++;
+
+    return 0;
+}
+
+int16_t ModPlanReads(const modPlanRange_t* wanted, uint16_t numWanted, const modRegionMap_t* map,
+                     const modProfile_t* profile, uint16_t maxGap, modPlanRange_t* reads, uint16_t maxReads)
+{
+    uint32_t limit = ModProfileMaxRead(profile);
+    uint32_t pos = 0;           // registers below are covered by planned reads
+    uint16_t numReads = 0;
+    uint16_t i = 0;
+
+    for (uint16_t k = 0; k < numWanted; k++)
+    {
+        if (wanted[k].num == 0 || (uint32_t)wanted[k].first + wanted[k].num > 0x10000ul ||
+            (k > 0 && wanted[k].first < wanted[k - 1].first))
+        {
+            return -2; // wrong params
+        }
+    }
+
+    while (i < numWanted)
+    {
+        uint32_t last = (uint32_t)wanted[i].first + wanted[i].num - 1;
+        uint32_t start = wanted[i].first > pos ? wanted[i].first : pos;
+        uint32_t end = last < start + limit - 1 ? last : start + limit - 1;
+        uint16_t j = i + 1;
+
+        if (start > last)
+        {
+            i++; // covered by previous read
+            continue;
+        }
+
+        // absorb following ranges while the read stays legal
+        while (end == last && j < numWanted)
+        {
+            uint32_t nextFirst = wanted[j].first;
+            uint32_t nextLast = nextFirst + wanted[j].num - 1;
+
+            if (nextLast <= end)
+            {
+                j++; // covered already
+                continue;
+            }
+            if (nextFirst > end + 1 + maxGap || nextFirst > start + limit - 1)
+            {
+                break; // gap too long / read too long
+            }
+            if (nextFirst > end + 1 && map != NULL && ModRegionFind(map, (uint16_t)(end + 1), (uint16_t)(nextFirst - 1)) < 0)
+            {
+                break; // gap isn't readable
+            }
+            i = j;
+            last = nextLast;
+            end = last < start + limit - 1 ? last : start + limit - 1;
+            j++;
+        }
+
+        if (ModPlanEmit(reads, maxReads, &numReads, start, end) < 0)
+        {
+            return -1; // storage is too small
+        }
+        pos = end + 1;
+        if (end == last)
+        {
+            i = j;
+        }
+        // else rest of range i goes to next read
+    }
+
+    return (int16_t)numReads;
+}
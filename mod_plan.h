@@ -0,0 +1,50 @@
+/**
+ * @file    mod_plan.h
+ * @brief   Read-coalescing planner. Registers wanted from one slave are merged into as few reads as possible:
+ *          neighbouring ranges are read together when the registers between them are readable (inside one region
+ *          of @ref modRegionMap_t) and the gap is not longer than maxGap (reading gap costs 2 B per register,
+ *          each extra read costs ~20 B of frames and gaps). Reads never exceed limit of slave
+ *          (@ref ModProfileMaxRead()), longer ranges are split.
+ */
+
+#ifndef SYSTEM_MOD_PLAN_H
+#define SYSTEM_MOD_PLAN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "mod_regscan.h"
+#include "mod_profile.h"
+
+#define MODBUS_PLAN_MAX_GAP         10      ///< default max. number of unwanted registers read between ranges
+
+/**
+ * @brief   Range of registers, first - first + num - 1
+ */
+typedef struct
+{
+    uint16_t                    first;
+    uint16_t                    num;
+} modPlanRange_t;
+
+/**
+ * @brief           Plans reads covering wanted ranges
+ * @param wanted    Wanted ranges sorted by first register, may overlap
+ * @param numWanted Number of wanted ranges
+ * @param map       Readable regions of slave, NULL = all registers readable
+ * @param profile   Capabilities of slave, NULL = no limits known
+ * @param maxGap    Max. number of unwanted registers read between two ranges, 0 merges touching ranges only
+ * @param reads     Storage for planned reads
+ * @param maxReads  Size of reads storage
+ * @return int16_t  Number of planned reads, -1 storage is too small, -2 wrong params (unsorted, empty range)
+ */
+int16_t ModPlanReads(const modPlanRange_t* wanted, uint16_t numWanted, const modRegionMap_t* map,
+                     const modProfile_t* profile, uint16_t maxGap, modPlanRange_t* reads, uint16_t maxReads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_PLAN_H */
@@ -0,0 +1,261 @@
+#include <stdio.h>
+#include <string.h>
+#include "mod_poller.h"
+
+static void ModPollHistAdd(modPollHist_t* hist, uint32_t ms)
+{
+    hist->samples[hist->next] = (uint16_t)(ms < 0xFFFF ? ms : 0xFFFF);
+    hist->next = (uint16_t)((hist->next + 1) % MODBUS_POLL_HISTORY);
+    if (hist->count < MODBUS_POLL_HISTORY)
+    {
+        hist->count++;
+    }
+    if (ms > hist->max)
+    {
+        hist->max = ms;
+    }
+}
+
+uint32_t ModPollPercentile(const modPollHist_t* hist, uint8_t percent)
+{
+    uint16_t sorted[MODBUS_POLL_HISTORY];
+    uint16_t rank;
+
+    if (hist->count == 0)
+    {
+        return 0;
+    }
+    for (uint16_t i = 0; i < hist->count; i++)
+    {
+        // insertion sort, history is short
+        uint16_t j = i;
+
+        while (j > 0 && sorted[j - 1] > hist->samples[i])
+        {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = hist->samples[i];
+    }
+    // nearest rank
+    rank = (uint16_t)(((uint32_t)(percent > 100 ? 100 : percent) * hist->count + 99) / 100);
+
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static uint32_t ModPollerLimit(const modPoller_t* poller, const modPollItem_t* item)
+{
+    uint32_t limit = (uint32_t)((uint64_t)item->periodMs * poller->latePercent / 100);
+
+    if (limit < 1)
+    {
+        limit = 1;
+    }
+    return limit < MODBUS_WHEEL_MAX_MS ? limit : MODBUS_WHEEL_MAX_MS;
+}
+
+static void ModPollerReqDone(modMasterQueue_t* queue, modMasterReq_t* req)
+{
+    modPollItem_t* item = (modPollItem_t*)req->userContent;
+    modPoller_t* poller = item->poller;
+    MODBUS_TIME_T now = MODBUS_GET_TIME_MS;
+
+    item->result = req->result;
+    item->errCode = req->errCode;
+    if (req->result == eMOD_M_STATE_PROCESSED)
+    {
+        if (item->sampled)
+        {
+            item->intervalMs = (uint32_t)(MODBUS_TIME_T)(now - item->sampleTime);
+            ModPollHistAdd(&item->intervals, item->intervalMs);
+            if (!item->late && item->intervalMs > ModPollerLimit(poller, item))
+            {
+                // watchdog didn't expire yet (wheel is advanced after the answer)
+                item->lateCount++;
+                if (poller->pfLate != NULL)
+                {
+                    poller->pfLate(poller, item, item->intervalMs);
+                }
+            }
+        }
+        item->sampleTime = now;
+        item->sampled = 1;
+        item->late = 0;
+        item->samples++;
+        if (poller->running)
+        {
+            ModTimerStart(queue->wheel, &item->watchdog, ModPollerLimit(poller, item));
+        }
+    }
+    else
+    {
+        item->errors++;
+    }
+
+    // cycle ends when every item was read once (successfully or not)
+    if (!item->inCycle)
+    {
+        item->inCycle = 1;
+        if (--poller->cycleLeft == 0)
+        {
+            ModPollHistAdd(&poller->cycles, (uint32_t)(MODBUS_TIME_T)(now - poller->cycleStart));
+            poller->numCycles++;
+            poller->cycleStart = now;
+            poller->cycleLeft = poller->numItems;
+            for (uint16_t i = 0; i < poller->numItems; i++)
+            {
+                poller->items[i].inCycle = 0;
+            }
+        }
+    }
+
+    if (poller->pfUpdate != NULL)
+    {
+        poller->pfUpdate(poller, item);
+    }
+}
+
+static void ModPollerSubmit(modPollItem_t* item)
+{
+    modMasterReq_t* req = &item->req;
+
+    if (req->queue != NULL)
+    {
+        item->overlaps++; // previous read is still waiting / on the bus
+        return;
+    }
+    memset(req, 0, sizeof(*req));
+    req->op = item->op;
+    req->slaveAddr = item->slaveAddr;
+    req->firstReg = item->firstReg;
+    req->numRegs = item->numRegs;
+    req->regs = item->regs;
+    req->pfDone = &ModPollerReqDone;
+    req->userContent = item;
+    (void)ModMasterReqSubmit(item->poller->queue, req);
+}
+
+static void ModPollerDue(modTimerWheel_t* wheel, modTimer_t* timer)
+{
+    modPollItem_t* item = (modPollItem_t*)timer->userContent;
+    uint32_t now = wheel->tick - 1;
+    uint32_t next = timer->expires + item->periodMs;
+
+    // next period on the grid, periods missed by late event loop are skipped
+    while ((int32_t)(next - now) <= 0)
+    {
+        next += item->periodMs;
+    }
+    ModTimerStart(wheel, timer, next - now);
+    ModPollerSubmit(item);
+}
+
+static void ModPollerWatchdog(modTimerWheel_t* wheel, modTimer_t* timer)
+{
+    modPollItem_t* item = (modPollItem_t*)timer->userContent;
+    modPoller_t* poller = item->poller;
+
+    (void)wheel;
+    item->late = 1;
+    item->lateCount++;
+    if (poller->pfLate != NULL)
+    {
+        poller->pfLate(poller, item,
+                       (uint32_t)(MODBUS_TIME_T)(MODBUS_GET_TIME_MS - (item->sampled ? item->sampleTime : poller->startTime)));
+    }
+}
+
+int16_t ModPollerInit(modPoller_t* poller, modMasterQueue_t* queue)
+{
+    if (queue == NULL)
+    {
+        return -2; // wrong params
+    }
+
+    memset(poller, 0, sizeof(*poller));
+    poller->queue = queue;
+    poller->latePercent = MODBUS_POLL_LATE_PERCENT;
+
+    return 0;
+}
+
+int16_t ModPollerStart(modPoller_t* poller, modPollItem_t* items, uint16_t numItems)
+{
+    modTimerWheel_t* wheel = poller->queue->wheel;
+
+    if (poller->running)
+    {
+        return -1; // running
+    }
+    if (items == NULL || numItems == 0)
+    {
+        return -2; // wrong params
+    }
+    for (uint16_t i = 0; i < numItems; i++)
+    {
+        const modPollItem_t* item = &items[i];
+
+        if ((item->op != eMOD_REQ_READ_REGS && item->op != eMOD_REQ_READ_INPUT_REGS) || item->regs == NULL ||
+            item->numRegs == 0 || item->numRegs > MODBUS_MAX_READ_REGS || item->periodMs == 0 ||
+            item->periodMs > MODBUS_WHEEL_MAX_MS || item->req.queue != NULL)
+        {
+            return -2; // wrong item (or its read of previous run is still pending)
+        }
+    }
+
+    poller->items = items;
+    poller->numItems = numItems;
+    poller->cycleLeft = numItems;
+    poller->startTime = MODBUS_GET_TIME_MS;
+    poller->cycleStart = poller->startTime;
+    poller->running = 1;
+
+    for (uint16_t i = 0; i < numItems; i++)
+    {
+        modPollItem_t* item = &items[i];
+
+        item->result = eMOD_M_STATE_STANDBY;
+        item->errCode = 0;
+        item->intervalMs = 0;
+        memset(&item->intervals, 0, sizeof(item->intervals));
+        item->samples = 0;
+        item->errors = 0;
+        item->overlaps = 0;
+        item->lateCount = 0;
+        item->poller = poller;
+        item->sampled = 0;
+        item->late = 0;
+        item->inCycle = 0;
+        memset(&item->timer, 0, sizeof(item->timer));
+        item->timer.pfExpired = &ModPollerDue;
+        item->timer.userContent = item;
+        memset(&item->watchdog, 0, sizeof(item->watchdog));
+        item->watchdog.pfExpired = &ModPollerWatchdog;
+        item->watchdog.userContent = item;
+        ModTimerStart(wheel, &item->timer, item->periodMs);
+        ModTimerStart(wheel, &item->watchdog, ModPollerLimit(poller, item));
+    }
+    for (uint16_t i = 0; i < numItems; i++)
+    {
+        ModPollerSubmit(&items[i]);
+    }
+
+    return 0;
+}
+
+void ModPollerStop(modPoller_t* poller)
+{
+    modTimerWheel_t* wheel = poller->queue->wheel;
+
+    if (!poller->running)
+    {
+        return;
+    }
+    poller->running = 0;
+    for (uint16_t i = 0; i < poller->numItems; i++)
+    {
+        ModTimerStop(wheel, &poller->items[i].timer);
+        ModTimerStop(wheel, &poller->items[i].watchdog);
+        (void)ModMasterReqCancel(poller->queue, &poller->items[i].req);
+    }
+}
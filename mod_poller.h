@@ -0,0 +1,147 @@
+/**
+ * @file    mod_poller.h
+ * @brief   Poll list over the request queue. Each item (read of holding / input registers) is submitted every
+ *          periodMs on fixed grid of the timer wheel. Poller measures actual interval between samples of each
+ *          item (its jitter against the period) and cycle time of the whole list (until every item was read
+ *          once), both keep rolling history for percentiles (@ref ModPollPercentile()).
+ *
+ *          Watchdog: when item isn't sampled for periodMs * latePercent / 100, pfLate is called right away (not
+ *          only after late sample arrives), so overloaded bus or dead slave is visible before stale data is used.
+ */
+
+#ifndef SYSTEM_MOD_POLLER_H
+#define SYSTEM_MOD_POLLER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "mod_master_req.h"
+
+#define MODBUS_POLL_HISTORY         64      ///< number of intervals kept for percentiles
+#define MODBUS_POLL_LATE_PERCENT    150     ///< default watchdog limit, percent of period
+
+typedef struct modPollItem_s modPollItem_t;
+typedef struct modPoller_s modPoller_t;
+
+/**
+ * @brief   Called when item wasn't sampled for longer than its limit, once per late episode
+ * @param intervalMs    Time since last sample (since start, if item wasn't sampled yet)
+ */
+typedef void (*pfModPollLate_t)(modPoller_t* poller, modPollItem_t* item, uint32_t intervalMs);
+
+/**
+ * @brief   Called when item finished (item->result tells if regs hold new sample)
+ */
+typedef void (*pfModPollUpdate_t)(modPoller_t* poller, modPollItem_t* item);
+
+/**
+ * @brief   Rolling history of intervals [ms]
+ */
+typedef struct
+{
+    uint16_t                    samples[MODBUS_POLL_HISTORY];   ///< ring buffer, saturated to 65535
+    uint16_t                    count;          ///< number of valid samples
+    uint16_t                    next;           ///< position of next sample
+    uint32_t                    max;            ///< worst interval since start
+} modPollHist_t;
+
+/**
+ * @brief   Item of poll list
+ */
+struct modPollItem_s
+{
+    // parameters
+    modMasterReqOp_t            op;             ///< eMOD_REQ_READ_REGS or eMOD_REQ_READ_INPUT_REGS
+    uint8_t                     slaveAddr;      ///< address of slave device
+    uint16_t                    firstReg;       ///< first register
+    uint16_t                    numRegs;        ///< number of registers
+    uint16_t*                   regs;           ///< storage of read
+    uint32_t                    periodMs;       ///< wanted period
+
+    // results
+    modMasterState_t            result;         ///< result of last read
+    uint8_t                     errCode;        ///< error code reported by slave, if result is eMOD_M_STATE_ERR_REPORTED
+    MODBUS_TIME_T               sampleTime;     ///< when last successful read finished
+    uint32_t                    intervalMs;     ///< time between last two samples
+    modPollHist_t               intervals;      ///< rolling history of intervals
+    uint32_t                    samples;        ///< number of successful reads
+    uint32_t                    errors;         ///< number of failed reads
+    uint32_t                    overlaps;       ///< periods skipped because previous read wasn't finished
+    uint32_t                    lateCount;      ///< number of late episodes
+
+    // internal
+    modPoller_t*                poller;
+    modMasterReq_t              req;
+    modTimer_t                  timer;          ///< period
+    modTimer_t                  watchdog;       ///< late limit
+    uint8_t                     sampled;        ///< 1 after first sample
+    uint8_t                     late;           ///< 1 while late episode lasts
+    uint8_t                     inCycle;        ///< 1 if item was read in current cycle
+
+    void*                       userContent;    ///< user defined pointer, can by used to pass anything
+};
+
+/**
+ * @brief   Poller structure
+ */
+struct modPoller_s
+{
+    // parameters
+    modMasterQueue_t*           queue;          ///< queue of the bus
+    uint16_t                    latePercent;    ///< watchdog limit, percent of period (default MODBUS_POLL_LATE_PERCENT)
+    pfModPollLate_t             pfLate;         ///< watchdog callback, can be NULL
+    pfModPollUpdate_t           pfUpdate;       ///< item finished callback, can be NULL
+
+    // results
+    modPollHist_t               cycles;         ///< rolling history of cycle times
+    uint32_t                    numCycles;      ///< number of finished cycles
+
+    // internal
+    modPollItem_t*              items;
+    uint16_t                    numItems;
+    uint16_t                    cycleLeft;      ///< items not read in current cycle yet
+    MODBUS_TIME_T               cycleStart;
+    MODBUS_TIME_T               startTime;
+    uint8_t                     running;
+
+    void*                       userContent;    ///< user defined pointer, can by used to pass anything
+};
+
+/**
+ * @brief           Initializes poller
+ * @param poller    Pointer to poller structure
+ * @param queue     Queue of the bus (and its timer wheel)
+ * @return int16_t  0 if OK, -2 wrong params
+ */
+int16_t ModPollerInit(modPoller_t* poller, modMasterQueue_t* queue);
+
+/**
+ * @brief           Starts polling of items, all of them are due now
+ * @param poller    Pointer to poller structure
+ * @param items     Items, have to stay valid while poller runs
+ * @param numItems  Number of items
+ * @return int16_t  0 if OK, -1 poller is running, -2 wrong params (wrong operation / registers, zero period)
+ */
+int16_t ModPollerStart(modPoller_t* poller, modPollItem_t* items, uint16_t numItems);
+
+/**
+ * @brief           Stops polling, waiting reads are cancelled, read on the bus finishes silently
+ * @param poller    Pointer to poller structure
+ */
+void ModPollerStop(modPoller_t* poller);
+
+/**
+ * @brief           Percentile of rolling history
+ * @param hist      History of intervals
+ * @param percent   Percentile 0 - 100 (50 = median)
+ * @return uint32_t Interval [ms], 0 if history is empty
+ */
+uint32_t ModPollPercentile(const modPollHist_t* hist, uint8_t percent);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_POLLER_H */
@@ -0,0 +1,280 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "mod_port_linux.h"
+
+uint32_t ModPortTimeMs(void)
+{
+    return (uint32_t)(ModPortTimeUs() / 1000u);
+}
+
+uint64_t ModPortTimeUs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static speed_t ModPortBaudToSpeed(uint32_t baud)
+{
+    switch (baud)
+    {
+        case 1200:      return B1200;
+        case 2400:      return B2400;
+        case 4800:      return B4800;
+        case 9600:      return B9600;
+        case 19200:     return B19200;
+        case 38400:     return B38400;
+        case 57600:     return B57600;
+        case 115200:    return B115200;
+        case 230400:    return B230400;
+#ifdef B460800
+        case 460800:    return B460800;
+#endif
+#ifdef B921600
+        case 921600:    return B921600;
+#endif
+        default:        return B0;
+    }
+}
+
+int16_t ModPortSetRaw(int fd, uint32_t baud, char parity)
+{
+    struct termios tio;
+    speed_t speed = B0;
+
+    if (baud != 0)
+    {
+        speed = ModPortBaudToSpeed(baud);
+        if (speed == B0)
+        {
+            return -2; // unsupported baud rate
+        }
+    }
+    if (parity != 'N' && parity != 'E' && parity != 'O')
+    {
+        return -2; // wrong params
+    }
+
+    if (tcgetattr(fd, &tio) < 0)
+    {
+        return -1;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~(PARENB | PARODD | CSTOPB);
+    if (parity != 'N')
+    {
+        tio.c_cflag |= PARENB | (parity == 'O' ? PARODD : 0);
+    }
+    else
+    {
+        tio.c_cflag |= CSTOPB; // RTU: no parity = 2 stop bits
+    }
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    if (speed != B0)
+    {
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+    }
+    if (tcsetattr(fd, TCSANOW, &tio) < 0)
+    {
+        return -1;
+    }
+
+    return (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0) ? -1 : 0;
+}
+
+int ModPortOpenSerial(const char* device, uint32_t baud, char parity)
+{
+    int fd;
+    int16_t r;
+
+    if (device == NULL)
+    {
+        return -2; // wrong params
+    }
+
+    fd = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    r = ModPortSetRaw(fd, baud, parity);
+    if (r < 0)
+    {
+        close(fd);
+        return r;
+    }
+
+    return fd;
+}
+
+uint32_t ModPortCharTimeUs(uint32_t baud)
+{
+    return ModMasterCharTimeUs(baud);
+}
+
+uint32_t ModPortFrameGapUs(uint32_t baud)
+{
+    return ModMasterFrameGapUs(baud);
+}
+
+/***** transport *****/
+
+static int16_t ModPortWrite(modPortLink_t* link, const uint8_t* data, uint16_t length)
+{
+    while (length > 0)
+    {
+        ssize_t r = write(link->fd, data, length);
+
+        if (r < 0)
+        {
+            struct pollfd pfd = { link->fd, POLLOUT, 0 };
+
+            if (errno != EAGAIN && errno != EINTR)
+            {
+                return -1;
+            }
+            (void)poll(&pfd, 1, 100);
+            continue;
+        }
+        data += r;
+        length -= (uint16_t)r;
+    }
+    if (link->drain && tcdrain(link->fd) < 0)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int16_t ModPortMasterSend(modMasterStack_t* mstack, const uint8_t* data, uint16_t length)
+{
+    if (ModPortWrite((modPortLink_t*)mstack->userContent, data, length) < 0)
+    {
+        return -1;
+    }
+    ModMasterTxDoneCallback(mstack); // write is synchronous
+
+    return 0;
+}
+
+static int16_t ModPortMasterReceive(modMasterStack_t* mstack)
+{
+    ModStreamFlush(&((modPortLink_t*)mstack->userContent)->framer); // forget late answers of previous command
+    return 0;
+}
+
+static void ModPortMasterFrame(modStreamFramer_t* framer, const uint8_t* frame, uint16_t length, modFrameDir_t dir)
+{
+    modPortLink_t* link = (modPortLink_t*)framer->userContent;
+
+    (void)dir;
+    ModMasterRxDoneCallback((modMasterStack_t*)link->stack, frame, length);
+}
+
+static int16_t ModPortSlaveStandby(modSlaveStack_t* mstack)
+{
+    (void)mstack;
+    return 0; // receiver is always on, framer keeps pending bytes
+}
+
+static int16_t ModPortSlaveSendAns(modSlaveStack_t* mstack, const uint8_t* data, uint16_t length)
+{
+    if (ModPortWrite((modPortLink_t*)mstack->userContent, data, length) < 0)
+    {
+        return -1;
+    }
+    ModSlaveTxDoneCallback(mstack); // write is synchronous
+
+    return 0;
+}
+
+static void ModPortSlaveFrame(modStreamFramer_t* framer, const uint8_t* frame, uint16_t length, modFrameDir_t dir)
+{
+    modPortLink_t* link = (modPortLink_t*)framer->userContent;
+    modSlaveStack_t* slave = (modSlaveStack_t*)link->stack;
+
+    (void)dir;
+    if (slave->status == eMOD_S_STATE_STANDBY)
+    {
+        slave->status = eMOD_S_STATE_RECEIVING; // receiver is always on
+    }
+    ModSlaveRxDoneCallback(slave, frame, length);
+    (void)ModSlaveCheck(slave); // answer before next frame overwrites the message
+}
+
+static int16_t ModPortLinkInit(modPortLink_t* link, void* stack, int fd, pfModStreamFrame_t pfFrame, modStreamMode_t mode)
+{
+    if (link == NULL || stack == NULL || fd < 0)
+    {
+        return -2; // wrong params
+    }
+    link->fd = fd;
+    link->stack = stack;
+    memset(&link->framer, 0, sizeof(link->framer));
+    link->framer.userContent = link;
+    link->framer.pfFrame = pfFrame;
+
+    return ModStreamInit(&link->framer, mode);
+}
+
+int16_t ModPortMasterAttach(modPortLink_t* link, modMasterStack_t* mstack, int fd)
+{
+    if (ModPortLinkInit(link, mstack, fd, &ModPortMasterFrame, eMOD_STREAM_RESPONSES) < 0)
+    {
+        return -2;
+    }
+    mstack->userContent = link;
+    mstack->pfSend = &ModPortMasterSend;
+    mstack->pfReceive = &ModPortMasterReceive;
+
+    return 0;
+}
+
+int16_t ModPortSlaveAttach(modPortLink_t* link, modSlaveStack_t* mstack, int fd)
+{
+    if (ModPortLinkInit(link, mstack, fd, &ModPortSlaveFrame, eMOD_STREAM_REQUESTS) < 0)
+    {
+        return -2;
+    }
+    mstack->userContent = link;
+    mstack->pfStandby = &ModPortSlaveStandby;
+    mstack->pfSendAns = &ModPortSlaveSendAns;
+
+    return 0;
+}
+
+int16_t ModPortPoll(modPortLink_t* link, int timeoutMs)
+{
+    struct pollfd pfd = { link->fd, POLLIN, 0 };
+    uint8_t buf[512];
+    int16_t frames = 0;
+    ssize_t r;
+
+    if (poll(&pfd, 1, timeoutMs) <= 0)
+    {
+        return 0;
+    }
+    while ((r = read(link->fd, buf, sizeof(buf))) > 0)
+    {
+        frames += (int16_t)ModStreamFeed(&link->framer, buf, (uint32_t)r);
+    }
+    if (r < 0 && errno != EAGAIN && errno != EINTR)
+    {
+        return -1;
+    }
+
+    return frames;
+}
@@ -0,0 +1,104 @@
+/**
+ * @file    mod_port_linux.h
+ * @brief   Linux port of Modbus RTU stacks: monotonic time, serial line (tty / pty) setup and transport binding
+ *          master / slave stack to file descriptor. Received bytes are framed by @ref mod_stream_rtu.h, so the
+ *          transport works with USB adapters and ptys where the 3.5 character gap can't be observed.
+ * @note    Build with -DMODBUS_PORT_LINUX.
+ */
+
+#ifndef SYSTEM_MOD_PORT_LINUX_H
+#define SYSTEM_MOD_PORT_LINUX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef MODBUS_PORT_LINUX
+#error "mod_port_linux.h requires MODBUS_PORT_LINUX to be defined"
+#endif
+
+#include <stdint.h>
+#include "mod_time_linux.h"
+#include "mod_master_rtu.h"
+#include "mod_slave_rtu.h"
+#include "mod_stream_rtu.h"
+
+/**
+ * @brief   Transport link between one stack and file descriptor. Link occupies userContent of the stack,
+ *          use userContent of the link instead.
+ */
+typedef struct
+{
+    void*                       userContent;    ///< user defined pointer, can by used to pass anything
+    int                         fd;             ///< tty / pty descriptor in non-blocking mode
+    uint8_t                     drain;          ///< wait until bytes leave UART before reporting Tx done (real RS-485)
+    void*                       stack;          ///< attached master or slave stack
+    modStreamFramer_t           framer;         ///< receiver
+} modPortLink_t;
+
+/**
+ * @brief           Opens serial device in raw non-blocking mode
+ * @param device    Path to tty device, e.g. "/dev/ttyUSB0"
+ * @param baud      Baud rate
+ * @param parity    'N', 'E' or 'O'
+ * @return int      File descriptor, -1 if device can't be opened, -2 wrong params
+ */
+int ModPortOpenSerial(const char* device, uint32_t baud, char parity);
+
+/**
+ * @brief           Switches already opened descriptor (tty or pty) to raw non-blocking mode
+ * @param fd        File descriptor
+ * @param baud      Baud rate, 0 to keep current (e.g. for pty)
+ * @param parity    'N', 'E' or 'O'
+ * @return int16_t  0 if OK, -1 if fd can't be configured, -2 wrong params
+ */
+int16_t ModPortSetRaw(int fd, uint32_t baud, char parity);
+
+/**
+ * @brief           Duration of one character on the line, same as @ref ModMasterCharTimeUs()
+ * @param baud      Baud rate
+ * @return uint32_t Character time in microseconds
+ */
+uint32_t ModPortCharTimeUs(uint32_t baud);
+
+/**
+ * @brief           Minimum silent interval between frames, same as @ref ModMasterFrameGapUs()
+ * @param baud      Baud rate
+ * @return uint32_t Inter-frame gap in microseconds
+ */
+uint32_t ModPortFrameGapUs(uint32_t baud);
+
+/**
+ * @brief           Binds master stack to file descriptor: sets pfSend, pfReceive and userContent of the stack.
+ *                  Call @ref ModMasterInit() afterwards.
+ * @param link      Pointer to link structure
+ * @param mstack    Pointer to master stack
+ * @param fd        Descriptor in raw non-blocking mode
+ * @return int16_t  0 if OK, -2 wrong params
+ */
+int16_t ModPortMasterAttach(modPortLink_t* link, modMasterStack_t* mstack, int fd);
+
+/**
+ * @brief           Binds slave stack to file descriptor: sets pfStandby, pfSendAns and userContent of the stack.
+ *                  Call @ref ModSlaveInit() afterwards.
+ * @param link      Pointer to link structure
+ * @param mstack    Pointer to slave stack
+ * @param fd        Descriptor in raw non-blocking mode
+ * @return int16_t  0 if OK, -2 wrong params
+ */
+int16_t ModPortSlaveAttach(modPortLink_t* link, modSlaveStack_t* mstack, int fd);
+
+/**
+ * @brief           Waits for incoming bytes and passes complete frames to the attached stack.
+ *                  Call @ref ModMasterCheck() / @ref ModSlaveCheck() afterwards.
+ * @param link      Pointer to link structure
+ * @param timeoutMs Maximum waiting time, 0 = don't wait, -1 = forever
+ * @return int16_t  Number of frames passed to the stack, -1 if read fails
+ */
+int16_t ModPortPoll(modPortLink_t* link, int timeoutMs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_PORT_LINUX_H */
@@ -0,0 +1,300 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mod_profile.h"
+#include "mod_textout.h"
+
+#define MODBUS_OPCODE_READ_OUT_REGS     0x03
+#define MODBUS_OPCODE_READ_INP_REGS     0x04
+#define MODBUS_OPCODE_WRITE_MULTI_REGS  0x10
+
+// limits found in real devices, learning tries them from the largest one
+static const uint8_t modProfileLadder[] = { 100, 64, 50, 32, 16, 10, 8, 4, 2, 1 };
+
+void ModProfileInit(modProfileTable_t* table)
+{
+    memset(table->slaves, 0, sizeof(table->slaves));
+}
+
+uint16_t ModProfileMaxRead(const modProfile_t* profile)
+{
+    return (profile != NULL && profile->maxRead > 0 && profile->maxRead < MODBUS_MAX_READ_REGS) ?
+           profile->maxRead : MODBUS_MAX_READ_REGS;
+}
+
+uint16_t ModProfileMaxWrite(const modProfile_t* profile)
+{
+    return (profile != NULL && profile->maxWrite > 0 && profile->maxWrite < MODBUS_MAX_WRITE_REGS) ?
+           profile->maxWrite : MODBUS_MAX_WRITE_REGS;
+}
+
+uint8_t ModProfileSupports(const modProfile_t* profile, uint8_t opCode)
+{
+    opCode &= 0x7F;
+
+    return (profile == NULL || !(profile->unsupported[opCode >> 3] & (1u << (opCode & 7)))) ? 1 : 0;
+}
+
+// next smaller limit to try after num was refused, never below largest successful count
+static uint8_t ModProfileShrink(uint16_t num, uint8_t ok)
+{
+    uint8_t i;
+
+    for (i = 0; i < sizeof(modProfileLadder) - 1 && modProfileLadder[i] >= num; i++)
+    {
+        ;
+    }
+
+    return modProfileLadder[i] > ok ? modProfileLadder[i] : ok;
+}
+
+int16_t ModProfileLearn(modProfileTable_t* table, uint8_t slaveAddr, uint8_t opCode, uint16_t num,
+                        modMasterState_t status, uint8_t errCode)
+{
+    modProfile_t* profile;
+    uint8_t isRead = (opCode == MODBUS_OPCODE_READ_OUT_REGS || opCode == MODBUS_OPCODE_READ_INP_REGS);
+    uint8_t isWrite = (opCode == MODBUS_OPCODE_WRITE_MULTI_REGS);
+    uint8_t limit;
+
+    if (slaveAddr >= MODBUS_PROFILE_SLAVES)
+    {
+        return 0;
+    }
+    profile = &table->slaves[slaveAddr];
+
+    if (status == eMOD_M_STATE_PROCESSED)
+    {
+        if (isRead && num > profile->okRead)
+        {
+            profile->okRead = (uint8_t)num;
+        }
+        if (isWrite && num > profile->okWrite)
+        {
+            profile->okWrite = (uint8_t)num;
+        }
+        return 0;
+    }
+    if (status != eMOD_M_STATE_ERR_REPORTED)
+    {
+        return 0;
+    }
+
+    if (errCode == MODBUS_ERR_ILLEGAL_VALUE && num > 1 && (isRead || isWrite))
+    {
+        // too many registers at once
+        if (isRead && num > profile->okRead)
+        {
+            limit = ModProfileShrink(num, profile->okRead);
+            if (limit < ModProfileMaxRead(profile))
+            {
+                profile->maxRead = limit;
+                return 1;
+            }
+        }
+        if (isWrite && num > profile->okWrite)
+        {
+            limit = ModProfileShrink(num, profile->okWrite);
+            if (limit < ModProfileMaxWrite(profile))
+            {
+                profile->maxWrite = limit;
+                return 1;
+            }
+        }
+    }
+    else if (errCode == MODBUS_ERR_ILLEGAL_OPCODE)
+    {
+        if (isWrite && num > 1 && profile->okWrite <= 1)
+        {
+            // some devices implement 0x10 for single register only
+            profile->maxWrite = 1;
+            return 1;
+        }
+        if (ModProfileSupports(profile, opCode))
+        {
+            profile->unsupported[(opCode & 0x7F) >> 3] |= (uint8_t)(1u << (opCode & 7));
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// parse "key=value", returns pointer behind the value or NULL
+static const char* ModProfileValue(const char* p, const char* key, unsigned long* value)
+{
+    size_t len = strlen(key);
+    char* end;
+
+    if (strncmp(p, key, len) != 0 || p[len] != '=')
+    {
+        return NULL;
+    }
+    *value = strtoul(p + len + 1, &end, 0);
+
+    return end == p + len + 1 ? NULL : end;
+}
+
+// parse one line (without comment), returns 1 loaded, 0 empty, -1 wrong
+static int16_t ModProfileLine(modProfileTable_t* table, const char* p, const char* end)
+{
+    modProfile_t profile;
+    unsigned long v;
+    char* next;
+    unsigned long addr;
+
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+    {
+        p++;
+    }
+    if (p == end)
+    {
+        return 0;
+    }
+    addr = strtoul(p, &next, 0);
+    if (next == p || addr >= MODBUS_PROFILE_SLAVES)
+    {
+        return -1;
+    }
+    p = next;
+    memset(&profile, 0, sizeof(profile));
+
+    for (;;)
+    {
+        const char* q;
+
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        {
+            p++;
+        }
+        if (p >= end)
+        {
+            break;
+        }
+        if ((q = ModProfileValue(p, "read", &v)) != NULL && v <= 255)
+        {
+            profile.maxRead = (uint8_t)v;
+        }
+        else if ((q = ModProfileValue(p, "write", &v)) != NULL && v <= 255)
+        {
+            profile.maxWrite = (uint8_t)v;
+        }
+        else if ((q = ModProfileValue(p, "gap", &v)) != NULL && v <= 255)
+        {
+            profile.gapMs = (uint8_t)v;
+        }
+        else if ((q = ModProfileValue(p, "turnaround", &v)) != NULL && v <= 255)
+        {
+            profile.turnaroundMs = (uint8_t)v;
+        }
+        else if ((q = ModProfileValue(p, "no", &v)) != NULL && v <= 127)
+        {
+            // list of function codes
+            for (;;)
+            {
+                profile.unsupported[v >> 3] |= (uint8_t)(1u << (v & 7));
+                if (*q != ',')
+                {
+                    break;
+                }
+                v = strtoul(q + 1, &next, 0);
+                if (next == q + 1 || v > 127)
+                {
+                    return -1;
+                }
+                q = next;
+            }
+        }
+        else
+        {
+            return -1;
+        }
+        if (q > end || (q < end && *q != ' ' && *q != '\t' && *q != '\r'))
+        {
+            return -1;
+        }
+        p = q;
+    }
+
+    table->slaves[addr] = profile;
+
+    return 1;
+}
+
+int32_t ModProfileParse(modProfileTable_t* table, const char* text)
+{
+    int32_t loaded = 0;
+    int32_t line = 1;
+
+    while (*text != '\0')
+    {
+        const char* eol = strchr(text, '\n');
+        const char* comment;
+        int16_t r;
+
+        if (eol == NULL)
+        {
+            eol = text + strlen(text);
+        }
+        comment = memchr(text, '#', (size_t)(eol - text));
+        r = ModProfileLine(table, text, comment != NULL ? comment : eol);
+        if (r < 0)
+        {
+            return -line;
+        }
+        loaded += r;
+        line++;
+        text = *eol == '\n' ? eol + 1 : eol;
+    }
+
+    return loaded;
+}
+
+int32_t ModProfileFormat(const modProfileTable_t* table, char* buf, uint32_t size)
+{
+    modTextOut_t out = { buf, size, 0, 0 };
+    static const modProfile_t empty;
+
+    for (uint16_t a = 0; a < MODBUS_PROFILE_SLAVES; a++)
+    {
+        const modProfile_t* profile = &table->slaves[a];
+        const char* sep = " no=";
+
+        if (!profile->maxRead && !profile->maxWrite && !profile->gapMs && !profile->turnaroundMs &&
+            memcmp(profile->unsupported, empty.unsupported, sizeof(empty.unsupported)) == 0)
+        {
+            continue; // nothing known
+        }
+        ModTextOutPrintf(&out, "%u", a);
+        if (profile->maxRead)
+        {
+            ModTextOutPrintf(&out, " read=%u", profile->maxRead);
+        }
+        if (profile->maxWrite)
+        {
+            ModTextOutPrintf(&out, " write=%u", profile->maxWrite);
+        }
+        if (profile->gapMs)
+        {
+            ModTextOutPrintf(&out, " gap=%u", profile->gapMs);
+        }
+        if (profile->turnaroundMs)
+        {
+            ModTextOutPrintf(&out, " turnaround=%u", profile->turnaroundMs);
+        }
+        for (uint8_t fc = 0; fc < 128; fc++)
+        {
+            if (!ModProfileSupports(profile, fc))
+            {
+                ModTextOutPrintf(&out, "%s%u", sep, fc);
+                sep = ",";
+            }
+        }
+        ModTextOutPrintf(&out, "\n");
+    }
+    if (size > 0 && out.len == 0)
+    {
+        buf[0] = '\0';
+    }
+
+    return out.overflow ? -1 : (int32_t)out.len;
+}
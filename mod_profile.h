@@ -0,0 +1,116 @@
+/**
+ * @file    mod_profile.h
+ * @brief   Capability profiles of slave devices - max. registers per read / write, unsupported function codes,
+ *          extra silence before next request and extra answer time. Limits are learned from exception
+ *          responses (@ref ModProfileLearn()), all fields can be preloaded from text definition
+ *          (@ref ModProfileParse()) and learned state saved back (@ref ModProfileFormat()).
+ *
+ *          Text definition, one slave per line, keys are optional, '#' starts comment:
+ * @code
+ *          # addr  read=max  write=max  gap=ms  turnaround=ms  no=fc,fc
+ *          12 read=32 write=1
+ *          40 read=64 gap=5 turnaround=30 no=8
+ * @endcode
+ *
+ *          @ref mod_master_req.h learns and applies profiles when queue->profiles is set, @ref mod_plan.h
+ *          splits and merges reads by them.
+ */
+
+#ifndef SYSTEM_MOD_PROFILE_H
+#define SYSTEM_MOD_PROFILE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "mod_master_rtu.h"
+
+#define MODBUS_PROFILE_SLAVES       248     ///< slave addresses 0 - 247
+
+/**
+ * @brief   Profile of one slave, zeroed profile = no known limits
+ */
+typedef struct
+{
+    uint8_t                     maxRead;        ///< max. registers per read, 0 = MODBUS_MAX_READ_REGS
+    uint8_t                     maxWrite;       ///< max. registers per write, 0 = MODBUS_MAX_WRITE_REGS
+    uint8_t                     okRead;         ///< largest read seen successful (learning never goes below)
+    uint8_t                     okWrite;        ///< largest write seen successful
+    uint8_t                     gapMs;          ///< extra silence before next request
+    uint8_t                     turnaroundMs;   ///< extra answer time over MODBUS_RX_TIMEOUT
+    uint8_t                     unsupported[16];    ///< bitmap of function codes 0 - 127 reported as illegal
+} modProfile_t;
+
+/**
+ * @brief   Profiles of all slaves of one bus
+ */
+typedef struct
+{
+    modProfile_t                slaves[MODBUS_PROFILE_SLAVES];
+    void*                       userContent;    ///< user defined pointer, can by used to pass anything
+} modProfileTable_t;
+
+/**
+ * @brief           Clears all profiles (no known limits)
+ * @param table     Pointer to profile table
+ */
+void ModProfileInit(modProfileTable_t* table);
+
+/**
+ * @brief           Learns from result of finished operation
+ * @param table     Pointer to profile table
+ * @param slaveAddr Slave address
+ * @param opCode    Function code of request
+ * @param num       Number of registers of read / write
+ * @param status    Status reported by @ref ModMasterCheck()
+ * @param errCode   Exception code, if status is eMOD_M_STATE_ERR_REPORTED
+ * @return int16_t  1 if profile was changed (request may be repeated with new limits), 0 otherwise
+ */
+int16_t ModProfileLearn(modProfileTable_t* table, uint8_t slaveAddr, uint8_t opCode, uint16_t num,
+                        modMasterState_t status, uint8_t errCode);
+
+/**
+ * @brief           Max. registers per read of slave
+ * @param profile   Profile of slave, can be NULL
+ * @return uint16_t Limit, MODBUS_MAX_READ_REGS if not known
+ */
+uint16_t ModProfileMaxRead(const modProfile_t* profile);
+
+/**
+ * @brief           Max. registers per write of slave
+ * @param profile   Profile of slave, can be NULL
+ * @return uint16_t Limit, MODBUS_MAX_WRITE_REGS if not known
+ */
+uint16_t ModProfileMaxWrite(const modProfile_t* profile);
+
+/**
+ * @brief           Tells if function code is supported by slave (not reported as illegal)
+ * @param profile   Profile of slave, can be NULL
+ * @param opCode    Function code
+ * @return uint8_t  1 supported or unknown, 0 reported as illegal
+ */
+uint8_t ModProfileSupports(const modProfile_t* profile, uint8_t opCode);
+
+/**
+ * @brief           Preloads profiles from text definition (see file description)
+ * @param table     Pointer to profile table
+ * @param text      Zero terminated text
+ * @return int32_t  Number of loaded slaves, -(line number) of first wrong line (lines above it are loaded)
+ */
+int32_t ModProfileParse(modProfileTable_t* table, const char* text);
+
+/**
+ * @brief           Writes all non-empty profiles as text definition
+ * @param table     Pointer to profile table
+ * @param buf       Output buffer
+ * @param size      Size of output buffer
+ * @return int32_t  Length of text (without terminating zero), -1 if buffer is too small
+ */
+int32_t ModProfileFormat(const modProfileTable_t* table, char* buf, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_PROFILE_H */
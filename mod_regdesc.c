@@ -0,0 +1,267 @@
+#include <stdio.h>
+#include <string.h>
+#include "mod_regdesc.h"
+
+// table of n items of given size at offset lies inside of image and is aligned
+static uint8_t ModRegDescTableOk(uint32_t size, uint32_t offset, uint32_t n, uint32_t item)
+{
+    return (offset % 4) == 0 && offset <= size && (uint64_t)n * item <= size - offset;
+}
+
+int16_t ModRegDescOpen(modRegDesc_t* desc, const void* image, uint32_t size)
+{
+    const uint8_t* base = (const uint8_t*)image;
+    const modRegDescHeader_t* h = (const modRegDescHeader_t*)image;
+
+    if (image == NULL || ((uintptr_t)image % 4) != 0 || size < sizeof(modRegDescHeader_t) ||
+        h->magic != MODBUS_REGDESC_MAGIC || h->version != MODBUS_REGDESC_VERSION || h->size > size ||
+        !ModRegDescTableOk(h->size, h->devices, h->numDevices, sizeof(modRegDescDevice_t)) ||
+        !ModRegDescTableOk(h->size, h->regions, h->numRegions, sizeof(modRegDescRegion_t)) ||
+        !ModRegDescTableOk(h->size, h->defaults, h->numDefaults, sizeof(uint16_t)) ||
+        !ModRegDescTableOk(h->size, h->strings, h->stringsSize, 1) ||
+        h->stringsSize == 0 || base[h->strings + h->stringsSize - 1] != '\0')
+    {
+        return -2; // wrong image
+    }
+
+    desc->header = h;
+    desc->devices = (const modRegDescDevice_t*)(base + h->devices);
+    desc->regions = (const modRegDescRegion_t*)(base + h->regions);
+    desc->defaults = (const uint16_t*)(base + h->defaults);
+    desc->strings = (const char*)(base + h->strings);
+    desc->size = size;
+
+    // indexes are checked once here, accessors can trust them
+    for (uint16_t d = 0; d < h->numDevices; d++)
+    {
+        const modRegDescDevice_t* dev = &desc->devices[d];
+
+        if (dev->name >= h->stringsSize || (uint64_t)dev->firstRegion + dev->numRegions > h->numRegions)
+        {
+            return -2;
+        }
+    }
+    for (uint32_t r = 0; r < h->numRegions; r++)
+    {
+        const modRegDescRegion_t* reg = &desc->regions[r];
+        uint16_t width = ModRegDescWidth(reg->type);
+
+        if (width == 0 || reg->count == 0 || reg->count % width != 0 || (uint32_t)reg->first + reg->count > 0x10000 ||
+            reg->name >= h->stringsSize || (uint64_t)reg->defaults + reg->count > h->numDefaults)
+        {
+            return -2;
+        }
+    }
+
+    return 0;
+}
+
+int32_t ModRegDescFind(const modRegDesc_t* desc, const char* name)
+{
+    int32_t lo = 0;
+    int32_t hi = (int32_t)desc->header->numDevices - 1;
+
+    while (lo <= hi)
+    {
+        int32_t mid = (lo + hi) / 2;
+        int c = strcmp(name, desc->strings + desc->devices[mid].name);
+
+        if (c == 0)
+        {
+            return mid;
+        }
+        if (c < 0)
+        {
+            hi = mid - 1;
+        }
+        else
+        {
+            lo = mid + 1;
+        }
+    }
+
+    return -1;
+}
+
+const char* ModRegDescName(const modRegDesc_t* desc, uint32_t offset)
+{
+    return desc->strings + (offset < desc->header->stringsSize ? offset : 0);
+}
+
+uint16_t ModRegDescWidth(uint8_t type)
+{
+    switch (type)
+    {
+    case eMOD_REGTYPE_U16:
+    case eMOD_REGTYPE_S16:
+        return 1;
+    case eMOD_REGTYPE_U32:
+    case eMOD_REGTYPE_S32:
+    case eMOD_REGTYPE_F32:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+int32_t ModRegDescRegMap(const modRegDesc_t* desc, uint16_t device, modRegRegion_t* regions, uint16_t maxRegions,
+                         uint16_t* values, modRegMap_t* map)
+{
+    const modRegDescDevice_t* dev;
+    uint16_t n = 0;
+    uint32_t used = 0;
+
+    if (device >= desc->header->numDevices || regions == NULL || values == NULL || map == NULL)
+    {
+        return -2; // wrong params
+    }
+
+    dev = &desc->devices[device];
+    for (uint16_t i = 0; i < dev->numRegions; i++)
+    {
+        const modRegDescRegion_t* r = &desc->regions[dev->firstRegion + i];
+
+        if (r->flags & MODBUS_REGDESC_INPUT)
+        {
+            break; // input regions follow holding ones
+        }
+        if (n >= maxRegions || used + r->count > dev->numRegs)
+        {
+            return -1; // storage too small
+        }
+        regions[n].first = r->first;
+        regions[n].count = r->count;
+        regions[n].flags = r->flags & MODBUS_REGMAP_READONLY;
+        regions[n].values = &values[used];
+        memcpy(&values[used], &desc->defaults[r->defaults], r->count * sizeof(uint16_t));
+        used += r->count;
+        n++;
+    }
+
+    map->regions = regions;
+    map->numRegions = n;
+
+    return ModRegMapInit(map);
+}
+
+int16_t ModRegDescRegionMap(const modRegDesc_t* desc, uint16_t device, uint8_t input, modRegionMap_t* map)
+{
+    const modRegDescDevice_t* dev;
+    uint8_t space = input ? MODBUS_REGDESC_INPUT : 0;
+    uint16_t n = 0;
+
+    if (device >= desc->header->numDevices || map == NULL)
+    {
+        return -2; // wrong params
+    }
+
+    dev = &desc->devices[device];
+    map->input = input ? 1 : 0;
+    map->complete = 0;
+    for (uint16_t i = 0; i < dev->numRegions; i++)
+    {
+        const modRegDescRegion_t* r = &desc->regions[dev->firstRegion + i];
+        uint16_t last = (uint16_t)(r->first + r->count - 1);
+
+        if ((r->flags & MODBUS_REGDESC_INPUT) != space)
+        {
+            continue;
+        }
+        if (n > 0 && (uint32_t)map->regions[n - 1].last + 1 == r->first)
+        {
+            map->regions[n - 1].last = last; // touching
+            continue;
+        }
+        if (n >= MODBUS_REGION_MAX)
+        {
+            map->numRegions = n;
+            return -1; // map too small
+        }
+        map->regions[n].first = r->first;
+        map->regions[n].last = last;
+        n++;
+    }
+    map->numRegions = n;
+    map->complete = 1;
+
+    return (int16_t)n;
+}
+
+const modRegDescRegion_t* ModRegDescRegion(const modRegDesc_t* desc, uint16_t device, uint8_t input, uint16_t regAddr)
+{
+    const modRegDescDevice_t* dev;
+    uint8_t space = input ? MODBUS_REGDESC_INPUT : 0;
+    int32_t lo;
+    int32_t hi;
+
+    if (device >= desc->header->numDevices)
+    {
+        return NULL;
+    }
+    dev = &desc->devices[device];
+    lo = 0;
+    hi = (int32_t)dev->numRegions - 1;
+
+    // regions are sorted by (space, first)
+    while (lo <= hi)
+    {
+        int32_t mid = (lo + hi) / 2;
+        const modRegDescRegion_t* r = &desc->regions[dev->firstRegion + mid];
+        uint8_t rSpace = r->flags & MODBUS_REGDESC_INPUT;
+
+        if (rSpace > space || (rSpace == space && regAddr < r->first))
+        {
+            hi = mid - 1;
+        }
+        else if (rSpace < space || (uint32_t)regAddr >= (uint32_t)r->first + r->count)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            return r;
+        }
+    }
+
+    return NULL;
+}
+
+int16_t ModRegDescDecode(const modRegDescRegion_t* region, const uint16_t* regs, uint16_t first, uint16_t num,
+                         double* values)
+{
+    uint16_t width = ModRegDescWidth(region->type);
+
+    if (width == 0 || regs == NULL || values == NULL || ((uint32_t)first + num) * width > region->count)
+    {
+        return -2; // wrong params
+    }
+
+    for (uint16_t i = 0; i < num; i++)
+    {
+        const uint16_t* v = &regs[(first + i) * width];
+        uint32_t u32;
+        float f;
+
+        if (width == 1)
+        {
+            values[i] = (region->type == eMOD_REGTYPE_S16) ? (double)(int16_t)v[0] : (double)v[0];
+            continue;
+        }
+        u32 = (region->flags & MODBUS_REGDESC_SWAP) ? ((uint32_t)v[1] << 16) | v[0] : ((uint32_t)v[0] << 16) | v[1];
+        switch (region->type)
+        {
+        case eMOD_REGTYPE_S32:
+            values[i] = (double)(int32_t)u32;
+            break;
+        case eMOD_REGTYPE_F32:
+            memcpy(&f, &u32, sizeof(f));
+            values[i] = (double)f;
+            break;
+        default:
+            values[i] = (double)u32;
+            break;
+        }
+    }
+
+    return 0;
+}
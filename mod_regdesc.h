@@ -0,0 +1,183 @@
+/**
+ * @file    mod_regdesc.h
+ * @brief   Binary register-map descriptors. Register definitions of many device types (regions of holding / input
+ *          registers with value type, access flags, name and default values) are compiled offline
+ *          (tools/modregc) into one image, which is used in place - mmap'd file (@ref mod_regdesc_linux.h) or
+ *          const array in flash. @ref ModRegDescOpen() only checks bounds of the tables (no parsing, no allocation),
+ *          so loading thousands of device types takes microseconds.
+ *
+ *          Image feeds both sides of the stack: slave register map (@ref ModRegDescRegMap(), regions and values
+ *          initialized by defaults), readable regions for read-coalescing planner (@ref ModRegDescRegionMap()) and
+ *          decoding of read registers to typed values (@ref ModRegDescDecode()).
+ *
+ *          Image layout (little-endian, tables 4-byte aligned): header, devices sorted by name, regions of each
+ *          device sorted by space (holding first) and address, default values (registers, in bus order), names.
+ */
+
+#ifndef SYSTEM_MOD_REGDESC_H
+#define SYSTEM_MOD_REGDESC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "mod_regmap.h"
+#include "mod_regscan.h"
+
+#define MODBUS_REGDESC_MAGIC        0x4244524Du     ///< "MRDB"
+#define MODBUS_REGDESC_VERSION      1
+
+/**
+ * @defgroup ModbusRegDescFlags Region flags
+ * @{
+ */
+#define MODBUS_REGDESC_READONLY     MODBUS_REGMAP_READONLY  ///< writes are refused
+#define MODBUS_REGDESC_INPUT        0x02    ///< input registers (0x04), holding registers (0x03 / 0x10) otherwise
+#define MODBUS_REGDESC_SWAP         0x04    ///< multi-register values have low word first
+/** @} */
+
+/** Type of values in region */
+typedef enum
+{
+    eMOD_REGTYPE_U16,
+    eMOD_REGTYPE_S16,
+    eMOD_REGTYPE_U32,
+    eMOD_REGTYPE_S32,
+    eMOD_REGTYPE_F32,
+    eMOD_REGTYPE_COUNT
+} modRegType_t;
+
+/** Image header */
+typedef struct
+{
+    uint32_t                    magic;          ///< MODBUS_REGDESC_MAGIC
+    uint16_t                    version;        ///< MODBUS_REGDESC_VERSION
+    uint16_t                    numDevices;
+    uint32_t                    size;           ///< size of whole image
+    uint32_t                    numRegions;
+    uint32_t                    devices;        ///< offset of device table
+    uint32_t                    regions;        ///< offset of region table
+    uint32_t                    defaults;       ///< offset of default values
+    uint32_t                    numDefaults;    ///< number of default values (registers)
+    uint32_t                    strings;        ///< offset of names
+    uint32_t                    stringsSize;
+} modRegDescHeader_t;
+
+/** Device type */
+typedef struct
+{
+    uint32_t                    name;           ///< offset in names
+    uint32_t                    firstRegion;    ///< index of first region
+    uint16_t                    numRegions;
+    uint16_t                    numRegs;        ///< registers of all holding regions (size of slave storage)
+    uint32_t                    reserved;
+} modRegDescDevice_t;
+
+/** Region of registers, count is multiple of width of type */
+typedef struct
+{
+    uint16_t                    first;          ///< address of first register
+    uint16_t                    count;          ///< number of registers
+    uint8_t                     type;           ///< @ref modRegType_t
+    uint8_t                     flags;          ///< see @ref ModbusRegDescFlags
+    uint16_t                    reserved;
+    uint32_t                    name;           ///< offset in names
+    uint32_t                    defaults;       ///< index of first default value (count registers)
+} modRegDescRegion_t;
+
+/** Opened image, all pointers point into it */
+typedef struct
+{
+    const modRegDescHeader_t*   header;
+    const modRegDescDevice_t*   devices;
+    const modRegDescRegion_t*   regions;
+    const uint16_t*             defaults;
+    const char*                 strings;
+    uint32_t                    size;           ///< size of image (as passed to open)
+} modRegDesc_t;
+
+/**
+ * @brief           Opens image, checks header and that all tables, indexes and names lie inside of the image
+ * @param desc      Pointer to descriptor structure
+ * @param image     Image, 4-byte aligned, has to stay valid while desc is used
+ * @param size      Size of image
+ * @return int16_t  0 if OK, -2 wrong image (magic, version, bounds)
+ */
+int16_t ModRegDescOpen(modRegDesc_t* desc, const void* image, uint32_t size);
+
+/**
+ * @brief           Finds device type by name (binary search)
+ * @param desc      Opened image
+ * @param name      Name of device type
+ * @return int32_t  Index of device, -1 if not found
+ */
+int32_t ModRegDescFind(const modRegDesc_t* desc, const char* name);
+
+/**
+ * @brief           Name of device or region
+ * @param desc      Opened image
+ * @param offset    name field of device / region
+ * @return const char* Name
+ */
+const char* ModRegDescName(const modRegDesc_t* desc, uint32_t offset);
+
+/**
+ * @brief           Number of registers of one value of type
+ * @return uint16_t 1 or 2, 0 if type is unknown
+ */
+uint16_t ModRegDescWidth(uint8_t type);
+
+/**
+ * @brief           Builds slave register map of device from its holding regions, storage is initialized by
+ *                  default values. Regions touching each other are kept apart (they differ by flags / names).
+ * @param desc      Opened image
+ * @param device    Index of device
+ * @param regions   Storage for regions of map
+ * @param maxRegions Size of regions storage
+ * @param values    Storage for register values, devices[device].numRegs registers
+ * @param map       Map to initialize, ready for @ref ModRegMapRead() / @ref ModRegMapWrite()
+ * @return int32_t  Address of last register (lastReg of slave stack), -1 storage too small or device has no
+ *                  holding registers, -2 wrong params
+ */
+int32_t ModRegDescRegMap(const modRegDesc_t* desc, uint16_t device, modRegRegion_t* regions, uint16_t maxRegions,
+                         uint16_t* values, modRegMap_t* map);
+
+/**
+ * @brief           Fills readable regions of device for read-coalescing planner (@ref ModPlanReads()),
+ *                  touching regions are merged
+ * @param desc      Opened image
+ * @param device    Index of device
+ * @param input     1 input registers, 0 holding registers
+ * @param map       Region map to fill (slaveAddr is kept), complete is set if all regions fit
+ * @return int16_t  Number of regions, -1 map is too small (map holds the first ones), -2 wrong params
+ */
+int16_t ModRegDescRegionMap(const modRegDesc_t* desc, uint16_t device, uint8_t input, modRegionMap_t* map);
+
+/**
+ * @brief           Finds region of device holding register
+ * @param desc      Opened image
+ * @param device    Index of device
+ * @param input     1 input registers, 0 holding registers
+ * @param regAddr   Register address
+ * @return const modRegDescRegion_t* Region, NULL if register isn't described
+ */
+const modRegDescRegion_t* ModRegDescRegion(const modRegDesc_t* desc, uint16_t device, uint8_t input, uint16_t regAddr);
+
+/**
+ * @brief           Decodes values of region from registers read from the bus
+ * @param region    Region
+ * @param regs      Registers read, starting at region->first
+ * @param first     Index of first value to decode (in values, not registers)
+ * @param num       Number of values
+ * @param values    Decoded values
+ * @return int16_t  0 if OK, -2 wrong params (values outside of region, unknown type)
+ */
+int16_t ModRegDescDecode(const modRegDescRegion_t* region, const uint16_t* regs, uint16_t first, uint16_t num,
+                         double* values);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_REGDESC_H */
@@ -0,0 +1,49 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "mod_regdesc_linux.h"
+
+int16_t ModRegDescMapFile(modRegDesc_t* desc, const char* path)
+{
+    struct stat st;
+    void* image;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+    {
+        return -3;
+    }
+    if (fstat(fd, &st) < 0 || st.st_size <= 0 || (uint64_t)st.st_size > 0xFFFFFFFFu)
+    {
+        close(fd);
+        return -3;
+    }
+    image = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // mapping keeps the file
+    if (image == MAP_FAILED)
+    {
+        return -3;
+    }
+    if (ModRegDescOpen(desc, image, (uint32_t)st.st_size) < 0)
+    {
+        munmap(image, (size_t)st.st_size);
+        return -2;
+    }
+
+    return 0;
+}
+
+void ModRegDescUnmapFile(modRegDesc_t* desc)
+{
+    if (desc->header != NULL)
+    {
+        munmap((void*)desc->header, desc->size);
+        desc->header = NULL;
+    }
+}
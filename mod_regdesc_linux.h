@@ -0,0 +1,35 @@
+/**
+ * @file    mod_regdesc_linux.h
+ * @brief   Maps compiled register-map image (@ref mod_regdesc.h) from file, read-only and shared by all
+ *          processes using it - pages are loaded on first touch, nothing is parsed or copied.
+ */
+
+#ifndef SYSTEM_MOD_REGDESC_LINUX_H
+#define SYSTEM_MOD_REGDESC_LINUX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "mod_regdesc.h"
+
+/**
+ * @brief           Maps image file and opens it by @ref ModRegDescOpen()
+ * @param desc      Pointer to descriptor structure
+ * @param path      Image file
+ * @return int16_t  0 if OK, -2 wrong image, -3 file can't be opened / mapped
+ */
+int16_t ModRegDescMapFile(modRegDesc_t* desc, const char* path);
+
+/**
+ * @brief           Unmaps image mapped by @ref ModRegDescMapFile()
+ * @param desc      Pointer to descriptor structure
+ */
+void ModRegDescUnmapFile(modRegDesc_t* desc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_REGDESC_LINUX_H */
@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <string.h>
+#include "mod_regjournal.h"
+#include "crc.h"
+
+// single writer and single flusher, head / tail publish ring slots
+#if defined(__GNUC__)
+    #define JOURNAL_LOAD(var)           __atomic_load_n(&(var), __ATOMIC_ACQUIRE)
+    #define JOURNAL_STORE(var, v)       __atomic_store_n(&(var), (v), __ATOMIC_RELEASE)
+#else
+    #define JOURNAL_LOAD(var)           (var)
+    #define JOURNAL_STORE(var, v)       ((var) = (v))
+#endif
+
+#define JOURNAL_MASK                    (MODBUS_JOURNAL_RING - 1)
+
+// CRC of records is seeded by generation, so records of other journal generation don't match
+static uint16_t ModRegJournalSeed(uint16_t generation)
+{
+    return (uint16_t)(0xFFFF ^ generation);
+}
+
+static void ModRegJournalEncode(uint8_t* out, uint16_t generation, uint16_t regAddr, uint16_t regValue)
+{
+    uint16_t crc;
+
+    out[0] = (uint8_t)regAddr;
+    out[1] = (uint8_t)(regAddr >> 8);
+    out[2] = (uint8_t)regValue;
+    out[3] = (uint8_t)(regValue >> 8);
+    crc = CrcModbus(out, 4, ModRegJournalSeed(generation));
+    out[4] = (uint8_t)crc;
+    out[5] = (uint8_t)(crc >> 8);
+}
+
+int16_t ModRegJournalInit(modRegJournal_t* journal, modRegMap_t* map)
+{
+    if (map == NULL || journal->pfAppend == NULL || journal->pfSync == NULL || journal->pfBegin == NULL ||
+        journal->pfCommit == NULL)
+    {
+        return -2; // wrong params
+    }
+
+    journal->map = map;
+    if (journal->compactBytes == 0)
+    {
+        journal->compactBytes = MODBUS_JOURNAL_COMPACT;
+    }
+    journal->head = 0;
+    journal->tail = 0;
+    journal->overflow = 0;
+    journal->generation = 0;
+    journal->size = 0;
+    journal->records = 0;
+    journal->syncs = 0;
+    journal->compactions = 0;
+    journal->overflows = 0;
+    journal->errors = 0;
+
+    return 0;
+}
+
+int32_t ModRegJournalRecover(modRegJournal_t* journal, const uint8_t* data, uint32_t length)
+{
+    uint32_t pos = MODBUS_JOURNAL_HEADER_SIZE;
+    uint16_t generation;
+    uint16_t seed;
+
+    journal->size = 0;
+    if (data == NULL || length < MODBUS_JOURNAL_HEADER_SIZE ||
+        (data[0] | (uint32_t)data[1] << 8 | (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24) != MODBUS_JOURNAL_MAGIC ||
+        CrcModbus(data, 6, 0xFFFF) != (uint16_t)(data[6] | data[7] << 8))
+    {
+        return 0; // no valid journal
+    }
+    generation = (uint16_t)(data[4] | data[5] << 8);
+    seed = ModRegJournalSeed(generation);
+
+    while (pos + MODBUS_JOURNAL_RECORD_SIZE <= length)
+    {
+        const uint8_t* rec = &data[pos];
+
+        if (CrcModbus(rec, 4, seed) != (uint16_t)(rec[4] | rec[5] << 8))
+        {
+            break; // torn write or stale data
+        }
+        // registers removed from the map by firmware update are skipped
+        (void)ModRegMapWrite(journal->map, (uint16_t)(rec[0] | rec[1] << 8), (uint16_t)(rec[2] | rec[3] << 8));
+        pos += MODBUS_JOURNAL_RECORD_SIZE;
+    }
+    journal->generation = generation;
+    journal->size = pos;
+
+    return (int32_t)pos;
+}
+
+uint8_t ModRegJournalWrite(modRegJournal_t* journal, uint16_t regAddr, uint16_t regValue)
+{
+    uint8_t err = ModRegMapWrite(journal->map, regAddr, regValue);
+    uint32_t head = journal->head;
+
+    if (err != 0)
+    {
+        return err;
+    }
+    // map is written first: change dropped here or discarded by compaction is in the snapshot
+    if (head - JOURNAL_LOAD(journal->tail) >= MODBUS_JOURNAL_RING)
+    {
+        journal->overflows++;
+        JOURNAL_STORE(journal->overflow, 1);
+        return 0;
+    }
+    journal->ring[head & JOURNAL_MASK] = (uint32_t)regAddr << 16 | regValue;
+    JOURNAL_STORE(journal->head, head + 1);
+
+    return 0;
+}
+
+uint8_t ModRegJournalGetReg(modSlaveStack_t* mstack, uint16_t regAddr, uint16_t* regValue)
+{
+    return ModRegMapRead(((modRegJournal_t*)mstack->userContent)->map, regAddr, regValue);
+}
+
+uint8_t ModRegJournalSetReg(modSlaveStack_t* mstack, uint16_t regAddr, uint16_t regValue)
+{
+    return ModRegJournalWrite((modRegJournal_t*)mstack->userContent, regAddr, regValue);
+}
+
+// writes header and all writable registers into new journal
+static int16_t ModRegJournalSnapshot(modRegJournal_t* journal, uint16_t generation, uint32_t* size)
+{
+    uint8_t buf[MODBUS_JOURNAL_BATCH * MODBUS_JOURNAL_RECORD_SIZE];
+    uint32_t len = MODBUS_JOURNAL_HEADER_SIZE;
+    const modRegMap_t* map = journal->map;
+    uint16_t crc;
+
+    buf[0] = (uint8_t)MODBUS_JOURNAL_MAGIC;
+    buf[1] = (uint8_t)(MODBUS_JOURNAL_MAGIC >> 8);
+    buf[2] = (uint8_t)(MODBUS_JOURNAL_MAGIC >> 16);
+    buf[3] = (uint8_t)(MODBUS_JOURNAL_MAGIC >> 24);
+    buf[4] = (uint8_t)generation;
+    buf[5] = (uint8_t)(generation >> 8);
+    crc = CrcModbus(buf, 6, 0xFFFF);
+    buf[6] = (uint8_t)crc;
+    buf[7] = (uint8_t)(crc >> 8);
+    *size = 0;
+
+    for (uint16_t i = 0; i < map->numRegions; i++)
+    {
+        const modRegRegion_t* r = &map->regions[i];
+
+        if (r->flags & MODBUS_REGMAP_READONLY)
+        {
+            continue;
+        }
+        for (uint16_t k = 0; k < r->count; k++)
+        {
+            if (len + MODBUS_JOURNAL_RECORD_SIZE > sizeof(buf))
+            {
+                if (journal->pfAppend(journal, buf, len) < 0)
+                {
+                    return -3;
+                }
+                *size += len;
+                len = 0;
+            }
+            // value may be written by slave meanwhile, the change is queued after the snapshot
+            ModRegJournalEncode(&buf[len], generation, (uint16_t)(r->first + k),
+                                ((volatile const uint16_t*)r->values)[k]);
+            len += MODBUS_JOURNAL_RECORD_SIZE;
+        }
+    }
+    if (journal->pfAppend(journal, buf, len) < 0)
+    {
+        return -3;
+    }
+    *size += len;
+
+    return 0;
+}
+
+int16_t ModRegJournalCompact(modRegJournal_t* journal)
+{
+    uint16_t generation = (uint16_t)(journal->generation + 1);
+    uint32_t size;
+
+    // queued changes are in the map already, snapshot covers them
+    JOURNAL_STORE(journal->overflow, 0);
+    JOURNAL_STORE(journal->tail, JOURNAL_LOAD(journal->head));
+
+    if (journal->pfBegin(journal) < 0)
+    {
+        journal->errors++;
+        JOURNAL_STORE(journal->overflow, 1); // retry by next flush
+        return -3;
+    }
+    if (ModRegJournalSnapshot(journal, generation, &size) < 0)
+    {
+        (void)journal->pfCommit(journal, 0); // drop new journal, old one stays
+        journal->errors++;
+        JOURNAL_STORE(journal->overflow, 1);
+        return -3;
+    }
+    if (journal->pfCommit(journal, 1) < 0)
+    {
+        journal->errors++;
+        JOURNAL_STORE(journal->overflow, 1);
+        return -3;
+    }
+
+    journal->generation = generation;
+    journal->size = size;
+    journal->compactions++;
+    journal->syncs++;
+
+    return 0;
+}
+
+int32_t ModRegJournalFlush(modRegJournal_t* journal)
+{
+    uint8_t buf[MODBUS_JOURNAL_BATCH * MODBUS_JOURNAL_RECORD_SIZE];
+    int32_t done = 0;
+
+    if (journal->size == 0 || journal->size >= journal->compactBytes || JOURNAL_LOAD(journal->overflow))
+    {
+        return ModRegJournalCompact(journal) < 0 ? -3 : 0;
+    }
+
+    for (;;)
+    {
+        uint32_t tail = journal->tail;
+        uint32_t n = JOURNAL_LOAD(journal->head) - tail;
+
+        if (n == 0)
+        {
+            break;
+        }
+        if (n > MODBUS_JOURNAL_BATCH)
+        {
+            n = MODBUS_JOURNAL_BATCH;
+        }
+        for (uint32_t i = 0; i < n; i++)
+        {
+            uint32_t change = journal->ring[(tail + i) & JOURNAL_MASK];
+
+            ModRegJournalEncode(&buf[i * MODBUS_JOURNAL_RECORD_SIZE], journal->generation, (uint16_t)(change >> 16),
+                                (uint16_t)change);
+        }
+        if (journal->pfAppend(journal, buf, n * MODBUS_JOURNAL_RECORD_SIZE) < 0)
+        {
+            // tail of journal is unknown now, next flush writes fresh snapshot
+            journal->errors++;
+            journal->size = 0;
+            return -3;
+        }
+        journal->size += n * MODBUS_JOURNAL_RECORD_SIZE;
+        JOURNAL_STORE(journal->tail, tail + n);
+        done += (int32_t)n;
+    }
+
+    if (done > 0)
+    {
+        if (journal->pfSync(journal) < 0)
+        {
+            journal->errors++;
+            journal->size = 0;
+            return -3;
+        }
+        journal->syncs++;
+        journal->records += (uint32_t)done;
+    }
+
+    return done;
+}
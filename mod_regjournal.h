@@ -0,0 +1,154 @@
+/**
+ * @file    mod_regjournal.h
+ * @brief   Write-behind persistence of memory-backed register map (@ref mod_regmap.h). Slave write callback only
+ *          updates RAM and queues the change into lock-free ring, so write answers leave at RAM speed.
+ *          @ref ModRegJournalFlush(), called from background task, appends queued changes to journal and syncs
+ *          storage once per batch. At startup @ref ModRegJournalRecover() replays the journal into the map.
+ *          Journal longer than compactBytes is replaced by snapshot of writable registers.
+ *
+ *          Storage is reached by callbacks (file: @ref mod_regjournal_linux.h, flash: two sectors used in turns).
+ *          Journal is header (magic, generation) followed by records {register, value, CRC}. CRC is seeded by
+ *          generation, so torn tail or records of older generation left in flash end the replay.
+ *
+ *          Changes written while the ring is full aren't lost: ring overflow forces snapshot at next flush.
+ * @warning One writer (slave thread) and one flusher, each may run in own thread / task.
+ */
+
+#ifndef SYSTEM_MOD_REGJOURNAL_H
+#define SYSTEM_MOD_REGJOURNAL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "mod_regmap.h"
+
+#ifndef MODBUS_JOURNAL_RING
+#define MODBUS_JOURNAL_RING         256     ///< queued changes, power of 2
+#endif
+#define MODBUS_JOURNAL_BATCH        64      ///< records encoded per append
+#define MODBUS_JOURNAL_COMPACT      65536   ///< default journal length triggering compaction [B]
+#define MODBUS_JOURNAL_MAGIC        0x314A524Du     ///< "MRJ1"
+#define MODBUS_JOURNAL_HEADER_SIZE  8
+#define MODBUS_JOURNAL_RECORD_SIZE  6
+
+#if (MODBUS_JOURNAL_RING & (MODBUS_JOURNAL_RING - 1)) != 0
+#error "MODBUS_JOURNAL_RING has to be power of 2"
+#endif
+
+typedef struct modRegJournal_s modRegJournal_t;
+
+/**
+ * @brief   Appends data to the journal being written (current one or new one after pfBegin)
+ * @return  0 if OK, negative value in case of failure
+ */
+typedef int16_t (*pfModJournalAppend_t)(modRegJournal_t* journal, const uint8_t* data, uint32_t length);
+
+/**
+ * @brief   Makes appended data durable (fsync, flash write of buffered page)
+ * @return  0 if OK, negative value in case of failure
+ */
+typedef int16_t (*pfModJournalSync_t)(modRegJournal_t* journal);
+
+/**
+ * @brief   Starts new empty journal (compaction), old one stays valid until pfCommit
+ * @return  0 if OK, negative value in case of failure
+ */
+typedef int16_t (*pfModJournalBegin_t)(modRegJournal_t* journal);
+
+/**
+ * @brief   Makes new journal durable and atomically replaces the old one by it
+ * @param ok    0 if compaction failed, new journal has to be dropped and old one kept
+ * @return  0 if OK, negative value in case of failure
+ */
+typedef int16_t (*pfModJournalCommit_t)(modRegJournal_t* journal, uint8_t ok);
+
+/**
+ * @brief   Journal structure
+ */
+struct modRegJournal_s
+{
+    // parameters
+    modRegMap_t*                map;            ///< persisted map, only writable regions are journaled
+    pfModJournalAppend_t        pfAppend;
+    pfModJournalSync_t          pfSync;
+    pfModJournalBegin_t         pfBegin;
+    pfModJournalCommit_t        pfCommit;
+    uint32_t                    compactBytes;   ///< journal longer than this is compacted (MODBUS_JOURNAL_COMPACT)
+
+    // internal
+    uint32_t                    ring[MODBUS_JOURNAL_RING];  ///< register << 16 | value
+    uint32_t                    head;           ///< written by writer
+    uint32_t                    tail;           ///< written by flusher
+    uint8_t                     overflow;       ///< change was dropped from ring, snapshot needed
+    uint16_t                    generation;     ///< generation of current journal
+    uint32_t                    size;           ///< length of current journal, 0 = no journal yet
+
+    // statistics
+    uint32_t                    records;        ///< persisted records
+    uint32_t                    syncs;
+    uint32_t                    compactions;
+    uint32_t                    overflows;      ///< changes dropped from ring (covered by snapshot)
+    uint32_t                    errors;         ///< storage failures
+
+    void*                       userContent;    ///< user defined pointer, can by used to pass anything
+};
+
+/**
+ * @brief           Initializes journal, map has to be initialized by @ref ModRegMapInit()
+ * @warning         journal structure must have valid storage callbacks BEFORE calling this fnc
+ * @param journal   Pointer to journal structure
+ * @param map       Persisted register map
+ * @return int16_t  0 if OK, -2 wrong params
+ */
+int16_t ModRegJournalInit(modRegJournal_t* journal, modRegMap_t* map);
+
+/**
+ * @brief           Replays stored journal into the map (call it before slave starts). Replay stops at first record
+ *                  with wrong CRC (torn write), storage should be truncated to returned length before appending.
+ * @param journal   Pointer to journal structure
+ * @param data      Content of storage
+ * @param length    Length of content
+ * @return int32_t  Length of valid journal (0 = no valid journal, first flush writes snapshot)
+ */
+int32_t ModRegJournalRecover(modRegJournal_t* journal, const uint8_t* data, uint32_t length);
+
+/**
+ * @brief           Writes register value and queues the change, never blocks
+ * @return uint8_t  0 if OK, MODBUS_ERR_ILLEGAL_ADDRESS if register is not mapped or is read-only
+ */
+uint8_t ModRegJournalWrite(modRegJournal_t* journal, uint16_t regAddr, uint16_t regValue);
+
+/**
+ * @brief   pfGetReg callback of slave stack, mstack->userContent points to @ref modRegJournal_t
+ * @return  0 if OK, MODBUS_ERR_ILLEGAL_ADDRESS if register is not mapped
+ */
+uint8_t ModRegJournalGetReg(modSlaveStack_t* mstack, uint16_t regAddr, uint16_t* regValue);
+
+/**
+ * @brief   pfSetReg callback of slave stack, mstack->userContent points to @ref modRegJournal_t
+ * @return  0 if OK, MODBUS_ERR_ILLEGAL_ADDRESS if register is not mapped or is read-only
+ */
+uint8_t ModRegJournalSetReg(modSlaveStack_t* mstack, uint16_t regAddr, uint16_t regValue);
+
+/**
+ * @brief           Persists queued changes (append + one sync), compacts journal if needed. Call it periodically
+ *                  from background task, period bounds the time of changes not yet durable.
+ * @param journal   Pointer to journal structure
+ * @return int32_t  Number of persisted changes, -3 storage error (changes are kept queued / snapshot is retried)
+ */
+int32_t ModRegJournalFlush(modRegJournal_t* journal);
+
+/**
+ * @brief           Replaces journal by snapshot of all writable registers of the map
+ * @param journal   Pointer to journal structure
+ * @return int16_t  0 if OK, -3 storage error (old journal is kept)
+ */
+int16_t ModRegJournalCompact(modRegJournal_t* journal);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_REGJOURNAL_H */
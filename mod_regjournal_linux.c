@@ -0,0 +1,169 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "mod_regjournal_linux.h"
+
+static int16_t ModRegJournalFileWrite(int fd, const uint8_t* data, uint32_t length)
+{
+    while (length > 0)
+    {
+        ssize_t n = write(fd, data, length);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -3;
+        }
+        data += n;
+        length -= (uint32_t)n;
+    }
+
+    return 0;
+}
+
+// rename is durable after sync of the directory
+static void ModRegJournalFileSyncDir(const char* path)
+{
+    char dir[MODBUS_JOURNAL_PATH_MAX];
+    int fd;
+
+    strcpy(dir, path);
+    fd = open(dirname(dir), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0)
+    {
+        (void)fsync(fd);
+        close(fd);
+    }
+}
+
+static void ModRegJournalFileTmp(const modRegJournalFile_t* file, char* tmp)
+{
+    snprintf(tmp, MODBUS_JOURNAL_PATH_MAX + 4, "%s.tmp", file->path);
+}
+
+static int16_t ModRegJournalFileAppend(modRegJournal_t* journal, const uint8_t* data, uint32_t length)
+{
+    modRegJournalFile_t* file = (modRegJournalFile_t*)journal->userContent;
+
+    return ModRegJournalFileWrite(file->newFd >= 0 ? file->newFd : file->fd, data, length);
+}
+
+static int16_t ModRegJournalFileSync(modRegJournal_t* journal)
+{
+    modRegJournalFile_t* file = (modRegJournalFile_t*)journal->userContent;
+
+    return fdatasync(file->fd) < 0 ? -3 : 0;
+}
+
+static int16_t ModRegJournalFileBegin(modRegJournal_t* journal)
+{
+    modRegJournalFile_t* file = (modRegJournalFile_t*)journal->userContent;
+    char tmp[MODBUS_JOURNAL_PATH_MAX + 4];
+
+    ModRegJournalFileTmp(file, tmp);
+    file->newFd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+
+    return file->newFd < 0 ? -3 : 0;
+}
+
+static int16_t ModRegJournalFileCommit(modRegJournal_t* journal, uint8_t ok)
+{
+    modRegJournalFile_t* file = (modRegJournalFile_t*)journal->userContent;
+    char tmp[MODBUS_JOURNAL_PATH_MAX + 4];
+    int newFd = file->newFd;
+
+    ModRegJournalFileTmp(file, tmp);
+    file->newFd = -1;
+    if (!ok || fsync(newFd) < 0 || rename(tmp, file->path) < 0)
+    {
+        close(newFd);
+        unlink(tmp);
+        return -3;
+    }
+    ModRegJournalFileSyncDir(file->path);
+    close(file->fd);
+    file->fd = newFd;
+
+    return 0;
+}
+
+int32_t ModRegJournalOpenFile(modRegJournalFile_t* file, modRegMap_t* map, const char* path)
+{
+    struct stat st;
+    uint8_t* data;
+    int32_t valid;
+
+    if (path == NULL || strlen(path) >= MODBUS_JOURNAL_PATH_MAX)
+    {
+        return -2; // wrong params
+    }
+    strcpy(file->path, path);
+    file->newFd = -1;
+    file->journal.pfAppend = ModRegJournalFileAppend;
+    file->journal.pfSync = ModRegJournalFileSync;
+    file->journal.pfBegin = ModRegJournalFileBegin;
+    file->journal.pfCommit = ModRegJournalFileCommit;
+    file->journal.userContent = file;
+    if (ModRegJournalInit(&file->journal, map) < 0)
+    {
+        return -2;
+    }
+
+    file->fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (file->fd < 0)
+    {
+        return -3;
+    }
+    if (fstat(file->fd, &st) < 0 || (uint64_t)st.st_size > 0x7FFFFFFFu)
+    {
+        close(file->fd);
+        return -3;
+    }
+
+    // journal is read once at startup, plain read is enough
+    data = (uint8_t*)malloc(st.st_size > 0 ? (size_t)st.st_size : 1);
+    if (data == NULL || pread(file->fd, data, (size_t)st.st_size, 0) != (ssize_t)st.st_size)
+    {
+        free(data);
+        close(file->fd);
+        return -3;
+    }
+    valid = ModRegJournalRecover(&file->journal, data, (uint32_t)st.st_size);
+    free(data);
+    if (valid == 0 && st.st_size > 0)
+    {
+        // journal is created empty and replaced by rename, so this isn't a journal - keep it untouched
+        close(file->fd);
+        return -2;
+    }
+
+    // torn tail is cut off, next records are appended behind the last valid one
+    if (valid != (int32_t)st.st_size && ftruncate(file->fd, valid) < 0)
+    {
+        close(file->fd);
+        return -3;
+    }
+
+    return valid;
+}
+
+int16_t ModRegJournalCloseFile(modRegJournalFile_t* file)
+{
+    int16_t ret = ModRegJournalFlush(&file->journal) < 0 ? -3 : 0;
+
+    close(file->fd);
+    file->fd = -1;
+
+    return ret;
+}
@@ -0,0 +1,53 @@
+/**
+ * @file    mod_regjournal_linux.h
+ * @brief   File storage of register journal (@ref mod_regjournal.h). Changes are appended to the file and made durable
+ *          by one fdatasync per flush. Compaction writes snapshot into "<path>.tmp", syncs it and renames it over
+ *          the journal, so crash at any moment leaves either old or new journal.
+ */
+
+#ifndef SYSTEM_MOD_REGJOURNAL_LINUX_H
+#define SYSTEM_MOD_REGJOURNAL_LINUX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "mod_regjournal.h"
+
+#define MODBUS_JOURNAL_PATH_MAX     256
+
+/**
+ * @brief   Journal with file storage, journal.userContent points to this structure
+ */
+typedef struct
+{
+    modRegJournal_t             journal;
+    int                         fd;             ///< current journal
+    int                         newFd;          ///< journal being written by compaction, -1 otherwise
+    char                        path[MODBUS_JOURNAL_PATH_MAX];
+} modRegJournalFile_t;
+
+/**
+ * @brief           Opens (creates) journal file, replays it into the map and cuts torn tail off. File which isn't
+ *                  a journal is refused and left untouched.
+ * @param file      Pointer to journal structure, journal.compactBytes may be set before
+ * @param map       Persisted register map, initialized by @ref ModRegMapInit()
+ * @param path      Journal file
+ * @return int32_t  Number of replayed bytes (0 = new journal), -2 wrong params or existing file isn't a journal,
+ *                  -3 file error
+ */
+int32_t ModRegJournalOpenFile(modRegJournalFile_t* file, modRegMap_t* map, const char* path);
+
+/**
+ * @brief           Flushes queued changes and closes journal file
+ * @param file      Pointer to journal structure
+ * @return int16_t  0 if OK, -3 last flush failed
+ */
+int16_t ModRegJournalCloseFile(modRegJournalFile_t* file);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_REGJOURNAL_LINUX_H */
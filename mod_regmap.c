@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <string.h>
+#include "mod_regmap.h"
+
+int32_t ModRegMapInit(modRegMap_t* map)
+{
+    uint32_t next = 0;
+
+    if (map->regions == NULL || map->numRegions == 0)
+    {
+        return -1;
+    }
+    for (uint16_t i = 0; i < map->numRegions; i++)
+    {
+        const modRegRegion_t* r = &map->regions[i];
+
+        if (r->count == 0 || r->values == NULL ||
+            r->first < next ||                      // not sorted or overlaps previous one
+            (uint32_t)r->first + r->count > 0x10000)
+        {
+            return -1;
+        }
+        next = (uint32_t)r->first + r->count;
+    }
+    map->lastHit = 0;
+
+    return (int32_t)(next - 1);
+}
+
+static const modRegRegion_t* ModRegMapRegion(modRegMap_t* map, uint16_t regAddr)
+{
+    const modRegRegion_t* r = &map->regions[map->lastHit];
+    uint16_t lo = 0;
+    uint16_t hi = map->numRegions;
+
+    // multi-register commands access same region again and again
+    if ((uint16_t)(regAddr - r->first) < r->count)
+    {
+        return r;
+    }
+
+    while (lo < hi)
+    {
+        uint16_t mid = (uint16_t)((lo + hi) / 2);
+
+        r = &map->regions[mid];
+        if (regAddr < r->first)
+        {
+            hi = mid;
+        }
+        else if ((uint16_t)(regAddr - r->first) >= r->count)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            map->lastHit = mid;
+            return r;
+        }
+    }
+
+    return NULL;
+}
+
+uint16_t* ModRegMapFind(modRegMap_t* map, uint16_t regAddr, uint8_t* flags)
+{
+    const modRegRegion_t* r = ModRegMapRegion(map, regAddr);
+
+    if (r == NULL)
+    {
+        return NULL;
+    }
+    if (flags != NULL)
+    {
+        *flags = r->flags;
+    }
+
+    return &r->values[regAddr - r->first];
+}
+
+uint8_t ModRegMapRead(modRegMap_t* map, uint16_t regAddr, uint16_t* regValue)
+{
+    uint16_t* v = ModRegMapFind(map, regAddr, NULL);
+
+    if (v == NULL)
+    {
+        return MODBUS_ERR_ILLEGAL_ADDRESS;
+    }
+    *regValue = *v;
+
+    return 0;
+}
+
+uint8_t ModRegMapWrite(modRegMap_t* map, uint16_t regAddr, uint16_t regValue)
+{
+    uint8_t flags;
+    uint16_t* v = ModRegMapFind(map, regAddr, &flags);
+
+    if (v == NULL || (flags & MODBUS_REGMAP_READONLY))
+    {
+        return MODBUS_ERR_ILLEGAL_ADDRESS;
+    }
+    *v = regValue;
+
+    return 0;
+}
+
+uint8_t ModRegMapGetReg(modSlaveStack_t* mstack, uint16_t regAddr, uint16_t* regValue)
+{
+    return ModRegMapRead((modRegMap_t*)mstack->userContent, regAddr, regValue);
+}
+
+uint8_t ModRegMapSetReg(modSlaveStack_t* mstack, uint16_t regAddr, uint16_t regValue)
+{
+    return ModRegMapWrite((modRegMap_t*)mstack->userContent, regAddr, regValue);
+}
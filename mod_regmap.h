@@ -0,0 +1,88 @@
+/**
+ * @file    mod_regmap.h
+ * @brief   Memory-backed register map for Modbus slave stack. Registers are stored in user provided arrays grouped
+ *          to regions, @ref ModRegMapGetReg() and @ref ModRegMapSetReg() can be passed directly as pfGetReg / pfSetReg
+ *          callbacks of @ref modSlaveStack_t (mstack->userContent has to point to @ref modRegMap_t). If userContent
+ *          is occupied (e.g. by transport), call @ref ModRegMapRead() / @ref ModRegMapWrite() from own callbacks.
+ */
+
+#ifndef SYSTEM_MOD_REGMAP_H
+#define SYSTEM_MOD_REGMAP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "mod_slave_rtu.h"
+
+/**
+ * @defgroup ModbusRegMapFlags Region flags
+ * @{
+ */
+#define MODBUS_REGMAP_READONLY      0x01    ///< writes are refused by MODBUS_ERR_ILLEGAL_ADDRESS
+/** @} */
+
+/** Continuous block of registers */
+typedef struct
+{
+    uint16_t                    first;          ///< address of first register
+    uint16_t                    count;          ///< number of registers, at least 1
+    uint8_t                     flags;          ///< see @ref ModbusRegMapFlags
+    uint16_t*                   values;         ///< storage of @b count registers
+} modRegRegion_t;
+
+/** Register map, regions has to be sorted by address and must not overlap */
+typedef struct
+{
+    const modRegRegion_t*       regions;        ///< array of regions
+    uint16_t                    numRegions;     ///< number of regions
+    uint16_t                    lastHit;        ///< index of last used region, speeds up sequential access
+} modRegMap_t;
+
+/**
+ * @brief           Initializes register map
+ * @param map       Pointer to map with valid regions and numRegions
+ * @return int32_t  Address of last mapped register (use it as lastReg of slave stack),
+ *                  -1 if regions are not sorted, overlap or are empty
+ */
+int32_t ModRegMapInit(modRegMap_t* map);
+
+/**
+ * @brief           Finds register in map
+ * @param map       Pointer to register map
+ * @param regAddr   Register address
+ * @param flags     Flags of region are stored here, can be NULL
+ * @return uint16_t* Pointer to register value, NULL if not mapped
+ */
+uint16_t* ModRegMapFind(modRegMap_t* map, uint16_t regAddr, uint8_t* flags);
+
+/**
+ * @brief           Reads register value
+ * @return uint8_t  0 if OK, MODBUS_ERR_ILLEGAL_ADDRESS if register is not mapped
+ */
+uint8_t ModRegMapRead(modRegMap_t* map, uint16_t regAddr, uint16_t* regValue);
+
+/**
+ * @brief           Writes register value
+ * @return uint8_t  0 if OK, MODBUS_ERR_ILLEGAL_ADDRESS if register is not mapped or is read-only
+ */
+uint8_t ModRegMapWrite(modRegMap_t* map, uint16_t regAddr, uint16_t regValue);
+
+/**
+ * @brief   pfGetReg callback of slave stack, mstack->userContent points to @ref modRegMap_t
+ * @return  0 if OK, MODBUS_ERR_ILLEGAL_ADDRESS if register is not mapped
+ */
+uint8_t ModRegMapGetReg(modSlaveStack_t* mstack, uint16_t regAddr, uint16_t* regValue);
+
+/**
+ * @brief   pfSetReg callback of slave stack, mstack->userContent points to @ref modRegMap_t
+ * @return  0 if OK, MODBUS_ERR_ILLEGAL_ADDRESS if register is not mapped or is read-only
+ */
+uint8_t ModRegMapSetReg(modSlaveStack_t* mstack, uint16_t regAddr, uint16_t regValue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_REGMAP_H */
@@ -0,0 +1,348 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "mod_regscan.h"
+
+// result of one read
+typedef enum
+{
+    eMOD_PROBE_OK,
+    eMOD_PROBE_FAILED,              ///< some register of the range is unreadable
+    eMOD_PROBE_TOO_BIG,             ///< slave refuses so many registers at once
+    eMOD_PROBE_RETRY,
+    eMOD_PROBE_ABORT                ///< slave doesn't implement the function / HW error
+} modRegProbe_t;
+
+int16_t ModRegScanInit(modRegScan_t* scan, modMasterStack_t* mstack)
+{
+    if (mstack == NULL)
+    {
+        return -2; // wrong params
+    }
+
+    memset(scan, 0, offsetof(modRegScan_t, userContent));
+    scan->mstack = mstack;
+    scan->block = MODBUS_MAX_READ_REGS;
+    scan->maxSkip = MODBUS_REGSCAN_MAX_SKIP;
+    scan->maxRetries = 1;
+    scan->state = eMOD_SCAN_IDLE;
+
+    return 0;
+}
+
+int16_t ModRegScanStart(modRegScan_t* scan, modRegionMap_t* map, uint8_t slaveAddr, uint8_t input, uint16_t first,
+                        uint16_t last)
+{
+    if (scan->state != eMOD_SCAN_IDLE && scan->state != eMOD_SCAN_DONE)
+    {
+        return -1; // scan is running
+    }
+    if (map == NULL || first > last || slaveAddr < 1 || slaveAddr > 247)
+    {
+        return -2; // wrong params
+    }
+
+    map->numRegions = 0;
+    map->slaveAddr = slaveAddr;
+    map->input = input ? 1 : 0;
+    map->complete = 1;
+    scan->map = map;
+    if (scan->block < 1 || scan->block > MODBUS_MAX_READ_REGS)
+    {
+        scan->block = MODBUS_MAX_READ_REGS;
+    }
+    if (scan->maxSkip < 1)
+    {
+        scan->maxSkip = 1;
+    }
+    scan->pos = first;
+    scan->last = last;
+    scan->step = 1;
+    scan->probing = 0;
+    scan->retries = 0;
+    scan->transactions = 0;
+    scan->state = eMOD_SCAN_BLOCK;
+
+    return 0;
+}
+
+// append readable region, merge it with previous one if they touch
+static void ModRegScanAdd(modRegScan_t* scan, uint32_t first, uint32_t last)
+{
+    modRegionMap_t* map = scan->map;
+
+    if (map->numRegions > 0 && (uint32_t)map->regions[map->numRegions - 1].last + 1 == first)
+    {
+        map->regions[map->numRegions - 1].last = (uint16_t)last;
+    }
+    else if (map->numRegions < MODBUS_REGION_MAX)
+    {
+        map->regions[map->numRegions].first = (uint16_t)first;
+        map->regions[map->numRegions].last = (uint16_t)last;
+        map->numRegions++;
+    }
+    else
+    {
+        map->complete = 0; // map is full
+    }
+}
+
+// continue with blocks after found region
+static void ModRegScanNext(modRegScan_t* scan, uint32_t pos)
+{
+    scan->pos = pos;
+    scan->step = 1;
+    scan->state = pos > scan->last ? eMOD_SCAN_DONE : eMOD_SCAN_BLOCK;
+}
+
+// continue with skipping after unreadable register
+static void ModRegScanSkip(modRegScan_t* scan, uint32_t unreadable)
+{
+    scan->unreadable = unreadable;
+    scan->state = unreadable >= scan->last ? eMOD_SCAN_DONE : eMOD_SCAN_SKIP;
+}
+
+// plan next read of current state
+static void ModRegScanPlan(modRegScan_t* scan)
+{
+    switch (scan->state)
+    {
+    case eMOD_SCAN_BLOCK:
+        scan->probeFirst = scan->pos;
+        scan->probeNum = (uint16_t)(scan->last - scan->pos + 1 < scan->block ? scan->last - scan->pos + 1 : scan->block);
+        break;
+
+    case eMOD_SCAN_PREFIX:
+        // lo registers known readable, hi registers known failing
+        scan->probeFirst = scan->pos;
+        scan->probeNum = (uint16_t)((scan->lo + scan->hi) / 2);
+        break;
+
+    case eMOD_SCAN_SKIP:
+        if (scan->unreadable + scan->step > scan->last)
+        {
+            scan->step = (uint16_t)(scan->last - scan->unreadable);
+        }
+        scan->probeFirst = scan->unreadable + scan->step;
+        scan->probeNum = 1;
+        break;
+
+    case eMOD_SCAN_SEARCH:
+        // lo known unreadable, hi - (pos - 1) known readable
+        scan->probeFirst = (scan->lo + scan->hi) / 2;
+        scan->probeNum = (uint16_t)(scan->pos - scan->probeFirst);
+        break;
+
+    default:
+        break;
+    }
+}
+
+static modRegProbe_t ModRegScanResult(modRegScan_t* scan, modMasterState_t status, uint8_t err)
+{
+    switch (status)
+    {
+    case eMOD_M_STATE_PROCESSED:
+        return eMOD_PROBE_OK;
+
+    case eMOD_M_STATE_ERR_REPORTED:
+        if (err == MODBUS_ERR_ILLEGAL_OPCODE)
+        {
+            return eMOD_PROBE_ABORT;
+        }
+        if (err == MODBUS_ERR_ILLEGAL_VALUE && scan->probeNum > 1)
+        {
+            return eMOD_PROBE_TOO_BIG;
+        }
+        return eMOD_PROBE_FAILED;
+
+    case eMOD_M_STATE_HW_ERROR:
+        return eMOD_PROBE_ABORT;
+
+    default:
+        // timed out / corrupted
+        if (scan->retries < scan->maxRetries)
+        {
+            scan->retries++;
+            return eMOD_PROBE_RETRY;
+        }
+        return eMOD_PROBE_FAILED;
+    }
+}
+
+// move state machine by result of read
+static void ModRegScanStep(modRegScan_t* scan, modRegProbe_t probe)
+{
+    uint32_t end = scan->probeFirst + scan->probeNum - 1;
+
+    switch (scan->state)
+    {
+    case eMOD_SCAN_BLOCK:
+        if (probe == eMOD_PROBE_OK)
+        {
+            ModRegScanAdd(scan, scan->probeFirst, end);
+            ModRegScanNext(scan, end + 1);
+        }
+        else if (scan->probeNum == 1)
+        {
+            ModRegScanSkip(scan, scan->pos);
+        }
+        else
+        {
+            scan->lo = 0;
+            scan->hi = scan->probeNum;
+            scan->state = eMOD_SCAN_PREFIX;
+        }
+        break;
+
+    case eMOD_SCAN_PREFIX:
+        if (probe == eMOD_PROBE_OK)
+        {
+            scan->lo = scan->probeNum;
+        }
+        else
+        {
+            scan->hi = scan->probeNum;
+        }
+        if (scan->hi - scan->lo == 1)
+        {
+            // first lo registers readable, next one isn't
+            if (scan->lo > 0)
+            {
+                ModRegScanAdd(scan, scan->pos, scan->pos + scan->lo - 1);
+            }
+            ModRegScanSkip(scan, scan->pos + scan->lo);
+        }
+        break;
+
+    case eMOD_SCAN_SKIP:
+        if (probe != eMOD_PROBE_OK)
+        {
+            scan->step = (uint16_t)(scan->step * 2 < scan->maxSkip ? scan->step * 2 : scan->maxSkip);
+            ModRegScanSkip(scan, scan->probeFirst);
+        }
+        else if (scan->probeFirst == scan->unreadable + 1)
+        {
+            ModRegScanAdd(scan, scan->probeFirst, scan->probeFirst);
+            ModRegScanNext(scan, scan->probeFirst + 1);
+        }
+        else
+        {
+            // readable run starts somewhere after last unreadable register
+            scan->lo = scan->unreadable;
+            scan->hi = scan->probeFirst;
+            scan->pos = scan->probeFirst + 1;
+            scan->state = eMOD_SCAN_SEARCH;
+        }
+        break;
+
+    case eMOD_SCAN_SEARCH:
+        if (probe == eMOD_PROBE_OK)
+        {
+            scan->hi = scan->probeFirst;
+        }
+        else
+        {
+            scan->lo = scan->probeFirst;
+        }
+        if (scan->hi - scan->lo == 1)
+        {
+            ModRegScanAdd(scan, scan->hi, end);
+            ModRegScanNext(scan, end + 1);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+int16_t ModRegScanCheck(modRegScan_t* scan)
+{
+    modMasterState_t status;
+    uint8_t err = 0;
+    modRegProbe_t probe;
+    int16_t r;
+
+    if (scan->state == eMOD_SCAN_IDLE || scan->state == eMOD_SCAN_DONE)
+    {
+        return 1;
+    }
+
+    if (!scan->probing)
+    {
+        if (scan->retries == 0)
+        {
+            ModRegScanPlan(scan);
+        }
+        if (scan->map->input)
+        {
+            r = ModMasterReadInputRegs(scan->mstack, scan->map->slaveAddr, (uint16_t)scan->probeFirst, scan->probeNum,
+                                       scan->regs);
+        }
+        else
+        {
+            r = ModMasterReadRegs(scan->mstack, scan->map->slaveAddr, (uint16_t)scan->probeFirst, scan->probeNum,
+                                  scan->regs);
+        }
+        if (r == -1)
+        {
+            return 0; // stack is busy, try again later
+        }
+        // HW error is reported by next check
+        scan->probing = 1;
+        scan->transactions++;
+        return 0;
+    }
+
+    if (!ModMasterCheck(scan->mstack, &status, &err))
+    {
+        return 0; // still waiting
+    }
+    scan->probing = 0;
+
+    probe = ModRegScanResult(scan, status, err);
+    if (probe == eMOD_PROBE_RETRY)
+    {
+        return 0; // same read again
+    }
+    scan->retries = 0;
+    if (probe == eMOD_PROBE_ABORT)
+    {
+        scan->map->complete = 0;
+        scan->state = eMOD_SCAN_DONE;
+        return 1;
+    }
+    if (probe == eMOD_PROBE_TOO_BIG)
+    {
+        // smaller blocks, all reads are at most block long
+        scan->block = scan->probeNum / 2;
+        if (scan->maxSkip > scan->block)
+        {
+            scan->maxSkip = scan->block;
+        }
+        if (scan->state == eMOD_SCAN_SEARCH || scan->state == eMOD_SCAN_SKIP)
+        {
+            scan->pos = scan->unreadable + 1;
+        }
+        scan->state = eMOD_SCAN_BLOCK;
+        return 0;
+    }
+
+    ModRegScanStep(scan, probe);
+
+    return scan->state == eMOD_SCAN_DONE ? 1 : 0;
+}
+
+int16_t ModRegionFind(const modRegionMap_t* map, uint16_t first, uint16_t last)
+{
+    for (uint16_t i = 0; i < map->numRegions; i++)
+    {
+        if (map->regions[i].first <= first && last <= map->regions[i].last)
+        {
+            return (int16_t)i;
+        }
+    }
+
+    return -1;
+}
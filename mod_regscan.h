@@ -0,0 +1,128 @@
+/**
+ * @file    mod_regscan.h
+ * @brief   Maps readable holding / input register space of undocumented slave device. Registers are read in
+ *          blocks as large as possible, failed block (MODBUS_ERR_ILLEGAL_ADDRESS or other exception) is bisected
+ *          to find end of readable run, unreadable space is skipped by exponentially growing steps and start of next
+ *          run is bisected back. Readable run of L registers costs ceil(L / block) reads + ~log2(block) per
+ *          boundary. Result is list of readable regions (@ref modRegionMap_t), input of read-coalescing planner
+ *          (@ref mod_plan.h).
+ *
+ * @note    Readable islands shorter than skip step inside unreadable space can be missed, set maxSkip to 1
+ *          for exhaustive (and slow) scan.
+ */
+
+#ifndef SYSTEM_MOD_REGSCAN_H
+#define SYSTEM_MOD_REGSCAN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "mod_master_rtu.h"
+
+#ifndef MODBUS_REGION_MAX
+#define MODBUS_REGION_MAX           32      ///< max. number of regions in map
+#endif
+#define MODBUS_REGSCAN_MAX_SKIP     64      ///< default max. step in unreadable space
+
+/**
+ * @brief   Readable region, first - last (incl.)
+ */
+typedef struct
+{
+    uint16_t                    first;
+    uint16_t                    last;
+} modRegion_t;
+
+/**
+ * @brief   Region map of one slave, regions are sorted and don't touch each other
+ */
+typedef struct
+{
+    modRegion_t                 regions[MODBUS_REGION_MAX];
+    uint16_t                    numRegions;
+    uint8_t                     slaveAddr;
+    uint8_t                     input;          ///< 1 input registers (0x04), 0 holding registers (0x03)
+    uint8_t                     complete;       ///< 1 scan finished, all regions fit into the map
+} modRegionMap_t;
+
+/** Scan state **/
+typedef enum
+{
+    eMOD_SCAN_IDLE,
+    eMOD_SCAN_BLOCK,                ///< reading block at pos
+    eMOD_SCAN_PREFIX,               ///< bisecting readable prefix of failed block
+    eMOD_SCAN_SKIP,                 ///< skipping unreadable space
+    eMOD_SCAN_SEARCH,               ///< bisecting start of found readable run
+    eMOD_SCAN_DONE
+} modRegScanState_t;
+
+/**
+ * @brief   Scanner structure, uses one master stack exclusively while scanning
+ */
+typedef struct
+{
+    modMasterStack_t*           mstack;
+    modRegionMap_t*             map;            ///< map being filled
+    uint16_t                    block;          ///< max. registers per read, halved if slave reports illegal value
+    uint16_t                    maxSkip;        ///< max. step in unreadable space, MODBUS_REGSCAN_MAX_SKIP after init
+    uint8_t                     maxRetries;     ///< retries of timed out / corrupted read (then taken as unreadable)
+    modRegScanState_t           state;
+    uint32_t                    pos;            ///< first not yet scanned register (end of found run + 1 in search)
+    uint32_t                    last;           ///< last register to scan
+    uint32_t                    lo;             ///< bisection bounds
+    uint32_t                    hi;
+    uint32_t                    unreadable;     ///< last register known unreadable
+    uint16_t                    step;           ///< current skip step
+    uint32_t                    probeFirst;     ///< read on the fly
+    uint16_t                    probeNum;
+    uint8_t                     probing;
+    uint8_t                     retries;
+    uint32_t                    transactions;   ///< reads sent by the scan
+    uint16_t                    regs[MODBUS_MAX_READ_REGS];     ///< read data, discarded
+    void*                       userContent;    ///< user defined pointer, can by used to pass anything
+} modRegScan_t;
+
+/**
+ * @brief           Initializes scanner with default settings
+ * @param scan      Pointer to scanner structure
+ * @param mstack    Initialized master stack
+ * @return int16_t  0 if OK, -2 wrong params
+ */
+int16_t ModRegScanInit(modRegScan_t* scan, modMasterStack_t* mstack);
+
+/**
+ * @brief           Starts mapping of register space
+ * @param scan      Pointer to scanner structure
+ * @param map       Map to be filled (cleared here)
+ * @param slaveAddr Slave device address
+ * @param input     1 scan input registers, 0 holding registers
+ * @param first     First register to scan
+ * @param last      Last register to scan
+ * @return int16_t  0 if OK, -1 scan is running, -2 wrong params
+ */
+int16_t ModRegScanStart(modRegScan_t* scan, modRegionMap_t* map, uint8_t slaveAddr, uint8_t input, uint16_t first,
+                        uint16_t last);
+
+/**
+ * @brief           Main function of scanner, has to be called periodically until scan is done
+ * @param scan      Pointer to scanner structure
+ * @return int16_t  0 if scan is ongoing, 1 if done (map->complete tells if it was finished)
+ */
+int16_t ModRegScanCheck(modRegScan_t* scan);
+
+/**
+ * @brief           Finds region containing whole range
+ * @param map       Pointer to region map
+ * @param first     First register of range
+ * @param last      Last register of range
+ * @return int16_t  Index of region, -1 if range isn't inside one readable region
+ */
+int16_t ModRegionFind(const modRegionMap_t* map, uint16_t first, uint16_t last);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_REGSCAN_H */
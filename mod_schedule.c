@@ -0,0 +1,277 @@
+#include <stdio.h>
+#include <string.h>
+#include "mod_schedule.h"
+
+// signed distance of clock values, clock wraps around
+#define MODBUS_SCHEDULE_DIFF(a, b)  ((int32_t)((uint32_t)(a) - (uint32_t)(b)))
+
+int16_t ModScheduleInit(modSchedule_t* sched, modMasterStack_t* mstack, uint32_t baud, uint32_t turnaroundUs)
+{
+    if (mstack == NULL || baud == 0)
+    {
+        return -2; // wrong params
+    }
+
+    memset(sched, 0, sizeof(*sched));
+    sched->mstack = mstack;
+    sched->charUs = ModMasterCharTimeUs(baud);
+    sched->gapUs = ModMasterFrameGapUs(baud);
+    sched->turnaroundUs = turnaroundUs;
+
+    return 0;
+}
+
+// worst case length of slot: request, answer timeout and gap; timeout covers turnaround and the longest answer
+static int16_t ModScheduleSlotLength(const modSchedule_t* sched, modSlot_t* slot)
+{
+    uint32_t reqBytes;
+    uint32_t respBytes;
+
+    switch (slot->op)
+    {
+    case eMOD_REQ_READ_REGS:
+    case eMOD_REQ_READ_INPUT_REGS:
+        if (slot->numRegs == 0 || slot->numRegs > MODBUS_MAX_READ_REGS)
+        {
+            return -2;
+        }
+        reqBytes = 8;
+        respBytes = 5 + 2 * slot->numRegs;
+        break;
+    case eMOD_REQ_WRITE_REGS:
+        if (slot->numRegs == 0 || slot->numRegs > MODBUS_MAX_WRITE_REGS)
+        {
+            return -2;
+        }
+        reqBytes = 9 + 2 * slot->numRegs;
+        respBytes = slot->slaveAddr == 0 ? 0 : 8;
+        break;
+    default:
+        return -2; // answer length isn't known in advance
+    }
+    if (slot->regs == NULL)
+    {
+        return -2;
+    }
+
+    // stack counts timeout in whole ms from truncated start time and reports it at first check after more
+    // than timeoutMs elapsed - up to 2 ms and one poll period later
+    slot->timeoutMs = (uint16_t)((sched->turnaroundUs + respBytes * sched->charUs + 999) / 1000);
+    slot->lengthUs = reqBytes * sched->charUs + (slot->timeoutMs + 2) * 1000u + MODBUS_SCHEDULE_POLL_US +
+                     sched->gapUs;
+
+    return 0;
+}
+
+int16_t ModScheduleBuild(modSchedule_t* sched, modSlot_t* slots, uint16_t numSlots, uint32_t cycleUs)
+{
+    uint32_t end = 0;
+    uint32_t busy = 0;
+
+    if (sched->running || sched->active)
+    {
+        return -3; // schedule is running
+    }
+    if (slots == NULL || numSlots == 0)
+    {
+        return -2; // wrong params
+    }
+
+    for (uint16_t i = 0; i < numSlots; i++)
+    {
+        modSlot_t* slot = &slots[i];
+
+        if (ModScheduleSlotLength(sched, slot) < 0)
+        {
+            return -2; // wrong slot
+        }
+        if (slot->offsetUs < end)
+        {
+            slot->offsetUs = end;
+        }
+        end = slot->offsetUs + slot->lengthUs;
+        busy += slot->lengthUs;
+        slot->result = eMOD_M_STATE_STANDBY;
+        slot->errCode = 0;
+        slot->lateUs = 0;
+        slot->maxLateUs = 0;
+        slot->overruns = 0;
+    }
+
+    sched->slots = slots;
+    sched->numSlots = numSlots;
+    sched->busyUs = busy;
+    sched->cycleUs = cycleUs == 0 ? end : cycleUs;
+
+    return end > sched->cycleUs ? -1 : 0;
+}
+
+int16_t ModScheduleStart(modSchedule_t* sched, uint32_t nowUs)
+{
+    if (sched->slots == NULL || sched->cycleUs == 0 || sched->active)
+    {
+        return -1; // no schedule
+    }
+
+    sched->cycleStart = nowUs;
+    sched->busFree = nowUs;
+    sched->current = 0;
+    sched->running = 1;
+
+    return 0;
+}
+
+void ModScheduleStop(modSchedule_t* sched)
+{
+    sched->running = 0;
+    if (!sched->active)
+    {
+        ModMasterSetTimeout(sched->mstack, MODBUS_RX_TIMEOUT); // timeout of last slot isn't for ad-hoc requests
+    }
+}
+
+// finish running slot if the stack has result
+static uint8_t ModScheduleFinish(modSchedule_t* sched, uint32_t nowUs)
+{
+    modSlot_t* slot = &sched->slots[sched->current];
+    modMasterState_t status;
+    uint8_t err = 0;
+    int32_t over;
+
+    if (!ModMasterCheck(sched->mstack, &status, &err))
+    {
+        return 0; // still waiting
+    }
+
+    sched->active = 0;
+    if (!sched->running)
+    {
+        ModMasterSetTimeout(sched->mstack, MODBUS_RX_TIMEOUT); // stopped while slot was running
+    }
+    slot->result = status;
+    slot->errCode = err;
+    sched->busFree = nowUs + sched->gapUs;
+    over = MODBUS_SCHEDULE_DIFF(nowUs + sched->gapUs, sched->cycleStart + slot->offsetUs + slot->lengthUs);
+    if (over > 0)
+    {
+        slot->overruns++;
+        sched->overruns++;
+        if (sched->pfOverrun != NULL)
+        {
+            sched->pfOverrun(sched, sched->current, (uint32_t)over);
+        }
+    }
+    sched->current++;
+
+    return 1;
+}
+
+// start slot, returns 0 if started, -1 stack is busy
+static int16_t ModScheduleStartSlot(modSchedule_t* sched, modSlot_t* slot, uint32_t late)
+{
+    int16_t r;
+
+    ModMasterSetTimeout(sched->mstack, slot->timeoutMs);
+    switch (slot->op)
+    {
+    case eMOD_REQ_WRITE_REGS:
+        r = ModMasterWriteRegs(sched->mstack, slot->slaveAddr, slot->firstReg, slot->numRegs, slot->regs);
+        break;
+    case eMOD_REQ_READ_INPUT_REGS:
+        r = ModMasterReadInputRegs(sched->mstack, slot->slaveAddr, slot->firstReg, slot->numRegs, slot->regs);
+        break;
+    default:
+        r = ModMasterReadRegs(sched->mstack, slot->slaveAddr, slot->firstReg, slot->numRegs, slot->regs);
+        break;
+    }
+    if (r == -1)
+    {
+        return -1;
+    }
+
+    // HW error is reported by next check
+    sched->active = 1;
+    slot->lateUs = late;
+    if (late > slot->maxLateUs)
+    {
+        slot->maxLateUs = late;
+    }
+
+    return 0;
+}
+
+int32_t ModScheduleRun(modSchedule_t* sched, uint32_t nowUs)
+{
+    if (sched->active)
+    {
+        const modSlot_t* slot = &sched->slots[sched->current];
+        int32_t left;
+
+        if (!ModScheduleFinish(sched, nowUs))
+        {
+            left = MODBUS_SCHEDULE_DIFF(sched->cycleStart + slot->offsetUs + slot->lengthUs, nowUs);
+            return (left > 0 && left < MODBUS_SCHEDULE_POLL_US) ? left : MODBUS_SCHEDULE_POLL_US;
+        }
+    }
+    if (!sched->running)
+    {
+        return -1;
+    }
+
+    for (;;)
+    {
+        modSlot_t* slot;
+        uint32_t due;
+        int32_t wait;
+
+        if (sched->current >= sched->numSlots)
+        {
+            // end of cycle, next one starts on the grid
+            wait = MODBUS_SCHEDULE_DIFF(sched->cycleStart + sched->cycleUs, nowUs);
+            if (wait > 0)
+            {
+                return wait;
+            }
+            sched->cycles++;
+            if (sched->pfCycle != NULL)
+            {
+                sched->pfCycle(sched);
+                if (!sched->running)
+                {
+                    return -1;
+                }
+            }
+            sched->cycleStart += sched->cycleUs;
+            while (MODBUS_SCHEDULE_DIFF(nowUs, sched->cycleStart + sched->cycleUs) >= 0)
+            {
+                // whole cycles were missed, keep the grid
+                sched->cycleStart += sched->cycleUs;
+                sched->skipped++;
+            }
+            sched->current = 0;
+        }
+
+        slot = &sched->slots[sched->current];
+        due = sched->cycleStart + slot->offsetUs;
+        if (MODBUS_SCHEDULE_DIFF(sched->busFree, due) > 0)
+        {
+            due = sched->busFree; // previous slot overran, bus has to be silent first
+        }
+        wait = MODBUS_SCHEDULE_DIFF(due, nowUs);
+        if (wait > 0)
+        {
+            return wait;
+        }
+
+        if (ModScheduleStartSlot(sched, slot, (uint32_t)MODBUS_SCHEDULE_DIFF(nowUs, sched->cycleStart + slot->offsetUs)) < 0)
+        {
+            return MODBUS_SCHEDULE_POLL_US; // stack is busy (no free message buffer), try again
+        }
+        slot->startUs = nowUs;
+        if (!ModScheduleFinish(sched, nowUs))
+        {
+            return MODBUS_SCHEDULE_POLL_US;
+        }
+        // answered synchronously (loopback, HW error), continue by next slot
+    }
+}
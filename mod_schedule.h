@@ -0,0 +1,152 @@
+/**
+ * @file    mod_schedule.h
+ * @brief   Time-triggered master. Cyclic schedule of slots (slave, operation, start offset) is computed offline
+ *          from baud-rate timing by @ref ModScheduleBuild() - each slot gets its worst case length (request,
+ *          answer timeout covering turnaround and longest answer, inter-frame gap) and the slots are placed
+ *          so they never overlap. @ref ModScheduleRun() starts each slot at its offset from cycle start
+ *          (cycles follow each other on fixed grid of monotonic clock, no drift), so every value is sampled
+ *          with bounded jitter. Slot finished after end of its window is reported as overrun.
+ *
+ *          Scheduler owns the master stack, don't use it for other operations (request queue, discovery)
+ *          meanwhile. Clock is passed by caller in microseconds (e.g. ModPortTimeUs() on Linux, free running
+ *          hardware timer on MCU), it may wrap around.
+ */
+
+#ifndef SYSTEM_MOD_SCHEDULE_H
+#define SYSTEM_MOD_SCHEDULE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "mod_master_req.h"
+
+#define MODBUS_SCHEDULE_POLL_US     500     ///< max. sleep while answer is awaited (stack checks timeout by polling)
+
+typedef struct modSchedule_s modSchedule_t;
+
+/**
+ * @brief   Called when slot finished after end of its window (slave answered late, the stack was busy, previous
+ *          slot overran or the loop was called late)
+ * @param overUs    How long after end of window the slot finished
+ */
+typedef void (*pfModScheduleOverrun_t)(modSchedule_t* sched, uint16_t slot, uint32_t overUs);
+
+/**
+ * @brief   Called when all slots of the cycle are finished, results of slots form one sample set
+ */
+typedef void (*pfModScheduleCycle_t)(modSchedule_t* sched);
+
+/**
+ * @brief   Slot of the schedule. Operations read holding / input registers and write registers are supported.
+ */
+typedef struct
+{
+    // parameters
+    modMasterReqOp_t            op;             ///< operation
+    uint8_t                     slaveAddr;      ///< address of slave device
+    uint16_t                    firstReg;       ///< first register
+    uint16_t                    numRegs;        ///< number of registers
+    uint16_t*                   regs;           ///< storage of read / values to write
+    uint32_t                    offsetUs;       ///< wanted start from cycle start (0 = as soon as possible),
+                                                ///< @ref ModScheduleBuild() replaces it by actual start
+    // computed by ModScheduleBuild()
+    uint32_t                    lengthUs;       ///< worst case length of slot
+    uint16_t                    timeoutMs;      ///< answer timeout
+
+    // results
+    modMasterState_t            result;         ///< result of last run
+    uint8_t                     errCode;        ///< error code reported by slave, if result is eMOD_M_STATE_ERR_REPORTED
+    uint32_t                    startUs;        ///< clock at last start (sample time of read values)
+    uint32_t                    lateUs;         ///< how late was last start
+    uint32_t                    maxLateUs;      ///< worst start jitter
+    uint32_t                    overruns;       ///< number of runs finished after end of window
+} modSlot_t;
+
+/**
+ * @brief   Scheduler structure
+ */
+struct modSchedule_s
+{
+    // parameters
+    modMasterStack_t*           mstack;         ///< stack of the bus, used by scheduler only
+    uint32_t                    charUs;         ///< time of one character
+    uint32_t                    gapUs;          ///< silence between frames
+    uint32_t                    turnaroundUs;   ///< max. time from end of request to start of answer
+    pfModScheduleOverrun_t      pfOverrun;      ///< overrun callback, can be NULL
+    pfModScheduleCycle_t        pfCycle;        ///< end of cycle callback, can be NULL
+
+    // schedule, set by ModScheduleBuild()
+    modSlot_t*                  slots;
+    uint16_t                    numSlots;
+    uint32_t                    cycleUs;        ///< cycle period
+    uint32_t                    busyUs;         ///< sum of slot lengths
+
+    // internal
+    uint32_t                    cycleStart;     ///< clock at start of current cycle
+    uint32_t                    busFree;        ///< clock when inter-frame gap after last frame ends
+    uint16_t                    current;        ///< slot running / waiting for its offset
+    uint8_t                     active;         ///< 1 if slot is on the bus
+    uint8_t                     running;        ///< 1 if schedule was started
+
+    // statistics
+    uint32_t                    cycles;         ///< finished cycles
+    uint32_t                    overruns;       ///< overrun slots
+    uint32_t                    skipped;        ///< cycles skipped because previous one ran over their start
+
+    void*                       userContent;    ///< user defined pointer, can by used to pass anything
+};
+
+/**
+ * @brief               Initializes scheduler, timing of frames is derived from baud rate
+ * @warning             mstack has to be initialized by @ref ModMasterInit() already
+ * @param sched         Pointer to scheduler structure
+ * @param mstack        Master stack of the bus
+ * @param baud          Baud rate of the bus
+ * @param turnaroundUs  Max. time from end of request to start of answer of all scheduled slaves
+ * @return int16_t      0 if OK, -2 wrong params
+ */
+int16_t ModScheduleInit(modSchedule_t* sched, modMasterStack_t* mstack, uint32_t baud, uint32_t turnaroundUs);
+
+/**
+ * @brief           Computes length of each slot and places slots in order of the array, each one at its wanted
+ *                  offset or right after end of previous slot
+ * @param sched     Pointer to scheduler structure
+ * @param slots     Slots, have to stay valid while schedule runs
+ * @param numSlots  Number of slots
+ * @param cycleUs   Cycle period, 0 = shortest possible (end of last slot)
+ * @return int16_t  0 if OK, -1 slots don't fit into the cycle (cycleUs / busyUs tell by how much),
+ *                  -2 wrong params (unsupported operation, too many registers), -3 schedule is running
+ */
+int16_t ModScheduleBuild(modSchedule_t* sched, modSlot_t* slots, uint16_t numSlots, uint32_t cycleUs);
+
+/**
+ * @brief           Starts first cycle now
+ * @param sched     Pointer to scheduler structure
+ * @param nowUs     Clock
+ * @return int16_t  0 if OK, -1 no schedule built
+ */
+int16_t ModScheduleStart(modSchedule_t* sched, uint32_t nowUs);
+
+/**
+ * @brief           Stops schedule after running slot (if any) is finished by @ref ModScheduleRun(), answer timeout
+ *                  of the stack is set back to MODBUS_RX_TIMEOUT then
+ * @param sched     Pointer to scheduler structure
+ */
+void ModScheduleStop(modSchedule_t* sched);
+
+/**
+ * @brief           Starts / finishes slots by clock. Call it when time returned by last call elapsed and when
+ *                  Rx-done or Rx-error callback of the stack was called.
+ * @param sched     Pointer to scheduler structure
+ * @param nowUs     Clock
+ * @return int32_t  Microseconds until next call is needed, -1 schedule doesn't run
+ */
+int32_t ModScheduleRun(modSchedule_t* sched, uint32_t nowUs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_SCHEDULE_H */
@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <string.h>
+#include "mod_shmpub.h"
+
+// seqlock: one writer per block, any number of readers in other processes
+#if defined(__GNUC__)
+    #define SHMPUB_LOAD(var)            __atomic_load_n(&(var), __ATOMIC_ACQUIRE)
+    #define SHMPUB_LOAD_RELAXED(var)    __atomic_load_n(&(var), __ATOMIC_RELAXED)
+    #define SHMPUB_STORE(var, v)        __atomic_store_n(&(var), (v), __ATOMIC_RELEASE)
+    #define SHMPUB_STORE_RELAXED(var, v) __atomic_store_n(&(var), (v), __ATOMIC_RELAXED)
+    #define SHMPUB_FENCE_ACQUIRE()      __atomic_thread_fence(__ATOMIC_ACQUIRE)
+    #define SHMPUB_FENCE_RELEASE()      __atomic_thread_fence(__ATOMIC_RELEASE)
+#else
+    #define SHMPUB_LOAD(var)            (var)
+    #define SHMPUB_LOAD_RELAXED(var)    (var)
+    #define SHMPUB_STORE(var, v)        ((var) = (v))
+    #define SHMPUB_STORE_RELAXED(var, v) ((var) = (v))
+    #define SHMPUB_FENCE_ACQUIRE()
+    #define SHMPUB_FENCE_RELEASE()
+#endif
+
+#define SHMPUB_ALIGN(x)                 (((x) + 63u) & ~63u)
+
+uint32_t ModShmPubSize(uint16_t numItems)
+{
+    // devices are counted as if every item had own device
+    return SHMPUB_ALIGN(sizeof(modShmPubHeader_t) + numItems * (sizeof(modShmPubDevice_t) + sizeof(uint16_t))) +
+           numItems * (uint32_t)sizeof(modShmPubBlock_t);
+}
+
+int16_t ModShmPubInit(modShmPub_t* pub, void* mem, uint32_t size, const modPollItem_t* items, uint16_t numItems)
+{
+    modShmPubHeader_t* h = (modShmPubHeader_t*)mem;
+    modShmPubDevice_t* devices;
+    uint16_t* lists;
+    uint16_t numDevices = 0;
+    uint32_t n = 0;
+
+    if (mem == NULL || ((uintptr_t)mem % 64) != 0 || items == NULL || numItems == 0)
+    {
+        return -2; // wrong params
+    }
+    for (uint16_t i = 0; i < numItems; i++)
+    {
+        if (items[i].numRegs == 0 || items[i].numRegs > MODBUS_SHMPUB_REGS)
+        {
+            return -2;
+        }
+    }
+    if (size < ModShmPubSize(numItems))
+    {
+        return -1; // segment too small
+    }
+
+    // readers attached meanwhile see no magic yet
+    memset(mem, 0, size);
+    devices = (modShmPubDevice_t*)((uint8_t*)mem + sizeof(modShmPubHeader_t));
+    lists = (uint16_t*)((uint8_t*)devices + numItems * sizeof(modShmPubDevice_t));
+    pub->header = h;
+    pub->blocks = (modShmPubBlock_t*)((uint8_t*)mem + (ModShmPubSize(numItems) - numItems * sizeof(modShmPubBlock_t)));
+    pub->numBlocks = numItems;
+    pub->size = size;
+    pub->updates = 0;
+
+    for (uint16_t i = 0; i < numItems; i++)
+    {
+        modShmPubBlock_t* b = &pub->blocks[i];
+
+        b->input = (items[i].op == eMOD_REQ_READ_INPUT_REGS) ? 1 : 0;
+        b->result = eMOD_M_STATE_STANDBY;
+        b->firstReg = items[i].firstReg;
+        b->numRegs = items[i].numRegs;
+    }
+    // devices sorted by address, blocks of device in order of items
+    for (uint16_t addr = 0; addr < 256; addr++)
+    {
+        uint32_t first = n;
+
+        for (uint16_t i = 0; i < numItems; i++)
+        {
+            if (items[i].slaveAddr == addr)
+            {
+                lists[n++] = i;
+            }
+        }
+        if (n != first)
+        {
+            devices[numDevices].slaveAddr = (uint8_t)addr;
+            devices[numDevices].numBlocks = (uint16_t)(n - first);
+            devices[numDevices].firstList = first;
+            numDevices++;
+        }
+    }
+
+    h->version = MODBUS_SHMPUB_VERSION;
+    h->numDevices = numDevices;
+    h->size = size;
+    h->numBlocks = numItems;
+    h->devices = (uint32_t)((uint8_t*)devices - (uint8_t*)mem);
+    h->lists = (uint32_t)((uint8_t*)lists - (uint8_t*)mem);
+    h->blocks = (uint32_t)((uint8_t*)pub->blocks - (uint8_t*)mem);
+    h->state = MODBUS_SHMPUB_LIVE;
+    SHMPUB_STORE(h->magic, MODBUS_SHMPUB_MAGIC);
+
+    return 0;
+}
+
+void ModShmPubPollUpdate(modPoller_t* poller, modPollItem_t* item)
+{
+    modShmPub_t* pub = (modShmPub_t*)poller->userContent;
+    uint32_t index = (uint32_t)(item - poller->items);
+    modShmPubBlock_t* b;
+    uint32_t seq;
+
+    if (index >= pub->numBlocks)
+    {
+        return;
+    }
+    b = &pub->blocks[index];
+    seq = b->seq;
+
+    SHMPUB_STORE_RELAXED(b->seq, seq + 1);
+    SHMPUB_FENCE_RELEASE(); // odd sequence is visible before any change of data
+    b->result = (uint8_t)item->result;
+    b->errCode = item->errCode;
+    if (item->result == eMOD_M_STATE_PROCESSED)
+    {
+        memcpy(b->regs, item->regs, b->numRegs * sizeof(uint16_t));
+        b->updateUs = (pub->pfTime != NULL) ? pub->pfTime(pub) : (uint64_t)item->sampleTime * 1000u;
+        b->samples++;
+    }
+    else
+    {
+        b->errors++;
+    }
+    SHMPUB_STORE(b->seq, seq + 2);
+    pub->updates++;
+}
+
+void ModShmPubClose(modShmPub_t* pub)
+{
+    if (pub->header != NULL)
+    {
+        SHMPUB_STORE(pub->header->state, MODBUS_SHMPUB_CLOSED);
+    }
+}
+
+int16_t ModShmPubOpen(modShmPubView_t* view, const void* mem, uint32_t size)
+{
+    const uint8_t* base = (const uint8_t*)mem;
+    const modShmPubHeader_t* h = (const modShmPubHeader_t*)mem;
+
+    if (mem == NULL || ((uintptr_t)mem % 64) != 0 || size < sizeof(modShmPubHeader_t))
+    {
+        return -2; // wrong segment
+    }
+    if (SHMPUB_LOAD(h->magic) != MODBUS_SHMPUB_MAGIC)
+    {
+        return -1; // writer didn't finish init yet
+    }
+    if (h->version != MODBUS_SHMPUB_VERSION || h->size > size || h->blocks % 64 != 0 ||
+        h->devices > h->size || (uint64_t)h->numDevices * sizeof(modShmPubDevice_t) > h->size - h->devices ||
+        h->lists > h->size || (uint64_t)h->numBlocks * sizeof(uint16_t) > h->size - h->lists ||
+        h->blocks > h->size || (uint64_t)h->numBlocks * sizeof(modShmPubBlock_t) > h->size - h->blocks)
+    {
+        return -2;
+    }
+
+    view->header = h;
+    view->devices = (const modShmPubDevice_t*)(base + h->devices);
+    view->lists = (const uint16_t*)(base + h->lists);
+    view->blocks = (const modShmPubBlock_t*)(base + h->blocks);
+    view->size = size;
+
+    // indexes are checked once here, lookups can trust them
+    for (uint16_t d = 0; d < h->numDevices; d++)
+    {
+        if ((uint64_t)view->devices[d].firstList + view->devices[d].numBlocks > h->numBlocks)
+        {
+            return -2;
+        }
+    }
+    for (uint32_t i = 0; i < h->numBlocks; i++)
+    {
+        if (view->lists[i] >= h->numBlocks || view->blocks[i].numRegs > MODBUS_SHMPUB_REGS)
+        {
+            return -2;
+        }
+    }
+
+    return 0;
+}
+
+const modShmPubBlock_t* ModShmPubFind(const modShmPubView_t* view, uint8_t slaveAddr, uint8_t input, uint16_t regAddr)
+{
+    int32_t lo = 0;
+    int32_t hi = (int32_t)view->header->numDevices - 1;
+
+    input = input ? 1 : 0;
+    while (lo <= hi)
+    {
+        int32_t mid = (lo + hi) / 2;
+        const modShmPubDevice_t* dev = &view->devices[mid];
+
+        if (slaveAddr < dev->slaveAddr)
+        {
+            hi = mid - 1;
+        }
+        else if (slaveAddr > dev->slaveAddr)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            for (uint16_t i = 0; i < dev->numBlocks; i++)
+            {
+                const modShmPubBlock_t* b = &view->blocks[view->lists[dev->firstList + i]];
+
+                // layout of block doesn't change, no seqlock needed
+                if (b->input == input && regAddr >= b->firstReg && (uint32_t)regAddr < (uint32_t)b->firstReg + b->numRegs)
+                {
+                    return b;
+                }
+            }
+            return NULL;
+        }
+    }
+
+    return NULL;
+}
+
+uint32_t ModShmPubReadBegin(const modShmPubBlock_t* block)
+{
+    uint32_t seq = 1;
+
+    for (uint32_t i = 0; i < MODBUS_SHMPUB_RETRIES; i++)
+    {
+        seq = SHMPUB_LOAD(block->seq);
+        if ((seq & 1) == 0)
+        {
+            return seq;
+        }
+    }
+
+    return seq; // odd, retry reports change
+}
+
+uint8_t ModShmPubReadRetry(const modShmPubBlock_t* block, uint32_t seq)
+{
+    SHMPUB_FENCE_ACQUIRE(); // data were read before sequence is checked again
+
+    return ((seq & 1) != 0 || SHMPUB_LOAD_RELAXED(block->seq) != seq) ? 1 : 0;
+}
+
+int16_t ModShmPubRead(const modShmPubBlock_t* block, uint16_t regAddr, uint16_t num, uint16_t* regs,
+                      uint32_t* generation, uint64_t* updateUs)
+{
+    if (regs == NULL || regAddr < block->firstReg || (uint32_t)regAddr + num > (uint32_t)block->firstReg + block->numRegs)
+    {
+        return -2; // outside of block
+    }
+
+    for (uint32_t i = 0; i < MODBUS_SHMPUB_RETRIES; i++)
+    {
+        uint32_t seq = ModShmPubReadBegin(block);
+        uint64_t t = block->updateUs;
+
+        memcpy(regs, &block->regs[regAddr - block->firstReg], num * sizeof(uint16_t));
+        if (!ModShmPubReadRetry(block, seq))
+        {
+            if (generation != NULL)
+            {
+                *generation = seq / 2;
+            }
+            if (updateUs != NULL)
+            {
+                *updateUs = t;
+            }
+            return 0;
+        }
+    }
+
+    return -1; // block is being written too long
+}
@@ -0,0 +1,202 @@
+/**
+ * @file    mod_shmpub.h
+ * @brief   Publication of polled register images in shared memory. Every poll item gets fixed-size block holding its
+ *          registers, result of last read and time of last sample. Block is protected by seqlock: writer makes its
+ *          sequence odd, updates the block and makes it even again, so sequence / 2 is generation of the block.
+ *          Readers (other processes) map the segment read-only and read registers in place - no syscalls, no locks,
+ *          writer is never blocked by them. Read is repeated when sequence changed meanwhile.
+ *
+ *          Writer: @ref ModShmPubPollUpdate() as pfUpdate of the poller. Readers: @ref ModShmPubFind() + @ref
+ *          ModShmPubRead(), or @ref ModShmPubReadBegin() / @ref ModShmPubReadRetry() around own in-place access.
+ *          Segment lives in POSIX shared memory on Linux (@ref mod_shmpub_linux.h), any memory shared by tasks
+ *          works as well.
+ *
+ *          Segment layout (native byte order, blocks 64-byte aligned): header, devices sorted by slave address,
+ *          block indexes of each device, blocks (in order of poll items).
+ */
+
+#ifndef SYSTEM_MOD_SHMPUB_H
+#define SYSTEM_MOD_SHMPUB_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "mod_poller.h"
+
+#define MODBUS_SHMPUB_MAGIC         0x3150534Du     ///< "MSP1"
+#define MODBUS_SHMPUB_VERSION       1
+#define MODBUS_SHMPUB_REGS          125     ///< registers of block (fixed, layout doesn't depend on build)
+#define MODBUS_SHMPUB_RETRIES       1000    ///< attempts of reader before it gives up (writer died while writing)
+
+/**
+ * @defgroup ModbusShmPubStates State of segment
+ * @{
+ */
+#define MODBUS_SHMPUB_LIVE          1       ///< writer publishes into segment
+#define MODBUS_SHMPUB_CLOSED        2       ///< segment was replaced or writer stopped, readers should attach again
+/** @} */
+
+/** Segment header */
+typedef struct
+{
+    uint32_t                    magic;          ///< MODBUS_SHMPUB_MAGIC, written last by init
+    uint16_t                    version;        ///< MODBUS_SHMPUB_VERSION
+    uint16_t                    numDevices;
+    uint32_t                    size;           ///< size of segment
+    uint32_t                    numBlocks;
+    uint32_t                    devices;        ///< offset of device table
+    uint32_t                    lists;          ///< offset of block indexes (uint16_t) of devices
+    uint32_t                    blocks;         ///< offset of blocks
+    uint32_t                    state;          ///< see @ref ModbusShmPubStates
+} modShmPubHeader_t;
+
+/** Device */
+typedef struct
+{
+    uint8_t                     slaveAddr;
+    uint8_t                     reserved;
+    uint16_t                    numBlocks;
+    uint32_t                    firstList;      ///< index of its first block index in lists
+} modShmPubDevice_t;
+
+/** Register image of one poll item, 320 bytes */
+typedef struct
+{
+    uint32_t                    seq;            ///< seqlock, odd while block is being written
+    uint8_t                     input;          ///< 1 input registers, 0 holding registers
+    uint8_t                     result;         ///< @ref modMasterState_t of last read
+    uint8_t                     errCode;        ///< exception code, if result is eMOD_M_STATE_ERR_REPORTED
+    uint8_t                     reserved;
+    uint16_t                    firstReg;
+    uint16_t                    numRegs;
+    uint32_t                    samples;        ///< successful reads
+    uint32_t                    errors;         ///< failed reads
+    uint32_t                    reserved2;
+    uint64_t                    updateUs;       ///< time of last successful read (CLOCK_MONOTONIC on Linux) [us]
+    uint16_t                    regs[MODBUS_SHMPUB_REGS];   ///< values of last successful read
+    uint16_t                    pad[19];        ///< to multiple of cache line
+} modShmPubBlock_t;
+
+typedef struct modShmPub_s modShmPub_t;
+
+/**
+ * @brief   Timestamp of sample [us]
+ */
+typedef uint64_t (*pfModShmPubTime_t)(modShmPub_t* pub);
+
+/**
+ * @brief   Writer structure
+ */
+struct modShmPub_s
+{
+    // parameters
+    pfModShmPubTime_t           pfTime;         ///< can be NULL, sampleTime of poll item is used then (ms)
+
+    // internal
+    modShmPubHeader_t*          header;
+    modShmPubBlock_t*           blocks;
+    uint16_t                    numBlocks;
+    uint32_t                    size;           ///< size of segment
+
+    // statistics
+    uint32_t                    updates;        ///< published updates
+
+    void*                       userContent;    ///< user defined pointer, can by used to pass anything
+};
+
+/**
+ * @brief   Reader structure, all pointers point into the segment
+ */
+typedef struct
+{
+    const modShmPubHeader_t*    header;
+    const modShmPubDevice_t*    devices;
+    const uint16_t*             lists;
+    const modShmPubBlock_t*     blocks;
+    uint32_t                    size;           ///< size of mapping
+} modShmPubView_t;
+
+/**
+ * @brief           Size of segment for poll list
+ * @param numItems  Number of poll items
+ * @return uint32_t Size [B]
+ */
+uint32_t ModShmPubSize(uint16_t numItems);
+
+/**
+ * @brief           Builds segment for poll list, one block per item (items have to be valid for @ref ModPollerStart())
+ * @param pub       Pointer to writer structure
+ * @param mem       Segment, 64-byte aligned, @ref ModShmPubSize() bytes
+ * @param size      Size of segment
+ * @param items     Poll items, same array as passed to the poller
+ * @param numItems  Number of items
+ * @return int16_t  0 if OK, -1 segment is too small, -2 wrong params
+ */
+int16_t ModShmPubInit(modShmPub_t* pub, void* mem, uint32_t size, const modPollItem_t* items, uint16_t numItems);
+
+/**
+ * @brief   pfUpdate callback of poller, poller->userContent points to @ref modShmPub_t.
+ *          Registers and time are updated by successful read, result and counters by every read.
+ */
+void ModShmPubPollUpdate(modPoller_t* poller, modPollItem_t* item);
+
+/**
+ * @brief           Marks segment closed, attached readers should attach again
+ * @param pub       Pointer to writer structure
+ */
+void ModShmPubClose(modShmPub_t* pub);
+
+/**
+ * @brief           Opens segment for reading, checks header and bounds of all tables
+ * @param view      Pointer to reader structure
+ * @param mem       Segment
+ * @param size      Size of segment (mapping)
+ * @return int16_t  0 if OK, -1 segment isn't initialized yet, -2 wrong segment
+ */
+int16_t ModShmPubOpen(modShmPubView_t* view, const void* mem, uint32_t size);
+
+/**
+ * @brief           Finds block holding register of device (binary search of device, then its blocks)
+ * @param view      Opened segment
+ * @param slaveAddr Address of device
+ * @param input     1 input registers, 0 holding registers
+ * @param regAddr   Register address
+ * @return const modShmPubBlock_t* Block, NULL if register isn't polled
+ */
+const modShmPubBlock_t* ModShmPubFind(const modShmPubView_t* view, uint8_t slaveAddr, uint8_t input, uint16_t regAddr);
+
+/**
+ * @brief           Starts in-place read of block, waits while writer updates it
+ * @param block     Block
+ * @return uint32_t Sequence to pass to @ref ModShmPubReadRetry()
+ */
+uint32_t ModShmPubReadBegin(const modShmPubBlock_t* block);
+
+/**
+ * @brief           Finishes in-place read of block
+ * @param block     Block
+ * @param seq       Sequence returned by @ref ModShmPubReadBegin()
+ * @return uint8_t  1 if block was changed meanwhile and read has to be repeated, 0 values read are consistent
+ */
+uint8_t ModShmPubReadRetry(const modShmPubBlock_t* block, uint32_t seq);
+
+/**
+ * @brief           Copies consistent registers of block
+ * @param block     Block
+ * @param regAddr   First register
+ * @param num       Number of registers
+ * @param regs      Values
+ * @param generation Generation of values (number of updates of block), can be NULL
+ * @param updateUs  Time of last successful read, can be NULL
+ * @return int16_t  0 if OK, -1 block is being written too long (writer died), -2 registers outside of block
+ */
+int16_t ModShmPubRead(const modShmPubBlock_t* block, uint16_t regAddr, uint16_t num, uint16_t* regs,
+                      uint32_t* generation, uint64_t* updateUs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_SHMPUB_H */
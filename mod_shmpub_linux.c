@@ -0,0 +1,160 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "mod_shmpub_linux.h"
+
+static uint64_t ModShmPubTime(modShmPub_t* pub)
+{
+    struct timespec ts;
+
+    (void)pub;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+// segment of previous writer is closed for its readers, then removed, returns -2 if object isn't a segment
+static int16_t ModShmPubReplace(const char* name)
+{
+    struct stat st;
+    void* mem = MAP_FAILED;
+    int16_t ret = -2;
+    int fd = shm_open(name, O_RDWR, 0);
+
+    if (fd < 0)
+    {
+        return 0; // nothing to replace (or no access, create reports it)
+    }
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(modShmPubHeader_t))
+    {
+        mem = mmap(NULL, sizeof(modShmPubHeader_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (mem != MAP_FAILED)
+    {
+        modShmPub_t old;
+
+        old.header = (modShmPubHeader_t*)mem;
+        // other object of the same name is kept untouched
+        if (old.header->magic == MODBUS_SHMPUB_MAGIC && old.header->version == MODBUS_SHMPUB_VERSION)
+        {
+            ModShmPubClose(&old);
+            ret = 0;
+        }
+        munmap(mem, sizeof(modShmPubHeader_t));
+    }
+    if (ret == 0)
+    {
+        shm_unlink(name);
+    }
+
+    return ret;
+}
+
+int16_t ModShmPubCreate(modShmPub_t* pub, const char* name, const modPollItem_t* items, uint16_t numItems)
+{
+    uint32_t size;
+    void* mem;
+    int fd;
+
+    if (name == NULL || items == NULL || numItems == 0)
+    {
+        return -2; // wrong params
+    }
+    size = ModShmPubSize(numItems);
+
+    if (ModShmPubReplace(name) < 0)
+    {
+        return -2; // object of the name isn't a segment
+    }
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        return -3;
+    }
+    if (ftruncate(fd, size) < 0)
+    {
+        close(fd);
+        shm_unlink(name);
+        return -3;
+    }
+    mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // mapping keeps the segment
+    if (mem == MAP_FAILED)
+    {
+        shm_unlink(name);
+        return -3;
+    }
+
+    pub->pfTime = ModShmPubTime;
+    if (ModShmPubInit(pub, mem, size, items, numItems) < 0)
+    {
+        munmap(mem, size);
+        shm_unlink(name);
+        return -2;
+    }
+
+    return 0;
+}
+
+void ModShmPubDestroy(modShmPub_t* pub, const char* name)
+{
+    if (pub->header != NULL)
+    {
+        ModShmPubClose(pub);
+        munmap(pub->header, pub->size);
+        pub->header = NULL;
+        pub->blocks = NULL;
+        pub->numBlocks = 0;
+    }
+    shm_unlink(name);
+}
+
+int16_t ModShmPubAttach(modShmPubView_t* view, const char* name)
+{
+    struct stat st;
+    void* mem;
+    int16_t ret;
+    int fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+
+    if (fd < 0)
+    {
+        return -3;
+    }
+    if (fstat(fd, &st) < 0 || st.st_size <= 0 || (uint64_t)st.st_size > 0xFFFFFFFFu)
+    {
+        close(fd);
+        return -3;
+    }
+    mem = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED)
+    {
+        return -3;
+    }
+    ret = ModShmPubOpen(view, mem, (uint32_t)st.st_size);
+    if (ret < 0)
+    {
+        munmap(mem, (size_t)st.st_size);
+        view->header = NULL;
+        return ret;
+    }
+
+    return 0;
+}
+
+void ModShmPubDetach(modShmPubView_t* view)
+{
+    if (view->header != NULL)
+    {
+        munmap((void*)view->header, view->size);
+        view->header = NULL;
+    }
+}
@@ -0,0 +1,57 @@
+/**
+ * @file    mod_shmpub_linux.h
+ * @brief   POSIX shared memory (shm_open, name like "/modbus-bus1") for @ref mod_shmpub.h. Writer creates segment
+ *          for its poll list, readers attach it read-only. Segment of previous writer is marked closed and
+ *          unlinked first, readers still mapping it see MODBUS_SHMPUB_CLOSED and attach again. Other shared memory
+ *          object of the same name is left untouched, creation fails then.
+ *          Timestamps are CLOCK_MONOTONIC, readers compare them with own clock_gettime() (vDSO, no syscall).
+ *          Link with -lrt on old glibc.
+ */
+
+#ifndef SYSTEM_MOD_SHMPUB_LINUX_H
+#define SYSTEM_MOD_SHMPUB_LINUX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "mod_shmpub.h"
+
+/**
+ * @brief           Creates segment for poll list and initializes writer by @ref ModShmPubInit()
+ * @param pub       Pointer to writer structure
+ * @param name      Name of shared memory object
+ * @param items     Poll items, same array as passed to the poller
+ * @param numItems  Number of items
+ * @return int16_t  0 if OK, -2 wrong params (or existing object of the name isn't a segment), -3 segment can't be
+ *                  created / mapped
+ */
+int16_t ModShmPubCreate(modShmPub_t* pub, const char* name, const modPollItem_t* items, uint16_t numItems);
+
+/**
+ * @brief           Marks segment closed, unmaps and removes it
+ * @param pub       Pointer to writer structure
+ * @param name      Name of shared memory object
+ */
+void ModShmPubDestroy(modShmPub_t* pub, const char* name);
+
+/**
+ * @brief           Maps segment read-only and opens it by @ref ModShmPubOpen()
+ * @param view      Pointer to reader structure
+ * @param name      Name of shared memory object
+ * @return int16_t  0 if OK, -1 segment isn't initialized yet, -2 wrong segment, -3 segment doesn't exist
+ */
+int16_t ModShmPubAttach(modShmPubView_t* view, const char* name);
+
+/**
+ * @brief           Unmaps segment attached by @ref ModShmPubAttach()
+ * @param view      Pointer to reader structure
+ */
+void ModShmPubDetach(modShmPubView_t* view);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_SHMPUB_LINUX_H */
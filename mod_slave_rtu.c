@@ -2,6 +2,10 @@
 #include <string.h>
 #include "mod_slave_rtu.h"
 #include "crc.h"
+#include "mod_trace.h"
+#ifdef MODBUS_STACK_STATS
+#include "mod_stats.h"
+#endif
 
 // MODBUS commands
 #define MODBUS_OPCODE_READ_OUT_REGS     0x03
@@ -14,27 +18,44 @@
     #define MODBUS_OPCODE_WRITE_DATA_PACKET 0x65
 #endif
 
+// every state transition goes through here
+#define SSTACK_SET_STATUS(mstack, state) \
+    do { (mstack)->status = (state); MODBUS_TRACE_S_STATE(mstack, state); } while (0)
+
 int16_t ModSlaveInit (modSlaveStack_t* mstack)
 {
     int16_t retval = 0;
 
     //MODBUS engine
 
+#ifdef MODBUS_SLAVE_MULTI_UNIT
+    if (   (mstack->address == 0 && mstack->pfUnit == NULL)
+#else
     if (   mstack->address == 0
+#endif
         || mstack->pfStandby == NULL
         || mstack->pfGetReg == NULL
         || mstack->pfSetReg == NULL
         || mstack->pfSendAns == NULL
 #ifdef MODBUS_USER_COMMANDS
         || mstack->pfGetPacket == NULL
-        || mstack->pfSetPacket = NULL
+        || mstack->pfSetPacket == NULL
 #endif
     ) {
         retval = -1; // wrong config
     }
+#ifdef MODBUS_MESSAGE_POOL
+    else if (mstack->pool == NULL || mstack->pool->bufferSize < MODBUS_MESSAGE_SIZE)
+    {
+        retval = -1; // wrong config, Rx callbacks copy up to MODBUS_MESSAGE_SIZE bytes into borrowed buffer
+    }
+#endif
     else
     {
-        mstack->status = eMOD_S_STATE_STANDBY;
+#ifdef MODBUS_MESSAGE_POOL
+        mstack->message = NULL; // borrowed when receiver is armed
+#endif
+        SSTACK_SET_STATUS(mstack, eMOD_S_STATE_STANDBY);
     }
 
     return retval;
@@ -46,8 +67,8 @@ static int16_t ModSlaveSendAnswer (modSlaveStack_t* mstack)
     int16_t retval = 0;
     uint16_t crc;
 
-    // check msg lenght 256Bytes total (254 + 2CRC)
-    if (mstack->messageLast > 253)
+    // check msg lenght MODBUS_MAX_FRAME total (incl. 2 CRC)
+    if (mstack->messageLast > MODBUS_MAX_FRAME - 3)
     {
         retval = -1;
     }
@@ -57,7 +78,8 @@ static int16_t ModSlaveSendAnswer (modSlaveStack_t* mstack)
         mstack->message[(++mstack->messageLast)] = (uint8_t)crc;
         mstack->message[(++mstack->messageLast)] = (uint8_t)(crc >> 8);
         //reserve the bus for us
-        mstack->status = eMOD_S_STATE_TRANSMITTING;
+        SSTACK_SET_STATUS(mstack, eMOD_S_STATE_TRANSMITTING);
+        MODBUS_TRACE_S_SEND(mstack, mstack->message, mstack->messageLast + 1);
         retval = mstack->pfSendAns(mstack, (uint8_t*)mstack->message, mstack->messageLast + 1);
     }
 
@@ -78,6 +100,7 @@ static int16_t ModSlaveProcessCommand(modSlaveStack_t* mstack)
     int16_t retval = 0;
     uint16_t i, j;
 
+    MODBUS_TRACE_S_DISPATCH(mstack, mstack->message[1]);
     switch (mstack->message[1])
     {
         case MODBUS_OPCODE_READ_OUT_REGS:
@@ -87,10 +110,10 @@ static int16_t ModSlaveProcessCommand(modSlaveStack_t* mstack)
             i |= (uint16_t)mstack->message[3];
 
             //check if message have correct lengh &
-            //minimum 1, maximum 125 registers can be readed
+            //minimum 1, maximum MODBUS_MAX_READ_REGS (125) registers can be readed
             if (mstack->messageLast != 5  ||
                 mstack->message[4]   != 0  ||
-                mstack->message[5]   > 125 ||
+                mstack->message[5]   > MODBUS_MAX_READ_REGS ||
                 mstack->message[5]   < 1)
             {
                 ModSlaveErrorReport(mstack, MODBUS_ERR_ILLEGAL_VALUE);
@@ -132,9 +155,9 @@ static int16_t ModSlaveProcessCommand(modSlaveStack_t* mstack)
             i  = (uint16_t)mstack->message[2] << 8;
             i |= (uint16_t)mstack->message[3];
 
-            //minimum 1, maximum 123 registers can be writen
+            //minimum 1, maximum MODBUS_MAX_WRITE_REGS (123) registers can be writen
             if (mstack->message[4] != 0  ||
-                mstack->message[5] > 123 ||
+                mstack->message[5] > MODBUS_MAX_WRITE_REGS ||
                 mstack->message[5] < 1)
             {
                 ModSlaveErrorReport(mstack, MODBUS_ERR_ILLEGAL_VALUE);
@@ -201,7 +224,7 @@ static int16_t ModSlaveProcessCommand(modSlaveStack_t* mstack)
 
 #ifdef MODBUS_USER_COMMANDS
         case MODBUS_OPCODE_READ_DATA_PACKET:
-            if (mstack->messageLast != 2)
+            if (mstack->messageLast != 1) // address + opcode only
             {
                 ModSlaveErrorReport(mstack, MODBUS_ERR_ILLEGAL_VALUE);
                 retval = -1;
@@ -214,7 +237,7 @@ static int16_t ModSlaveProcessCommand(modSlaveStack_t* mstack)
                     ModSlaveErrorReport(mstack, r);
                     retval = -1;
                 }
-                else if (i > 251)
+                else if (i > MODBUS_MAX_PACKET)
                 {
                     // internal fault - pfGetPacket callback returned too long packet
                     ModSlaveErrorReport(mstack, MODBUS_ERR_DEVICE_FAULT);
@@ -252,22 +275,42 @@ static int16_t ModSlaveProcessCommand(modSlaveStack_t* mstack)
     return retval;
 }
 
+#ifdef MODBUS_SLAVE_MULTI_UNIT
+uint8_t ModSlaveUnit(const modSlaveStack_t* mstack)
+{
+    return mstack->message[0];
+}
+
+// request is for this stack
+static uint8_t ModSlaveIsMine(modSlaveStack_t* mstack, uint8_t address)
+{
+    if (address == 0 || address == mstack->address)
+    {
+        return 1;
+    }
+    return (mstack->pfUnit != NULL && mstack->pfUnit(mstack, address)) ? 1 : 0;
+}
+    #define SSTACK_IS_MINE(mstack, addr)    ModSlaveIsMine(mstack, addr)
+#else
+    #define SSTACK_IS_MINE(mstack, addr)    ((addr) == (mstack)->address || (addr) == 0)
+#endif
+
 // parse received message and answer
 static int16_t ModSlaveParseMessage(modSlaveStack_t* mstack)
 {
     int16_t retval = 0;
     uint16_t crc;
 
-    mstack->status = eMOD_S_STATE_PROCESSING;
+    SSTACK_SET_STATUS(mstack, eMOD_S_STATE_PROCESSING);
 
     //if message is for me or b-cast...
-    if (mstack->message[0] == mstack->address || mstack->message[0] == 0)
+    if (SSTACK_IS_MINE(mstack, mstack->message[0]))
     {
         /*** test for message validity ***/
         if (mstack->messageLast < 3)
         {
             // message too short
-            mstack->status = eMOD_S_STATE_STANDBY;
+            SSTACK_SET_STATUS(mstack, eMOD_S_STATE_STANDBY);
             retval = -1;
         }
         else
@@ -277,13 +320,27 @@ static int16_t ModSlaveParseMessage(modSlaveStack_t* mstack)
                 mstack->message[(mstack->messageLast--)] != (uint8_t)(crc))
             {
                 // invalid CRC
-                mstack->status = eMOD_S_STATE_STANDBY;
+                MODBUS_TRACE_S_CRC(mstack, 0);
+#ifdef MODBUS_STACK_STATS
+                if (mstack->stats != NULL)
+                {
+                    ModStatsCrcError(mstack->stats, mstack->statsBus, 0);
+                }
+#endif
+                SSTACK_SET_STATUS(mstack, eMOD_S_STATE_STANDBY);
                 retval = -1;
             }
             else
             {
                 //message correct, process it (.messageLast pointing to last byte of data, not CRC)
+                MODBUS_TRACE_S_CRC(mstack, 1);
                 retval = ModSlaveProcessCommand(mstack);
+#ifdef MODBUS_STACK_STATS
+                if (mstack->stats != NULL)
+                {
+                    ModStatsSlave(mstack->stats, mstack->statsBus, retval == 0);
+                }
+#endif
 
                 //if not broad-cast, send answer
                 if (mstack->message[0] != 0)
@@ -296,7 +353,7 @@ static int16_t ModSlaveParseMessage(modSlaveStack_t* mstack)
                 }
                 else
                 {
-                    mstack->status = eMOD_S_STATE_STANDBY;
+                    SSTACK_SET_STATUS(mstack, eMOD_S_STATE_STANDBY);
                 }
             }
         }
@@ -306,7 +363,7 @@ static int16_t ModSlaveParseMessage(modSlaveStack_t* mstack)
     {
         // On 485 I will receive somebody's answer as CMD, but
         // it will have it's address = ignored by me
-        mstack->status = eMOD_S_STATE_STANDBY;
+        SSTACK_SET_STATUS(mstack, eMOD_S_STATE_STANDBY);
     }
 
     return retval;
@@ -319,7 +376,16 @@ int16_t ModSlaveCheck(modSlaveStack_t* mstack)
      // refresh listening-state
     if (mstack->status == eMOD_S_STATE_STANDBY)
     {
-        mstack->status = eMOD_S_STATE_RECEIVING;
+#ifdef MODBUS_MESSAGE_POOL
+        // return buffer of finished transaction, borrow one for the next
+        ModMsgPoolFree(mstack->pool, mstack->message);
+        mstack->message = ModMsgPoolAlloc(mstack->pool);
+        if (mstack->message == NULL)
+        {
+            return 0; // pool is empty, try to arm receiver next time
+        }
+#endif
+        SSTACK_SET_STATUS(mstack, eMOD_S_STATE_RECEIVING);
         retval = mstack->pfStandby(mstack);
     }
     // MODBUS receive completed check
@@ -340,14 +406,14 @@ void ModSlaveRxDoneCallback(modSlaveStack_t* mstack, const uint8_t* msg, uint16_
     // full message received
     if (mstack->status == eMOD_S_STATE_RECEIVING)
     {
-        if (len < 1 || len > 257)
+        if (len < 1 || len > MODBUS_MESSAGE_SIZE)
         {
             // too short or too long message, ignore it
-            mstack->status = eMOD_S_STATE_STANDBY; // re-start in ModSlaveCheck()
+            SSTACK_SET_STATUS(mstack, eMOD_S_STATE_STANDBY); // re-start in ModSlaveCheck()
         }
         else
         {
-            mstack->status = eMOD_S_STATE_RECEIVED; // parse new message in main code
+            SSTACK_SET_STATUS(mstack, eMOD_S_STATE_RECEIVED); // parse new message in main code
             mstack->messageLast = len - 1; // index of last received byte
 
             if (mstack->message != msg)
@@ -364,7 +430,7 @@ void ModSlaveRxErrorCallback(modSlaveStack_t* mstack)
     // general rx error
     if (mstack->status == eMOD_S_STATE_RECEIVING)
     {
-        mstack->status = eMOD_S_STATE_STANDBY; // re-start in ModSlaveCheck()
+        SSTACK_SET_STATUS(mstack, eMOD_S_STATE_STANDBY); // re-start in ModSlaveCheck()
     }
 }
 
@@ -372,6 +438,6 @@ void ModSlaveTxDoneCallback(modSlaveStack_t* mstack)
 {
     if (mstack->status == eMOD_S_STATE_TRANSMITTING)
     {
-        mstack->status = eMOD_S_STATE_STANDBY; // re-start in ModSlaveCheck()
+        SSTACK_SET_STATUS(mstack, eMOD_S_STATE_STANDBY); // re-start in ModSlaveCheck()
     }
 }
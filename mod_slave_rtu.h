@@ -23,6 +23,40 @@ extern "C" {
 #define MODBUS_ERR_DEVICE_FAULT     0x04
 /** @} */
 
+/**
+ * @defgroup ModbusBuffer Message buffer size
+ * Define MODBUS_MESSAGE_SIZE (e.g. by compiler flag) to shrink stacks exchanging short frames only.
+ * Limits of all operations are derived from it.
+ * @{
+ */
+#ifndef MODBUS_MESSAGE_SIZE
+#define MODBUS_MESSAGE_SIZE         257     ///< longest RTU frame (256 B) + 1 B, so DMA can detect overflow
+#endif
+#if MODBUS_MESSAGE_SIZE < 12 || MODBUS_MESSAGE_SIZE > 257
+#error "MODBUS_MESSAGE_SIZE has to be 12 - 257"
+#endif
+#define MODBUS_MAX_FRAME            (MODBUS_MESSAGE_SIZE - 1)
+#define MODBUS_MAX_READ_REGS        ((MODBUS_MAX_FRAME - 5) / 2 < 125 ? (MODBUS_MAX_FRAME - 5) / 2 : 125)
+#define MODBUS_MAX_WRITE_REGS       ((MODBUS_MAX_FRAME - 9) / 2 < 123 ? (MODBUS_MAX_FRAME - 9) / 2 : 123)
+#define MODBUS_MAX_PACKET           (MODBUS_MAX_FRAME - 5 < 251 ? MODBUS_MAX_FRAME - 5 : 251)
+/** @} */
+
+/**
+ * Define MODBUS_MESSAGE_POOL to borrow message buffers from shared pool (see @ref mod_msgpool.h)
+ * instead of embedding one in each stack.
+ */
+#ifdef MODBUS_MESSAGE_POOL
+#include "mod_msgpool.h"
+#endif
+
+/**
+ * Define MODBUS_STACK_STATS to record requests (served / refused) and CRC errors into statistics shard
+ * (see @ref mod_stats.h).
+ */
+#ifdef MODBUS_STACK_STATS
+struct modStatsShard_s;
+#endif
+
 /** MODBUS engine status flags */
 typedef enum
 {
@@ -67,10 +101,20 @@ typedef uint8_t (*pfModSGetReg_t) (modSlaveStack_t* mstack, uint16_t regAddr, ui
  */
 typedef uint8_t (*pfModSSetReg_t) (modSlaveStack_t* mstack, uint16_t regAddr, uint16_t regValue);
 
+#ifdef MODBUS_SLAVE_MULTI_UNIT
+/**
+ * @brief   User will pass pointer to function that tells if the stack answers for unit @b address (one stack serves
+ *          many units of a bus, e.g. gateway or simulator). Callbacks get address of the unit by @ref ModSlaveUnit().
+ * @warning It is called before CRC check, @b address can be any byte value (1 - 255).
+ * @return  1 if unit exists, 0 otherwise (request is ignored)
+ */
+typedef uint8_t (*pfModSUnit_t) (modSlaveStack_t* mstack, uint8_t address);
+#endif
+
 #ifdef MODBUS_USER_COMMANDS
 /**
  * @brief   User will pass pointer to function that store packet from local FIFO to @b buffer and its lenth to @b length
- * @warning Maximum length of single packet is 251 Bytes
+ * @warning Maximum length of single packet is MODBUS_MAX_PACKET (251) Bytes
  * @return  0 if everything OK or @ref ModbusErrors code if fails (e.g. register doesn't exists)
  */
 typedef uint8_t (*pfModSGetPacket_t) (modSlaveStack_t* mstack, uint8_t* buffer, uint16_t* length);
@@ -78,7 +122,7 @@ typedef uint8_t (*pfModSGetPacket_t) (modSlaveStack_t* mstack, uint8_t* buffer,
 /**
  * @brief   User will pass pointer to function that store packet from master (in @b buffer) to local FIFO.
  *          Lenght of packet is @b length bytes.
- * @note    Maximum length of single packet is 251 Bytes
+ * @note    Maximum length of single packet is MODBUS_MAX_PACKET (251) Bytes
  * @return  0 if everything OK or @ref ModbusErrors code if fails (e.g. register doesn't exists)
  */
 typedef uint8_t (*pfModSSetPacket_t) (modSlaveStack_t* mstack, const uint8_t* buffer, uint16_t length);
@@ -92,32 +136,57 @@ typedef uint8_t (*pfModSSetPacket_t) (modSlaveStack_t* mstack, const uint8_t* bu
  */
 struct modSlaveStack_s
 {
-    void*                       userContent;    ///< user defined pointer, can by used to pass anything
+    // hot: touched by every callback and check
     modSlaveState_t volatile    status;         ///< status of MODBUS engine
-    uint8_t                     address;        ///< this module address
+    uint16_t volatile           messageLast;    ///< total lengh of MODBUS message - 1
     uint16_t                    lastReg;        ///< last valid register
 
     pfModSStandby_t             pfStandby;      ///< called from ModSlaveCheck() when eMOD_S_STATE_STANDBY; has to turn on receiver; eMOD_S_STATE_RECEIVING than
     pfModSSendAns_t             pfSendAns;      ///< send answer function
     pfModSGetReg_t              pfGetReg;       ///< get register function
     pfModSSetReg_t              pfSetReg;       ///< set register function
+#ifdef MODBUS_SLAVE_MULTI_UNIT
+    pfModSUnit_t                pfUnit;         ///< units served by the stack, NULL = address only
+#endif
 #ifdef MODBUS_USER_COMMANDS
     pfModSGetPacket_t           pfGetPacket;    ///< get packet from local FIFO to be sent to master
     pfModSSetPacket_t           pfSetPacket;    ///< store packet from incomming message to local FIFO
 #endif
+    void*                       userContent;    ///< user defined pointer, can by used to pass anything
+#ifdef MODBUS_STACK_STATS
+    struct modStatsShard_s*     stats;          ///< shard of thread running the stack, can be NULL
+    uint8_t                     statsBus;       ///< bus number in statistics
+#endif
 
-    uint16_t volatile           messageLast;    ///< total lengh of MODBUS message - 1
-    uint8_t                     message[257];   ///< the message
+#ifdef MODBUS_MESSAGE_POOL
+    modMsgPool_t*               pool;           ///< pool of message buffers (MODBUS_MESSAGE_SIZE each), shared with other stacks
+    uint8_t                     address;        ///< this module address
+    uint8_t*                    message;        ///< the message, borrowed from pool while receiver is armed
+#else
+    uint8_t                     address;        ///< this module address (next to message = no padding)
+    uint8_t                     message[MODBUS_MESSAGE_SIZE];   ///< the message
+#endif
 };
 
 /**
  * @brief           Initializes modbus stack
  * @warning         mstack structure must have valid address, lastReg and function pointers BEFORE calling this fnc
+ *                  (with MODBUS_SLAVE_MULTI_UNIT address can be 0 when pfUnit is set)
  * @param mstack    pointer to modbus stack structure
  * @return int16_t  O if OK, -1 if params are wrong
  */
 int16_t ModSlaveInit(modSlaveStack_t* mstack);
 
+#ifdef MODBUS_SLAVE_MULTI_UNIT
+/**
+ * @brief           Address of unit the request being processed is sent to (0 = broadcast), valid in pfGetReg,
+ *                  pfSetReg, pfGetPacket and pfSetPacket callbacks
+ * @param mstack    pointer to modbus stack structure
+ * @return uint8_t  Unit address
+ */
+uint8_t ModSlaveUnit(const modSlaveStack_t* mstack);
+#endif
+
 /**
  * @brief           Check of MODBUS state, called periodically from main loop
  * @return int16_t  0 if no message received yet OR processed without any error,
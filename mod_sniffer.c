@@ -0,0 +1,327 @@
+#include <stdio.h>
+#include <string.h>
+#include "mod_sniffer.h"
+
+// MODBUS commands
+#define MODBUS_OPCODE_READ_OUT_REGS     0x03
+#define MODBUS_OPCODE_READ_INP_REGS     0x04
+#define MODBUS_OPCODE_WRITE_MULTI_REGS  0x10
+#define MODBUS_OPCODE_DIAGNOSTIC        0x08
+// custom user defined commands
+#ifdef MODBUS_USER_COMMANDS
+    #define MODBUS_OPCODE_READ_DATA_PACKET  0x64
+    #define MODBUS_OPCODE_WRITE_DATA_PACKET 0x65
+#endif
+
+/***** shadow stack callbacks - never touch the bus *****/
+
+static int16_t ModSnifferNopSend(modMasterStack_t* mstack, const uint8_t* data, uint16_t length)
+{
+    (void)mstack; (void)data; (void)length;
+    return 0;
+}
+
+static int16_t ModSnifferNopReceive(modMasterStack_t* mstack)
+{
+    (void)mstack;
+    return 0;
+}
+
+static int16_t ModSnifferNopStandby(modSlaveStack_t* mstack)
+{
+    (void)mstack;
+    return 0;
+}
+
+static int16_t ModSnifferNopSendAns(modSlaveStack_t* mstack, const uint8_t* data, uint16_t length)
+{
+    (void)mstack; (void)data; (void)length;
+    return 0;
+}
+
+static uint8_t ModSnifferNopGetReg(modSlaveStack_t* mstack, uint16_t regAddr, uint16_t* regValue)
+{
+    (void)mstack; (void)regAddr;
+    *regValue = 0;
+    return 0;
+}
+
+static uint8_t ModSnifferNopSetReg(modSlaveStack_t* mstack, uint16_t regAddr, uint16_t regValue)
+{
+    (void)mstack; (void)regAddr; (void)regValue;
+    return 0;
+}
+
+#ifdef MODBUS_USER_COMMANDS
+static uint8_t ModSnifferNopGetPacket(modSlaveStack_t* mstack, uint8_t* buffer, uint16_t* length)
+{
+    (void)mstack; (void)buffer;
+    *length = 0;
+    return 0;
+}
+
+static uint8_t ModSnifferNopSetPacket(modSlaveStack_t* mstack, const uint8_t* buffer, uint16_t length)
+{
+    (void)mstack; (void)buffer; (void)length;
+    return 0;
+}
+#endif
+
+/***** transaction pairing *****/
+
+static void ModSnifferLog(modSniffer_t* sniffer, const uint8_t* frame, uint16_t length, modFrameDir_t dir,
+                          modSniffResult_t result)
+{
+    uint8_t rec[MODBUS_CAPLOG_RECORD_MAX];
+    uint16_t n;
+
+    if (sniffer->pfLog == NULL)
+    {
+        return;
+    }
+    n = ModCapLogEncode(sniffer->log, rec, sniffer->nowUs, sniffer->port,
+                        MODBUS_CAPLOG_INFO(dir == eMOD_FRAME_RESPONSE, result), frame, length);
+    if (n > 0)
+    {
+        sniffer->pfLog(sniffer, rec, n);
+    }
+}
+
+static void ModSnifferFinish(modSniffer_t* sniffer, modSniffResult_t result, uint32_t latencyUs)
+{
+    modSnifferSlaveStats_t* st = &sniffer->slaves[sniffer->pendingAddr];
+
+    switch (result)
+    {
+        case eMOD_SNIFF_TIMED_OUT:
+            st->timeouts++;
+            break;
+        case eMOD_SNIFF_EXCEPTION:
+            st->exceptions++;
+            break;
+        case eMOD_SNIFF_CORRUPTED:
+            st->corrupted++;
+            break;
+        default:
+            st->answered++;
+            break;
+    }
+    if (result != eMOD_SNIFF_TIMED_OUT)
+    {
+        // first paired answer (counted above) sets minimum, 0 us latency is a valid sample
+        if (st->answered + st->exceptions + st->corrupted == 1 || latencyUs < st->latencyMinUs)
+        {
+            st->latencyMinUs = latencyUs;
+        }
+        if (latencyUs > st->latencyMaxUs)
+        {
+            st->latencyMaxUs = latencyUs;
+        }
+        st->latencySumUs += latencyUs;
+    }
+
+    sniffer->pending = 0;
+    if (sniffer->pfTransaction != NULL)
+    {
+        sniffer->pfTransaction(sniffer, sniffer->pendingAddr, sniffer->pendingOpCode, result, latencyUs);
+    }
+}
+
+// run request through slave validation, prepare shadow master for the answer
+static modSniffResult_t ModSnifferRequest(modSniffer_t* sniffer, const uint8_t* frame, uint16_t length)
+{
+    modSlaveStack_t* slave = &sniffer->shadowSlave;
+    modMasterStack_t* master = &sniffer->shadowMaster;
+    uint8_t opCode = frame[1];
+
+    switch (opCode)
+    {
+        case MODBUS_OPCODE_READ_OUT_REGS:
+        case MODBUS_OPCODE_READ_INP_REGS:
+        case MODBUS_OPCODE_WRITE_MULTI_REGS:
+        case MODBUS_OPCODE_DIAGNOSTIC:
+#ifdef MODBUS_USER_COMMANDS
+        case MODBUS_OPCODE_READ_DATA_PACKET:
+        case MODBUS_OPCODE_WRITE_DATA_PACKET:
+#endif
+            break;
+        default:
+            return eMOD_SNIFF_UNCHECKED;
+    }
+
+    // pretend to be addressed slave with all registers available
+    slave->address = frame[0];
+    slave->status = eMOD_S_STATE_RECEIVING;
+    ModSlaveRxDoneCallback(slave, frame, length);
+    if (ModSlaveCheck(slave) < 0)
+    {
+        ModSlaveTxDoneCallback(slave);
+        return eMOD_SNIFF_INVALID;
+    }
+    ModSlaveTxDoneCallback(slave);
+
+    // arm shadow master as if it sent the request itself
+    master->slaveAddr = frame[0];
+    master->opCode = opCode;
+    master->firstReg = 0;
+    master->numRegs = 0;
+    master->dataStorage = sniffer->scratch;
+    master->dataStorage2 = NULL;
+    switch (opCode)
+    {
+        case MODBUS_OPCODE_READ_OUT_REGS:
+        case MODBUS_OPCODE_READ_INP_REGS:
+        case MODBUS_OPCODE_WRITE_MULTI_REGS:
+        case MODBUS_OPCODE_DIAGNOSTIC:
+            // address, opcode, register (subcode), count (data), CRC
+            if (length >= 8)
+            {
+                master->firstReg = ((uint16_t)frame[2] << 8) | frame[3];
+                master->numRegs = ((uint16_t)frame[4] << 8) | frame[5];
+            }
+            break;
+#ifdef MODBUS_USER_COMMANDS
+        case MODBUS_OPCODE_WRITE_DATA_PACKET:
+            master->numRegs = frame[2];
+            break;
+#endif
+        default:
+            break; // read packet: address, opcode, CRC only
+    }
+    sniffer->pendingArmed = 1;
+
+    return eMOD_SNIFF_OK;
+}
+
+static modSniffResult_t ModSnifferResponse(modSniffer_t* sniffer, const uint8_t* frame, uint16_t length)
+{
+    modMasterStack_t* master = &sniffer->shadowMaster;
+    modMasterState_t status;
+    uint8_t err;
+
+    if ((frame[1] & 0x7F) != sniffer->pendingOpCode)
+    {
+        return eMOD_SNIFF_CORRUPTED; // answer to other command
+    }
+    if (!sniffer->pendingArmed)
+    {
+        return (frame[1] & 0x80) ? eMOD_SNIFF_EXCEPTION : eMOD_SNIFF_UNCHECKED;
+    }
+
+    master->status = eMOD_M_STATE_WAITING_ANSWER;
+    ModMasterRxDoneCallback(master, frame, length);
+    (void)ModMasterCheck(master, &status, &err);
+    switch (status)
+    {
+        case eMOD_M_STATE_PROCESSED:
+            return eMOD_SNIFF_OK;
+        case eMOD_M_STATE_ERR_REPORTED:
+            return eMOD_SNIFF_EXCEPTION;
+        default:
+            return eMOD_SNIFF_CORRUPTED;
+    }
+}
+
+static void ModSnifferFrame(modStreamFramer_t* framer, const uint8_t* frame, uint16_t length, modFrameDir_t dir)
+{
+    modSniffer_t* sniffer = (modSniffer_t*)framer->userContent;
+    modSniffResult_t result;
+
+    if (dir == eMOD_FRAME_REQUEST)
+    {
+        if (sniffer->pending)
+        {
+            // new request before answer of previous one
+            ModSnifferFinish(sniffer, eMOD_SNIFF_TIMED_OUT, 0);
+        }
+        sniffer->pendingArmed = 0;
+        result = ModSnifferRequest(sniffer, frame, length);
+        sniffer->slaves[frame[0]].requests++;
+        if (result == eMOD_SNIFF_INVALID)
+        {
+            sniffer->slaves[frame[0]].invalid++;
+        }
+        if (frame[0] != 0)
+        {
+            // nobody answers broadcast
+            sniffer->pending = 1;
+            sniffer->pendingAddr = frame[0];
+            sniffer->pendingOpCode = frame[1];
+            sniffer->requestTimeUs = sniffer->nowUs;
+        }
+    }
+    else if (!sniffer->pending || frame[0] != sniffer->pendingAddr)
+    {
+        result = eMOD_SNIFF_ORPHAN;
+        sniffer->orphans++;
+        if (sniffer->pfTransaction != NULL)
+        {
+            sniffer->pfTransaction(sniffer, frame[0], frame[1] & 0x7F, result, 0);
+        }
+    }
+    else
+    {
+        result = ModSnifferResponse(sniffer, frame, length);
+        ModSnifferFinish(sniffer, result, (uint32_t)(sniffer->nowUs - sniffer->requestTimeUs));
+    }
+
+    ModSnifferLog(sniffer, frame, length, dir, result);
+}
+
+int16_t ModSnifferInit(modSniffer_t* sniffer)
+{
+    if (sniffer->pfLog != NULL && sniffer->log == NULL)
+    {
+        return -1; // wrong config
+    }
+    if (sniffer->port == MODBUS_CAPLOG_PORT_SYNC)
+    {
+        return -1; // reserved by log format
+    }
+    if (sniffer->timeoutUs == 0)
+    {
+        sniffer->timeoutUs = MODBUS_RX_TIMEOUT * 1000u;
+    }
+
+    sniffer->pending = 0;
+    sniffer->pendingArmed = 0;
+    sniffer->orphans = 0;
+    memset(sniffer->slaves, 0, sizeof(sniffer->slaves));
+
+    memset(&sniffer->shadowMaster, 0, sizeof(sniffer->shadowMaster));
+    sniffer->shadowMaster.pfSend = &ModSnifferNopSend;
+    sniffer->shadowMaster.pfReceive = &ModSnifferNopReceive;
+    (void)ModMasterInit(&sniffer->shadowMaster);
+
+    memset(&sniffer->shadowSlave, 0, sizeof(sniffer->shadowSlave));
+    sniffer->shadowSlave.lastReg = 0xFFFF;
+    sniffer->shadowSlave.pfStandby = &ModSnifferNopStandby;
+    sniffer->shadowSlave.pfSendAns = &ModSnifferNopSendAns;
+    sniffer->shadowSlave.pfGetReg = &ModSnifferNopGetReg;
+    sniffer->shadowSlave.pfSetReg = &ModSnifferNopSetReg;
+#ifdef MODBUS_USER_COMMANDS
+    sniffer->shadowSlave.pfGetPacket = &ModSnifferNopGetPacket;
+    sniffer->shadowSlave.pfSetPacket = &ModSnifferNopSetPacket;
+#endif
+
+    memset(&sniffer->framer, 0, sizeof(sniffer->framer));
+    sniffer->framer.userContent = sniffer;
+    sniffer->framer.pfFrame = &ModSnifferFrame;
+
+    return ModStreamInit(&sniffer->framer, eMOD_STREAM_BOTH);
+}
+
+void ModSnifferFeed(modSniffer_t* sniffer, const uint8_t* data, uint32_t length, uint64_t nowUs)
+{
+    ModSnifferCheck(sniffer, nowUs);
+    sniffer->nowUs = nowUs;
+    (void)ModStreamFeed(&sniffer->framer, data, length);
+}
+
+void ModSnifferCheck(modSniffer_t* sniffer, uint64_t nowUs)
+{
+    if (sniffer->pending && nowUs - sniffer->requestTimeUs > sniffer->timeoutUs)
+    {
+        ModSnifferFinish(sniffer, eMOD_SNIFF_TIMED_OUT, 0);
+    }
+}
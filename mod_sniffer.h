@@ -0,0 +1,124 @@
+/**
+ * @file    mod_sniffer.h
+ * @brief   Passive Modbus RTU bus monitor. Listens without transmitting, cuts traffic into frames by
+ *          @ref mod_stream_rtu.h and pairs each request with its response. Requests are validated by the same code
+ *          as slave uses (ModSlaveProcessCommand()), responses by the same code as master uses (ModMasterProcessAnswer()),
+ *          both run on internal shadow stacks which never touch the bus.
+ * @note    One sniffer instance per monitored line. Feed it from any thread, but one instance from one thread only.
+ */
+
+#ifndef SYSTEM_MOD_SNIFFER_H
+#define SYSTEM_MOD_SNIFFER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "mod_master_rtu.h"
+#include "mod_slave_rtu.h"
+#include "mod_stream_rtu.h"
+#include "mod_caplog.h"
+
+#if defined(MODBUS_MESSAGE_POOL) || defined(MODBUS_MASTER_TABLE)
+#error "mod_sniffer.h drives shadow stacks directly, it requires embedded message buffers and state"
+#endif
+
+#define MODBUS_SNIFF_SLAVES         248     ///< addresses 0 (broadcast) - 247
+
+/** Result of single frame / transaction */
+typedef enum
+{
+    eMOD_SNIFF_OK,              ///< request valid / response accepted by master validation
+    eMOD_SNIFF_UNCHECKED,       ///< opcode not implemented by the stacks, paired by address and opcode only
+    eMOD_SNIFF_INVALID,         ///< request rejected by slave validation
+    eMOD_SNIFF_EXCEPTION,       ///< slave reported error
+    eMOD_SNIFF_CORRUPTED,       ///< response rejected by master validation
+    eMOD_SNIFF_ORPHAN,          ///< response without matching request
+    eMOD_SNIFF_TIMED_OUT        ///< request without response
+} modSniffResult_t;
+
+/** Live per-slave statistics */
+typedef struct
+{
+    uint32_t                    requests;       ///< all requests incl. broadcast (index 0)
+    uint32_t                    answered;       ///< valid answers
+    uint32_t                    exceptions;     ///< error reports
+    uint32_t                    corrupted;      ///< answers rejected by master validation
+    uint32_t                    timeouts;       ///< requests without answer
+    uint32_t                    invalid;        ///< requests rejected by slave validation
+    uint32_t                    latencyMinUs;   ///< from request to answer (frame arrival times)
+    uint32_t                    latencyMaxUs;
+    uint64_t                    latencySumUs;   ///< divide by number of paired answers to get average
+} modSnifferSlaveStats_t;
+
+typedef struct modSniffer_s modSniffer_t;
+
+/**
+ * @brief   Optional. Receives encoded @ref mod_caplog.h records, user appends them to log file.
+ */
+typedef void (*pfModSniffLog_t)(modSniffer_t* sniffer, const uint8_t* data, uint16_t length);
+
+/**
+ * @brief   Optional. Called when transaction is finished (answered, timed out or orphan response).
+ */
+typedef void (*pfModSniffTransaction_t)(modSniffer_t* sniffer, uint8_t slaveAddr, uint8_t opCode,
+                                        modSniffResult_t result, uint32_t latencyUs);
+
+/**
+ * @brief   Sniffer structure, one per monitored line.
+ */
+struct modSniffer_s
+{
+    void*                       userContent;    ///< user defined pointer, can by used to pass anything
+    pfModSniffLog_t             pfLog;          ///< log writer, can be NULL
+    pfModSniffTransaction_t     pfTransaction;  ///< transaction consumer, can be NULL
+    modCapLog_t*                log;            ///< log cursor, can be shared by more sniffers writing one log
+    uint8_t                     port;           ///< port index written to log
+    uint32_t                    timeoutUs;      ///< answer timeout, MODBUS_RX_TIMEOUT if 0 during init
+
+    uint8_t                     pending;        ///< request waiting for answer
+    uint8_t                     pendingAddr;
+    uint8_t                     pendingOpCode;
+    uint8_t                     pendingArmed;   ///< shadow master prepared to validate answer
+    uint64_t                    requestTimeUs;  ///< arrival of pending request
+    uint64_t                    nowUs;          ///< arrival of currently processed chunk
+    uint32_t                    orphans;        ///< responses without request
+
+    modSnifferSlaveStats_t      slaves[MODBUS_SNIFF_SLAVES];
+
+    modStreamFramer_t           framer;
+    modMasterStack_t            shadowMaster;
+    modSlaveStack_t             shadowSlave;
+    uint16_t                    scratch[128];   ///< shadow master data storage
+};
+
+/**
+ * @brief           Initializes sniffer
+ * @warning         Callbacks, log, port and timeoutUs has to be set BEFORE calling this fnc
+ * @param sniffer   Pointer to sniffer structure
+ * @return int16_t  0 if OK, -1 if params are wrong
+ */
+int16_t ModSnifferInit(modSniffer_t* sniffer);
+
+/**
+ * @brief           Feeds chunk of bytes received from the line
+ * @param sniffer   Pointer to sniffer structure
+ * @param data      Received bytes
+ * @param length    Number of received bytes
+ * @param nowUs     Arrival time of the chunk, monotonic microseconds
+ */
+void ModSnifferFeed(modSniffer_t* sniffer, const uint8_t* data, uint32_t length, uint64_t nowUs);
+
+/**
+ * @brief           Periodic check of answer timeout, call it at least once per timeout period
+ * @param sniffer   Pointer to sniffer structure
+ * @param nowUs     Current monotonic time in microseconds
+ */
+void ModSnifferCheck(modSniffer_t* sniffer, uint64_t nowUs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_SNIFFER_H */
@@ -0,0 +1,306 @@
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include "mod_stats.h"
+#include "mod_textout.h"
+
+// single writer per shard, readers merge - relaxed atomics avoid torn 64-bit values
+#if defined(__GNUC__)
+    #define STATS_LOAD(var)         __atomic_load_n(&(var), __ATOMIC_RELAXED)
+    #define STATS_ADD(var, n)       __atomic_store_n(&(var), (var) + (n), __ATOMIC_RELAXED)
+    #define STATS_SET(var, v)       __atomic_store_n(&(var), (v), __ATOMIC_RELAXED)
+    #define STATS_SHARDS(stats)     __atomic_load_n(&(stats)->shards, __ATOMIC_ACQUIRE)
+#else
+    #define STATS_LOAD(var)         (var)
+    #define STATS_ADD(var, n)       ((var) += (n))
+    #define STATS_SET(var, v)       ((var) = (v))
+    #define STATS_SHARDS(stats)     ((stats)->shards)
+#endif
+
+static const uint32_t bucketLimits[MODBUS_STATS_BUCKETS] = MODBUS_STATS_BUCKET_LIMITS;
+static const char* const resultNames[eMOD_STATS_RESULTS] = { "processed", "timed_out", "corrupted", "exception", "hw_error" };
+
+// sum of one uint64_t counter (at offset within modStatsBus_t) over all shards
+static uint64_t ModStatsSum(const modStats_t* stats, uint8_t bus, size_t offset)
+{
+    uint64_t sum = 0;
+
+    for (modStatsShard_t* shard = STATS_SHARDS(stats); shard != NULL; shard = shard->next)
+    {
+        uint64_t* counter = (uint64_t*)((uint8_t*)&shard->bus[bus] + offset);
+        sum += STATS_LOAD(*counter);
+    }
+
+    return sum;
+}
+
+#define SUM(stats, bus, field)          ModStatsSum(stats, bus, offsetof(modStatsBus_t, field))
+#define SUMI(stats, bus, field, i)      ModStatsSum(stats, bus, offsetof(modStatsBus_t, field) + (i) * sizeof(uint64_t))
+
+static void ModStatsBusLabel(modTextOut_t* out, const modStats_t* stats, uint8_t bus)
+{
+    if (stats->busName[bus] != NULL)
+    {
+        ModTextOutPrintf(out, "bus=\"%s\"", stats->busName[bus]);
+    }
+    else
+    {
+        ModTextOutPrintf(out, "bus=\"%u\"", bus);
+    }
+}
+
+void ModStatsInit(modStats_t* stats)
+{
+    stats->shards = NULL;
+    memset(stats->busName, 0, sizeof(stats->busName));
+}
+
+void ModStatsAddShard(modStats_t* stats, modStatsShard_t* shard)
+{
+    memset(shard->bus, 0, sizeof(shard->bus));
+#if defined(__GNUC__)
+    shard->next = __atomic_load_n(&stats->shards, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&stats->shards, &shard->next, shard, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+    {
+        ; // shard->next refreshed by failed exchange
+    }
+#else
+    shard->next = stats->shards;
+    stats->shards = shard;
+#endif
+}
+
+void ModStatsMaster(modStatsShard_t* shard, uint8_t bus, uint8_t slave, modMasterState_t status, uint8_t errCode,
+                    uint32_t latencyMs)
+{
+    modStatsBus_t* b;
+    modStatsResult_t result;
+    uint8_t bucket = 0;
+
+    if (bus >= MODBUS_STATS_BUSES)
+    {
+        return;
+    }
+    b = &shard->bus[bus];
+
+    switch (status)
+    {
+        case eMOD_M_STATE_PROCESSED:    result = eMOD_STATS_PROCESSED; break;
+        case eMOD_M_STATE_TIMED_OUT:    result = eMOD_STATS_TIMED_OUT; break;
+        case eMOD_M_STATE_ERR_REPORTED: result = eMOD_STATS_EXCEPTION; break;
+        case eMOD_M_STATE_HW_ERROR:     result = eMOD_STATS_HW_ERROR; break;
+        default:                        result = eMOD_STATS_CORRUPTED; break;
+    }
+    STATS_ADD(b->master[result], 1);
+    if (slave < MODBUS_STATS_SLAVES)
+    {
+        STATS_ADD(b->perSlave[slave][result], 1);
+    }
+    if (result == eMOD_STATS_EXCEPTION)
+    {
+        STATS_ADD(b->exceptions[errCode < MODBUS_STATS_EXCEPTIONS ? errCode : 0], 1);
+    }
+    if (result == eMOD_STATS_PROCESSED || result == eMOD_STATS_EXCEPTION)
+    {
+        // latency of answered transactions only
+        while (bucket < MODBUS_STATS_BUCKETS && latencyMs > bucketLimits[bucket])
+        {
+            bucket++;
+        }
+        STATS_ADD(b->latency[bucket], 1);
+        STATS_ADD(b->latencySumMs, latencyMs);
+    }
+}
+
+void ModStatsSlave(modStatsShard_t* shard, uint8_t bus, uint8_t ok)
+{
+    if (bus >= MODBUS_STATS_BUSES)
+    {
+        return;
+    }
+    if (ok)
+    {
+        STATS_ADD(shard->bus[bus].slaveOk, 1);
+    }
+    else
+    {
+        STATS_ADD(shard->bus[bus].slaveInvalid, 1);
+    }
+}
+
+void ModStatsCrcError(modStatsShard_t* shard, uint8_t bus, uint8_t master)
+{
+    if (bus >= MODBUS_STATS_BUSES)
+    {
+        return;
+    }
+    STATS_ADD(shard->bus[bus].crcErrors[master ? 1 : 0], 1);
+}
+
+void ModStatsGauge(modStatsShard_t* shard, uint8_t bus, modStatsGauge_t gauge, uint64_t value)
+{
+    if (bus >= MODBUS_STATS_BUSES || gauge >= eMOD_STATS_GAUGES)
+    {
+        return;
+    }
+    STATS_SET(shard->bus[bus].gauges[gauge], value);
+}
+
+int32_t ModStatsRender(const modStats_t* stats, char* buf, uint32_t size)
+{
+    modTextOut_t out = { buf, size, 0, 0 };
+    uint8_t used[MODBUS_STATS_BUSES];
+
+    if (size == 0)
+    {
+        return -1;
+    }
+
+    // buses with name or any activity
+    for (uint8_t bus = 0; bus < MODBUS_STATS_BUSES; bus++)
+    {
+        used[bus] = stats->busName[bus] != NULL || SUM(stats, bus, slaveOk) != 0 || SUM(stats, bus, slaveInvalid) != 0 ||
+                    SUMI(stats, bus, crcErrors, 0) != 0 || SUMI(stats, bus, crcErrors, 1) != 0;
+        for (uint8_t r = 0; r < eMOD_STATS_RESULTS && !used[bus]; r++)
+        {
+            used[bus] = SUMI(stats, bus, master, r) != 0;
+        }
+    }
+
+    ModTextOutPrintf(&out, "# TYPE modbus_master_transactions counter\n"
+                           "# HELP modbus_master_transactions Finished master transactions by result.\n");
+    for (uint8_t bus = 0; bus < MODBUS_STATS_BUSES; bus++)
+    {
+        for (uint8_t r = 0; used[bus] && r < eMOD_STATS_RESULTS; r++)
+        {
+            ModTextOutPrintf(&out, "modbus_master_transactions_total{");
+            ModStatsBusLabel(&out, stats, bus);
+            ModTextOutPrintf(&out, ",result=\"%s\"} %llu\n", resultNames[r], (unsigned long long)SUMI(stats, bus, master, r));
+        }
+    }
+
+    ModTextOutPrintf(&out, "# TYPE modbus_master_exceptions counter\n"
+                           "# HELP modbus_master_exceptions Exceptions reported by slaves by code, 0 = other.\n");
+    for (uint8_t bus = 0; bus < MODBUS_STATS_BUSES; bus++)
+    {
+        for (uint8_t code = 0; used[bus] && code < MODBUS_STATS_EXCEPTIONS; code++)
+        {
+            uint64_t n = SUMI(stats, bus, exceptions, code);
+            if (n != 0)
+            {
+                ModTextOutPrintf(&out, "modbus_master_exceptions_total{");
+                ModStatsBusLabel(&out, stats, bus);
+                ModTextOutPrintf(&out, ",code=\"%u\"} %llu\n", code, (unsigned long long)n);
+            }
+        }
+    }
+
+    ModTextOutPrintf(&out, "# TYPE modbus_master_latency_seconds histogram\n"
+                           "# HELP modbus_master_latency_seconds Time from request to answer.\n");
+    for (uint8_t bus = 0; bus < MODBUS_STATS_BUSES; bus++)
+    {
+        uint64_t cumulative = 0;
+
+        if (!used[bus])
+        {
+            continue;
+        }
+        for (uint8_t b = 0; b <= MODBUS_STATS_BUCKETS; b++)
+        {
+            cumulative += SUMI(stats, bus, latency, b);
+            ModTextOutPrintf(&out, "modbus_master_latency_seconds_bucket{");
+            ModStatsBusLabel(&out, stats, bus);
+            if (b < MODBUS_STATS_BUCKETS)
+            {
+                ModTextOutPrintf(&out, ",le=\"%.3f\"} %llu\n", bucketLimits[b] / 1000.0, (unsigned long long)cumulative);
+            }
+            else
+            {
+                ModTextOutPrintf(&out, ",le=\"+Inf\"} %llu\n", (unsigned long long)cumulative);
+            }
+        }
+        ModTextOutPrintf(&out, "modbus_master_latency_seconds_count{");
+        ModStatsBusLabel(&out, stats, bus);
+        ModTextOutPrintf(&out, "} %llu\n", (unsigned long long)cumulative);
+        ModTextOutPrintf(&out, "modbus_master_latency_seconds_sum{");
+        ModStatsBusLabel(&out, stats, bus);
+        ModTextOutPrintf(&out, "} %.3f\n", SUM(stats, bus, latencySumMs) / 1000.0);
+    }
+
+    ModTextOutPrintf(&out, "# TYPE modbus_master_slave_transactions counter\n"
+                           "# HELP modbus_master_slave_transactions Finished master transactions by slave and result.\n");
+    for (uint8_t bus = 0; bus < MODBUS_STATS_BUSES; bus++)
+    {
+        for (uint16_t slave = 0; used[bus] && slave < MODBUS_STATS_SLAVES; slave++)
+        {
+            for (uint8_t r = 0; r < eMOD_STATS_RESULTS; r++)
+            {
+                uint64_t n = SUMI(stats, bus, perSlave, slave * eMOD_STATS_RESULTS + r);
+                if (n != 0)
+                {
+                    ModTextOutPrintf(&out, "modbus_master_slave_transactions_total{");
+                    ModStatsBusLabel(&out, stats, bus);
+                    ModTextOutPrintf(&out, ",slave=\"%u\",result=\"%s\"} %llu\n", slave, resultNames[r], (unsigned long long)n);
+                }
+            }
+        }
+    }
+
+    ModTextOutPrintf(&out, "# TYPE modbus_slave_requests counter\n"
+                           "# HELP modbus_slave_requests Requests processed by slave stacks.\n");
+    for (uint8_t bus = 0; bus < MODBUS_STATS_BUSES; bus++)
+    {
+        if (used[bus])
+        {
+            ModTextOutPrintf(&out, "modbus_slave_requests_total{");
+            ModStatsBusLabel(&out, stats, bus);
+            ModTextOutPrintf(&out, ",result=\"ok\"} %llu\n", (unsigned long long)SUM(stats, bus, slaveOk));
+            ModTextOutPrintf(&out, "modbus_slave_requests_total{");
+            ModStatsBusLabel(&out, stats, bus);
+            ModTextOutPrintf(&out, ",result=\"invalid\"} %llu\n", (unsigned long long)SUM(stats, bus, slaveInvalid));
+        }
+    }
+
+    ModTextOutPrintf(&out, "# TYPE modbus_crc_errors counter\n"
+                           "# HELP modbus_crc_errors Received frames with wrong CRC by stack.\n");
+    for (uint8_t bus = 0; bus < MODBUS_STATS_BUSES; bus++)
+    {
+        if (used[bus])
+        {
+            ModTextOutPrintf(&out, "modbus_crc_errors_total{");
+            ModStatsBusLabel(&out, stats, bus);
+            ModTextOutPrintf(&out, ",stack=\"master\"} %llu\n", (unsigned long long)SUMI(stats, bus, crcErrors, 1));
+            ModTextOutPrintf(&out, "modbus_crc_errors_total{");
+            ModStatsBusLabel(&out, stats, bus);
+            ModTextOutPrintf(&out, ",stack=\"slave\"} %llu\n", (unsigned long long)SUMI(stats, bus, crcErrors, 0));
+        }
+    }
+
+    ModTextOutPrintf(&out, "# TYPE modbus_queue_depth gauge\n"
+                           "# HELP modbus_queue_depth Requests waiting for the bus.\n");
+    for (uint8_t bus = 0; bus < MODBUS_STATS_BUSES; bus++)
+    {
+        if (used[bus])
+        {
+            ModTextOutPrintf(&out, "modbus_queue_depth{");
+            ModStatsBusLabel(&out, stats, bus);
+            ModTextOutPrintf(&out, "} %llu\n", (unsigned long long)SUMI(stats, bus, gauges, eMOD_STATS_QUEUE_DEPTH));
+        }
+    }
+
+    ModTextOutPrintf(&out, "# TYPE modbus_bus_utilization_ratio gauge\n"
+                           "# HELP modbus_bus_utilization_ratio Share of time the bus carries frames or required gaps.\n");
+    for (uint8_t bus = 0; bus < MODBUS_STATS_BUSES; bus++)
+    {
+        if (used[bus])
+        {
+            ModTextOutPrintf(&out, "modbus_bus_utilization_ratio{");
+            ModStatsBusLabel(&out, stats, bus);
+            ModTextOutPrintf(&out, "} %.6f\n", SUMI(stats, bus, gauges, eMOD_STATS_UTILIZATION_PPM) / 1e6);
+        }
+    }
+
+    ModTextOutPrintf(&out, "# EOF\n");
+
+    return out.overflow ? -1 : (int32_t)out.len;
+}
@@ -0,0 +1,154 @@
+/**
+ * @file    mod_stats.h
+ * @brief   Statistics registry of gateway - per-bus and per-slave counters, exception codes, latency histograms
+ *          and gauges (queue depth, bus utilization) - rendered as OpenMetrics text on demand.
+ *
+ *          Collection is lock-free: each thread running stacks owns one @ref modStatsShard_t and is its only
+ *          writer, scraper reads all shards registered in @ref modStats_t and merges them while rendering.
+ *          Counters are updated by relaxed atomic stores, so scraping never blocks or slows down bus threads.
+ *          Each bus should be served by one thread (gauges of shards are summed).
+ *
+ *          @ref mod_master_req.h records results of all transactions of its queue when queue->stats is set.
+ *          With MODBUS_STACK_STATS master and slave stacks record CRC errors and slave stack its requests when
+ *          mstack->stats is set.
+ *          @ref mod_stats_linux.h writes rendered text to file or serves it on Unix socket.
+ */
+
+#ifndef SYSTEM_MOD_STATS_H
+#define SYSTEM_MOD_STATS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "mod_master_rtu.h"
+
+#ifndef MODBUS_STATS_BUSES
+#define MODBUS_STATS_BUSES          16      ///< number of buses in registry
+#endif
+#define MODBUS_STATS_SLAVES         248     ///< slave addresses 0 - 247
+#define MODBUS_STATS_EXCEPTIONS     12      ///< exception codes 1 - 11, 0 = any other
+#define MODBUS_STATS_BUCKETS        10      ///< latency histogram buckets (+ infinity)
+#define MODBUS_STATS_BUCKET_LIMITS  { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000 }   ///< upper bounds [ms]
+
+/** Result of master transaction **/
+typedef enum
+{
+    eMOD_STATS_PROCESSED,
+    eMOD_STATS_TIMED_OUT,
+    eMOD_STATS_CORRUPTED,
+    eMOD_STATS_EXCEPTION,
+    eMOD_STATS_HW_ERROR,
+    eMOD_STATS_RESULTS              ///< number of results
+} modStatsResult_t;
+
+/** Gauges of bus **/
+typedef enum
+{
+    eMOD_STATS_QUEUE_DEPTH,         ///< requests waiting for the bus
+    eMOD_STATS_UTILIZATION_PPM,     ///< bus utilization [parts per million]
+    eMOD_STATS_GAUGES               ///< number of gauges
+} modStatsGauge_t;
+
+/**
+ * @brief   Counters of one bus in one shard
+ */
+typedef struct
+{
+    uint64_t                    master[eMOD_STATS_RESULTS];                 ///< transactions by result
+    uint64_t                    exceptions[MODBUS_STATS_EXCEPTIONS];        ///< exceptions by code
+    uint64_t                    latency[MODBUS_STATS_BUCKETS + 1];          ///< histogram, not cumulative
+    uint64_t                    latencySumMs;
+    uint64_t                    slaveOk;                                    ///< requests served by slave stacks
+    uint64_t                    slaveInvalid;                               ///< invalid requests (answered by exception)
+    uint64_t                    crcErrors[2];                               ///< frames with wrong CRC, [0] slave, [1] master
+    uint64_t                    gauges[eMOD_STATS_GAUGES];
+    uint64_t                    perSlave[MODBUS_STATS_SLAVES][eMOD_STATS_RESULTS];  ///< transactions by slave
+} modStatsBus_t;
+
+typedef struct modStatsShard_s modStatsShard_t;
+
+/**
+ * @brief   Per-thread shard
+ */
+struct modStatsShard_s
+{
+    modStatsBus_t               bus[MODBUS_STATS_BUSES];
+    modStatsShard_t*            next;           ///< registry link
+};
+
+/**
+ * @brief   Registry structure
+ */
+typedef struct
+{
+    modStatsShard_t*            shards;         ///< registered shards
+    const char*                 busName[MODBUS_STATS_BUSES];    ///< label of bus, NULL = bus number
+    void*                       userContent;    ///< user defined pointer, can by used to pass anything
+} modStats_t;
+
+/**
+ * @brief           Initializes empty registry
+ * @param stats     Pointer to registry structure
+ */
+void ModStatsInit(modStats_t* stats);
+
+/**
+ * @brief           Clears shard and adds it to registry, can be called while other threads run
+ * @param stats     Pointer to registry structure
+ * @param shard     Shard of calling thread, has to stay valid while registry is used
+ */
+void ModStatsAddShard(modStats_t* stats, modStatsShard_t* shard);
+
+/**
+ * @brief           Records finished master transaction
+ * @param shard     Shard of calling thread
+ * @param bus       Bus number, 0 - MODBUS_STATS_BUSES-1 (others ignored)
+ * @param slave     Slave address
+ * @param status    Status reported by @ref ModMasterCheck()
+ * @param errCode   Exception code, if status is eMOD_M_STATE_ERR_REPORTED
+ * @param latencyMs Time from request to result
+ */
+void ModStatsMaster(modStatsShard_t* shard, uint8_t bus, uint8_t slave, modMasterState_t status, uint8_t errCode,
+                    uint32_t latencyMs);
+
+/**
+ * @brief           Records request with valid CRC processed by slave stack
+ * @param shard     Shard of calling thread
+ * @param bus       Bus number
+ * @param ok        1 if request was served, 0 if it was invalid (answered by exception)
+ */
+void ModStatsSlave(modStatsShard_t* shard, uint8_t bus, uint8_t ok);
+
+/**
+ * @brief           Records received frame with wrong CRC (request of slave stack / answer of master stack)
+ * @param shard     Shard of calling thread
+ * @param bus       Bus number
+ * @param master    1 master stack, 0 slave stack
+ */
+void ModStatsCrcError(modStatsShard_t* shard, uint8_t bus, uint8_t master);
+
+/**
+ * @brief           Sets gauge of bus
+ * @param shard     Shard of thread serving the bus
+ * @param bus       Bus number
+ * @param gauge     Gauge
+ * @param value     New value
+ */
+void ModStatsGauge(modStatsShard_t* shard, uint8_t bus, modStatsGauge_t gauge, uint64_t value);
+
+/**
+ * @brief           Merges all shards and renders OpenMetrics text (incl. terminating # EOF)
+ * @param stats     Pointer to registry structure
+ * @param buf       Output buffer
+ * @param size      Size of output buffer
+ * @return int32_t  Length of text (without terminating zero), -1 if buffer is too small
+ */
+int32_t ModStatsRender(const modStats_t* stats, char* buf, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_STATS_H */
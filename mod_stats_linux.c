@@ -0,0 +1,113 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "mod_stats_linux.h"
+
+// sockets are written by send(), gone scraper must not raise SIGPIPE
+static int16_t ModStatsWriteAll(int fd, const char* data, uint32_t len, int isSocket)
+{
+    while (len > 0)
+    {
+        ssize_t n = isSocket ? send(fd, data, len, MSG_NOSIGNAL) : write(fd, data, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -3;
+        }
+        data += n;
+        len -= (uint32_t)n;
+    }
+
+    return 0;
+}
+
+int16_t ModStatsWriteFile(const modStats_t* stats, const char* path, char* buf, uint32_t size)
+{
+    char tmp[256];
+    int32_t len = ModStatsRender(stats, buf, size);
+    int fd;
+    int16_t r;
+
+    if (len < 0)
+    {
+        return -1; // buffer too small
+    }
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp))
+    {
+        return -3;
+    }
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        return -3;
+    }
+    r = ModStatsWriteAll(fd, buf, (uint32_t)len, 0);
+    if (close(fd) < 0 || r < 0 || rename(tmp, path) < 0)
+    {
+        unlink(tmp);
+        return -3;
+    }
+
+    return 0;
+}
+
+int ModStatsListen(const char* path)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        return -1;
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 8) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+int16_t ModStatsServe(const modStats_t* stats, int listenFd, char* buf, uint32_t size)
+{
+    int16_t served = 0;
+    int32_t len = 0;
+    int fd;
+
+    while ((fd = accept4(listenFd, NULL, NULL, SOCK_CLOEXEC)) >= 0)
+    {
+        if (served == 0)
+        {
+            // one snapshot for all waiting scrapers
+            len = ModStatsRender(stats, buf, size);
+        }
+        if (len >= 0)
+        {
+            (void)ModStatsWriteAll(fd, buf, (uint32_t)len, 1);
+        }
+        close(fd);
+        served++;
+    }
+
+    return len < 0 ? -1 : served;
+}
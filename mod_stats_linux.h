@@ -0,0 +1,49 @@
+/**
+ * @file    mod_stats_linux.h
+ * @brief   OpenMetrics export of @ref mod_stats.h on Linux - to file (e.g. for node_exporter textfile collector)
+ *          or on Unix stream socket, each connection gets one rendered snapshot. Run it in own thread or from
+ *          poll() loop of the gateway, it only reads shards of bus threads.
+ */
+
+#ifndef SYSTEM_MOD_STATS_LINUX_H
+#define SYSTEM_MOD_STATS_LINUX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "mod_stats.h"
+
+/**
+ * @brief           Renders statistics and atomically replaces file (writes path.tmp and renames it)
+ * @param stats     Pointer to registry structure
+ * @param path      Output file
+ * @param buf       Render buffer
+ * @param size      Size of render buffer
+ * @return int16_t  0 if OK, -1 buffer too small, -3 file can't be written
+ */
+int16_t ModStatsWriteFile(const modStats_t* stats, const char* path, char* buf, uint32_t size);
+
+/**
+ * @brief           Creates listening Unix stream socket (old socket file is removed)
+ * @param path      Socket path
+ * @return int      Non-blocking listening socket, -1 on error
+ */
+int ModStatsListen(const char* path);
+
+/**
+ * @brief           Accepts all pending connections, sends rendered statistics to each and closes it
+ * @param stats     Pointer to registry structure
+ * @param listenFd  Socket from @ref ModStatsListen()
+ * @param buf       Render buffer
+ * @param size      Size of render buffer
+ * @return int16_t  Number of served connections, -1 buffer too small
+ */
+int16_t ModStatsServe(const modStats_t* stats, int listenFd, char* buf, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_STATS_LINUX_H */
@@ -0,0 +1,286 @@
+#include <stdio.h>
+#include <string.h>
+#include "mod_stream_rtu.h"
+#include "crc.h"
+
+// MODBUS commands
+#define MODBUS_OPCODE_READ_COILS        0x01
+#define MODBUS_OPCODE_READ_INPUTS       0x02
+#define MODBUS_OPCODE_READ_OUT_REGS     0x03
+#define MODBUS_OPCODE_READ_INP_REGS     0x04
+#define MODBUS_OPCODE_WRITE_COIL        0x05
+#define MODBUS_OPCODE_WRITE_REG         0x06
+#define MODBUS_OPCODE_READ_EXCEPTION    0x07
+#define MODBUS_OPCODE_DIAGNOSTIC        0x08
+#define MODBUS_OPCODE_EVENT_COUNTER     0x0B
+#define MODBUS_OPCODE_EVENT_LOG         0x0C
+#define MODBUS_OPCODE_WRITE_MULTI_COILS 0x0F
+#define MODBUS_OPCODE_WRITE_MULTI_REGS  0x10
+#define MODBUS_OPCODE_REPORT_SLAVE_ID   0x11
+#define MODBUS_OPCODE_MASK_WRITE_REG    0x16
+#define MODBUS_OPCODE_READ_WRITE_REGS   0x17
+// custom user defined commands
+#ifdef MODBUS_USER_COMMANDS
+    #define MODBUS_OPCODE_READ_DATA_PACKET  0x64
+    #define MODBUS_OPCODE_WRITE_DATA_PACKET 0x65
+#endif
+
+#define MODBUS_MAX_ADDRESS              247
+#define MODBUS_STREAM_MIN_FRAME         4   // address + opcode + CRC
+
+int16_t ModStreamInit(modStreamFramer_t* framer, modStreamMode_t mode)
+{
+    if (framer->pfFrame == NULL || mode > eMOD_STREAM_BOTH)
+    {
+        return -1; // wrong config
+    }
+
+    framer->mode = mode;
+    framer->expect = (mode == eMOD_STREAM_RESPONSES) ? eMOD_FRAME_RESPONSE : eMOD_FRAME_REQUEST;
+    framer->head = 0;
+    framer->tail = 0;
+    framer->frames = 0;
+    framer->dropped = 0;
+
+    return 0;
+}
+
+// length = fixed + value of byte at index 'at' (byte count field)
+static int16_t ModStreamCountedLength(const uint8_t* buf, uint16_t avail, uint16_t at, uint16_t fixed)
+{
+    if (avail <= at)
+    {
+        return 0; // need more bytes
+    }
+    return (int16_t)(fixed + buf[at]);
+}
+
+static int16_t ModStreamRequestLength(const uint8_t* buf, uint16_t avail)
+{
+    switch (buf[1])
+    {
+        case MODBUS_OPCODE_READ_COILS:
+        case MODBUS_OPCODE_READ_INPUTS:
+        case MODBUS_OPCODE_READ_OUT_REGS:
+        case MODBUS_OPCODE_READ_INP_REGS:
+        case MODBUS_OPCODE_WRITE_COIL:
+        case MODBUS_OPCODE_WRITE_REG:
+        case MODBUS_OPCODE_DIAGNOSTIC:
+            return 8;
+
+        case MODBUS_OPCODE_READ_EXCEPTION:
+        case MODBUS_OPCODE_EVENT_COUNTER:
+        case MODBUS_OPCODE_EVENT_LOG:
+        case MODBUS_OPCODE_REPORT_SLAVE_ID:
+            return 4;
+
+        case MODBUS_OPCODE_WRITE_MULTI_COILS:
+        case MODBUS_OPCODE_WRITE_MULTI_REGS:
+            // addr, opcode, first(2), num(2), bytes, data, CRC(2)
+            return ModStreamCountedLength(buf, avail, 6, 9);
+
+        case MODBUS_OPCODE_MASK_WRITE_REG:
+            return 10;
+
+        case MODBUS_OPCODE_READ_WRITE_REGS:
+            // addr, opcode, rd first(2), rd num(2), wr first(2), wr num(2), bytes, data, CRC(2)
+            return ModStreamCountedLength(buf, avail, 10, 13);
+
+#ifdef MODBUS_USER_COMMANDS
+        case MODBUS_OPCODE_READ_DATA_PACKET:
+            return 4;
+
+        case MODBUS_OPCODE_WRITE_DATA_PACKET:
+            return ModStreamCountedLength(buf, avail, 2, 5);
+#endif
+
+        default:
+            return -1;
+    }
+}
+
+static int16_t ModStreamResponseLength(const uint8_t* buf, uint16_t avail)
+{
+    if (buf[1] & 0x80)
+    {
+        // error report: addr, opcode | 0x80, error code, CRC(2) - only for known opcodes
+        const uint8_t hdr[2] = { buf[0], (uint8_t)(buf[1] & 0x7F) };
+        return (ModStreamRequestLength(hdr, 2) == -1) ? -1 : 5;
+    }
+
+    switch (buf[1])
+    {
+        case MODBUS_OPCODE_READ_COILS:
+        case MODBUS_OPCODE_READ_INPUTS:
+        case MODBUS_OPCODE_READ_OUT_REGS:
+        case MODBUS_OPCODE_READ_INP_REGS:
+        case MODBUS_OPCODE_EVENT_LOG:
+        case MODBUS_OPCODE_REPORT_SLAVE_ID:
+        case MODBUS_OPCODE_READ_WRITE_REGS:
+            // addr, opcode, bytes, data, CRC(2)
+            return ModStreamCountedLength(buf, avail, 2, 5);
+
+        case MODBUS_OPCODE_WRITE_COIL:
+        case MODBUS_OPCODE_WRITE_REG:
+        case MODBUS_OPCODE_DIAGNOSTIC:
+        case MODBUS_OPCODE_EVENT_COUNTER:
+        case MODBUS_OPCODE_WRITE_MULTI_COILS:
+        case MODBUS_OPCODE_WRITE_MULTI_REGS:
+            return 8;
+
+        case MODBUS_OPCODE_READ_EXCEPTION:
+            return 5;
+
+        case MODBUS_OPCODE_MASK_WRITE_REG:
+            return 10;
+
+#ifdef MODBUS_USER_COMMANDS
+        case MODBUS_OPCODE_READ_DATA_PACKET:
+            return ModStreamCountedLength(buf, avail, 2, 5);
+
+        case MODBUS_OPCODE_WRITE_DATA_PACKET:
+            return 5;
+#endif
+
+        default:
+            return -1;
+    }
+}
+
+int16_t ModStreamPredictLength(const uint8_t* buf, uint16_t avail, modFrameDir_t dir)
+{
+    int16_t len;
+
+    if (avail < 2)
+    {
+        return 0; // need more bytes
+    }
+    if (buf[0] > MODBUS_MAX_ADDRESS || (dir == eMOD_FRAME_RESPONSE && buf[0] == 0))
+    {
+        return -1; // invalid address, nobody answers broadcast
+    }
+
+    len = (dir == eMOD_FRAME_REQUEST) ? ModStreamRequestLength(buf, avail) : ModStreamResponseLength(buf, avail);
+    if (len > MODBUS_STREAM_MAX_FRAME)
+    {
+        len = -1;
+    }
+
+    return len;
+}
+
+// try to confirm frame of given direction at buf: >0 frame length, 0 need more bytes, -1 not a frame
+static int16_t ModStreamTry(const uint8_t* buf, uint16_t avail, modFrameDir_t dir)
+{
+    int16_t len = ModStreamPredictLength(buf, avail, dir);
+
+    if (len <= 0)
+    {
+        return len;
+    }
+    if (len > avail)
+    {
+        return 0;
+    }
+    // CRC over frame without its last 2 bytes has to match received CRC (low byte first)
+    if (CrcModbus(buf, (uint8_t)(len - 2), 0xFFFF) != ((uint16_t)buf[len - 1] << 8 | buf[len - 2]))
+    {
+        return -1;
+    }
+
+    return len;
+}
+
+// find and emit all complete frames in buffer
+static uint32_t ModStreamScan(modStreamFramer_t* framer)
+{
+    uint32_t found = 0;
+
+    while (framer->tail - framer->head >= MODBUS_STREAM_MIN_FRAME)
+    {
+        const uint8_t* p = framer->buffer + framer->head;
+        uint16_t avail = framer->tail - framer->head;
+        modFrameDir_t dir = framer->expect;
+        int16_t len = ModStreamTry(p, avail, dir);
+
+        if (len <= 0 && framer->mode == eMOD_STREAM_BOTH)
+        {
+            // other direction could match (or needs more bytes)
+            modFrameDir_t other = (dir == eMOD_FRAME_REQUEST) ? eMOD_FRAME_RESPONSE : eMOD_FRAME_REQUEST;
+            int16_t len2 = ModStreamTry(p, avail, other);
+            if (len2 > 0)
+            {
+                dir = other;
+                len = len2;
+            }
+            else if (len2 == 0)
+            {
+                len = 0;
+            }
+        }
+
+        if (len > 0)
+        {
+            framer->head += len;
+            framer->frames++;
+            found++;
+            if (framer->mode == eMOD_STREAM_BOTH)
+            {
+                framer->expect = (dir == eMOD_FRAME_REQUEST) ? eMOD_FRAME_RESPONSE : eMOD_FRAME_REQUEST;
+            }
+            framer->pfFrame(framer, p, (uint16_t)len, dir);
+        }
+        else if (len == 0)
+        {
+            break; // wait for more bytes
+        }
+        else
+        {
+            // garbage, slide to next candidate start
+            framer->head++;
+            framer->dropped++;
+        }
+    }
+
+    return found;
+}
+
+uint32_t ModStreamFeed(modStreamFramer_t* framer, const uint8_t* data, uint32_t length)
+{
+    uint32_t found = 0;
+
+    while (length > 0)
+    {
+        uint16_t space;
+
+        // move pending bytes to the beginning of buffer
+        if (framer->head > 0)
+        {
+            memmove(framer->buffer, framer->buffer + framer->head, framer->tail - framer->head);
+            framer->tail -= framer->head;
+            framer->head = 0;
+        }
+
+        // pending bytes never exceed one frame after scan, so there is always space here
+        space = MODBUS_STREAM_BUF_SIZE - framer->tail;
+        if (space > length)
+        {
+            space = (uint16_t)length;
+        }
+        memcpy(framer->buffer + framer->tail, data, space);
+        framer->tail += space;
+        data += space;
+        length -= space;
+
+        found += ModStreamScan(framer);
+    }
+
+    return found;
+}
+
+void ModStreamFlush(modStreamFramer_t* framer)
+{
+    framer->dropped += framer->tail - framer->head;
+    framer->head = 0;
+    framer->tail = 0;
+}
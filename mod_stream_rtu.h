@@ -0,0 +1,104 @@
+/**
+ * @file    mod_stream_rtu.h
+ * @brief   Modbus RTU byte-stream framer. Cuts complete frames out of a byte stream delivered in arbitrary chunks
+ *          (USB-serial adapters, TCP tunnels, replayed captures) where the 3.5-character idle gap can't be observed.
+ *          Frame length is predicted from the function code (separate tables for requests and responses) and
+ *          confirmed by CRC. After garbage the framer resynchronizes by sliding through candidate start offsets.
+ * @note    Result of each frame is passed to @ref pfModStreamFrame_t callback, which can forward it directly
+ *          to @ref ModMasterRxDoneCallback() or @ref ModSlaveRxDoneCallback().
+ */
+
+#ifndef SYSTEM_MOD_STREAM_RTU_H
+#define SYSTEM_MOD_STREAM_RTU_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define MODBUS_STREAM_MAX_FRAME     256     ///< longest valid RTU frame (address + PDU + CRC)
+#define MODBUS_STREAM_BUF_SIZE      512     ///< internal buffer, has to hold at least one pending frame + one chunk
+
+/** Kind of traffic carried by the stream */
+typedef enum
+{
+    eMOD_STREAM_REQUESTS,       ///< only master commands (slave side of the line)
+    eMOD_STREAM_RESPONSES,      ///< only slave answers (master side of the line)
+    eMOD_STREAM_BOTH            ///< both directions interleaved (passive bus monitor)
+} modStreamMode_t;
+
+/** Direction of single frame */
+typedef enum
+{
+    eMOD_FRAME_REQUEST,
+    eMOD_FRAME_RESPONSE
+} modFrameDir_t;
+
+typedef struct modStreamFramer_s modStreamFramer_t;
+
+/**
+ * @brief   User will pass pointer to function that consumes one complete frame (CRC already checked,
+ *          @b length includes CRC bytes).
+ * @warning @b frame points into internal buffer, it is valid only during the call.
+ */
+typedef void (*pfModStreamFrame_t)(modStreamFramer_t* framer, const uint8_t* frame, uint16_t length, modFrameDir_t dir);
+
+/**
+ * @brief   Stream framer structure. More than one framer can exist in the system at one time.
+ */
+struct modStreamFramer_s
+{
+    void*                       userContent;    ///< user defined pointer, can by used to pass anything
+    pfModStreamFrame_t          pfFrame;        ///< frame consumer
+
+    modStreamMode_t             mode;           ///< kind of traffic
+    modFrameDir_t               expect;         ///< direction tried first in eMOD_STREAM_BOTH mode
+    uint16_t                    head;           ///< first not yet consumed byte in buffer
+    uint16_t                    tail;           ///< first free byte in buffer
+
+    uint32_t                    frames;         ///< statistics: number of emitted frames
+    uint32_t                    dropped;        ///< statistics: number of bytes skipped during resynchronization
+
+    uint8_t                     buffer[MODBUS_STREAM_BUF_SIZE];
+};
+
+/**
+ * @brief           Initializes stream framer
+ * @warning         framer structure must have valid pfFrame pointer BEFORE calling this fnc
+ * @param framer    Pointer to framer structure
+ * @param mode      Kind of traffic carried by the stream
+ * @return int16_t  0 if OK, -1 if params are wrong
+ */
+int16_t ModStreamInit(modStreamFramer_t* framer, modStreamMode_t mode);
+
+/**
+ * @brief           Feeds chunk of received bytes, calls pfFrame for every complete frame found.
+ * @param framer    Pointer to framer structure
+ * @param data      Received bytes
+ * @param length    Number of received bytes, any size
+ * @return uint32_t Number of frames emitted during this call
+ */
+uint32_t ModStreamFeed(modStreamFramer_t* framer, const uint8_t* data, uint32_t length);
+
+/**
+ * @brief           Drops all pending (incomplete) bytes. Call it if idle gap is detected by other means
+ *                  or when direction of half-duplex line changes (e.g. from @ref pfModMReceive_t).
+ * @param framer    Pointer to framer structure
+ */
+void ModStreamFlush(modStreamFramer_t* framer);
+
+/**
+ * @brief           Predicts length of frame starting at @b buf from its function code.
+ * @param buf       Candidate frame start
+ * @param avail     Number of valid bytes at @b buf
+ * @param dir       Request or response table
+ * @return int16_t  Frame length incl. CRC, 0 if more bytes are needed to decide, -1 if it can't be valid frame
+ */
+int16_t ModStreamPredictLength(const uint8_t* buf, uint16_t avail, modFrameDir_t dir);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_STREAM_RTU_H */
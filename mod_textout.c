@@ -0,0 +1,25 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include "mod_textout.h"
+
+void ModTextOutPrintf(modTextOut_t* out, const char* fmt, ...)
+{
+    va_list args;
+    int n;
+
+    if (out->overflow)
+    {
+        return;
+    }
+    va_start(args, fmt);
+    n = vsnprintf(out->buf + out->len, out->size - out->len, fmt, args);
+    va_end(args);
+    if (n < 0 || (uint32_t)n >= out->size - out->len)
+    {
+        out->overflow = 1;
+    }
+    else
+    {
+        out->len += (uint32_t)n;
+    }
+}
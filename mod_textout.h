@@ -0,0 +1,39 @@
+/**
+ * @file    mod_textout.h
+ * @brief   Bounded text output into caller's buffer with overflow detection, used by text renderers of modules
+ *          (@ref mod_stats.h, @ref mod_profile.h). Once the buffer is full, further output is ignored and overflow
+ *          stays set, so renderer checks it once at the end.
+ */
+
+#ifndef SYSTEM_MOD_TEXTOUT_H
+#define SYSTEM_MOD_TEXTOUT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/**
+ * @brief   Output buffer
+ */
+typedef struct
+{
+    char*                       buf;
+    uint32_t                    size;           ///< size of buf, > 0
+    uint32_t                    len;            ///< length of text (without terminating zero)
+    uint8_t                     overflow;       ///< 1 if some output didn't fit, text is incomplete
+} modTextOut_t;
+
+/**
+ * @brief           Appends formatted text (printf format)
+ * @param out       Pointer to output buffer
+ * @param fmt       Format
+ */
+void ModTextOutPrintf(modTextOut_t* out, const char* fmt, ...);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_TEXTOUT_H */
@@ -0,0 +1,36 @@
+/**
+ * @file    mod_time_linux.h
+ * @brief   Time API for Modbus stacks running on Linux (host tools, gateways). Included by @ref mod_master_rtu.h
+ *          instead of FreeRTOS when MODBUS_PORT_LINUX is defined. Implemented in mod_port_linux.c.
+ */
+
+#ifndef SYSTEM_MOD_TIME_LINUX_H
+#define SYSTEM_MOD_TIME_LINUX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define MODBUS_TIME_T               uint32_t
+#define MODBUS_GET_TIME_MS          ModPortTimeMs()
+#define MODBUS_GET_TIME_ISR_MS      ModPortTimeMs()
+
+/**
+ * @brief           Monotonic time
+ * @return uint32_t Milliseconds since arbitrary point, wraps around
+ */
+uint32_t ModPortTimeMs(void);
+
+/**
+ * @brief           Monotonic time
+ * @return uint64_t Microseconds since arbitrary point
+ */
+uint64_t ModPortTimeUs(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_TIME_LINUX_H */
@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <string.h>
+#include "mod_timer_wheel.h"
+
+#define WHEEL_MASK      (MODBUS_WHEEL_SLOTS - 1)
+
+// slot index of given time at given level
+#define WHEEL_INDEX(time, level)    (((time) >> ((level) * MODBUS_WHEEL_BITS)) & WHEEL_MASK)
+
+static void ModTimerWheelLink(modTimerWheel_t* wheel, modTimer_t* timer)
+{
+    uint32_t delta = timer->expires - wheel->tick;
+    uint32_t expires = timer->expires;
+    uint8_t level = 0;
+    uint8_t idx;
+
+    if ((int32_t)delta < 0)
+    {
+        // already expired, process at next tick
+        delta = 0;
+        expires = wheel->tick;
+    }
+    while (level < MODBUS_WHEEL_LEVELS - 1 && delta >= (1ul << ((level + 1) * MODBUS_WHEEL_BITS)))
+    {
+        level++;
+    }
+    idx = (uint8_t)WHEEL_INDEX(expires, level);
+
+    timer->level = level;
+    timer->slot = idx;
+    timer->prev = NULL;
+    timer->next = wheel->slots[level][idx];
+    if (timer->next != NULL)
+    {
+        timer->next->prev = timer;
+    }
+    wheel->slots[level][idx] = timer;
+    wheel->occupied[level] |= (uint64_t)1 << idx;
+}
+
+static void ModTimerWheelUnlink(modTimerWheel_t* wheel, modTimer_t* timer)
+{
+    if (timer->prev != NULL)
+    {
+        timer->prev->next = timer->next;
+    }
+    else
+    {
+        wheel->slots[timer->level][timer->slot] = timer->next;
+        if (timer->next == NULL)
+        {
+            wheel->occupied[timer->level] &= ~((uint64_t)1 << timer->slot);
+        }
+    }
+    if (timer->next != NULL)
+    {
+        timer->next->prev = timer->prev;
+    }
+}
+
+// move timers of higher level slot to lower levels
+static void ModTimerWheelCascade(modTimerWheel_t* wheel, uint8_t level, uint8_t idx)
+{
+    modTimer_t* timer = wheel->slots[level][idx];
+
+    wheel->slots[level][idx] = NULL;
+    wheel->occupied[level] &= ~((uint64_t)1 << idx);
+    while (timer != NULL)
+    {
+        modTimer_t* next = timer->next;
+        ModTimerWheelLink(wheel, timer);
+        timer = next;
+    }
+}
+
+void ModTimerWheelInit(modTimerWheel_t* wheel, uint32_t now)
+{
+    memset(wheel->slots, 0, sizeof(wheel->slots));
+    memset(wheel->occupied, 0, sizeof(wheel->occupied));
+    wheel->tick = now + 1; // time now is processed
+    wheel->count = 0;
+}
+
+void ModTimerStart(modTimerWheel_t* wheel, modTimer_t* timer, uint32_t delayMs)
+{
+    if (timer->running)
+    {
+        ModTimerWheelUnlink(wheel, timer);
+        wheel->count--;
+    }
+    if (delayMs == 0)
+    {
+        delayMs = 1; // next tick, also callback re-starting its timer can't loop forever
+    }
+    else if (delayMs > MODBUS_WHEEL_MAX_MS)
+    {
+        delayMs = MODBUS_WHEEL_MAX_MS;
+    }
+    timer->expires = wheel->tick - 1 + delayMs;
+    timer->running = 1;
+    ModTimerWheelLink(wheel, timer);
+    wheel->count++;
+}
+
+void ModTimerStop(modTimerWheel_t* wheel, modTimer_t* timer)
+{
+    if (timer->running)
+    {
+        ModTimerWheelUnlink(wheel, timer);
+        timer->running = 0;
+        wheel->count--;
+    }
+}
+
+uint32_t ModTimerWheelAdvance(modTimerWheel_t* wheel, uint32_t now)
+{
+    uint32_t expired = 0;
+
+    // process ticks wheel->tick .. now inclusive
+    while ((int32_t)(now - wheel->tick) >= 0)
+    {
+        uint8_t idx = (uint8_t)WHEEL_INDEX(wheel->tick, 0);
+        modTimer_t* timer;
+
+        if (wheel->count == 0)
+        {
+            wheel->tick = now + 1;
+            break;
+        }
+        if (idx == 0)
+        {
+            // level 0 wrapped, refill it from higher levels (highest first)
+            uint8_t top = 1;
+            while (top < MODBUS_WHEEL_LEVELS - 1 && WHEEL_INDEX(wheel->tick, top) == 0)
+            {
+                top++;
+            }
+            for (uint8_t level = top; level > 0; level--)
+            {
+                ModTimerWheelCascade(wheel, level, (uint8_t)WHEEL_INDEX(wheel->tick, level));
+            }
+        }
+        else if (!(wheel->occupied[0] >> idx))
+        {
+            // nothing in the rest of level 0, jump to its wrap (or to now)
+            uint32_t wrap = (wheel->tick | WHEEL_MASK) + 1;
+            wheel->tick = (int32_t)(now - wrap) >= 0 ? wrap : now + 1;
+            continue;
+        }
+
+        // expire timers of current tick, callbacks may start new timers
+        while ((timer = wheel->slots[0][idx]) != NULL)
+        {
+            wheel->slots[0][idx] = timer->next;
+            if (timer->next != NULL)
+            {
+                timer->next->prev = NULL;
+            }
+            else
+            {
+                wheel->occupied[0] &= ~((uint64_t)1 << idx);
+            }
+            timer->running = 0;
+            wheel->count--;
+            expired++;
+            if (timer->pfExpired != NULL)
+            {
+                timer->pfExpired(wheel, timer);
+            }
+        }
+        wheel->tick++;
+    }
+
+    return expired;
+}
+
+int32_t ModTimerWheelNextExpiry(const modTimerWheel_t* wheel)
+{
+    uint32_t best = MODBUS_WHEEL_MAX_MS + 1;
+    uint8_t idx = (uint8_t)WHEEL_INDEX(wheel->tick, 0);
+
+    if (wheel->count == 0)
+    {
+        return -1;
+    }
+
+    // level 0: exact expiry, slots before current index belong to next round
+    for (uint8_t i = 0; i < MODBUS_WHEEL_SLOTS; i++)
+    {
+        if (wheel->occupied[0] & ((uint64_t)1 << ((idx + i) & WHEEL_MASK)))
+        {
+            best = i;
+            break;
+        }
+    }
+
+    // higher levels: time when slot is cascaded
+    for (uint8_t level = 1; level < MODBUS_WHEEL_LEVELS; level++)
+    {
+        uint8_t shift = level * MODBUS_WHEEL_BITS;
+        uint8_t cur = (uint8_t)WHEEL_INDEX(wheel->tick, level);
+
+        if (wheel->occupied[level] == 0)
+        {
+            continue;
+        }
+        if (idx == 0)
+        {
+            best = 0; // wrap of level 0 not processed yet, current slots wait for cascade
+            break;
+        }
+        for (uint8_t i = 1; i <= MODBUS_WHEEL_SLOTS; i++)
+        {
+            if (wheel->occupied[level] & ((uint64_t)1 << ((cur + i) & WHEEL_MASK)))
+            {
+                uint32_t at = ((wheel->tick >> shift) + i) << shift;
+                if (at - wheel->tick < best)
+                {
+                    best = at - wheel->tick;
+                }
+                break;
+            }
+        }
+    }
+
+    return (int32_t)best + 1; // relative to last processed tick
+}
@@ -0,0 +1,112 @@
+/**
+ * @file    mod_timer_wheel.h
+ * @brief   Hierarchical timer wheel with millisecond resolution. Start, stop and expiry of timer is O(1) regardless
+ *          of number of running timers, next expiry is found from per-level occupancy bitmaps without scanning
+ *          timers. Timers are allocated by caller (usually embedded in request or queue structure), no heap is used.
+ *
+ *          4 levels of 64 slots cover timeouts up to 2^24 ms (4.6 hours), longer ones are clamped.
+ *          Wheel doesn't read any clock, time is passed to @ref ModTimerWheelAdvance() by the event loop:
+ * @code
+ *          for (;;) {
+ *              int32_t wait = ModTimerWheelNextExpiry(&wheel);    // -1 = no timer running
+ *              WaitForIo(wait);
+ *              ModTimerWheelAdvance(&wheel, NowMs());              // runs callbacks of expired timers
+ *          }
+ * @endcode
+ * @warning Not ISR-safe, use it from main loop only.
+ */
+
+#ifndef SYSTEM_MOD_TIMER_WHEEL_H
+#define SYSTEM_MOD_TIMER_WHEEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define MODBUS_WHEEL_LEVELS         4
+#define MODBUS_WHEEL_BITS           6
+#define MODBUS_WHEEL_SLOTS          (1 << MODBUS_WHEEL_BITS)
+#define MODBUS_WHEEL_MAX_MS         ((1ul << (MODBUS_WHEEL_LEVELS * MODBUS_WHEEL_BITS)) - 1)
+
+typedef struct modTimer_s modTimer_t;
+typedef struct modTimerWheel_s modTimerWheel_t;
+
+/**
+ * @brief   Called by @ref ModTimerWheelAdvance() when timer expires. Timer is stopped already, so it can be
+ *          started again from the callback.
+ */
+typedef void (*pfModTimer_t)(modTimerWheel_t* wheel, modTimer_t* timer);
+
+/**
+ * @brief   Timer structure, set pfExpired and userContent before start.
+ */
+struct modTimer_s
+{
+    modTimer_t*                 next;           ///< intrusive link in wheel slot
+    modTimer_t*                 prev;
+    uint32_t                    expires;        ///< absolute time [ms]
+    uint8_t                     running;        ///< 1 while in wheel
+    uint8_t                     level;          ///< position in wheel, valid while running
+    uint8_t                     slot;
+    pfModTimer_t                pfExpired;      ///< expiry callback
+    void*                       userContent;    ///< user defined pointer, can by used to pass anything
+};
+
+/**
+ * @brief   Timer wheel structure
+ */
+struct modTimerWheel_s
+{
+    uint32_t                    tick;           ///< next tick to process, wheel time is tick - 1
+    uint32_t                    count;          ///< number of running timers
+    uint64_t                    occupied[MODBUS_WHEEL_LEVELS];  ///< bitmap of non-empty slots
+    modTimer_t*                 slots[MODBUS_WHEEL_LEVELS][MODBUS_WHEEL_SLOTS];
+    void*                       userContent;    ///< user defined pointer, can by used to pass anything
+};
+
+/**
+ * @brief           Initializes empty wheel
+ * @param wheel     Pointer to wheel structure
+ * @param now       Current time [ms]
+ */
+void ModTimerWheelInit(modTimerWheel_t* wheel, uint32_t now);
+
+/**
+ * @brief           Starts (or re-starts) timer
+ * @param wheel     Pointer to wheel structure
+ * @param timer     Pointer to timer structure
+ * @param delayMs   Expiry relative to wheel time (last time passed to @ref ModTimerWheelAdvance()),
+ *                  1 - MODBUS_WHEEL_MAX_MS, 0 is treated as 1
+ */
+void ModTimerStart(modTimerWheel_t* wheel, modTimer_t* timer, uint32_t delayMs);
+
+/**
+ * @brief           Stops timer, stopped timer is ignored
+ * @param wheel     Pointer to wheel structure
+ * @param timer     Pointer to timer structure
+ */
+void ModTimerStop(modTimerWheel_t* wheel, modTimer_t* timer);
+
+/**
+ * @brief           Moves wheel time forward and runs callbacks of all timers expired up to now
+ * @param wheel     Pointer to wheel structure
+ * @param now       Current time [ms]
+ * @return uint32_t Number of expired timers
+ */
+uint32_t ModTimerWheelAdvance(modTimerWheel_t* wheel, uint32_t now);
+
+/**
+ * @brief           Time until wheel needs next @ref ModTimerWheelAdvance(). It may be earlier than expiry of any
+ *                  timer, when timers of higher level have to be moved to lower level.
+ * @param wheel     Pointer to wheel structure
+ * @return int32_t  Milliseconds from wheel time, -1 if no timer is running
+ */
+int32_t ModTimerWheelNextExpiry(const modTimerWheel_t* wheel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_TIMER_WHEEL_H */
@@ -0,0 +1,62 @@
+/**
+ * @file    mod_trace.h
+ * @brief   Compile-time instrumentation hooks of master and slave stacks. All hooks expand to nothing by default.
+ *          To attach tracer or profiler, define MODBUS_TRACE_HEADER (e.g. -DMODBUS_TRACE_HEADER='"my_trace.h"')
+ *          with definitions of hooks you need, undefined hooks stay empty. @ref mod_trace_usdt_linux.h maps all
+ *          hooks to USDT probes (SystemTap, bpftrace, LTTng userspace probes).
+ *
+ *          Hooks of state transitions are called right after new state is stored, so together they delimit
+ *          phases of transaction (e.g. PROCESSING -> TRANSMITTING of slave is time spent by command dispatch).
+ *          Example of cycle-counter tracing on Cortex-M:
+ * @code
+ *          // my_trace.h
+ *          extern uint32_t traceBuf[256]; extern uint8_t traceIdx;
+ *          #define MODBUS_TRACE_S_STATE(sstack, state)     (traceBuf[traceIdx++] = DWT->CYCCNT << 4 | (state))
+ * @endcode
+ * @warning Hooks of state transitions and sending may be called from ISR (stack callbacks).
+ */
+
+#ifndef SYSTEM_MOD_TRACE_H
+#define SYSTEM_MOD_TRACE_H
+
+#ifdef MODBUS_TRACE_HEADER
+#include MODBUS_TRACE_HEADER
+#endif
+
+/**
+ * @defgroup ModbusTraceMaster Master hooks
+ * @{
+ */
+#ifndef MODBUS_TRACE_M_STATE
+#define MODBUS_TRACE_M_STATE(mstack, state)             ///< new modMasterState_t stored (TIMED_OUT is reported only)
+#endif
+#ifndef MODBUS_TRACE_M_SEND
+#define MODBUS_TRACE_M_SEND(mstack, data, len)          ///< request with CRC is going to pfSend
+#endif
+#ifndef MODBUS_TRACE_M_CRC
+#define MODBUS_TRACE_M_CRC(mstack, ok)                  ///< CRC of answer checked, ok = 0 / 1
+#endif
+#ifndef MODBUS_TRACE_M_DISPATCH
+#define MODBUS_TRACE_M_DISPATCH(mstack, opCode)         ///< answer with valid CRC is going to be processed
+#endif
+/** @} */
+
+/**
+ * @defgroup ModbusTraceSlave Slave hooks
+ * @{
+ */
+#ifndef MODBUS_TRACE_S_STATE
+#define MODBUS_TRACE_S_STATE(sstack, state)             ///< new modSlaveState_t stored
+#endif
+#ifndef MODBUS_TRACE_S_SEND
+#define MODBUS_TRACE_S_SEND(sstack, data, len)          ///< answer with CRC is going to pfSendAns
+#endif
+#ifndef MODBUS_TRACE_S_CRC
+#define MODBUS_TRACE_S_CRC(sstack, ok)                  ///< CRC of request for this slave checked, ok = 0 / 1
+#endif
+#ifndef MODBUS_TRACE_S_DISPATCH
+#define MODBUS_TRACE_S_DISPATCH(sstack, opCode)         ///< valid request is going to be executed
+#endif
+/** @} */
+
+#endif /* SYSTEM_MOD_TRACE_H */
@@ -0,0 +1,26 @@
+/**
+ * @file    mod_trace_usdt_linux.h
+ * @brief   Maps hooks of @ref mod_trace.h to USDT probes of provider "modbus". Probes cost one nop when not attached.
+ *          Build stacks with -DMODBUS_TRACE_HEADER='"mod_trace_usdt_linux.h"' (needs sys/sdt.h, package
+ *          systemtap-sdt-dev / systemtap-sdt-devel) and attach e.g.:
+ *
+ *          bpftrace -e 'usdt:./gateway:modbus:slave_state { @[arg1] = count(); }'
+ *          lttng enable-event --userspace-probe=sdt:./gateway:modbus:master_send modbus_tx
+ */
+
+#ifndef SYSTEM_MOD_TRACE_USDT_LINUX_H
+#define SYSTEM_MOD_TRACE_USDT_LINUX_H
+
+#include <sys/sdt.h>
+
+#define MODBUS_TRACE_M_STATE(mstack, state)     DTRACE_PROBE2(modbus, master_state, (mstack), (int)(state))
+#define MODBUS_TRACE_M_SEND(mstack, data, len)  DTRACE_PROBE3(modbus, master_send, (mstack), (data), (int)(len))
+#define MODBUS_TRACE_M_CRC(mstack, ok)          DTRACE_PROBE2(modbus, master_crc, (mstack), (int)(ok))
+#define MODBUS_TRACE_M_DISPATCH(mstack, opCode) DTRACE_PROBE2(modbus, master_dispatch, (mstack), (int)(opCode))
+
+#define MODBUS_TRACE_S_STATE(sstack, state)     DTRACE_PROBE2(modbus, slave_state, (sstack), (int)(state))
+#define MODBUS_TRACE_S_SEND(sstack, data, len)  DTRACE_PROBE3(modbus, slave_send, (sstack), (data), (int)(len))
+#define MODBUS_TRACE_S_CRC(sstack, ok)          DTRACE_PROBE2(modbus, slave_crc, (sstack), (int)(ok))
+#define MODBUS_TRACE_S_DISPATCH(sstack, opCode) DTRACE_PROBE2(modbus, slave_dispatch, (sstack), (int)(opCode))
+
+#endif /* SYSTEM_MOD_TRACE_USDT_LINUX_H */
@@ -0,0 +1,513 @@
+#include <stdio.h>
+#include <string.h>
+#include "mod_tslog.h"
+
+#define TSLOG_MAX_REGS                  125
+
+static void ModTsLogPut16(uint8_t* p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void ModTsLogPut32(uint8_t* p, uint32_t v)
+{
+    ModTsLogPut16(p, (uint16_t)v);
+    ModTsLogPut16(p + 2, (uint16_t)(v >> 16));
+}
+
+static void ModTsLogPut64(uint8_t* p, uint64_t v)
+{
+    ModTsLogPut32(p, (uint32_t)v);
+    ModTsLogPut32(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint16_t ModTsLogGet16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static uint32_t ModTsLogGet32(const uint8_t* p)
+{
+    return ModTsLogGet16(p) | (uint32_t)ModTsLogGet16(p + 2) << 16;
+}
+
+static uint64_t ModTsLogGet64(const uint8_t* p)
+{
+    return ModTsLogGet32(p) | (uint64_t)ModTsLogGet32(p + 4) << 32;
+}
+
+static uint8_t* ModTsLogPutVar(uint8_t* p, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        *p++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+
+    return p;
+}
+
+// returns NULL if varint doesn't end before end
+static const uint8_t* ModTsLogGetVar(const uint8_t* p, const uint8_t* end, uint64_t* v)
+{
+    uint64_t r = 0;
+
+    for (uint8_t shift = 0; p < end && shift < 64; shift += 7)
+    {
+        uint8_t b = *p++;
+
+        r |= (uint64_t)(b & 0x7F) << shift;
+        if ((b & 0x80) == 0)
+        {
+            *v = r;
+            return p;
+        }
+    }
+
+    return NULL;
+}
+
+static uint8_t ModTsLogVarLen16(uint16_t v)
+{
+    return (v < 0x80) ? 1 : (v < 0x4000) ? 2 : 3;
+}
+
+static uint16_t ModTsLogZigzag16(uint16_t prev, uint16_t v)
+{
+    int16_t d = (int16_t)(uint16_t)(v - prev);
+
+    return (uint16_t)(((uint16_t)d << 1) ^ (uint16_t)(d >> 15));
+}
+
+// block / index entry header: length or offset, series, count, time span
+static void ModTsLogPutSpan(uint8_t* p, uint32_t lengthOrOffset, const modTsSeries_t* s, uint64_t t0, uint64_t t1)
+{
+    ModTsLogPut32(p, lengthOrOffset);
+    ModTsLogPut16(p + 4, s->firstReg);
+    ModTsLogPut16(p + 6, s->numRegs);
+    p[8] = s->input;
+    p[9] = 0;
+    ModTsLogPut16(p + 10, s->count);
+    ModTsLogPut32(p + 12, 0);
+    ModTsLogPut64(p + 16, t0);
+    ModTsLogPut64(p + 24, t1);
+}
+
+// encodes block of series at out, returns its length
+static uint32_t ModTsLogEncodeBlock(const modTsSeries_t* s, uint8_t* out)
+{
+    uint8_t* p = out + MODBUS_TSLOG_BLOCK_HEADER + 4 * s->numRegs;
+    uint64_t prev = s->times[0];
+    int64_t prevDelta = 0;
+    uint64_t t0 = s->times[0];
+    uint64_t t1 = s->times[0];
+
+    // timestamps: first one, then delta-of-delta (periodic polling gives zeros); first sample needn't be the
+    // earliest one (wall clock stepped back), t0 / t1 are only the span for index
+    ModTsLogPut64(p, s->times[0]);
+    p += 8;
+    for (uint16_t i = 1; i < s->count; i++)
+    {
+        int64_t delta = (int64_t)(s->times[i] - prev);
+        int64_t dd = delta - prevDelta;
+
+        p = ModTsLogPutVar(p, ((uint64_t)dd << 1) ^ (uint64_t)(dd >> 63));
+        prevDelta = delta;
+        prev = s->times[i];
+        t0 = (s->times[i] < t0) ? s->times[i] : t0;
+        t1 = (s->times[i] > t1) ? s->times[i] : t1;
+    }
+
+    for (uint16_t c = 0; c < s->numRegs; c++)
+    {
+        const uint16_t* v = &s->values[(uint32_t)c * MODBUS_TSLOG_BLOCK];
+        uint32_t deltaLen = 0;
+        uint32_t xorLen = 0;
+        uint16_t changed = 0;
+        uint8_t mode;
+
+        ModTsLogPut32(&out[MODBUS_TSLOG_BLOCK_HEADER + 4 * c], (uint32_t)(p - out));
+        for (uint16_t i = 1; i < s->count; i++)
+        {
+            deltaLen += ModTsLogVarLen16(ModTsLogZigzag16(v[i - 1], v[i]));
+            xorLen += ModTsLogVarLen16((uint16_t)(v[i - 1] ^ v[i]));
+            changed |= (uint16_t)(v[i - 1] ^ v[i]);
+        }
+        mode = (changed == 0) ? MODBUS_TSLOG_CONST :
+               (xorLen < deltaLen) ? MODBUS_TSLOG_XOR : MODBUS_TSLOG_DELTA;
+
+        *p++ = mode;
+        ModTsLogPut16(p, v[0]);
+        p += 2;
+        if (mode == MODBUS_TSLOG_DELTA)
+        {
+            for (uint16_t i = 1; i < s->count; i++)
+            {
+                p = ModTsLogPutVar(p, ModTsLogZigzag16(v[i - 1], v[i]));
+            }
+        }
+        else if (mode == MODBUS_TSLOG_XOR)
+        {
+            for (uint16_t i = 1; i < s->count; i++)
+            {
+                p = ModTsLogPutVar(p, (uint16_t)(v[i - 1] ^ v[i]));
+            }
+        }
+    }
+
+    ModTsLogPutSpan(out, (uint32_t)(p - out), s, t0, t1);
+
+    return (uint32_t)(p - out);
+}
+
+static int16_t ModTsLogWriteSegment(modTsLog_t* log)
+{
+    uint64_t t0 = UINT64_MAX;
+    uint64_t t1 = 0;
+    int16_t ret = 0;
+
+    for (uint16_t i = 0; i < log->segBlocks; i++)
+    {
+        const uint8_t* e = &log->buf[MODBUS_TSLOG_INDEX_HEADER + i * MODBUS_TSLOG_INDEX_ENTRY];
+        uint64_t e0 = ModTsLogGet64(e + 16);
+        uint64_t e1 = ModTsLogGet64(e + 24);
+
+        t0 = (e0 < t0) ? e0 : t0;
+        t1 = (e1 > t1) ? e1 : t1;
+    }
+    // unused entries stay in place, index has fixed size
+    memset(&log->buf[MODBUS_TSLOG_INDEX_HEADER + log->segBlocks * MODBUS_TSLOG_INDEX_ENTRY], 0,
+           (MODBUS_TSLOG_SEGMENT - log->segBlocks) * MODBUS_TSLOG_INDEX_ENTRY);
+    ModTsLogPut32(&log->buf[0], log->segLength);
+    ModTsLogPut16(&log->buf[4], log->segBlocks);
+    ModTsLogPut16(&log->buf[6], 0);
+    ModTsLogPut64(&log->buf[8], t0);
+    ModTsLogPut64(&log->buf[16], t1);
+
+    if (log->pfWrite(log, log->buf, log->segLength) < 0)
+    {
+        log->errors++; // segment is dropped, log stays consistent
+        ret = -3;
+    }
+    else
+    {
+        log->bytes += log->segLength;
+    }
+    log->segLength = 0;
+    log->segBlocks = 0;
+
+    return ret;
+}
+
+// closes block of series, writes segment when it is full
+static int16_t ModTsLogSeal(modTsLog_t* log, modTsSeries_t* s)
+{
+    uint8_t* entry;
+    uint32_t length;
+
+    if (s->count == 0)
+    {
+        return 0;
+    }
+    if (log->segLength != 0 && log->segLength + MODBUS_TSLOG_BLOCK_MAX(s->numRegs) > log->bufSize &&
+        ModTsLogWriteSegment(log) < 0)
+    {
+        s->count = 0;
+        return -3;
+    }
+    if (log->segLength == 0)
+    {
+        log->segLength = MODBUS_TSLOG_INDEX_SIZE; // room for index
+    }
+
+    length = ModTsLogEncodeBlock(s, &log->buf[log->segLength]);
+    entry = &log->buf[MODBUS_TSLOG_INDEX_HEADER + log->segBlocks * MODBUS_TSLOG_INDEX_ENTRY];
+    memcpy(entry, &log->buf[log->segLength], MODBUS_TSLOG_INDEX_ENTRY);
+    ModTsLogPut32(entry, log->segLength);
+    log->segLength += length;
+    log->segBlocks++;
+    log->blocks++;
+    s->count = 0;
+
+    if (log->segBlocks == MODBUS_TSLOG_SEGMENT)
+    {
+        return ModTsLogWriteSegment(log);
+    }
+
+    return 0;
+}
+
+int16_t ModTsLogInit(modTsLog_t* log)
+{
+    if (log->pfWrite == NULL || log->buf == NULL || log->pool == NULL ||
+        log->bufSize < MODBUS_TSLOG_INDEX_SIZE + MODBUS_TSLOG_BLOCK_MAX(TSLOG_MAX_REGS))
+    {
+        return -2; // wrong params
+    }
+
+    log->numSeries = 0;
+    log->poolUsed = 0;
+    log->segLength = 0;
+    log->segBlocks = 0;
+    log->samples = 0;
+    log->values = 0;
+    log->blocks = 0;
+    log->bytes = 0;
+    log->errors = 0;
+
+    return 0;
+}
+
+void ModTsLogHeader(uint8_t* data, uint8_t slaveAddr, uint64_t created)
+{
+    ModTsLogPut32(data, MODBUS_TSLOG_MAGIC);
+    ModTsLogPut16(data + 4, MODBUS_TSLOG_VERSION);
+    data[6] = slaveAddr;
+    data[7] = 0;
+    ModTsLogPut64(data + 8, created);
+}
+
+int16_t ModTsLogAppend(modTsLog_t* log, uint8_t input, uint16_t firstReg, uint16_t numRegs, const uint16_t* regs,
+                       uint64_t timeUs)
+{
+    modTsSeries_t* s = NULL;
+    uint16_t n;
+
+    if (regs == NULL || numRegs == 0 || numRegs > TSLOG_MAX_REGS)
+    {
+        return -2; // wrong params
+    }
+
+    for (uint16_t i = 0; i < log->numSeries; i++)
+    {
+        if (log->series[i].firstReg == firstReg && log->series[i].numRegs == numRegs &&
+            log->series[i].input == input)
+        {
+            s = &log->series[i];
+            break;
+        }
+    }
+    if (s == NULL)
+    {
+        if (log->numSeries >= MODBUS_TSLOG_SERIES ||
+            log->poolUsed + (uint32_t)numRegs * MODBUS_TSLOG_BLOCK > log->poolSize)
+        {
+            log->errors++;
+            return -1; // no free series
+        }
+        s = &log->series[log->numSeries++];
+        s->input = input ? 1 : 0;
+        s->firstReg = firstReg;
+        s->numRegs = numRegs;
+        s->count = 0;
+        s->values = &log->pool[log->poolUsed];
+        log->poolUsed += (uint32_t)numRegs * MODBUS_TSLOG_BLOCK;
+    }
+
+    n = s->count;
+    s->times[n] = timeUs;
+    for (uint16_t c = 0; c < numRegs; c++)
+    {
+        s->values[(uint32_t)c * MODBUS_TSLOG_BLOCK + n] = regs[c];
+    }
+    s->count = (uint16_t)(n + 1);
+    log->samples++;
+    log->values += numRegs;
+
+    if (s->count == MODBUS_TSLOG_BLOCK)
+    {
+        return ModTsLogSeal(log, s);
+    }
+
+    return 0;
+}
+
+void ModTsLogPollUpdate(modPoller_t* poller, modPollItem_t* item)
+{
+    modTsLog_t* log = (modTsLog_t*)item->userContent;
+
+    (void)poller;
+    if (item->result != eMOD_M_STATE_PROCESSED)
+    {
+        return;
+    }
+    (void)ModTsLogAppend(log, item->op == eMOD_REQ_READ_INPUT_REGS, item->firstReg, item->numRegs, item->regs,
+                         (log->pfTime != NULL) ? log->pfTime(log) : (uint64_t)item->sampleTime * 1000u);
+}
+
+int16_t ModTsLogFlush(modTsLog_t* log)
+{
+    int16_t ret = 0;
+
+    for (uint16_t i = 0; i < log->numSeries; i++)
+    {
+        if (ModTsLogSeal(log, &log->series[i]) < 0)
+        {
+            ret = -3;
+        }
+    }
+    if (log->segBlocks > 0 && ModTsLogWriteSegment(log) < 0)
+    {
+        ret = -3;
+    }
+
+    return ret;
+}
+
+uint32_t ModTsLogValidLength(const uint8_t* image, uint32_t size)
+{
+    uint32_t pos = MODBUS_TSLOG_FILE_HEADER;
+
+    if (image == NULL || size < MODBUS_TSLOG_FILE_HEADER || ModTsLogGet32(image) != MODBUS_TSLOG_MAGIC ||
+        ModTsLogGet16(image + 4) != MODBUS_TSLOG_VERSION)
+    {
+        return 0;
+    }
+    while (size - pos >= MODBUS_TSLOG_INDEX_SIZE)
+    {
+        uint32_t length = ModTsLogGet32(&image[pos]);
+
+        if (length < MODBUS_TSLOG_INDEX_SIZE || length > size - pos ||
+            ModTsLogGet16(&image[pos + 4]) > MODBUS_TSLOG_SEGMENT)
+        {
+            break; // torn segment
+        }
+        pos += length;
+    }
+
+    return pos;
+}
+
+int16_t ModTsLogOpen(modTsReader_t* reader, const uint8_t* image, uint32_t size)
+{
+    uint32_t valid = ModTsLogValidLength(image, size);
+
+    if (valid == 0)
+    {
+        return -2; // wrong image
+    }
+    reader->image = image;
+    reader->size = valid;
+    reader->slaveAddr = image[6];
+    reader->created = ModTsLogGet64(image + 8);
+
+    return 0;
+}
+
+// decodes column of block, returns number of stored samples
+static uint32_t ModTsLogDecode(const uint8_t* blk, const uint8_t* end, uint16_t column, uint64_t fromUs,
+                               uint64_t toUs, uint64_t* times, uint16_t* values, uint32_t max)
+{
+    uint16_t numRegs = ModTsLogGet16(blk + 6);
+    uint16_t count = ModTsLogGet16(blk + 10);
+    const uint8_t* tp = blk + MODBUS_TSLOG_BLOCK_HEADER + 4 * numRegs;
+    const uint8_t* vp;
+    uint64_t t;
+    int64_t delta = 0;
+    uint16_t v;
+    uint8_t mode;
+    uint32_t n = 0;
+
+    if (tp + 8 > end || ModTsLogGet32(blk + MODBUS_TSLOG_BLOCK_HEADER + 4 * column) + 3 > (uint32_t)(end - blk))
+    {
+        return 0; // damaged block
+    }
+    t = ModTsLogGet64(tp);
+    tp += 8;
+    vp = blk + ModTsLogGet32(blk + MODBUS_TSLOG_BLOCK_HEADER + 4 * column);
+    mode = vp[0];
+    if (mode > MODBUS_TSLOG_XOR)
+    {
+        return 0;
+    }
+    v = ModTsLogGet16(vp + 1);
+    vp += 3;
+
+    for (uint16_t i = 0; i < count && n < max; i++)
+    {
+        if (i > 0)
+        {
+            uint64_t zz;
+
+            tp = ModTsLogGetVar(tp, end, &zz);
+            if (tp == NULL)
+            {
+                break;
+            }
+            delta += (int64_t)(zz >> 1) ^ -(int64_t)(zz & 1);
+            t += (uint64_t)delta;
+            if (mode != MODBUS_TSLOG_CONST)
+            {
+                vp = ModTsLogGetVar(vp, end, &zz);
+                if (vp == NULL)
+                {
+                    break;
+                }
+                if (mode == MODBUS_TSLOG_XOR)
+                {
+                    v ^= (uint16_t)zz;
+                }
+                else
+                {
+                    v = (uint16_t)(v + (uint16_t)((zz >> 1) ^ -(zz & 1)));
+                }
+            }
+        }
+        if (t >= fromUs && t <= toUs)
+        {
+            times[n] = t;
+            values[n] = v;
+            n++;
+        }
+    }
+
+    return n;
+}
+
+int32_t ModTsLogRead(const modTsReader_t* reader, uint8_t input, uint16_t regAddr, uint64_t fromUs, uint64_t toUs,
+                     uint64_t* times, uint16_t* values, uint32_t max)
+{
+    uint32_t pos = MODBUS_TSLOG_FILE_HEADER;
+    uint32_t n = 0;
+
+    input = input ? 1 : 0;
+    // only index blocks are touched while skipping segments
+    while (pos < reader->size && n < max)
+    {
+        const uint8_t* seg = &reader->image[pos];
+        uint32_t length = ModTsLogGet32(seg);
+        uint16_t numBlocks = ModTsLogGet16(seg + 4);
+
+        if (ModTsLogGet64(seg + 8) <= toUs && ModTsLogGet64(seg + 16) >= fromUs)
+        {
+            for (uint16_t b = 0; b < numBlocks && n < max; b++)
+            {
+                const uint8_t* e = &seg[MODBUS_TSLOG_INDEX_HEADER + b * MODBUS_TSLOG_INDEX_ENTRY];
+                uint32_t offset = ModTsLogGet32(e);
+                uint16_t first = ModTsLogGet16(e + 4);
+                uint16_t numRegs = ModTsLogGet16(e + 6);
+                const uint8_t* blk;
+
+                if (e[8] != input || regAddr < first || (uint32_t)regAddr >= (uint32_t)first + numRegs ||
+                    ModTsLogGet64(e + 16) > toUs || ModTsLogGet64(e + 24) < fromUs)
+                {
+                    continue;
+                }
+                blk = seg + offset;
+                if (offset < MODBUS_TSLOG_INDEX_SIZE || offset > length - MODBUS_TSLOG_BLOCK_HEADER ||
+                    ModTsLogGet32(blk) > length - offset || ModTsLogGet16(blk + 6) != numRegs ||
+                    ModTsLogGet16(blk + 10) > MODBUS_TSLOG_BLOCK * 16u)
+                {
+                    continue; // damaged block
+                }
+                n += ModTsLogDecode(blk, blk + ModTsLogGet32(blk), (uint16_t)(regAddr - first), fromUs, toUs,
+                                    &times[n], &values[n], max - n);
+            }
+        }
+        pos += length;
+    }
+
+    return (int32_t)n;
+}
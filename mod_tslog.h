@@ -0,0 +1,206 @@
+/**
+ * @file    mod_tslog.h
+ * @brief   Columnar time-series log of polled registers, one append-only log per device. Samples of each series
+ *          (poll item: holding / input, first register, number of registers) are collected into blocks of
+ *          MODBUS_TSLOG_BLOCK samples and stored column by column: timestamps as delta-of-delta, each register as
+ *          delta or XOR of previous value (whichever is shorter, varints), constant column takes 1 byte.
+ *          Blocks are grouped into segments, each segment starts with index block (time span, series and offset
+ *          of every block), so range query reads only index blocks and columns of wanted register.
+ *
+ *          Writer (@ref ModTsLogAppend(), @ref ModTsLogPollUpdate() as pfUpdate of the poller) passes whole
+ *          segments to storage callback. Reader works in place on the image (mmap'd file, @ref mod_tslog_linux.h).
+ *
+ *          File layout (little-endian): file header, segments { index block, data blocks }. Data block: header,
+ *          offsets of columns, timestamp column { first time, deltas }, register columns { mode, values }.
+ */
+
+#ifndef SYSTEM_MOD_TSLOG_H
+#define SYSTEM_MOD_TSLOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "mod_poller.h"
+
+#ifndef MODBUS_TSLOG_BLOCK
+#define MODBUS_TSLOG_BLOCK          128     ///< samples per data block
+#endif
+#ifndef MODBUS_TSLOG_SEGMENT
+#define MODBUS_TSLOG_SEGMENT        32      ///< data blocks per segment (entries of index block)
+#endif
+#ifndef MODBUS_TSLOG_SERIES
+#define MODBUS_TSLOG_SERIES         16      ///< series per device
+#endif
+#define MODBUS_TSLOG_MAGIC          0x3153544Du     ///< "MTS1"
+#define MODBUS_TSLOG_VERSION        2
+#define MODBUS_TSLOG_FILE_HEADER    16      ///< magic, version, slave address, reserved, creation time
+#define MODBUS_TSLOG_INDEX_HEADER   24      ///< segment length, number of blocks, time span
+#define MODBUS_TSLOG_INDEX_ENTRY    32      ///< offset, series, count, time span of data block
+#define MODBUS_TSLOG_INDEX_SIZE     (MODBUS_TSLOG_INDEX_HEADER + MODBUS_TSLOG_SEGMENT * MODBUS_TSLOG_INDEX_ENTRY)
+#define MODBUS_TSLOG_BLOCK_HEADER   32      ///< length, series, count, time span
+
+/** Worst-case size of data block of numRegs registers */
+#define MODBUS_TSLOG_BLOCK_MAX(numRegs) \
+    (MODBUS_TSLOG_BLOCK_HEADER + 4 * (numRegs) + 8 + 10 * MODBUS_TSLOG_BLOCK + (numRegs) * (3 + 3 * MODBUS_TSLOG_BLOCK))
+
+/**
+ * @defgroup ModbusTsLogModes Encoding of register column
+ * @{
+ */
+#define MODBUS_TSLOG_CONST          0       ///< all samples equal to first one
+#define MODBUS_TSLOG_DELTA          1       ///< zigzag varint of difference to previous sample
+#define MODBUS_TSLOG_XOR            2       ///< varint of XOR with previous sample
+/** @} */
+
+typedef struct modTsLog_s modTsLog_t;
+
+/**
+ * @brief   Appends finished segment to storage, failed write has to leave storage as it was (no partial segment,
+ *          it would hide the following ones)
+ * @return  0 if OK, negative value in case of failure
+ */
+typedef int16_t (*pfModTsLogWrite_t)(modTsLog_t* log, const uint8_t* data, uint32_t length);
+
+/**
+ * @brief   Timestamp of sample [us], wall clock for archives
+ */
+typedef uint64_t (*pfModTsLogTime_t)(modTsLog_t* log);
+
+/**
+ * @brief   Series being collected (one per poll item)
+ */
+typedef struct
+{
+    uint8_t                     input;          ///< 1 input registers, 0 holding registers
+    uint16_t                    firstReg;
+    uint16_t                    numRegs;
+    uint16_t                    count;          ///< samples in current block
+    uint64_t                    times[MODBUS_TSLOG_BLOCK];
+    uint16_t*                   values;         ///< column-major, MODBUS_TSLOG_BLOCK per register (from pool)
+} modTsSeries_t;
+
+/**
+ * @brief   Log writer structure
+ */
+struct modTsLog_s
+{
+    // parameters
+    pfModTsLogWrite_t           pfWrite;
+    pfModTsLogTime_t            pfTime;         ///< can be NULL, sampleTime of poll item is used then (ms)
+    uint8_t*                    buf;            ///< segment buffer
+    uint32_t                    bufSize;        ///< at least MODBUS_TSLOG_INDEX_SIZE + MODBUS_TSLOG_BLOCK_MAX(125)
+    uint16_t*                   pool;           ///< staging of samples, MODBUS_TSLOG_BLOCK per polled register
+    uint32_t                    poolSize;       ///< number of registers in pool
+
+    // internal
+    modTsSeries_t               series[MODBUS_TSLOG_SERIES];
+    uint16_t                    numSeries;
+    uint32_t                    poolUsed;
+    uint32_t                    segLength;      ///< bytes in segment buffer, 0 = empty segment
+    uint16_t                    segBlocks;      ///< data blocks in segment
+
+    // statistics
+    uint32_t                    samples;        ///< logged samples
+    uint32_t                    values;         ///< logged register values
+    uint32_t                    blocks;         ///< written data blocks
+    uint64_t                    bytes;          ///< written bytes
+    uint32_t                    errors;         ///< failed writes, unknown series
+
+    void*                       userContent;    ///< user defined pointer, can by used to pass anything
+};
+
+/**
+ * @brief   Opened log image, all pointers point into it
+ */
+typedef struct
+{
+    const uint8_t*              image;
+    uint32_t                    size;           ///< size of complete segments
+    uint32_t                    mapped;         ///< size of mapping (set by @ref ModTsLogMapFile())
+    uint8_t                     slaveAddr;
+    uint64_t                    created;        ///< creation time [us]
+} modTsReader_t;
+
+/**
+ * @brief           Initializes log writer
+ * @warning         log structure must have valid parameters (pfWrite, buffers) BEFORE calling this fnc
+ * @param log       Pointer to log structure
+ * @return int16_t  0 if OK, -2 wrong params
+ */
+int16_t ModTsLogInit(modTsLog_t* log);
+
+/**
+ * @brief           Writes file header (beginning of new log) into data
+ * @param data      MODBUS_TSLOG_FILE_HEADER bytes
+ * @param slaveAddr Logged device
+ * @param created   Creation time [us]
+ */
+void ModTsLogHeader(uint8_t* data, uint8_t slaveAddr, uint64_t created);
+
+/**
+ * @brief           Appends one sample of series, series is created on first sample
+ * @param log       Pointer to log structure
+ * @param input     1 input registers, 0 holding registers
+ * @param firstReg  First register
+ * @param numRegs   Number of registers 1 - 125
+ * @param regs      Values
+ * @param timeUs    Timestamp [us]
+ * @return int16_t  0 if OK, -1 no free series / pool is too small, -2 wrong params, -3 storage error
+ */
+int16_t ModTsLogAppend(modTsLog_t* log, uint8_t input, uint16_t firstReg, uint16_t numRegs, const uint16_t* regs,
+                       uint64_t timeUs);
+
+/**
+ * @brief   pfUpdate callback of poller, item->userContent points to @ref modTsLog_t of the device.
+ *          Only successful reads are logged.
+ */
+void ModTsLogPollUpdate(modPoller_t* poller, modPollItem_t* item);
+
+/**
+ * @brief           Closes blocks of all series and writes segment (even not full one)
+ * @param log       Pointer to log structure
+ * @return int16_t  0 if OK, -3 storage error
+ */
+int16_t ModTsLogFlush(modTsLog_t* log);
+
+/**
+ * @brief           Length of valid part of log (complete segments), storage should be truncated to it before
+ *                  appending, torn segment would hide the following ones
+ * @param image     Log content
+ * @param size      Length of content
+ * @return uint32_t Length of valid log, 0 if header is wrong
+ */
+uint32_t ModTsLogValidLength(const uint8_t* image, uint32_t size);
+
+/**
+ * @brief           Opens log image for reading
+ * @param reader    Pointer to reader structure
+ * @param image     Log content, has to stay valid while reader is used
+ * @param size      Length of content
+ * @return int16_t  0 if OK, -2 wrong image
+ */
+int16_t ModTsLogOpen(modTsReader_t* reader, const uint8_t* image, uint32_t size);
+
+/**
+ * @brief           Reads samples of one register in time range, only blocks overlapping the range are decoded
+ *                  and only the column of the register
+ * @param reader    Opened log
+ * @param input     1 input registers, 0 holding registers
+ * @param regAddr   Register address
+ * @param fromUs    Start of range (including)
+ * @param toUs      End of range (including)
+ * @param times     Timestamps of samples [us]
+ * @param values    Values of samples
+ * @param max       Size of times / values, continue from last time + 1 if max samples were returned
+ * @return int32_t  Number of samples, in order of the log
+ */
+int32_t ModTsLogRead(const modTsReader_t* reader, uint8_t input, uint16_t regAddr, uint64_t fromUs, uint64_t toUs,
+                     uint64_t* times, uint16_t* values, uint32_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_TSLOG_H */
@@ -0,0 +1,191 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "mod_tslog_linux.h"
+
+static int16_t ModTsLogFileWrite(modTsLog_t* log, const uint8_t* data, uint32_t length)
+{
+    modTsLogFile_t* file = (modTsLogFile_t*)log->userContent;
+    uint32_t total = length;
+
+    // tail of failed write couldn't be cut off last time
+    if (file->torn)
+    {
+        if (ftruncate(file->fd, (off_t)file->end) < 0)
+        {
+            return -3;
+        }
+        file->torn = 0;
+    }
+    while (length > 0)
+    {
+        ssize_t n = write(file->fd, data, length);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            // partial segment would hide all following ones (e.g. ENOSPC), cut it off
+            file->torn = (ftruncate(file->fd, (off_t)file->end) < 0) ? 1 : 0;
+            return -3;
+        }
+        data += n;
+        length -= (uint32_t)n;
+    }
+    file->end += total;
+
+    return 0;
+}
+
+static uint64_t ModTsLogFileTime(modTsLog_t* log)
+{
+    struct timespec ts;
+
+    (void)log;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+// length of valid part of existing log, 0 if file isn't a log
+static uint32_t ModTsLogFileValid(int fd, uint32_t size)
+{
+    void* image;
+    uint32_t valid;
+
+    image = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (image == MAP_FAILED)
+    {
+        return 0;
+    }
+    valid = ModTsLogValidLength((const uint8_t*)image, size);
+    munmap(image, size);
+
+    return valid;
+}
+
+int16_t ModTsLogOpenFile(modTsLogFile_t* file, const char* dir, uint8_t slaveAddr)
+{
+    char path[512];
+    struct stat st;
+
+    if (dir == NULL || snprintf(path, sizeof(path), "%s/slave-%u.mts", dir, slaveAddr) >= (int)sizeof(path))
+    {
+        return -2; // wrong params
+    }
+    file->log.pfWrite = ModTsLogFileWrite;
+    file->log.pfTime = ModTsLogFileTime;
+    file->log.buf = file->buf;
+    file->log.bufSize = sizeof(file->buf);
+    file->log.pool = file->pool;
+    file->log.poolSize = MODBUS_TSLOG_POOL;
+    file->log.userContent = file;
+    if (ModTsLogInit(&file->log) < 0)
+    {
+        return -2;
+    }
+
+    file->fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (file->fd < 0)
+    {
+        return -3;
+    }
+    if (fstat(file->fd, &st) < 0 || (uint64_t)st.st_size > 0xFFFFFFFFu)
+    {
+        close(file->fd);
+        return -3;
+    }
+    file->end = 0;
+    file->torn = 0;
+    if (st.st_size == 0)
+    {
+        uint8_t header[MODBUS_TSLOG_FILE_HEADER];
+
+        ModTsLogHeader(header, slaveAddr, ModTsLogFileTime(&file->log));
+        if (ModTsLogFileWrite(&file->log, header, sizeof(header)) < 0)
+        {
+            close(file->fd);
+            return -3;
+        }
+    }
+    else
+    {
+        uint32_t valid = ModTsLogFileValid(file->fd, (uint32_t)st.st_size);
+
+        if (valid == 0)
+        {
+            close(file->fd);
+            return -2; // not a log, keep it untouched
+        }
+        // torn segment is cut off, next segments are appended behind the last complete one
+        if (valid != (uint32_t)st.st_size && ftruncate(file->fd, valid) < 0)
+        {
+            close(file->fd);
+            return -3;
+        }
+        file->end = valid;
+    }
+
+    return 0;
+}
+
+int16_t ModTsLogCloseFile(modTsLogFile_t* file)
+{
+    int16_t ret = ModTsLogFlush(&file->log);
+
+    close(file->fd);
+    file->fd = -1;
+
+    return ret;
+}
+
+int16_t ModTsLogMapFile(modTsReader_t* reader, const char* path)
+{
+    struct stat st;
+    void* image;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+    {
+        return -3;
+    }
+    if (fstat(fd, &st) < 0 || st.st_size <= 0 || (uint64_t)st.st_size > 0xFFFFFFFFu)
+    {
+        close(fd);
+        return -3;
+    }
+    image = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // mapping keeps the file
+    if (image == MAP_FAILED)
+    {
+        return -3;
+    }
+    // segment being appended is ignored, it is incomplete
+    if (ModTsLogOpen(reader, (const uint8_t*)image, (uint32_t)st.st_size) < 0)
+    {
+        munmap(image, (size_t)st.st_size);
+        return -2;
+    }
+    reader->mapped = (uint32_t)st.st_size;
+
+    return 0;
+}
+
+void ModTsLogUnmapFile(modTsReader_t* reader)
+{
+    if (reader->image != NULL)
+    {
+        munmap((void*)reader->image, reader->mapped);
+        reader->image = NULL;
+    }
+}
@@ -0,0 +1,72 @@
+/**
+ * @file    mod_tslog_linux.h
+ * @brief   File storage of time-series log (@ref mod_tslog.h): one file per device "<dir>/slave-<addr>.mts", segments
+ *          are appended by one write each. Segment which failed to be written (e.g. disk full) is cut off at once,
+ *          torn segment left by crash is cut off when the file is opened again.
+ *          Readers map the file (@ref ModTsLogMapFile()) and query it in place, also while it is being written.
+ *          Log is limited to 4 GB, new file has to be started then.
+ */
+
+#ifndef SYSTEM_MOD_TSLOG_LINUX_H
+#define SYSTEM_MOD_TSLOG_LINUX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "mod_tslog.h"
+
+#ifndef MODBUS_TSLOG_POOL
+#define MODBUS_TSLOG_POOL           (MODBUS_TSLOG_BLOCK * 256)  ///< staging of 256 polled registers per device
+#endif
+#define MODBUS_TSLOG_BUF_SIZE       (256 * 1024)    ///< segment buffer
+
+/**
+ * @brief   Log with file storage, log.userContent points to this structure
+ */
+typedef struct
+{
+    modTsLog_t                  log;
+    int                         fd;
+    uint32_t                    end;            ///< length of complete segments
+    uint8_t                     torn;           ///< 1 if failed write left partial segment behind end
+    uint8_t                     buf[MODBUS_TSLOG_BUF_SIZE];
+    uint16_t                    pool[MODBUS_TSLOG_POOL];
+} modTsLogFile_t;
+
+/**
+ * @brief           Opens (creates) log file of device, timestamps are taken from CLOCK_REALTIME
+ * @param file      Pointer to log structure
+ * @param dir       Directory of logs
+ * @param slaveAddr Logged device
+ * @return int16_t  0 if OK, -2 wrong params (or existing file isn't a log), -3 file error
+ */
+int16_t ModTsLogOpenFile(modTsLogFile_t* file, const char* dir, uint8_t slaveAddr);
+
+/**
+ * @brief           Flushes collected samples and closes log file
+ * @param file      Pointer to log structure
+ * @return int16_t  0 if OK, -3 last flush failed
+ */
+int16_t ModTsLogCloseFile(modTsLogFile_t* file);
+
+/**
+ * @brief           Maps log file read-only and opens it by @ref ModTsLogOpen()
+ * @param reader    Pointer to reader structure
+ * @param path      Log file
+ * @return int16_t  0 if OK, -2 wrong log, -3 file can't be opened / mapped
+ */
+int16_t ModTsLogMapFile(modTsReader_t* reader, const char* path);
+
+/**
+ * @brief           Unmaps log mapped by @ref ModTsLogMapFile()
+ * @param reader    Pointer to reader structure
+ */
+void ModTsLogUnmapFile(modTsReader_t* reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSTEM_MOD_TSLOG_LINUX_H */
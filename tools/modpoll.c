@@ -0,0 +1,538 @@
+/**
+ * @file    modpoll.c
+ * @brief   Command-line Modbus RTU master for Linux: reads / writes registers and packets, scans the bus and
+ *          qualifies devices and cables by benchmark mode - back-to-back transactions of configurable operation
+ *          mix, reporting transactions/s, latency percentiles, error breakdown and bus utilization
+ *          (@ref mod_busload.h).
+ *
+ *          Build:
+ *          gcc -O2 -DMODBUS_PORT_LINUX [-DMODBUS_USER_COMMANDS] -I.. -o modpoll modpoll.c ../mod_master_rtu.c
+ *              ../mod_slave_rtu.c ../mod_discovery.c ../mod_busload.c ../mod_stream_rtu.c ../mod_port_linux.c
+ *              ../crc.c
+ *
+ *          Usage:
+ *          modpoll [-b baud] [-p N|E|O] [-t timeout_ms] [-d seconds] [-n transactions] device command
+ *          read SLAVE FIRST COUNT              read holding registers
+ *          input SLAVE FIRST COUNT             read input registers
+ *          write SLAVE FIRST VALUE [VALUE ...] write registers
+ *          echo SLAVE                          diagnostics echo
+ *          rpacket SLAVE                       read packet (MODBUS_USER_COMMANDS)
+ *          wpacket SLAVE HEX                   write packet, e.g. 0102A0 (MODBUS_USER_COMMANDS)
+ *          scan [FIRST [LAST]]                 find devices (default 1 - 247)
+ *          bench SLAVE FIRST COUNT [MIX]         benchmark for -d seconds (default 10) or -n transactions,
+ *              MIX is comma separated list of operation and weight, default r1:
+ *              r = read holding, i = read input, w = write (same registers), e = echo, e.g. r70,w20,e10
+ *          -b 0 = pty / unpaced link (no inter-frame gap, no bus utilization)
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "mod_port_linux.h"
+#include "mod_discovery.h"
+#include "mod_busload.h"
+
+#define MAX_MIX         8
+#define MAX_SAMPLES     (1u << 22)  ///< latencies kept for percentiles, later transactions aren't sampled
+
+typedef enum
+{
+    OP_READ,
+    OP_INPUT,
+    OP_WRITE,
+    OP_ECHO
+} benchOp_t;
+
+typedef struct
+{
+    benchOp_t op;
+    uint32_t weight;
+    uint64_t count;
+} benchMix_t;
+
+static modMasterStack_t mstack;
+static modPortLink_t portLink;
+static uint32_t baud = 19200;
+static uint32_t gapUs;
+static uint64_t lastEndUs;
+static volatile sig_atomic_t stop;
+
+static void OnSignal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+static const char* StateName(modMasterState_t state)
+{
+    switch (state)
+    {
+    case eMOD_M_STATE_PROCESSED:    return "ok";
+    case eMOD_M_STATE_TIMED_OUT:    return "timeout";
+    case eMOD_M_STATE_CORRUPTED:    return "corrupted";
+    case eMOD_M_STATE_ERR_REPORTED: return "exception";
+    case eMOD_M_STATE_HW_ERROR:     return "hw error";
+    default:                        return "?";
+    }
+}
+
+// keeps inter-frame gap after previous transaction, on real line slave wouldn't see start of next request
+static void WaitGap(void)
+{
+    uint64_t now = ModPortTimeUs();
+
+    if (gapUs > 0 && now - lastEndUs < gapUs)
+    {
+        usleep((useconds_t)(gapUs - (now - lastEndUs)));
+    }
+}
+
+// waits for result of operation started by r (return value of ModMaster* call)
+static modMasterState_t Finish(int16_t r, uint8_t* errCode)
+{
+    modMasterState_t state = eMOD_M_STATE_HW_ERROR;
+
+    *errCode = 0;
+    if (r == 0 || r == -3)
+    {
+        while (!ModMasterCheck(&mstack, &state, errCode))
+        {
+            (void)ModPortPoll(&portLink, 1);
+        }
+    }
+    lastEndUs = ModPortTimeUs();
+
+    return state;
+}
+
+static int Report(modMasterState_t state, uint8_t errCode)
+{
+    if (state == eMOD_M_STATE_ERR_REPORTED)
+    {
+        fprintf(stderr, "exception %u\n", errCode);
+    }
+    else if (state != eMOD_M_STATE_PROCESSED)
+    {
+        fprintf(stderr, "%s\n", StateName(state));
+    }
+    return state == eMOD_M_STATE_PROCESSED ? 0 : 1;
+}
+
+static void Found(modDiscovery_t* disc, uint8_t bus, uint8_t slaveAddr, uint8_t errCode, uint16_t responseMs)
+{
+    (void)disc;
+    (void)bus;
+    printf("%3u: %s, %u ms\n", slaveAddr, errCode ? "present (no diagnostics)" : "present", responseMs);
+}
+
+static int Scan(uint8_t first, uint8_t last)
+{
+    modDiscovery_t disc;
+
+    ModDiscoveryInit(&disc);
+    disc.pfFound = &Found;
+    // unpaced link still needs some timing for timeouts
+    if (ModDiscoveryAddBus(&disc, &mstack, baud ? baud : 115200) < 0 || ModDiscoveryStart(&disc, first, last) < 0)
+    {
+        fprintf(stderr, "wrong range\n");
+        return 2;
+    }
+    while (ModDiscoveryCheck(&disc) > 0 && !stop)
+    {
+        (void)ModPortPoll(&portLink, 1);
+    }
+    printf("found %u, corrupted answers %u\n", disc.bus[0].found, disc.bus[0].corrupted);
+
+    return 0;
+}
+
+static int ParseMix(const char* s, benchMix_t* mix)
+{
+    int n = 0;
+
+    while (*s != '\0')
+    {
+        char* end;
+
+        if (n >= MAX_MIX)
+        {
+            return -1;
+        }
+        switch (*s)
+        {
+        case 'r': mix[n].op = OP_READ; break;
+        case 'i': mix[n].op = OP_INPUT; break;
+        case 'w': mix[n].op = OP_WRITE; break;
+        case 'e': mix[n].op = OP_ECHO; break;
+        default: return -1;
+        }
+        mix[n].weight = (uint32_t)strtoul(s + 1, &end, 10);
+        if (end == s + 1)
+        {
+            mix[n].weight = 1;
+        }
+        mix[n].count = 0;
+        n++;
+        s = (*end == ',') ? end + 1 : end;
+        if (*end != ',' && *end != '\0')
+        {
+            return -1;
+        }
+    }
+    return n;
+}
+
+static int CompareU32(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+
+    return (x > y) - (x < y);
+}
+
+static int Bench(uint8_t slave, uint16_t first, uint16_t count, const char* mixText, unsigned seconds,
+                 uint64_t limit)
+{
+    static const char* opNames[] = { "read", "input", "write", "echo" };
+    benchMix_t mix[MAX_MIX];
+    int numMix = ParseMix(mixText, mix);
+    uint32_t totalWeight = 0;
+    uint16_t regs[MODBUS_MAX_READ_REGS];
+    uint32_t* samples;
+    uint64_t numSamples = 0;
+    uint64_t results[eMOD_M_STATE_EXPIRED + 1] = { 0 };
+    uint64_t exceptions[256] = { 0 };
+    uint64_t transactions = 0;
+    uint64_t sumUs = 0;
+    uint32_t rnd = 0x12345678u;
+    modBusLoad_t* load = NULL;
+    uint64_t startUs;
+    uint64_t endUs;
+    double elapsed;
+
+    if (numMix <= 0 || count == 0 || count > MODBUS_MAX_READ_REGS)
+    {
+        fprintf(stderr, "wrong mix or count\n");
+        return 2;
+    }
+    for (int m = 0; m < numMix; m++)
+    {
+        totalWeight += mix[m].weight;
+        if (mix[m].op == OP_WRITE && count > MODBUS_MAX_WRITE_REGS)
+        {
+            fprintf(stderr, "max. %d registers can be written\n", MODBUS_MAX_WRITE_REGS);
+            return 2;
+        }
+    }
+    if (totalWeight == 0)
+    {
+        return 2;
+    }
+    samples = malloc(MAX_SAMPLES * sizeof(uint32_t));
+    if (baud > 0)
+    {
+        load = malloc(sizeof(modBusLoad_t));
+        if (load != NULL)
+        {
+            (void)ModBusLoadInit(load, baud, MODBUS_GET_TIME_MS);
+        }
+    }
+    if (samples == NULL)
+    {
+        return 1;
+    }
+    memset(regs, 0, sizeof(regs));
+
+    startUs = ModPortTimeUs();
+    endUs = startUs + seconds * 1000000ull;
+    while (!stop && (limit == 0 || transactions < limit) && (seconds == 0 || ModPortTimeUs() < endUs))
+    {
+        uint32_t pick;
+        benchMix_t* m = &mix[0];
+        uint64_t t0;
+        uint32_t us;
+        int16_t r;
+        uint8_t errCode;
+        modMasterState_t state;
+        uint16_t reqBytes;
+        uint16_t respBytes;
+
+        // xorshift, mix is followed without being periodic
+        rnd ^= rnd << 13;
+        rnd ^= rnd >> 17;
+        rnd ^= rnd << 5;
+        pick = rnd % totalWeight;
+        for (int i = 0; i < numMix; i++)
+        {
+            if (pick < mix[i].weight)
+            {
+                m = &mix[i];
+                break;
+            }
+            pick -= mix[i].weight;
+        }
+
+        WaitGap();
+        t0 = ModPortTimeUs();
+        switch (m->op)
+        {
+        case OP_INPUT:
+            r = ModMasterReadInputRegs(&mstack, slave, first, count, regs);
+            reqBytes = 8;
+            respBytes = (uint16_t)(5 + 2 * count);
+            break;
+        case OP_WRITE:
+            r = ModMasterWriteRegs(&mstack, slave, first, count, regs);
+            reqBytes = (uint16_t)(9 + 2 * count);
+            respBytes = 8;
+            break;
+        case OP_ECHO:
+            r = ModMasterDiagEcho(&mstack, slave, (uint16_t)transactions);
+            reqBytes = 8;
+            respBytes = 8;
+            break;
+        default:
+            r = ModMasterReadRegs(&mstack, slave, first, count, regs);
+            reqBytes = 8;
+            respBytes = (uint16_t)(5 + 2 * count);
+            break;
+        }
+        state = Finish(r, &errCode);
+        us = (uint32_t)(lastEndUs - t0);
+
+        transactions++;
+        m->count++;
+        results[state]++;
+        if (state == eMOD_M_STATE_ERR_REPORTED)
+        {
+            exceptions[errCode]++;
+            respBytes = 5;
+        }
+        else if (state != eMOD_M_STATE_PROCESSED)
+        {
+            respBytes = 0;
+        }
+        if (state == eMOD_M_STATE_PROCESSED || state == eMOD_M_STATE_ERR_REPORTED)
+        {
+            sumUs += us;
+            if (numSamples < MAX_SAMPLES)
+            {
+                samples[numSamples++] = us;
+            }
+        }
+        if (load != NULL && state != eMOD_M_STATE_HW_ERROR)
+        {
+            ModBusLoadAdd(load, slave, mstack.opCode, reqBytes, respBytes, us, MODBUS_GET_TIME_MS);
+        }
+    }
+    elapsed = (double)(ModPortTimeUs() - startUs) / 1e6;
+
+    printf("transactions %llu in %.2f s, %.1f tx/s\n", (unsigned long long)transactions, elapsed,
+           elapsed > 0 ? (double)transactions / elapsed : 0.0);
+    for (int i = 0; i < numMix; i++)
+    {
+        printf("  %-6s %llu\n", opNames[mix[i].op], (unsigned long long)mix[i].count);
+    }
+    if (numSamples > 0)
+    {
+        qsort(samples, numSamples, sizeof(uint32_t), &CompareU32);
+        printf("latency us: avg %llu, p50 %u, p90 %u, p99 %u, p99.9 %u, max %u\n",
+               (unsigned long long)(sumUs / numSamples), samples[numSamples * 50 / 100],
+               samples[numSamples * 90 / 100], samples[numSamples * 99 / 100], samples[numSamples * 999 / 1000],
+               samples[numSamples - 1]);
+    }
+    printf("results: ok %llu, timeout %llu, corrupted %llu, exception %llu, hw error %llu\n",
+           (unsigned long long)results[eMOD_M_STATE_PROCESSED], (unsigned long long)results[eMOD_M_STATE_TIMED_OUT],
+           (unsigned long long)results[eMOD_M_STATE_CORRUPTED],
+           (unsigned long long)results[eMOD_M_STATE_ERR_REPORTED], (unsigned long long)results[eMOD_M_STATE_HW_ERROR]);
+    for (int c = 0; c < 256; c++)
+    {
+        if (exceptions[c] > 0)
+        {
+            printf("  exception %d: %llu\n", c, (unsigned long long)exceptions[c]);
+        }
+    }
+    if (load != NULL && elapsed > 0)
+    {
+        uint64_t busUs = load->requestUs + load->responseUs + load->turnaroundUs + load->gapTotalUs;
+
+        printf("bus utilization %.1f %% (request %.1f %%, response %.1f %%, turnaround %.1f %%, gaps %.1f %%)\n",
+               (double)busUs / (elapsed * 1e4), (double)load->requestUs / (elapsed * 1e4),
+               (double)load->responseUs / (elapsed * 1e4), (double)load->turnaroundUs / (elapsed * 1e4),
+               (double)load->gapTotalUs / (elapsed * 1e4));
+    }
+    free(samples);
+    free(load);
+
+    return results[eMOD_M_STATE_PROCESSED] == transactions ? 0 : 1;
+}
+
+static int Usage(const char* name)
+{
+    fprintf(stderr, "usage: %s [-b baud] [-p N|E|O] [-t timeout_ms] [-d seconds] [-n transactions] device command\n"
+                    "  read|input SLAVE FIRST COUNT, write SLAVE FIRST VALUE..., echo SLAVE,\n"
+                    "  rpacket SLAVE, wpacket SLAVE HEX, scan [FIRST [LAST]], bench SLAVE FIRST COUNT [MIX]\n", name);
+    return 2;
+}
+
+int main(int argc, char** argv)
+{
+    char parity = 'E';
+    unsigned timeoutMs = 1000;
+    unsigned seconds = 10;
+    uint64_t limit = 0;
+    const char* name = argv[0];
+    const char* device;
+    const char* cmd;
+    int args;
+    int opt;
+    int fd;
+    uint8_t errCode;
+    modMasterState_t state;
+
+    while ((opt = getopt(argc, argv, "b:p:t:d:n:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'b': baud = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'p': parity = optarg[0]; break;
+            case 't': timeoutMs = (unsigned)strtoul(optarg, NULL, 10); break;
+            case 'd': seconds = (unsigned)strtoul(optarg, NULL, 10); break;
+            case 'n': limit = strtoull(optarg, NULL, 10); break;
+            default: return Usage(name);
+        }
+    }
+    if (argc - optind < 2)
+    {
+        return Usage(name);
+    }
+    device = argv[optind];
+    cmd = argv[optind + 1];
+    args = argc - optind - 2;
+    argv += optind + 2;
+
+    fd = ModPortOpenSerial(device, baud, parity);
+    if (fd < 0)
+    {
+        fprintf(stderr, "%s: can't open (%d)\n", device, fd);
+        return 1;
+    }
+    if (ModPortMasterAttach(&portLink, &mstack, fd) < 0 || ModMasterInit(&mstack) < 0)
+    {
+        return 1;
+    }
+    ModMasterSetTimeout(&mstack, (uint16_t)timeoutMs);
+    gapUs = baud > 0 ? ModPortFrameGapUs(baud) : 0;
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+
+    if ((strcmp(cmd, "read") == 0 || strcmp(cmd, "input") == 0) && args == 3)
+    {
+        uint16_t regs[MODBUS_MAX_READ_REGS];
+        uint16_t first = (uint16_t)strtoul(argv[1], NULL, 0);
+        uint16_t count = (uint16_t)strtoul(argv[2], NULL, 0);
+        int16_t r = (cmd[0] == 'r') ? ModMasterReadRegs(&mstack, (uint8_t)atoi(argv[0]), first, count, regs)
+                                    : ModMasterReadInputRegs(&mstack, (uint8_t)atoi(argv[0]), first, count, regs);
+
+        if (r == -2)
+        {
+            fprintf(stderr, "wrong params\n");
+            return 2;
+        }
+        state = Finish(r, &errCode);
+        if (state == eMOD_M_STATE_PROCESSED)
+        {
+            for (uint16_t i = 0; i < count; i++)
+            {
+                printf("%u: %u (0x%04X)\n", first + i, regs[i], regs[i]);
+            }
+        }
+        return Report(state, errCode);
+    }
+    if (strcmp(cmd, "write") == 0 && args >= 3)
+    {
+        uint16_t regs[MODBUS_MAX_WRITE_REGS];
+        uint16_t count = (uint16_t)(args - 2);
+        int16_t r;
+
+        for (uint16_t i = 0; i < count && i < MODBUS_MAX_WRITE_REGS; i++)
+        {
+            regs[i] = (uint16_t)strtoul(argv[2 + i], NULL, 0);
+        }
+        r = ModMasterWriteRegs(&mstack, (uint8_t)atoi(argv[0]), (uint16_t)strtoul(argv[1], NULL, 0), count, regs);
+        if (r == -2)
+        {
+            fprintf(stderr, "wrong params\n");
+            return 2;
+        }
+        state = Finish(r, &errCode);
+        // broadcast isn't answered, stack reports timeout after the turnaround delay
+        if (atoi(argv[0]) == 0 && state == eMOD_M_STATE_TIMED_OUT)
+        {
+            return 0;
+        }
+        return Report(state, errCode);
+    }
+    if (strcmp(cmd, "echo") == 0 && args == 1)
+    {
+        uint64_t t0 = ModPortTimeUs();
+
+        state = Finish(ModMasterDiagEcho(&mstack, (uint8_t)atoi(argv[0]), 0xA55A), &errCode);
+        if (state == eMOD_M_STATE_PROCESSED)
+        {
+            printf("echo %llu us\n", (unsigned long long)(lastEndUs - t0));
+        }
+        return Report(state, errCode);
+    }
+#ifdef MODBUS_USER_COMMANDS
+    if (strcmp(cmd, "rpacket") == 0 && args == 1)
+    {
+        uint8_t data[MODBUS_MAX_PACKET];
+        uint8_t length = 0;
+
+        state = Finish(ModMasterReadDataPacket(&mstack, (uint8_t)atoi(argv[0]), &length, data), &errCode);
+        if (state == eMOD_M_STATE_PROCESSED)
+        {
+            for (uint8_t i = 0; i < length; i++)
+            {
+                printf("%02X", data[i]);
+            }
+            printf("\n");
+        }
+        return Report(state, errCode);
+    }
+    if (strcmp(cmd, "wpacket") == 0 && args == 2)
+    {
+        uint8_t data[MODBUS_MAX_PACKET];
+        size_t hexLen = strlen(argv[1]);
+        uint8_t length = 0;
+
+        if (hexLen % 2 != 0 || hexLen / 2 > MODBUS_MAX_PACKET)
+        {
+            fprintf(stderr, "wrong packet\n");
+            return 2;
+        }
+        for (size_t i = 0; i < hexLen; i += 2)
+        {
+            char byte[3] = { argv[1][i], argv[1][i + 1], '\0' };
+
+            data[length++] = (uint8_t)strtoul(byte, NULL, 16);
+        }
+        state = Finish(ModMasterWriteDataPacket(&mstack, (uint8_t)atoi(argv[0]), length, data), &errCode);
+        return Report(state, errCode);
+    }
+#endif
+    if (strcmp(cmd, "scan") == 0 && args <= 2)
+    {
+        return Scan(args > 0 ? (uint8_t)atoi(argv[0]) : 1, args > 1 ? (uint8_t)atoi(argv[1]) : 247);
+    }
+    if (strcmp(cmd, "bench") == 0 && (args == 3 || args == 4))
+    {
+        return Bench((uint8_t)atoi(argv[0]), (uint16_t)strtoul(argv[1], NULL, 0),
+                     (uint16_t)strtoul(argv[2], NULL, 0), args == 4 ? argv[3] : "r1", limit > 0 ? 0 : seconds, limit);
+    }
+
+    return Usage(name);
+}
@@ -0,0 +1,472 @@
+/**
+ * @file    modregc.c
+ * @brief   Compiles text register-map definitions into binary image (@ref mod_regdesc.h), which slaves,
+ *          simulators and gateways map at startup instead of parsing text. Image can be dumped back for review.
+ *
+ *          Build:
+ *          gcc -O2 -DMODBUS_PORT_LINUX -I.. -o modregc modregc.c ../mod_regdesc.c ../mod_regdesc_linux.c
+ *              ../mod_regmap.c
+ *
+ *          Usage:
+ *          modregc -o image.mrd defs.txt [defs.txt ...]
+ *          modregc -d image.mrd                    dump image
+ *
+ *          Definitions (# starts comment):
+ *          device meter
+ *            holding 0 2 u32 energy rw 0           space, first register, number of registers, type, name,
+ *            holding 10 4 s16 setpoint rw -5 10    access (holding: rw default, input: always ro), swap (low word
+ *            input 0 6 f32 voltage swap 230.0      first), default values (last one repeats, 0 if none)
+ *          end
+ *          Types: u16, s16, u32, s32, f32.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mod_regdesc_linux.h"
+
+typedef struct
+{
+    modRegDescRegion_t region;
+    uint16_t* defaults;         ///< count registers
+    char* name;
+} regcRegion_t;
+
+typedef struct
+{
+    char* name;
+    regcRegion_t* regions;
+    uint16_t numRegions;
+    uint16_t maxRegions;
+} regcDevice_t;
+
+static const char* typeNames[eMOD_REGTYPE_COUNT] = { "u16", "s16", "u32", "s32", "f32" };
+
+static regcDevice_t* devices;
+static uint32_t numDevices;
+static uint32_t maxDevices;
+
+static void* Grow(void* p, uint32_t* max, size_t item)
+{
+    *max = *max ? *max * 2 : 16;
+    p = realloc(p, *max * item);
+    if (p == NULL)
+    {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+// encodes one value into registers in bus order
+static int Encode(uint8_t type, uint8_t swap, const char* text, uint16_t* regs)
+{
+    char* end;
+    uint32_t u32;
+
+    if (type == eMOD_REGTYPE_F32)
+    {
+        float f = strtof(text, &end);
+
+        memcpy(&u32, &f, sizeof(u32));
+    }
+    else
+    {
+        long long v = strtoll(text, &end, 0);
+
+        if ((type == eMOD_REGTYPE_U16 && (v < 0 || v > 0xFFFF)) ||
+            (type == eMOD_REGTYPE_S16 && (v < -32768 || v > 32767)) ||
+            (type == eMOD_REGTYPE_U32 && (v < 0 || v > 0xFFFFFFFFll)) ||
+            (type == eMOD_REGTYPE_S32 && (v < -2147483648ll || v > 2147483647ll)))
+        {
+            return -1;
+        }
+        u32 = (uint32_t)v;
+    }
+    if (*end != '\0')
+    {
+        return -1;
+    }
+    if (ModRegDescWidth(type) == 1)
+    {
+        regs[0] = (uint16_t)u32;
+    }
+    else
+    {
+        regs[swap ? 1 : 0] = (uint16_t)(u32 >> 16);
+        regs[swap ? 0 : 1] = (uint16_t)u32;
+    }
+    return 0;
+}
+
+static int ParseRegion(regcDevice_t* dev, char** tok, int n)
+{
+    regcRegion_t* r;
+    modRegDescRegion_t* reg;
+    long first;
+    long count;
+    int type = -1;
+    int t = 5;
+    uint16_t width;
+    const char* last = "0";
+
+    if (n < 5 || (strcmp(tok[0], "holding") != 0 && strcmp(tok[0], "input") != 0))
+    {
+        return -1;
+    }
+    for (int i = 0; i < eMOD_REGTYPE_COUNT; i++)
+    {
+        if (strcmp(tok[3], typeNames[i]) == 0)
+        {
+            type = i;
+        }
+    }
+    first = strtol(tok[1], NULL, 0);
+    count = strtol(tok[2], NULL, 0);
+    if (type < 0 || first < 0 || count < 1 || first + count > 0x10000 || count % ModRegDescWidth((uint8_t)type) != 0)
+    {
+        return -1;
+    }
+
+    if (dev->numRegions == dev->maxRegions)
+    {
+        uint32_t max = dev->maxRegions;
+
+        dev->regions = Grow(dev->regions, &max, sizeof(regcRegion_t));
+        dev->maxRegions = (uint16_t)(max > 0xFFFF ? 0xFFFF : max);
+    }
+    r = &dev->regions[dev->numRegions];
+    memset(r, 0, sizeof(*r));
+    reg = &r->region;
+    reg->first = (uint16_t)first;
+    reg->count = (uint16_t)count;
+    reg->type = (uint8_t)type;
+    reg->flags = (tok[0][0] == 'i') ? (MODBUS_REGDESC_INPUT | MODBUS_REGDESC_READONLY) : 0;
+    r->name = strdup(tok[4]);
+    for (; t < n; t++)
+    {
+        if (strcmp(tok[t], "ro") == 0)
+        {
+            reg->flags |= MODBUS_REGDESC_READONLY;
+        }
+        else if (strcmp(tok[t], "rw") == 0)
+        {
+            if (reg->flags & MODBUS_REGDESC_INPUT)
+            {
+                return -1; // input registers can't be written
+            }
+        }
+        else if (strcmp(tok[t], "swap") == 0)
+        {
+            reg->flags |= MODBUS_REGDESC_SWAP;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    width = ModRegDescWidth((uint8_t)type);
+    r->defaults = calloc((size_t)count, sizeof(uint16_t));
+    if (r->name == NULL || r->defaults == NULL)
+    {
+        return -1;
+    }
+    for (long v = 0; v < count / width; v++)
+    {
+        if (t < n)
+        {
+            last = tok[t++];
+        }
+        if (Encode(reg->type, reg->flags & MODBUS_REGDESC_SWAP, last, &r->defaults[v * width]) < 0)
+        {
+            return -1;
+        }
+    }
+    if (t < n)
+    {
+        return -1; // more defaults than values
+    }
+    dev->numRegions++;
+
+    return 0;
+}
+
+static int CompareRegions(const void* a, const void* b)
+{
+    const modRegDescRegion_t* x = &((const regcRegion_t*)a)->region;
+    const modRegDescRegion_t* y = &((const regcRegion_t*)b)->region;
+    int sx = x->flags & MODBUS_REGDESC_INPUT;
+    int sy = y->flags & MODBUS_REGDESC_INPUT;
+
+    return sx != sy ? sx - sy : (int)x->first - (int)y->first;
+}
+
+static int CompareDevices(const void* a, const void* b)
+{
+    return strcmp(((const regcDevice_t*)a)->name, ((const regcDevice_t*)b)->name);
+}
+
+static int Load(const char* path)
+{
+    FILE* f = fopen(path, "r");
+    char line[1024];
+    int lineNo = 0;
+    regcDevice_t* dev = NULL;
+
+    if (f == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        char* tok[160];
+        int n = 0;
+        char* hash = strchr(line, '#');
+        int err = 0;
+
+        lineNo++;
+        if (hash != NULL)
+        {
+            *hash = '\0';
+        }
+        for (char* t = strtok(line, " \t\r\n"); t != NULL && n < 160; t = strtok(NULL, " \t\r\n"))
+        {
+            tok[n++] = t;
+        }
+        if (n == 0)
+        {
+            continue;
+        }
+
+        if (dev != NULL)
+        {
+            if (strcmp(tok[0], "end") == 0 && n == 1)
+            {
+                dev = NULL;
+            }
+            else
+            {
+                err = ParseRegion(dev, tok, n) < 0;
+            }
+        }
+        else if (strcmp(tok[0], "device") == 0 && n == 2)
+        {
+            if (numDevices == maxDevices)
+            {
+                devices = Grow(devices, &maxDevices, sizeof(regcDevice_t));
+            }
+            dev = &devices[numDevices++];
+            memset(dev, 0, sizeof(*dev));
+            dev->name = strdup(tok[1]);
+        }
+        else
+        {
+            err = 1;
+        }
+        if (err)
+        {
+            fprintf(stderr, "%s:%d: invalid line\n", path, lineNo);
+            fclose(f);
+            return -1;
+        }
+    }
+    fclose(f);
+    if (dev != NULL)
+    {
+        fprintf(stderr, "%s: device %s isn't terminated by end\n", path, dev->name);
+        return -1;
+    }
+    return 0;
+}
+
+static uint32_t Align4(uint32_t x)
+{
+    return (x + 3u) & ~3u;
+}
+
+static int Compile(const char* out)
+{
+    modRegDescHeader_t h;
+    uint32_t numRegions = 0;
+    uint32_t numDefaults = 0;
+    uint32_t stringsSize = 1;   // offset 0 = empty name
+    uint8_t* image;
+    modRegDescDevice_t* devTable;
+    modRegDescRegion_t* regTable;
+    uint16_t* defTable;
+    char* strTable;
+    uint32_t region = 0;
+    uint32_t def = 0;
+    uint32_t str = 1;
+    FILE* f;
+
+    qsort(devices, numDevices, sizeof(regcDevice_t), &CompareDevices);
+    if (numDevices > 0xFFFF)
+    {
+        fprintf(stderr, "too many devices\n");
+        return -1;
+    }
+    for (uint32_t d = 0; d < numDevices; d++)
+    {
+        regcDevice_t* dev = &devices[d];
+        uint32_t holding = 0;
+
+        if (d > 0 && strcmp(dev->name, devices[d - 1].name) == 0)
+        {
+            fprintf(stderr, "device %s defined twice\n", dev->name);
+            return -1;
+        }
+        qsort(dev->regions, dev->numRegions, sizeof(regcRegion_t), &CompareRegions);
+        for (uint16_t i = 0; i < dev->numRegions; i++)
+        {
+            const modRegDescRegion_t* r = &dev->regions[i].region;
+
+            const modRegDescRegion_t* prev = i > 0 ? &dev->regions[i - 1].region : NULL;
+
+            if (prev != NULL && (r->flags & MODBUS_REGDESC_INPUT) == (prev->flags & MODBUS_REGDESC_INPUT) &&
+                r->first < (uint32_t)prev->first + prev->count)
+            {
+                fprintf(stderr, "device %s: region %s overlaps %s\n", dev->name, dev->regions[i].name,
+                        dev->regions[i - 1].name);
+                return -1;
+            }
+            holding += (r->flags & MODBUS_REGDESC_INPUT) ? 0 : r->count;
+            numDefaults += r->count;
+            stringsSize += (uint32_t)strlen(dev->regions[i].name) + 1;
+        }
+        if (holding > 0xFFFF)
+        {
+            fprintf(stderr, "device %s: too many registers\n", dev->name);
+            return -1;
+        }
+        numRegions += dev->numRegions;
+        stringsSize += (uint32_t)strlen(dev->name) + 1;
+    }
+
+    memset(&h, 0, sizeof(h));
+    h.magic = MODBUS_REGDESC_MAGIC;
+    h.version = MODBUS_REGDESC_VERSION;
+    h.numDevices = (uint16_t)numDevices;
+    h.numRegions = numRegions;
+    h.numDefaults = numDefaults;
+    h.stringsSize = stringsSize;
+    h.devices = Align4(sizeof(h));
+    h.regions = Align4(h.devices + numDevices * sizeof(modRegDescDevice_t));
+    h.defaults = Align4(h.regions + numRegions * sizeof(modRegDescRegion_t));
+    h.strings = Align4(h.defaults + numDefaults * sizeof(uint16_t));
+    h.size = Align4(h.strings + stringsSize);
+
+    image = calloc(1, h.size);
+    if (image == NULL)
+    {
+        return -1;
+    }
+    memcpy(image, &h, sizeof(h));
+    devTable = (modRegDescDevice_t*)(image + h.devices);
+    regTable = (modRegDescRegion_t*)(image + h.regions);
+    defTable = (uint16_t*)(image + h.defaults);
+    strTable = (char*)(image + h.strings);
+
+    for (uint32_t d = 0; d < numDevices; d++)
+    {
+        regcDevice_t* dev = &devices[d];
+        modRegDescDevice_t* out = &devTable[d];
+
+        out->name = str;
+        str += (uint32_t)sprintf(strTable + str, "%s", dev->name) + 1;
+        out->firstRegion = region;
+        out->numRegions = dev->numRegions;
+        for (uint16_t i = 0; i < dev->numRegions; i++)
+        {
+            regcRegion_t* r = &dev->regions[i];
+            modRegDescRegion_t* reg = &regTable[region++];
+
+            *reg = r->region;
+            reg->name = str;
+            str += (uint32_t)sprintf(strTable + str, "%s", r->name) + 1;
+            reg->defaults = def;
+            memcpy(&defTable[def], r->defaults, r->region.count * sizeof(uint16_t));
+            def += r->region.count;
+            if (!(reg->flags & MODBUS_REGDESC_INPUT))
+            {
+                out->numRegs = (uint16_t)(out->numRegs + reg->count);
+            }
+        }
+    }
+
+    f = fopen(out, "wb");
+    if (f == NULL || fwrite(image, 1, h.size, f) != h.size || fclose(f) != 0)
+    {
+        perror(out);
+        free(image);
+        return -1;
+    }
+    printf("%s: %u devices, %u regions, %u B\n", out, numDevices, numRegions, h.size);
+    free(image);
+
+    return 0;
+}
+
+static int Dump(const char* path)
+{
+    modRegDesc_t desc;
+    int16_t r = ModRegDescMapFile(&desc, path);
+
+    if (r < 0)
+    {
+        fprintf(stderr, "%s: %s\n", path, r == -2 ? "wrong image" : "can't map");
+        return 1;
+    }
+    for (uint16_t d = 0; d < desc.header->numDevices; d++)
+    {
+        const modRegDescDevice_t* dev = &desc.devices[d];
+
+        printf("device %s\n", ModRegDescName(&desc, dev->name));
+        for (uint16_t i = 0; i < dev->numRegions; i++)
+        {
+            const modRegDescRegion_t* reg = &desc.regions[dev->firstRegion + i];
+            uint16_t width = ModRegDescWidth(reg->type);
+            uint16_t num = reg->count / width;
+            double v[8];
+
+            printf("  %s %u %u %s %s%s%s", (reg->flags & MODBUS_REGDESC_INPUT) ? "input" : "holding", reg->first,
+                   reg->count, typeNames[reg->type], ModRegDescName(&desc, reg->name),
+                   (reg->flags & MODBUS_REGDESC_INPUT) ? "" : ((reg->flags & MODBUS_REGDESC_READONLY) ? " ro" : " rw"),
+                   (reg->flags & MODBUS_REGDESC_SWAP) ? " swap" : "");
+            (void)ModRegDescDecode(reg, &desc.defaults[reg->defaults], 0, num < 8 ? num : 8, v);
+            for (uint16_t k = 0; k < num && k < 8; k++)
+            {
+                printf(" %.9g", v[k]);
+            }
+            printf("%s\n", num > 8 ? " ..." : "");
+        }
+        printf("end\n");
+    }
+    ModRegDescUnmapFile(&desc);
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc == 3 && strcmp(argv[1], "-d") == 0)
+    {
+        return Dump(argv[2]);
+    }
+    if (argc < 4 || strcmp(argv[1], "-o") != 0)
+    {
+        fprintf(stderr, "usage: %s -o image.mrd defs.txt [defs.txt ...] | %s -d image.mrd\n", argv[0], argv[0]);
+        return 2;
+    }
+    for (int i = 3; i < argc; i++)
+    {
+        if (Load(argv[i]) < 0)
+        {
+            return 1;
+        }
+    }
+
+    return Compile(argv[2]) < 0 ? 1 : 0;
+}
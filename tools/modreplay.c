@@ -0,0 +1,402 @@
+/**
+ * @file    modreplay.c
+ * @brief   Replays recorded Modbus RTU traffic through slave stack as fast as possible and reports processing cost.
+ *          Requests from capture (binary log of modsniff or pcap) are fed to @ref ModSlaveRxDoneCallback() /
+ *          @ref ModSlaveCheck() of one slave stack with memory-backed register map (registers 0 - 65534 mapped)
+ *          and null transport (answer is "transmitted" immediately).
+ *
+ *          Build (allocation counting needs the --wrap options):
+ *          gcc -O2 -DMODBUS_PORT_LINUX -I.. -o modreplay modreplay.c ../mod_slave_rtu.c ../mod_master_rtu.c ../mod_regmap.c
+ *              ../mod_stream_rtu.c ../mod_caplog.c ../mod_port_linux.c ../crc.c
+ *              -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free
+ *
+ *          Usage:
+ *          modreplay [-n repeat] [-a address] [-c baseline.txt] capture.bin|capture.pcap > result.txt
+ *          -a  answer only given address (default: every request is processed as if addressed to the stack)
+ *          -c  print relative change against result file of other build
+ *
+ *          Result is "key value" per line, so two builds can be compared by -c or any diff tool.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "mod_slave_rtu.h"
+#include "mod_regmap.h"
+#include "mod_stream_rtu.h"
+#include "mod_caplog.h"
+#include "mod_port_linux.h"
+
+/***** allocation counting *****/
+
+static unsigned long allocations;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* p, size_t size);
+void __real_free(void* p);
+
+void* __wrap_malloc(size_t size) { allocations++; return __real_malloc(size); }
+void* __wrap_calloc(size_t n, size_t size) { allocations++; return __real_calloc(n, size); }
+void* __wrap_realloc(void* p, size_t size) { allocations++; return __real_realloc(p, size); }
+void __wrap_free(void* p) { __real_free(p); }
+
+/***** capture loading *****/
+
+#define MAX_FRAMES  (1u << 20)
+
+typedef struct
+{
+    uint16_t length;
+    uint8_t  data[256];
+} frame_t;
+
+static frame_t* frames;
+static uint32_t numFrames;
+
+static void OnFrame(modStreamFramer_t* framer, const uint8_t* frame, uint16_t length, modFrameDir_t dir)
+{
+    (void)framer;
+    if (dir == eMOD_FRAME_REQUEST && numFrames < MAX_FRAMES)
+    {
+        frames[numFrames].length = length;
+        memcpy(frames[numFrames].data, frame, length);
+        numFrames++;
+    }
+}
+
+static uint32_t Get32(const uint8_t* p, int swap)
+{
+    uint32_t v = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+    return swap ? __builtin_bswap32(v) : v;
+}
+
+static int LoadPcap(const uint8_t* data, size_t length)
+{
+    modStreamFramer_t framer;
+    uint32_t magic = Get32(data, 0);
+    int swap;
+    uint32_t linkType;
+    size_t idx = 24;
+
+    if (magic == 0xA1B2C3D4u || magic == 0xA1B23C4Du)
+    {
+        swap = 0;
+    }
+    else if (magic == 0xD4C3B2A1u || magic == 0x4D3CB2A1u)
+    {
+        swap = 1;
+    }
+    else
+    {
+        return -1;
+    }
+    linkType = Get32(data + 20, swap) & 0xFFFF;
+
+    // packets may split or join frames, let the framer sort it out
+    memset(&framer, 0, sizeof(framer));
+    framer.pfFrame = &OnFrame;
+    (void)ModStreamInit(&framer, eMOD_STREAM_BOTH);
+
+    while (idx + 16 <= length)
+    {
+        uint32_t capLen = Get32(data + idx + 8, swap);
+        uint32_t skip = (linkType == 250) ? 12 : 0; // LINKTYPE_RTAC_SERIAL has 12 byte header
+
+        idx += 16;
+        if (idx + capLen > length)
+        {
+            break;
+        }
+        if (capLen > skip)
+        {
+            ModStreamFlush(&framer); // packet boundary = frame boundary in most capture tools
+            (void)ModStreamFeed(&framer, data + idx + skip, capLen - skip);
+        }
+        idx += capLen;
+    }
+
+    return 0;
+}
+
+static int LoadCapLog(const uint8_t* data, size_t length)
+{
+    modCapLog_t cursor;
+    modCapLogRecord_t rec;
+    size_t idx = MODBUS_CAPLOG_HEADER_SIZE;
+    int32_t n;
+
+    memset(&cursor, 0, sizeof(cursor));
+    while ((n = ModCapLogDecode(&cursor, data + idx, (uint32_t)(length - idx), &rec)) > 0)
+    {
+        if (!(rec.info & MODBUS_CAPLOG_INFO_RESPONSE) && numFrames < MAX_FRAMES)
+        {
+            frames[numFrames].length = rec.length;
+            memcpy(frames[numFrames].data, rec.frame, rec.length);
+            numFrames++;
+        }
+        idx += (size_t)n;
+    }
+
+    return (n < 0) ? -1 : 0;
+}
+
+static int LoadCapture(const char* name)
+{
+    FILE* f = fopen(name, "rb");
+    uint8_t* data;
+    long length;
+    int r;
+
+    if (f == NULL)
+    {
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    length = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = malloc((size_t)length + 1);
+    if (data == NULL || fread(data, 1, (size_t)length, f) != (size_t)length)
+    {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    if (ModCapLogCheckHeader(data, (uint32_t)length) == 0)
+    {
+        r = LoadCapLog(data, (size_t)length);
+    }
+    else if (length >= 24)
+    {
+        r = LoadPcap(data, (size_t)length);
+    }
+    else
+    {
+        r = -1;
+    }
+    free(data);
+
+    return r;
+}
+
+/***** slave with null transport *****/
+
+static modSlaveStack_t slave;
+static modRegMap_t regMap;
+static uint16_t regValues[0x10000];
+static const modRegRegion_t regRegion = { 0, 0xFFFF, 0, regValues };
+static uint8_t fixedAddress;
+static uint64_t answers;
+
+static int16_t NullStandby(modSlaveStack_t* mstack)
+{
+    (void)mstack;
+    return 0;
+}
+
+static int16_t NullSendAns(modSlaveStack_t* mstack, const uint8_t* data, uint16_t length)
+{
+    (void)data; (void)length;
+    answers++;
+    ModSlaveTxDoneCallback(mstack); // sent immediately
+    return 0;
+}
+
+#ifdef MODBUS_USER_COMMANDS
+static uint8_t NullGetPacket(modSlaveStack_t* mstack, uint8_t* buffer, uint16_t* length)
+{
+    (void)mstack;
+    memset(buffer, 0x55, 16);
+    *length = 16;
+    return 0;
+}
+
+static uint8_t NullSetPacket(modSlaveStack_t* mstack, const uint8_t* buffer, uint16_t length)
+{
+    (void)mstack; (void)buffer; (void)length;
+    return 0;
+}
+#endif
+
+static void Process(const frame_t* fr)
+{
+    if (!fixedAddress)
+    {
+        slave.address = fr->data[0];
+    }
+    (void)ModSlaveCheck(&slave); // standby -> receiving
+    ModSlaveRxDoneCallback(&slave, fr->data, fr->length);
+    (void)ModSlaveCheck(&slave); // parse, process, answer
+}
+
+static uint64_t NowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/***** result comparison *****/
+
+static double BaselineValue(FILE* f, const char* key)
+{
+    char line[128];
+    char k[64];
+    double v;
+
+    rewind(f);
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        if (sscanf(line, "%63s %lf", k, &v) == 2 && strcmp(k, key) == 0)
+        {
+            return v;
+        }
+    }
+    return -1.0;
+}
+
+static FILE* baseline;
+
+static void Report(const char* key, double value)
+{
+    double b = (baseline != NULL) ? BaselineValue(baseline, key) : -1.0;
+
+    if (b > 0.0)
+    {
+        printf("%s %.1f\t# %+.1f%%\n", key, value, (value - b) * 100.0 / b);
+    }
+    else
+    {
+        printf("%s %.1f\n", key, value);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    unsigned repeat = 10;
+    const char* baselineName = NULL;
+    int opt;
+    uint32_t perOpcode[256];
+    uint32_t* order;
+    uint64_t t0, t1;
+    unsigned long allocBefore;
+
+    while ((opt = getopt(argc, argv, "n:a:c:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n': repeat = (unsigned)strtoul(optarg, NULL, 10); break;
+            case 'a': fixedAddress = (uint8_t)strtoul(optarg, NULL, 10); break;
+            case 'c': baselineName = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-n repeat] [-a address] [-c baseline.txt] capture\n", argv[0]);
+                return 2;
+        }
+    }
+    if (optind >= argc || repeat == 0)
+    {
+        fprintf(stderr, "capture file expected\n");
+        return 2;
+    }
+    if (baselineName != NULL && (baseline = fopen(baselineName, "r")) == NULL)
+    {
+        perror(baselineName);
+        return 1;
+    }
+
+    frames = malloc(MAX_FRAMES * sizeof(frame_t));
+    if (frames == NULL || LoadCapture(argv[optind]) < 0 || numFrames == 0)
+    {
+        fprintf(stderr, "%s: no requests loaded\n", argv[optind]);
+        return 1;
+    }
+
+    regMap.regions = &regRegion;
+    regMap.numRegions = 1;
+    slave.userContent = &regMap;
+    slave.address = fixedAddress ? fixedAddress : 1;
+    slave.lastReg = (uint16_t)ModRegMapInit(&regMap);
+    slave.pfStandby = &NullStandby;
+    slave.pfSendAns = &NullSendAns;
+    slave.pfGetReg = &ModRegMapGetReg;
+    slave.pfSetReg = &ModRegMapSetReg;
+#ifdef MODBUS_USER_COMMANDS
+    slave.pfGetPacket = &NullGetPacket;
+    slave.pfSetPacket = &NullSetPacket;
+#endif
+    if (ModSlaveInit(&slave) < 0)
+    {
+        return 1;
+    }
+
+    // whole capture in recorded order
+    allocBefore = allocations;
+    t0 = NowNs();
+    for (unsigned r = 0; r < repeat; r++)
+    {
+        for (uint32_t i = 0; i < numFrames; i++)
+        {
+            Process(&frames[i]);
+        }
+    }
+    t1 = NowNs();
+
+    printf("frames %u\n", numFrames);
+    printf("answers %llu\n", (unsigned long long)(answers / repeat));
+    printf("allocations %lu\n", allocations - allocBefore);
+    Report("frames_per_s", (double)numFrames * repeat * 1e9 / (double)(t1 - t0));
+    Report("ns_per_frame", (double)(t1 - t0) / ((double)numFrames * repeat));
+
+    // cost by opcode, frames of one opcode replayed back to back
+    memset(perOpcode, 0, sizeof(perOpcode));
+    for (uint32_t i = 0; i < numFrames; i++)
+    {
+        perOpcode[frames[i].data[1]]++;
+    }
+    order = malloc(numFrames * sizeof(uint32_t));
+    if (order == NULL)
+    {
+        return 1;
+    }
+    for (unsigned op = 0, start = 0; op < 256; op++)
+    {
+        uint32_t n = 0;
+        char key[32];
+
+        if (perOpcode[op] == 0)
+        {
+            continue;
+        }
+        for (uint32_t i = 0; i < numFrames; i++)
+        {
+            if (frames[i].data[1] == op)
+            {
+                order[start + n++] = i;
+            }
+        }
+        t0 = NowNs();
+        for (unsigned r = 0; r < repeat; r++)
+        {
+            for (uint32_t i = 0; i < n; i++)
+            {
+                Process(&frames[order[start + i]]);
+            }
+        }
+        t1 = NowNs();
+        start += n;
+        snprintf(key, sizeof(key), "ns_per_frame_op%02x", op);
+        Report(key, (double)(t1 - t0) / ((double)n * repeat));
+    }
+    free(order);
+
+    if (baseline != NULL)
+    {
+        fclose(baseline);
+    }
+    free(frames);
+
+    return 0;
+}
@@ -0,0 +1,623 @@
+/**
+ * @file    modsim.c
+ * @brief   Slave simulator farm for Linux. Loads device definitions (register ranges with value generators) and
+ *          serves whole plants - up to 247 units on each bus - for load tests of masters, gateways and SCADA.
+ *          Each bus is served by one multi-unit slave stack (MODBUS_SLAVE_MULTI_UNIT) in its own thread, so cost
+ *          doesn't grow with number of units. Generated values are computed at read time, only writable registers
+ *          have storage (per unit), whole farm takes few MB.
+ *
+ *          Build:
+ *          gcc -O2 -pthread -DMODBUS_PORT_LINUX -DMODBUS_SLAVE_MULTI_UNIT -I.. -o modsim modsim.c
+ *              ../mod_slave_rtu.c ../mod_master_rtu.c ../mod_stream_rtu.c ../mod_port_linux.c
+ *              ../mod_bussim_linux.c ../crc.c -lm
+ *
+ *          Usage:
+ *          modsim [-i stats_interval_s] plant.cfg
+ *
+ *          Configuration (# starts comment):
+ *          device meter                    device definition, registers not listed don't exist
+ *            0 4 counter 1000              first, count, generator and its arguments
+ *            4 8 sine 60000 1000 5000
+ *            100 2 const 0 rw              rw = writable, value is kept per unit
+ *          end
+ *          bus 0-15 pty                    pseudo-terminal per bus, master opens printed path
+ *          bus 16 sim 19200                bus simulator paced to baud rate, master opens printed path
+ *          bus 17 /dev/ttyUSB0 19200 E     serial line
+ *          unit 0-15 1-247 meter           units (range) of buses (range) are instances of device
+ *
+ *          Generators: const VALUE, counter PERIOD_MS (increments each period), sine PERIOD_MS AMPLITUDE OFFSET,
+ *          random MIN MAX (changes every 100 ms), unit (unit address), reg (register address).
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "mod_port_linux.h"
+#include "mod_bussim_linux.h"
+
+#define MAX_BUSES       64
+#define MAX_DEVICES     64
+#define MAX_RANGES      64
+#define MAX_UNITS       248
+
+typedef enum
+{
+    GEN_CONST,
+    GEN_COUNTER,
+    GEN_SINE,
+    GEN_RANDOM,
+    GEN_UNIT,
+    GEN_REG
+} simGen_t;
+
+typedef struct
+{
+    uint16_t first;
+    uint16_t count;
+    simGen_t gen;
+    uint8_t rw;
+    uint16_t rwIndex;       ///< offset of range in storage of unit
+    int32_t arg[3];
+} simRange_t;
+
+typedef struct
+{
+    char name[32];
+    simRange_t ranges[MAX_RANGES];  ///< sorted by first register, not overlapping
+    uint16_t numRanges;
+    uint16_t rwCount;       ///< writable registers of unit
+} simDevice_t;
+
+typedef struct
+{
+    const simDevice_t* dev; ///< NULL = unit doesn't exist
+    uint16_t* rw;
+} simUnit_t;
+
+typedef struct
+{
+    modSlaveStack_t stack;
+    modPortLink_t link;
+    modBusSim_t* sim;
+    int fd;
+    int holdFd;             ///< pty slave side held open (pty bus)
+    char path[64];
+    simUnit_t units[MAX_UNITS];
+    uint32_t numUnits;
+    volatile uint64_t reads;
+    volatile uint64_t writes;
+    pthread_t thread;
+} simBus_t;
+
+static simDevice_t devices[MAX_DEVICES];
+static int numDevices;
+static simBus_t* buses[MAX_BUSES];
+static uint32_t startMs;
+static size_t storageBytes;
+static volatile sig_atomic_t stop;
+
+static void OnSignal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+static uint32_t Hash(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    x *= 0x846CA68Bu;
+    x ^= x >> 16;
+    return x;
+}
+
+static const simRange_t* FindRange(const simDevice_t* dev, uint16_t reg)
+{
+    int lo = 0;
+    int hi = dev->numRanges - 1;
+
+    while (lo <= hi)
+    {
+        int mid = (lo + hi) / 2;
+        const simRange_t* r = &dev->ranges[mid];
+
+        if (reg < r->first)
+        {
+            hi = mid - 1;
+        }
+        else if (reg >= r->first + r->count)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            return r;
+        }
+    }
+    return NULL;
+}
+
+static uint16_t Generate(const simRange_t* r, uint8_t unit, uint16_t reg)
+{
+    uint32_t t = ModPortTimeMs() - startMs;
+
+    switch (r->gen)
+    {
+    case GEN_COUNTER:
+        return (uint16_t)(t / (uint32_t)r->arg[0] + reg);
+    case GEN_SINE:
+    {
+        // each register gets its own phase, so the plant doesn't move in lock-step
+        double phase = (double)(Hash(((uint32_t)unit << 16) | reg) & 0xFFFF) / 65536.0;
+        double v = r->arg[2] + r->arg[1] * sin(2.0 * M_PI * ((double)(t % (uint32_t)r->arg[0]) / r->arg[0] + phase));
+
+        return (uint16_t)(int32_t)lround(v);
+    }
+    case GEN_RANDOM:
+    {
+        uint32_t span = (uint32_t)(r->arg[1] - r->arg[0]) + 1;
+        uint32_t h = Hash(Hash(((uint32_t)unit << 16) | reg) ^ (uint32_t)(t / 100));
+
+        return (uint16_t)(r->arg[0] + (int32_t)(span ? h % span : h));
+    }
+    case GEN_UNIT:
+        return unit;
+    case GEN_REG:
+        return reg;
+    default:
+        return (uint16_t)r->arg[0];
+    }
+}
+
+// userContent of the stack is occupied by transport link, bus is in userContent of the link
+static simBus_t* Bus(modSlaveStack_t* mstack)
+{
+    return (simBus_t*)((modPortLink_t*)mstack->userContent)->userContent;
+}
+
+static uint8_t HasUnit(modSlaveStack_t* mstack, uint8_t address)
+{
+    return address < MAX_UNITS && Bus(mstack)->units[address].dev != NULL;
+}
+
+static uint8_t GetReg(modSlaveStack_t* mstack, uint16_t regAddr, uint16_t* regValue)
+{
+    simBus_t* bus = Bus(mstack);
+    uint8_t unit = ModSlaveUnit(mstack);
+    const simUnit_t* u = &bus->units[unit];
+    const simRange_t* r;
+
+    if (u->dev == NULL || (r = FindRange(u->dev, regAddr)) == NULL)
+    {
+        return MODBUS_ERR_ILLEGAL_ADDRESS;
+    }
+    *regValue = r->rw ? u->rw[r->rwIndex + regAddr - r->first] : Generate(r, unit, regAddr);
+    bus->reads++;
+
+    return 0;
+}
+
+static uint8_t SetUnitReg(simUnit_t* u, uint16_t regAddr, uint16_t regValue)
+{
+    const simRange_t* r;
+
+    if (u->dev == NULL || (r = FindRange(u->dev, regAddr)) == NULL)
+    {
+        return MODBUS_ERR_ILLEGAL_ADDRESS;
+    }
+    if (!r->rw)
+    {
+        return MODBUS_ERR_ILLEGAL_ADDRESS;
+    }
+    u->rw[r->rwIndex + regAddr - r->first] = regValue;
+
+    return 0;
+}
+
+static uint8_t SetReg(modSlaveStack_t* mstack, uint16_t regAddr, uint16_t regValue)
+{
+    simBus_t* bus = Bus(mstack);
+    uint8_t unit = ModSlaveUnit(mstack);
+
+    bus->writes++;
+    if (unit == 0)
+    {
+        // broadcast, applied to every unit having the register
+        for (int a = 1; a < MAX_UNITS; a++)
+        {
+            (void)SetUnitReg(&bus->units[a], regAddr, regValue);
+        }
+        return 0;
+    }
+    return SetUnitReg(&bus->units[unit], regAddr, regValue);
+}
+
+static void* BusThread(void* arg)
+{
+    simBus_t* bus = (simBus_t*)arg;
+
+    while (!stop)
+    {
+        (void)ModSlaveCheck(&bus->stack);
+        (void)ModPortPoll(&bus->link, 50);
+    }
+    return NULL;
+}
+
+static int ParseRange(const char* s, long* lo, long* hi)
+{
+    char* end;
+
+    *lo = strtol(s, &end, 10);
+    *hi = *lo;
+    if (*end == '-')
+    {
+        *hi = strtol(end + 1, &end, 10);
+    }
+    return (*end == '\0' && *lo <= *hi) ? 0 : -1;
+}
+
+static int CompareRanges(const void* a, const void* b)
+{
+    return (int)((const simRange_t*)a)->first - (int)((const simRange_t*)b)->first;
+}
+
+static int ParseGenerator(simRange_t* r, char** tok, int n)
+{
+    static const struct { const char* name; simGen_t gen; int args; } gens[] =
+    {
+        { "const", GEN_CONST, 1 }, { "counter", GEN_COUNTER, 1 }, { "sine", GEN_SINE, 3 },
+        { "random", GEN_RANDOM, 2 }, { "unit", GEN_UNIT, 0 }, { "reg", GEN_REG, 0 }
+    };
+
+    for (unsigned g = 0; g < sizeof(gens) / sizeof(gens[0]); g++)
+    {
+        if (strcmp(tok[0], gens[g].name) != 0)
+        {
+            continue;
+        }
+        if (n < 1 + gens[g].args)
+        {
+            return -1;
+        }
+        r->gen = gens[g].gen;
+        for (int a = 0; a < gens[g].args; a++)
+        {
+            r->arg[a] = (int32_t)strtol(tok[1 + a], NULL, 0);
+        }
+        if ((r->gen == GEN_COUNTER || r->gen == GEN_SINE) && r->arg[0] <= 0)
+        {
+            return -1; // zero period
+        }
+        if (r->gen == GEN_RANDOM && r->arg[1] < r->arg[0])
+        {
+            return -1;
+        }
+        r->rw = (n > 1 + gens[g].args && strcmp(tok[1 + gens[g].args], "rw") == 0);
+        return 0;
+    }
+    return -1;
+}
+
+static int OpenBus(simBus_t* bus, char** tok, int n)
+{
+    bus->fd = -1;
+    bus->holdFd = -1;
+    if (strcmp(tok[0], "pty") == 0)
+    {
+        // external master opens the slave side, pty is held open so the bus survives its reconnects
+        int fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+        const char* name;
+
+        if (fd < 0 || grantpt(fd) < 0 || unlockpt(fd) < 0 || (name = ptsname(fd)) == NULL)
+        {
+            return -1;
+        }
+        snprintf(bus->path, sizeof(bus->path), "%s", name);
+        bus->holdFd = ModPortOpenSerial(name, 0, 'N');
+        bus->fd = fd;
+        return bus->holdFd < 0 ? -1 : 0;
+    }
+    if (strcmp(tok[0], "sim") == 0)
+    {
+        bus->sim = calloc(1, sizeof(modBusSim_t));
+        if (bus->sim == NULL ||
+            ModBusSimOpen(bus->sim, 2, n > 1 ? (uint32_t)strtoul(tok[1], NULL, 10) : 19200) < 0 ||
+            ModBusSimStart(bus->sim) < 0)
+        {
+            return -1;
+        }
+        snprintf(bus->path, sizeof(bus->path), "%s", bus->sim->deviceName[0]);
+        bus->fd = bus->sim->deviceFd[1];
+        return 0;
+    }
+    snprintf(bus->path, sizeof(bus->path), "%s", tok[0]);
+    bus->fd = ModPortOpenSerial(tok[0], n > 1 ? (uint32_t)strtoul(tok[1], NULL, 10) : 19200, n > 2 ? tok[2][0] : 'E');
+    return bus->fd < 0 ? -1 : 0;
+}
+
+static int AddUnits(long busLo, long busHi, long unitLo, long unitHi, const simDevice_t* dev)
+{
+    for (long b = busLo; b <= busHi; b++)
+    {
+        if (buses[b] == NULL)
+        {
+            return -1; // bus has to be defined first
+        }
+        for (long a = unitLo; a <= unitHi; a++)
+        {
+            simUnit_t* u = &buses[b]->units[a];
+
+            if (u->dev == NULL)
+            {
+                buses[b]->numUnits++;
+            }
+            free(u->rw);
+            u->dev = dev;
+            u->rw = NULL;
+            if (dev->rwCount > 0)
+            {
+                u->rw = calloc(dev->rwCount, sizeof(uint16_t));
+                if (u->rw == NULL)
+                {
+                    return -1;
+                }
+                storageBytes += dev->rwCount * sizeof(uint16_t);
+                // writable registers start with generated value
+                for (uint16_t i = 0; i < dev->numRanges; i++)
+                {
+                    const simRange_t* r = &dev->ranges[i];
+
+                    for (uint16_t k = 0; r->rw && k < r->count; k++)
+                    {
+                        u->rw[r->rwIndex + k] = Generate(r, (uint8_t)a, (uint16_t)(r->first + k));
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static int LoadConfig(const char* path)
+{
+    FILE* f = fopen(path, "r");
+    char line[256];
+    int lineNo = 0;
+    simDevice_t* dev = NULL;
+
+    if (f == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        char* tok[8];
+        int n = 0;
+        char* hash = strchr(line, '#');
+        long lo, hi, lo2, hi2;
+        int err = 0;
+
+        lineNo++;
+        if (hash != NULL)
+        {
+            *hash = '\0';
+        }
+        for (char* t = strtok(line, " \t\r\n"); t != NULL && n < 8; t = strtok(NULL, " \t\r\n"))
+        {
+            tok[n++] = t;
+        }
+        if (n == 0)
+        {
+            continue;
+        }
+
+        if (dev != NULL)
+        {
+            // inside device definition
+            if (strcmp(tok[0], "end") == 0)
+            {
+                uint16_t rw = 0;
+
+                qsort(dev->ranges, dev->numRanges, sizeof(simRange_t), &CompareRanges);
+                for (uint16_t i = 0; i < dev->numRanges; i++)
+                {
+                    simRange_t* r = &dev->ranges[i];
+
+                    if (i > 0 && r->first < dev->ranges[i - 1].first + dev->ranges[i - 1].count)
+                    {
+                        err = 1; // overlapping ranges
+                    }
+                    r->rwIndex = rw;
+                    rw = (uint16_t)(rw + (r->rw ? r->count : 0));
+                }
+                dev->rwCount = rw;
+                dev = NULL;
+            }
+            else
+            {
+                simRange_t* r = &dev->ranges[dev->numRanges];
+                long first = strtol(tok[0], NULL, 0);
+                long count = n > 1 ? strtol(tok[1], NULL, 0) : 0;
+
+                if (dev->numRanges >= MAX_RANGES || n < 3 || first < 0 || count < 1 || first + count > 0x10000 ||
+                    ParseGenerator(r, tok + 2, n - 2) < 0)
+                {
+                    err = 1;
+                }
+                else
+                {
+                    r->first = (uint16_t)first;
+                    r->count = (uint16_t)count;
+                    dev->numRanges++;
+                }
+            }
+        }
+        else if (strcmp(tok[0], "device") == 0 && n == 2 && numDevices < MAX_DEVICES)
+        {
+            dev = &devices[numDevices++];
+            snprintf(dev->name, sizeof(dev->name), "%s", tok[1]);
+        }
+        else if (strcmp(tok[0], "bus") == 0 && n >= 3 && ParseRange(tok[1], &lo, &hi) == 0 && lo >= 0 &&
+                 hi < MAX_BUSES)
+        {
+            for (long b = lo; b <= hi && !err; b++)
+            {
+                if (buses[b] != NULL || (buses[b] = calloc(1, sizeof(simBus_t))) == NULL ||
+                    OpenBus(buses[b], tok + 2, n - 2) < 0)
+                {
+                    fprintf(stderr, "%s:%d: can't open bus %ld\n", path, lineNo, b);
+                    err = 1;
+                }
+            }
+        }
+        else if (strcmp(tok[0], "unit") == 0 && n == 4 && ParseRange(tok[1], &lo, &hi) == 0 && lo >= 0 &&
+                 hi < MAX_BUSES && ParseRange(tok[2], &lo2, &hi2) == 0 && lo2 >= 1 && hi2 <= 247)
+        {
+            const simDevice_t* found = NULL;
+
+            for (int d = 0; d < numDevices; d++)
+            {
+                if (strcmp(devices[d].name, tok[3]) == 0)
+                {
+                    found = &devices[d];
+                }
+            }
+            err = (found == NULL || AddUnits(lo, hi, lo2, hi2, found) < 0);
+        }
+        else
+        {
+            err = 1;
+        }
+
+        if (err)
+        {
+            fprintf(stderr, "%s:%d: invalid line\n", path, lineNo);
+            fclose(f);
+            return -1;
+        }
+    }
+    fclose(f);
+
+    if (dev != NULL)
+    {
+        fprintf(stderr, "%s: device %s isn't terminated by end\n", path, dev->name);
+        return -1;
+    }
+    return 0;
+}
+
+static int StartBus(simBus_t* bus)
+{
+    bus->stack.address = 0; // units are selected by pfUnit
+    bus->stack.lastReg = 0xFFFF;
+    bus->stack.pfGetReg = &GetReg;
+    bus->stack.pfSetReg = &SetReg;
+    bus->stack.pfUnit = &HasUnit;
+    if (ModPortSlaveAttach(&bus->link, &bus->stack, bus->fd) < 0)
+    {
+        return -1;
+    }
+    bus->link.userContent = bus;
+    if (ModSlaveInit(&bus->stack) < 0)
+    {
+        return -1;
+    }
+    return pthread_create(&bus->thread, NULL, &BusThread, bus) == 0 ? 0 : -1;
+}
+
+static void PrintStats(void)
+{
+    for (int b = 0; b < MAX_BUSES; b++)
+    {
+        if (buses[b] != NULL)
+        {
+            fprintf(stderr, "bus %d: units %u, frames %u, regs read %llu, written %llu\n", b, buses[b]->numUnits,
+                    buses[b]->link.framer.frames, (unsigned long long)buses[b]->reads,
+                    (unsigned long long)buses[b]->writes);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    unsigned interval = 0;
+    int opt;
+    size_t memory = sizeof(devices);
+    uint64_t nextStats;
+
+    while ((opt = getopt(argc, argv, "i:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'i': interval = (unsigned)strtoul(optarg, NULL, 10); break;
+            default:
+                fprintf(stderr, "usage: %s [-i stats_s] plant.cfg\n", argv[0]);
+                return 2;
+        }
+    }
+    if (optind != argc - 1)
+    {
+        fprintf(stderr, "usage: %s [-i stats_s] plant.cfg\n", argv[0]);
+        return 2;
+    }
+
+    startMs = ModPortTimeMs();
+    if (LoadConfig(argv[optind]) < 0)
+    {
+        return 1;
+    }
+
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+    for (int b = 0; b < MAX_BUSES; b++)
+    {
+        if (buses[b] == NULL)
+        {
+            continue;
+        }
+        if (StartBus(buses[b]) < 0)
+        {
+            fprintf(stderr, "bus %d: can't start\n", b);
+            return 1;
+        }
+        memory += sizeof(simBus_t) + (buses[b]->sim != NULL ? sizeof(modBusSim_t) : 0);
+        printf("bus %d: %s (%u units)\n", b, buses[b]->path, buses[b]->numUnits);
+    }
+    fflush(stdout);
+    fprintf(stderr, "memory: %zu kB (register storage %zu kB)\n", (memory + storageBytes) / 1024, storageBytes / 1024);
+
+    nextStats = ModPortTimeUs() + interval * 1000000ULL;
+    while (!stop)
+    {
+        usleep(100000);
+        if (interval > 0 && ModPortTimeUs() >= nextStats)
+        {
+            PrintStats();
+            nextStats += interval * 1000000ULL;
+        }
+    }
+
+    PrintStats();
+    for (int b = 0; b < MAX_BUSES; b++)
+    {
+        if (buses[b] != NULL)
+        {
+            pthread_join(buses[b]->thread, NULL);
+            if (buses[b]->sim != NULL)
+            {
+                ModBusSimClose(buses[b]->sim);
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+/**
+ * @file    modsizes.c
+ * @brief   Static report of memory footprint of stack structures for current build configuration.
+ *          Build it with the same MODBUS_MESSAGE_SIZE / MODBUS_MESSAGE_POOL / MODBUS_MASTER_TABLE / MODBUS_STACK_STATS /
+ *          MODBUS_USER_COMMANDS flags and for the same data model as the firmware (e.g. -m32 for 32-bit MCUs)
+ *          to see the real per-instance cost.
+ *
+ *          Build:
+ *          gcc -DMODBUS_PORT_LINUX [-DMODBUS_MESSAGE_SIZE=24] [-DMODBUS_MESSAGE_POOL] [-DMODBUS_MASTER_TABLE]
+ *              [-m32] -I.. -o modsizes modsizes.c
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include "mod_master_rtu.h"
+#include "mod_slave_rtu.h"
+#include "mod_stream_rtu.h"
+#ifdef MODBUS_MASTER_TABLE
+#include "mod_master_table.h"
+#endif
+
+#define FIELD(type, field)  printf("  %-16s offset %4zu size %4zu\n", #field, offsetof(type, field), sizeof(((type*)0)->field))
+
+int main(void)
+{
+    printf("MODBUS_MESSAGE_SIZE %d, max read regs %d, max write regs %d, max packet %d\n",
+           MODBUS_MESSAGE_SIZE, MODBUS_MAX_READ_REGS, MODBUS_MAX_WRITE_REGS, MODBUS_MAX_PACKET);
+
+    printf("modMasterStack_t %zu B\n", sizeof(modMasterStack_t));
+#ifdef MODBUS_MASTER_TABLE
+    FIELD(modMasterStack_t, slot);
+#else
+    FIELD(modMasterStack_t, status);
+#endif
+    FIELD(modMasterStack_t, messageLast);
+    FIELD(modMasterStack_t, slaveAddr);
+    FIELD(modMasterStack_t, opCode);
+    FIELD(modMasterStack_t, firstReg);
+    FIELD(modMasterStack_t, numRegs);
+#ifndef MODBUS_MASTER_TABLE
+    FIELD(modMasterStack_t, rxStartTime);
+    FIELD(modMasterStack_t, rxTimeout);
+#endif
+    FIELD(modMasterStack_t, pfSend);
+    FIELD(modMasterStack_t, pfReceive);
+    FIELD(modMasterStack_t, dataStorage);
+    FIELD(modMasterStack_t, dataStorage2);
+    FIELD(modMasterStack_t, userContent);
+#ifdef MODBUS_MASTER_TABLE
+    FIELD(modMasterStack_t, table);
+#endif
+#ifdef MODBUS_MESSAGE_POOL
+    FIELD(modMasterStack_t, pool);
+#endif
+    FIELD(modMasterStack_t, message);
+
+    printf("modSlaveStack_t %zu B\n", sizeof(modSlaveStack_t));
+    FIELD(modSlaveStack_t, status);
+    FIELD(modSlaveStack_t, messageLast);
+    FIELD(modSlaveStack_t, lastReg);
+    FIELD(modSlaveStack_t, pfStandby);
+    FIELD(modSlaveStack_t, pfSendAns);
+    FIELD(modSlaveStack_t, pfGetReg);
+    FIELD(modSlaveStack_t, pfSetReg);
+#ifdef MODBUS_USER_COMMANDS
+    FIELD(modSlaveStack_t, pfGetPacket);
+    FIELD(modSlaveStack_t, pfSetPacket);
+#endif
+    FIELD(modSlaveStack_t, userContent);
+#ifdef MODBUS_MESSAGE_POOL
+    FIELD(modSlaveStack_t, pool);
+#endif
+    FIELD(modSlaveStack_t, address);
+    FIELD(modSlaveStack_t, message);
+
+#ifdef MODBUS_MASTER_TABLE
+    printf("modMasterTable_t %zu B, hot state %zu B per stack\n", sizeof(modMasterTable_t),
+           sizeof(((modMasterTable_t*)0)->status[0]) + sizeof(((modMasterTable_t*)0)->rxStartTime[0]) +
+           sizeof(((modMasterTable_t*)0)->rxTimeout[0]));
+#endif
+
+    printf("modStreamFramer_t %zu B\n", sizeof(modStreamFramer_t));
+
+    return 0;
+}
@@ -0,0 +1,191 @@
+/**
+ * @file    modsniff.c
+ * @brief   Passive Modbus RTU bus monitor for Linux. Listens on one or more serial lines without transmitting,
+ *          pairs requests with responses, writes compact binary log (@ref mod_caplog.h) and prints live
+ *          per-slave statistics. All lines are served by single thread.
+ *
+ *          Build:
+ *          gcc -O2 -DMODBUS_PORT_LINUX -I.. -o modsniff modsniff.c ../mod_sniffer.c ../mod_stream_rtu.c
+ *              ../mod_caplog.c ../mod_master_rtu.c ../mod_slave_rtu.c ../mod_port_linux.c ../crc.c
+ *
+ *          Usage:
+ *          modsniff [-b baud] [-p N|E|O] [-o log.bin] [-i stats_interval_s] [-g] device [device ...]
+ *          -g  drop incomplete frame when line is idle for longer than 3.5 character times
+ *              (use only with native UARTs, USB adapters deliver bytes in delayed chunks)
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "mod_sniffer.h"
+#include "mod_port_linux.h"
+
+#define MAX_PORTS   64
+
+static modSniffer_t* sniffers[MAX_PORTS];
+static uint64_t lastRxUs[MAX_PORTS];
+static modCapLog_t capLog;
+static FILE* logFile;
+static volatile sig_atomic_t stop;
+
+static void OnSignal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+static void WriteLog(modSniffer_t* sniffer, const uint8_t* data, uint16_t length)
+{
+    (void)sniffer;
+    (void)fwrite(data, 1, length, logFile);
+}
+
+static void PrintStats(int ports, char* const* devices)
+{
+    for (int p = 0; p < ports; p++)
+    {
+        modSniffer_t* s = sniffers[p];
+
+        fprintf(stderr, "%s: frames %u, dropped bytes %u, orphan answers %u\n",
+                devices[p], s->framer.frames, s->framer.dropped, s->orphans);
+        for (int a = 0; a < MODBUS_SNIFF_SLAVES; a++)
+        {
+            modSnifferSlaveStats_t* st = &s->slaves[a];
+            uint32_t paired = st->answered + st->exceptions + st->corrupted;
+
+            if (st->requests == 0)
+            {
+                continue;
+            }
+            fprintf(stderr, "  %3d: req %u ok %u exc %u bad %u tmo %u inv %u lat us min/avg/max %u/%llu/%u\n",
+                    a, st->requests, st->answered, st->exceptions, st->corrupted, st->timeouts, st->invalid,
+                    st->latencyMinUs, paired ? (unsigned long long)(st->latencySumUs / paired) : 0ULL,
+                    st->latencyMaxUs);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t baud = 19200;
+    char parity = 'E';
+    const char* logName = NULL;
+    unsigned interval = 5;
+    int idleFlush = 0;
+    int opt;
+    int ports;
+    struct pollfd fds[MAX_PORTS];
+    uint64_t nextStats;
+    uint32_t gapUs;
+
+    while ((opt = getopt(argc, argv, "b:p:o:i:g")) != -1)
+    {
+        switch (opt)
+        {
+            case 'b': baud = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'p': parity = optarg[0]; break;
+            case 'o': logName = optarg; break;
+            case 'i': interval = (unsigned)strtoul(optarg, NULL, 10); break;
+            case 'g': idleFlush = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-b baud] [-p N|E|O] [-o log.bin] [-i stats_s] [-g] device...\n", argv[0]);
+                return 2;
+        }
+    }
+    ports = argc - optind;
+    if (ports < 1 || ports > MAX_PORTS)
+    {
+        fprintf(stderr, "1 - %d devices expected\n", MAX_PORTS);
+        return 2;
+    }
+
+    if (logName != NULL)
+    {
+        uint8_t hdr[MODBUS_CAPLOG_HEADER_SIZE];
+
+        logFile = fopen(logName, "wb");
+        if (logFile == NULL)
+        {
+            perror(logName);
+            return 1;
+        }
+        setvbuf(logFile, NULL, _IOFBF, 1 << 20);
+        (void)fwrite(hdr, 1, ModCapLogHeader(hdr), logFile);
+    }
+
+    for (int p = 0; p < ports; p++)
+    {
+        fds[p].fd = ModPortOpenSerial(argv[optind + p], baud, parity);
+        fds[p].events = POLLIN;
+        if (fds[p].fd < 0)
+        {
+            fprintf(stderr, "%s: can't open (%d)\n", argv[optind + p], fds[p].fd);
+            return 1;
+        }
+        sniffers[p] = calloc(1, sizeof(modSniffer_t));
+        if (sniffers[p] == NULL)
+        {
+            return 1;
+        }
+        sniffers[p]->port = (uint8_t)p;
+        sniffers[p]->log = &capLog;
+        sniffers[p]->pfLog = (logFile != NULL) ? &WriteLog : NULL;
+        if (ModSnifferInit(sniffers[p]) < 0)
+        {
+            return 1;
+        }
+    }
+
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+    gapUs = ModPortFrameGapUs(baud);
+    nextStats = ModPortTimeUs() + interval * 1000000ULL;
+
+    while (!stop)
+    {
+        int n = poll(fds, (nfds_t)ports, 10);
+        uint64_t now = ModPortTimeUs();
+
+        if (n < 0 && errno != EINTR)
+        {
+            perror("poll");
+            break;
+        }
+        for (int p = 0; p < ports; p++)
+        {
+            if (fds[p].revents & POLLIN)
+            {
+                uint8_t buf[4096];
+                ssize_t r = read(fds[p].fd, buf, sizeof(buf));
+
+                if (r > 0)
+                {
+                    if (idleFlush && now - lastRxUs[p] > gapUs)
+                    {
+                        ModStreamFlush(&sniffers[p]->framer);
+                    }
+                    lastRxUs[p] = now;
+                    ModSnifferFeed(sniffers[p], buf, (uint32_t)r, now);
+                }
+            }
+            ModSnifferCheck(sniffers[p], now);
+        }
+        if (interval > 0 && now >= nextStats)
+        {
+            PrintStats(ports, argv + optind);
+            nextStats = now + interval * 1000000ULL;
+        }
+    }
+
+    PrintStats(ports, argv + optind);
+    if (logFile != NULL)
+    {
+        fclose(logFile);
+    }
+
+    return 0;
+}